@@ -0,0 +1,136 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "bmp.h"
+#include "codec.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+
+/**
+ * @brief Kinds of synthetic images.
+ */
+typedef enum {
+    PATTERN_NOISE = 0,          /* Uniform random bytes: worst case for the entropy coder */
+    PATTERN_GRADIENT,           /* Smooth horizontal, vertical and diagonal ramps */
+    PATTERN_TEXT,               /* UI-like screen: flat panels, buttons and lines of dark glyphs */
+    PATTERN_PHOTO,              /* Photo-like: multi-octave value noise with smooth color variation and grain */
+    NUM_PATTERNS
+} Corpus_Pattern;
+
+/**
+ * @brief A size class of the benchmark.
+ */
+typedef struct {
+    const char *name;
+    int width;
+    int height;
+} Size_Class;
+
+/**
+ * @brief Number of predefined size classes, from 64x64 up to 8K.
+ */
+#define NUM_SIZE_CLASSES 6
+
+/**
+ * @brief The predefined size classes, smallest first.
+ */
+extern const Size_Class size_classes[NUM_SIZE_CLASSES];
+
+/**
+ * @brief Options of a benchmark run.
+ */
+typedef struct {
+    int iterations;             /* Timed runs of each stage per image (default: 5) */
+    int warmup;                 /* Untimed runs before them (default: 1) */
+    int threads;                /* Encoder and decoder threads; 0 = one per CPU (default: 1) */
+    int size_mask;              /* Bit i set = size_classes[i] is run (default: all) */
+    int pattern_mask;           /* Bit p set = pattern p is run (default: all) */
+    Encoder_Config encoder;     /* Settings of every compression */
+} Bench_Options;
+
+/**
+ * @brief Fills a Bench_Options structure with the default settings.
+ *
+ * @param options Pointer to the options to initialize.
+ */
+void init_bench_options(Bench_Options *options);
+
+/**
+ * @brief Returns the name of a pattern, as used in the JSON output and the options.
+ *
+ * @param pattern The pattern.
+ * @return A static string.
+ */
+const char *pattern_name(Corpus_Pattern pattern);
+
+/**
+ * @brief Parses a comma-separated list of pattern names.
+ *
+ * @param text The option value, e.g. "noise,photo".
+ * @param mask Output for the set of patterns (bit p = pattern p).
+ * @return SUCCESS if every name is known, otherwise FAILURE.
+ */
+int parse_patterns(const char *text, int *mask);
+
+/**
+ * @brief Parses a comma-separated list of size class names.
+ *
+ * @param text The option value, e.g. "64x64,1080p".
+ * @param mask Output for the set of size classes (bit i = size_classes[i]).
+ * @return SUCCESS if every name is known, otherwise FAILURE.
+ */
+int parse_sizes(const char *text, int *mask);
+
+/**
+ * @brief Generates a synthetic image.
+ *
+ * The pixels only depend on the pattern and the size, so every run and every
+ * release benchmarks the same images.
+ *
+ * @param pattern Kind of image.
+ * @param width Image width.
+ * @param height Image height.
+ * @param top_row First pixel (BGR) of the top row.
+ * @param stride Bytes from a row to the one below it (negative for bottom-up buffers).
+ */
+void generate_image(Corpus_Pattern pattern, int width, int height, uint8_t *top_row, ptrdiff_t stride);
+
+/**
+ * @brief Writes the selected images of the corpus as BMP files, e.g. for the compressor's batch mode.
+ *
+ * The files are named <pattern>_<size class>.bmp.
+ *
+ * @param output_dir Existing directory receiving the files.
+ * @param options Options selecting the patterns and size classes.
+ * @return SUCCESS, or FAILURE if a file cannot be written.
+ */
+int write_corpus(const char *output_dir, const Bench_Options *options);
+
+/**
+ * @brief Compresses and decompresses every selected image in memory and writes the results as JSON.
+ *
+ * For each pattern and size class, reports the compressed bytes per pixel, the
+ * PSNR of the round trip and, for compression and decompression, megapixels per
+ * second with the median (p50), p99 and minimum latency.
+ *
+ * @param options Benchmark options.
+ * @param json Output receiving the JSON document.
+ * @return SUCCESS, or FAILURE if an image cannot be allocated, compressed or decompressed.
+ */
+int run_benchmarks(const Bench_Options *options, FILE *json);
+
+/**
+ * @brief Checks that the entropy coding round trips at every quality.
+ *
+ * Encodes 64x64 check images (gray columns repeating every 8 pixels and the selected
+ * patterns) at every quality, once with the standard Huffman tables and once
+ * with the image's own tables, and decodes both streams. Both carry the same
+ * coefficients, so their pixels must be identical; a code the decoder reads
+ * differently shows up as a difference or a decoding error.
+ *
+ * @param options Options selecting the patterns and the other encoder settings.
+ * @return SUCCESS, or FAILURE if a stream cannot be decoded or the two decode differently.
+ */
+int run_round_trip_checks(const Bench_Options *options);
+
+#endif /* BENCH_H */
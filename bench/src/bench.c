@@ -0,0 +1,231 @@
+// clock_gettime()
+#define _POSIX_C_SOURCE 200809L
+
+#include "bench.h"
+
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * Timings of one stage over the timed iterations.
+ */
+typedef struct {
+    double *seconds;            /* One entry per iteration */
+    int count;
+    uint64_t pixels;            /* Pixels processed per iteration */
+} Stage_Times;
+
+/**
+ * Totals of a size class over all its patterns.
+ */
+typedef struct {
+    double *compress;           /* Every compression latency of the class */
+    double *decompress;
+    int count;
+    uint64_t pixels;            /* Pixels compressed (and decompressed) in all timed runs */
+    uint64_t bytes;             /* Compressed bytes of one run of each image */
+    uint64_t image_pixels;      /* Pixels of one run of each image */
+} Class_Totals;
+
+void init_bench_options(Bench_Options *options) {
+    options->iterations = 5;
+    options->warmup = 1;
+    options->threads = 1;
+    options->size_mask = (1 << NUM_SIZE_CLASSES) - 1;
+    options->pattern_mask = (1 << NUM_PATTERNS) - 1;
+    init_encoder_config(&options->encoder);
+}
+
+static double now_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of sorted values
+static double percentile(const double *sorted, int count, double p) {
+    int rank = (int)ceil(p / 100.0 * count);
+    if (rank < 1) rank = 1;
+    if (rank > count) rank = count;
+    return sorted[rank - 1];
+}
+
+// Writes {"mpix_per_s", "p50_ms", "p99_ms", "min_ms"} for a set of latencies (sorted in place)
+static void write_stage(FILE *json, const char *name, double *seconds, int count, uint64_t pixels) {
+    double total = 0;
+    for (int i = 0; i < count; i++) {
+        total += seconds[i];
+    }
+    qsort(seconds, count, sizeof(double), compare_doubles);
+
+    fprintf(json, "\"%s\": {\"mpix_per_s\": %.3f, \"p50_ms\": %.3f, \"p99_ms\": %.3f, \"min_ms\": %.3f}",
+            name, total > 0 ? pixels / total / 1e6 : 0.0, 1e3 * percentile(seconds, count, 50),
+            1e3 * percentile(seconds, count, 99), 1e3 * seconds[0]);
+}
+
+// PSNR of the decoded image against the original, in dB; negative if they are identical
+static double psnr(const uint8_t *a, const uint8_t *b, size_t bytes) {
+    double sum = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        int d = (int)a[i] - (int)b[i];
+        sum += (double)(d * d);
+    }
+    if (sum == 0) return -1;
+    return 10.0 * log10(255.0 * 255.0 * (double)bytes / sum);
+}
+
+/**
+ * Runs one image: warmup, then the timed compressions and decompressions.
+ * Writes its JSON object and adds its timings to the class totals.
+ */
+static int bench_image(const Bench_Options *options, const Size_Class *size, Corpus_Pattern pattern,
+                       Class_Totals *totals, int first, FILE *json) {
+    int width = size->width, height = size->height;
+    size_t bytes = (size_t)width * height * 3;
+    uint8_t *pixels = malloc(bytes);
+    uint8_t *decoded = malloc(bytes);
+    Memory_Buffer encoded = {NULL, 0, 0};
+    if (!pixels || !decoded) {
+        printf("Error allocating a %dx%d image.\n", width, height);
+        free(pixels);
+        free(decoded);
+        return FAILURE;
+    }
+
+    generate_image(pattern, width, height, pixels, (ptrdiff_t)width * 3);
+    Pixel_Image source = {pixels, width, height, (ptrdiff_t)width * 3, PIXEL_BGR};
+    Pixel_Image target = {decoded, width, height, (ptrdiff_t)width * 3, PIXEL_BGR};
+
+    Encoder_Config encoder = options->encoder;
+    encoder.threads = options->threads;
+    Decoder_Config decoder;
+    init_decoder_config(&decoder);
+    decoder.idct_method = options->encoder.dct_method;
+    decoder.threads = options->threads;
+
+    double *compress = totals->compress + totals->count;
+    double *decompress = totals->decompress + totals->count;
+    Codec_Status status = CODEC_OK;
+
+    for (int i = -options->warmup; i < options->iterations && status == CODEC_OK; i++) {
+        double start = now_seconds();
+        status = encode_image_to_memory(&source, &encoder, &encoded);
+        double middle = now_seconds();
+        if (status == CODEC_OK) status = decode_image(encoded.data, encoded.size, &decoder, &target);
+        double end = now_seconds();
+
+        if (i >= 0) {
+            compress[i] = middle - start;
+            decompress[i] = end - middle;
+        }
+    }
+
+    if (status != CODEC_OK) {
+        printf("Error benchmarking %s %s: %s.\n", pattern_name(pattern), size->name, codec_status_text(status));
+        free(pixels);
+        free(decoded);
+        free(encoded.data);
+        return FAILURE;
+    }
+
+    uint64_t image_pixels = (uint64_t)width * height;
+    double quality = psnr(pixels, decoded, bytes);
+
+    fprintf(json, "%s    {\"pattern\": \"%s\", \"size_class\": \"%s\", \"width\": %d, \"height\": %d, "
+                  "\"bytes\": %zu, \"bytes_per_pixel\": %.4f, \"psnr_db\": ",
+            first ? "" : ",\n", pattern_name(pattern), size->name, width, height,
+            encoded.size, (double)encoded.size / image_pixels);
+    if (quality < 0) fprintf(json, "null, ");
+    else fprintf(json, "%.2f, ", quality);
+
+    // Stage summaries sort copies, so the class totals keep the raw timings
+    double *sorted = malloc(2 * (size_t)options->iterations * sizeof(double));
+    if (sorted) {
+        memcpy(sorted, compress, options->iterations * sizeof(double));
+        memcpy(sorted + options->iterations, decompress, options->iterations * sizeof(double));
+        write_stage(json, "compress", sorted, options->iterations, image_pixels * options->iterations);
+        fprintf(json, ", ");
+        write_stage(json, "decompress", sorted + options->iterations, options->iterations,
+                    image_pixels * options->iterations);
+        free(sorted);
+    }
+    fprintf(json, "}");
+
+    totals->count += options->iterations;
+    totals->pixels += image_pixels * options->iterations;
+    totals->bytes += encoded.size;
+    totals->image_pixels += image_pixels;
+
+    fprintf(stderr, "%-8s %-8s %7.3f bytes/pixel\n", pattern_name(pattern), size->name,
+            (double)encoded.size / image_pixels);
+
+    free(pixels);
+    free(decoded);
+    free(encoded.data);
+    return sorted ? SUCCESS : FAILURE;
+}
+
+int run_benchmarks(const Bench_Options *options, FILE *json) {
+    int num_patterns = 0;
+    for (int p = 0; p < NUM_PATTERNS; p++) {
+        if (options->pattern_mask & (1 << p)) num_patterns++;
+    }
+
+    Class_Totals totals[NUM_SIZE_CLASSES];
+    memset(totals, 0, sizeof(totals));
+    int status = SUCCESS;
+    for (int s = 0; s < NUM_SIZE_CLASSES && status == SUCCESS; s++) {
+        if (!(options->size_mask & (1 << s))) continue;
+        totals[s].compress = malloc((size_t)num_patterns * options->iterations * sizeof(double));
+        totals[s].decompress = malloc((size_t)num_patterns * options->iterations * sizeof(double));
+        if (!totals[s].compress || !totals[s].decompress) status = FAILURE;
+    }
+
+    fprintf(json, "{\n  \"benchmark\": \"libjpeg\",\n  \"format_version\": 1,\n"
+                  "  \"iterations\": %d,\n  \"warmup\": %d,\n  \"threads\": %d,\n  \"cpus\": %d,\n"
+                  "  \"dct_method\": \"%s\",\n  \"restart_interval\": %d,\n  \"index_interval\": %d,\n"
+                  "  \"optimize_huffman\": %s,\n  \"quality\": %d,\n  \"results\": [\n",
+            options->iterations, options->warmup, options->threads, available_cpus(),
+            options->encoder.dct_method == DCT_METHOD_MATRIX ? "matrix" : "fast",
+            options->encoder.restart_interval, options->encoder.index_interval,
+            options->encoder.optimize_huffman ? "true" : "false", options->encoder.quality);
+
+    int first = 1;
+    for (int s = 0; s < NUM_SIZE_CLASSES && status == SUCCESS; s++) {
+        if (!(options->size_mask & (1 << s))) continue;
+        for (int p = 0; p < NUM_PATTERNS && status == SUCCESS; p++) {
+            if (!(options->pattern_mask & (1 << p))) continue;
+            status = bench_image(options, &size_classes[s], (Corpus_Pattern)p, &totals[s], first, json);
+            first = 0;
+        }
+    }
+
+    // Per size class, over all its patterns
+    fprintf(json, "\n  ],\n  \"size_classes\": [\n");
+    first = 1;
+    for (int s = 0; s < NUM_SIZE_CLASSES && status == SUCCESS; s++) {
+        Class_Totals *t = &totals[s];
+        if (!(options->size_mask & (1 << s)) || t->count == 0) continue;
+
+        fprintf(json, "%s    {\"size_class\": \"%s\", \"images\": %d, \"bytes_per_pixel\": %.4f, ",
+                first ? "" : ",\n", size_classes[s].name, num_patterns, (double)t->bytes / t->image_pixels);
+        write_stage(json, "compress", t->compress, t->count, t->pixels);
+        fprintf(json, ", ");
+        write_stage(json, "decompress", t->decompress, t->count, t->pixels);
+        fprintf(json, "}");
+        first = 0;
+    }
+    fprintf(json, "\n  ]\n}\n");
+
+    for (int s = 0; s < NUM_SIZE_CLASSES; s++) {
+        free(totals[s].compress);
+        free(totals[s].decompress);
+    }
+    return status;
+}
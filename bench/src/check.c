@@ -0,0 +1,113 @@
+#include "bench.h"
+
+#include <string.h>
+
+// Size of the check images: enough stripes and blocks for every AC category, small enough for every quality
+#define CHECK_WIDTH 64
+#define CHECK_HEIGHT 64
+
+// Offset of bfReserved1 (the format flags) in an encoded stream
+#define FLAGS_OFFSET 6
+
+// Gray columns repeating 255,255,0,0,0,0,255,255 across every block: at high qualities their AC coefficients
+// reach categories 9 and 10 with zero runs of 2, the symbols whose provided codes once collided
+static void generate_stripes(uint8_t *pixels) {
+    static const uint8_t levels[8] = {255, 255, 0, 0, 0, 0, 255, 255};
+    for (int y = 0; y < CHECK_HEIGHT; y++) {
+        for (int x = 0; x < CHECK_WIDTH; x++) {
+            memset(pixels + ((size_t)y * CHECK_WIDTH + x) * 3, levels[x % 8], 3);
+        }
+    }
+}
+
+// Encodes 'source' with the given settings and decodes it into 'decoded'; 'flags' receives the format flags
+static Codec_Status encode_and_decode(const Pixel_Image *source, const Encoder_Config *encoder,
+                                      const Decoder_Config *decoder, const Pixel_Image *decoded, int *flags) {
+    Memory_Buffer encoded = {NULL, 0, 0};
+    Codec_Status status = encode_image_to_memory(source, encoder, &encoded);
+    if (status == CODEC_OK) {
+        *flags = encoded.size > FLAGS_OFFSET + 1 ? encoded.data[FLAGS_OFFSET] | encoded.data[FLAGS_OFFSET + 1] << 8
+                                                 : 0;
+        status = decode_image(encoded.data, encoded.size, decoder, decoded);
+    }
+    free(encoded.data);
+    return status;
+}
+
+// Checks one image at every quality; returns the number of failed qualities
+static int check_image(const Bench_Options *options, const char *name, const uint8_t *pixels,
+                       int *checked, int *image_tables) {
+    size_t bytes = (size_t)CHECK_WIDTH * CHECK_HEIGHT * 3;
+    uint8_t *standard = malloc(bytes);
+    uint8_t *optimized = malloc(bytes);
+    if (!standard || !optimized) {
+        printf("Error allocating the decoded %s image.\n", name);
+        free(standard);
+        free(optimized);
+        return 1;
+    }
+
+    Pixel_Image source = {(uint8_t *)pixels, CHECK_WIDTH, CHECK_HEIGHT, CHECK_WIDTH * 3, PIXEL_BGR};
+    Pixel_Image standard_image = {standard, CHECK_WIDTH, CHECK_HEIGHT, CHECK_WIDTH * 3, PIXEL_BGR};
+    Pixel_Image optimized_image = {optimized, CHECK_WIDTH, CHECK_HEIGHT, CHECK_WIDTH * 3, PIXEL_BGR};
+
+    Encoder_Config encoder = options->encoder;
+    encoder.threads = options->threads;
+    encoder.target_bytes = 0;
+    Decoder_Config decoder;
+    init_decoder_config(&decoder);
+    decoder.idct_method = options->encoder.dct_method;
+    decoder.threads = options->threads;
+
+    int failures = 0;
+    for (int quality = MIN_QUALITY; quality <= MAX_QUALITY; quality++) {
+        int flags = 0;
+        encoder.quality = quality;
+        encoder.optimize_huffman = 0;
+        Codec_Status status = encode_and_decode(&source, &encoder, &decoder, &standard_image, &flags);
+        if (status == CODEC_OK) {
+            encoder.optimize_huffman = 1;
+            status = encode_and_decode(&source, &encoder, &decoder, &optimized_image, &flags);
+        }
+
+        *checked += 1;
+        if (status != CODEC_OK) {
+            printf("Round trip of %s at quality %d failed: %s.\n", name, quality, codec_status_text(status));
+            failures++;
+        } else if (flags & BIN_FLAG_HUFFMAN) {
+            *image_tables += 1;
+            if (memcmp(standard, optimized, bytes) != 0) {
+                printf("Round trip of %s at quality %d: the standard and the image tables decode differently.\n",
+                       name, quality);
+                failures++;
+            }
+        }
+    }
+
+    free(standard);
+    free(optimized);
+    return failures;
+}
+
+int run_round_trip_checks(const Bench_Options *options) {
+    uint8_t *pixels = malloc((size_t)CHECK_WIDTH * CHECK_HEIGHT * 3);
+    if (!pixels) {
+        printf("Error allocating a %dx%d image.\n", CHECK_WIDTH, CHECK_HEIGHT);
+        return FAILURE;
+    }
+
+    int checked = 0, image_tables = 0;
+    generate_stripes(pixels);
+    int failures = check_image(options, "stripes", pixels, &checked, &image_tables);
+
+    for (int p = 0; p < NUM_PATTERNS; p++) {
+        if (!(options->pattern_mask & (1 << p))) continue;
+        generate_image((Corpus_Pattern)p, CHECK_WIDTH, CHECK_HEIGHT, pixels, CHECK_WIDTH * 3);
+        failures += check_image(options, pattern_name((Corpus_Pattern)p), pixels, &checked, &image_tables);
+    }
+
+    free(pixels);
+    printf("Round trip: %d images and qualities checked, %d of them with the image's own tables, %d failed.\n",
+           checked, image_tables, failures);
+    return failures == 0 ? SUCCESS : FAILURE;
+}
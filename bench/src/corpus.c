@@ -0,0 +1,283 @@
+#include "bench.h"
+
+#include <string.h>
+
+const Size_Class size_classes[NUM_SIZE_CLASSES] = {
+    {"64x64", 64, 64},
+    {"256x256", 256, 256},
+    {"vga", 640, 480},
+    {"1080p", 1920, 1080},
+    {"4k", 3840, 2160},
+    {"8k", 7680, 4320},
+};
+
+static const char *pattern_names[NUM_PATTERNS] = {"noise", "gradient", "text", "photo"};
+
+// Text layout of the UI pattern, in pixels
+#define GLYPH_WIDTH 5
+#define GLYPH_HEIGHT 7
+#define CELL_WIDTH 7
+#define LINE_HEIGHT 14
+
+const char *pattern_name(Corpus_Pattern pattern) {
+    return pattern >= 0 && pattern < NUM_PATTERNS ? pattern_names[pattern] : "unknown";
+}
+
+// Parses a comma-separated list of names from 'names' into a bit mask
+static int parse_name_list(const char *text, const char *const *names, int count, int *mask) {
+    *mask = 0;
+    const char *start = text;
+    for (;;) {
+        const char *end = strchr(start, ',');
+        size_t len = end ? (size_t)(end - start) : strlen(start);
+
+        int found = -1;
+        for (int i = 0; i < count; i++) {
+            if (strlen(names[i]) == len && strncmp(names[i], start, len) == 0) found = i;
+        }
+        if (found < 0) return FAILURE;
+        *mask |= 1 << found;
+
+        if (!end) return SUCCESS;
+        start = end + 1;
+    }
+}
+
+int parse_patterns(const char *text, int *mask) {
+    return parse_name_list(text, pattern_names, NUM_PATTERNS, mask);
+}
+
+int parse_sizes(const char *text, int *mask) {
+    const char *names[NUM_SIZE_CLASSES];
+    for (int i = 0; i < NUM_SIZE_CLASSES; i++) {
+        names[i] = size_classes[i].name;
+    }
+    return parse_name_list(text, names, NUM_SIZE_CLASSES, mask);
+}
+
+// Integer hash of a lattice point or glyph, so patterns need no random state to be reproducible
+static uint32_t hash3(uint32_t a, uint32_t b, uint32_t c) {
+    uint32_t h = a * 0x9E3779B1u ^ b * 0x85EBCA77u ^ c * 0xC2B2AE3Du;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 12;
+    h *= 0x297A2D39u;
+    h ^= h >> 15;
+    return h;
+}
+
+static uint8_t clamp_byte(int value) {
+    return value < 0 ? 0 : value > 255 ? 255 : (uint8_t)value;
+}
+
+static void generate_noise(int width, int height, uint8_t *top_row, ptrdiff_t stride) {
+    for (int y = 0; y < height; y++) {
+        uint8_t *row = top_row + (ptrdiff_t)y * stride;
+        for (int x = 0; x < width; x++) {
+            uint32_t h = hash3((uint32_t)x, (uint32_t)y, 1);
+            row[3 * x] = (uint8_t)h;
+            row[3 * x + 1] = (uint8_t)(h >> 8);
+            row[3 * x + 2] = (uint8_t)(h >> 16);
+        }
+    }
+}
+
+static void generate_gradient(int width, int height, uint8_t *top_row, ptrdiff_t stride) {
+    int64_t w = width > 1 ? width - 1 : 1;
+    int64_t h = height > 1 ? height - 1 : 1;
+    for (int y = 0; y < height; y++) {
+        uint8_t *row = top_row + (ptrdiff_t)y * stride;
+        for (int x = 0; x < width; x++) {
+            row[3 * x] = (uint8_t)(x * 255 / w);
+            row[3 * x + 1] = (uint8_t)(y * 255 / h);
+            row[3 * x + 2] = (uint8_t)((x + y) * 255 / (w + h));
+        }
+    }
+}
+
+// Bit (gx, gy) of the 5x7 glyph at text cell (line, column); ~1 cell in 6 is a space between words
+static int glyph_bit(int line, int column, int gx, int gy) {
+    uint32_t h = hash3((uint32_t)line, (uint32_t)column, 2);
+    if (h % 6 == 0) return 0;
+    uint32_t bits = hash3(h, (uint32_t)gy, 3);
+    return (bits >> gx) & 1;
+}
+
+// Title bar, side panel, and lines of text of varying length, some of them on accent-colored buttons
+static void generate_text(int width, int height, uint8_t *top_row, ptrdiff_t stride) {
+    int bar_height = height / 16 > LINE_HEIGHT ? height / 16 : LINE_HEIGHT;
+    int panel_width = width / 5;
+
+    for (int y = 0; y < height; y++) {
+        uint8_t *row = top_row + (ptrdiff_t)y * stride;
+        int in_bar = y < bar_height;
+        int line = in_bar ? -1 : (y - bar_height) / LINE_HEIGHT;
+        int gy = (in_bar ? y : (y - bar_height) % LINE_HEIGHT) - (LINE_HEIGHT - GLYPH_HEIGHT) / 2;
+        uint32_t line_hash = hash3((uint32_t)line, 0, 4);
+        int line_length = (int)(line_hash % (uint32_t)(width / CELL_WIDTH + 1));
+        int button = !in_bar && line % 9 == 4;
+
+        for (int x = 0; x < width; x++) {
+            int b, g, r;
+            if (in_bar) {
+                b = 160, g = 90, r = 60;
+            } else if (x < panel_width) {
+                b = 225, g = 215, r = 210;
+            } else if (button && x < panel_width + line_length * CELL_WIDTH / 3) {
+                b = 40, g = 140, r = 230;
+            } else {
+                b = 250, g = 250, r = 250;
+            }
+
+            int column = x / CELL_WIDTH;
+            int gx = x % CELL_WIDTH;
+            if (gy >= 0 && gy < GLYPH_HEIGHT && gx < GLYPH_WIDTH && column < line_length &&
+                glyph_bit(line, column, gx, gy)) {
+                // Light text on the bar and the buttons, dark text elsewhere
+                int light = in_bar || (button && b == 40);
+                b = g = r = light ? 255 : 30;
+            }
+
+            row[3 * x] = (uint8_t)b;
+            row[3 * x + 1] = (uint8_t)g;
+            row[3 * x + 2] = (uint8_t)r;
+        }
+    }
+}
+
+/**
+ * Random values on a square lattice, bilinearly interpolated between the
+ * points; the sum of a few of them at decreasing cell sizes is value noise.
+ */
+typedef struct {
+    int cell;                   /* Pixels between lattice points */
+    int columns;
+    uint8_t *values;
+} Lattice;
+
+static int init_lattice(Lattice *lattice, int cell, int width, int height, uint32_t seed) {
+    int columns = width / cell + 2;
+    int rows = height / cell + 2;
+    lattice->cell = cell;
+    lattice->columns = columns;
+    lattice->values = malloc((size_t)columns * rows);
+    if (!lattice->values) return FAILURE;
+
+    for (int j = 0; j < rows; j++) {
+        for (int i = 0; i < columns; i++) {
+            lattice->values[(size_t)j * columns + i] = (uint8_t)hash3((uint32_t)i, (uint32_t)j, seed);
+        }
+    }
+    return SUCCESS;
+}
+
+// Interpolated value at a pixel, 0..255
+static int lattice_value(const Lattice *lattice, int x, int y) {
+    int cell = lattice->cell;
+    int i = x / cell, fx = x % cell;
+    int j = y / cell, fy = y % cell;
+    const uint8_t *p = lattice->values + (size_t)j * lattice->columns + i;
+
+    int top = p[0] * (cell - fx) + p[1] * fx;
+    int bottom = p[lattice->columns] * (cell - fx) + p[lattice->columns + 1] * fx;
+    return (top * (cell - fy) + bottom * fy) / (cell * cell);
+}
+
+// Luma from four octaves of value noise, chroma from two coarse ones, plus a little grain
+static void generate_photo(int width, int height, uint8_t *top_row, ptrdiff_t stride) {
+    static const int luma_cells[4] = {256, 64, 16, 4};
+    static const int luma_weights[4] = {8, 4, 2, 1};
+    Lattice luma[4], blue, red;
+    int ok = 1;
+
+    for (int o = 0; o < 4; o++) {
+        ok &= init_lattice(&luma[o], luma_cells[o], width, height, 10 + o) == SUCCESS;
+    }
+    ok &= init_lattice(&blue, 512, width, height, 20) == SUCCESS;
+    ok &= init_lattice(&red, 384, width, height, 21) == SUCCESS;
+
+    for (int y = 0; y < height && ok; y++) {
+        uint8_t *row = top_row + (ptrdiff_t)y * stride;
+        for (int x = 0; x < width; x++) {
+            int l = 0;
+            for (int o = 0; o < 4; o++) {
+                l += luma_weights[o] * lattice_value(&luma[o], x, y);
+            }
+            l /= 15;
+
+            int u = lattice_value(&blue, x, y) - 128;
+            int v = lattice_value(&red, x, y) - 128;
+            int grain = (int)(hash3((uint32_t)x, (uint32_t)y, 5) & 7) - 3;
+
+            row[3 * x] = clamp_byte(l + u / 2 + grain);
+            row[3 * x + 1] = clamp_byte(l - (u + v) / 4 + grain);
+            row[3 * x + 2] = clamp_byte(l + v / 2 + grain);
+        }
+    }
+
+    // Without memory for the lattices, fall back to a flat gray image
+    if (!ok) {
+        for (int y = 0; y < height; y++) {
+            memset(top_row + (ptrdiff_t)y * stride, 128, (size_t)width * 3);
+        }
+    }
+
+    for (int o = 0; o < 4; o++) {
+        free(luma[o].values);
+    }
+    free(blue.values);
+    free(red.values);
+}
+
+void generate_image(Corpus_Pattern pattern, int width, int height, uint8_t *top_row, ptrdiff_t stride) {
+    switch (pattern) {
+        case PATTERN_NOISE: generate_noise(width, height, top_row, stride); break;
+        case PATTERN_GRADIENT: generate_gradient(width, height, top_row, stride); break;
+        case PATTERN_TEXT: generate_text(width, height, top_row, stride); break;
+        case PATTERN_PHOTO: generate_photo(width, height, top_row, stride); break;
+        default: break;
+    }
+}
+
+// Generates the image straight into its mapped BMP file
+static int write_corpus_image(const char *path, Corpus_Pattern pattern, int width, int height) {
+    BMPFILEHEADER fileHeader;
+    BMPINFOHEADER infoHeader;
+    if (init_bmp_headers(&fileHeader, &infoHeader, width, height) != SUCCESS) return FAILURE;
+
+    Mapped_Output output;
+    if (create_mapped_output(path, (size_t)bmp_file_size(&fileHeader, width, height), &output) != SUCCESS) {
+        return FAILURE;
+    }
+    store_bmp_headers(output.data, &fileHeader, &infoHeader);
+
+    size_t top_offset;
+    ptrdiff_t stride;
+    if (bmp_pixel_rows(output.size, &fileHeader, width, height, &top_offset, &stride) != SUCCESS) {
+        close_mapped_output(&output);
+        return FAILURE;
+    }
+
+    generate_image(pattern, width, height, output.data + top_offset, stride);
+    return close_mapped_output(&output);
+}
+
+int write_corpus(const char *output_dir, const Bench_Options *options) {
+    for (int s = 0; s < NUM_SIZE_CLASSES; s++) {
+        if (!(options->size_mask & (1 << s))) continue;
+        const Size_Class *size = &size_classes[s];
+
+        for (int p = 0; p < NUM_PATTERNS; p++) {
+            if (!(options->pattern_mask & (1 << p))) continue;
+
+            char path[4096];
+            snprintf(path, sizeof(path), "%s/%s_%s.bmp", output_dir, pattern_names[p], size->name);
+            if (write_corpus_image(path, (Corpus_Pattern)p, size->width, size->height) != SUCCESS) {
+                printf("Error writing %s.\n", path);
+                return FAILURE;
+            }
+            printf("%s\n", path);
+        }
+    }
+    return SUCCESS;
+}
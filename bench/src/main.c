@@ -0,0 +1,126 @@
+#include "bench.h"
+
+#include <string.h>
+
+// Parses a positive iteration count (or a non-negative one when 'allow_zero')
+static int parse_count(const char *text, int allow_zero, int *count) {
+    char *end;
+    long value = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || value < (allow_zero ? 0 : 1) || value > 100000) return FAILURE;
+
+    *count = (int)value;
+    return SUCCESS;
+}
+
+/**
+ * @brief Main entry point for the benchmark.
+ *
+ * Generates the synthetic corpus in memory, compresses and decompresses every
+ * image and writes the results as JSON (see run_benchmarks()).
+ *
+ * Options:
+ *   --iterations <n>      Timed runs per image (default: 5).
+ *   --warmup <n>          Untimed runs per image before them (default: 1).
+ *   --threads <n>         Encoder and decoder threads, 0 = one per CPU (default: 1).
+ *   --sizes <list>        Size classes: 64x64,256x256,vga,1080p,4k,8k (default: all).
+ *   --patterns <list>     Patterns: noise,gradient,text,photo (default: all).
+ *   --dct <matrix|fast>   DCT and IDCT implementation (default: fast).
+ *   --restart <n>         Restart segment every n 16-row stripes (default: 0).
+ *   --index <n>           Index entry every n 16-row stripes (default: 0).
+ *   --optimize            Two-pass encode with Huffman tables built for each image.
+ *   --quality <1-100>     Quality factor of the quantization matrices (default: 50).
+ *   --output <file>       Write the JSON to a file instead of stdout.
+ *   --corpus <dir>        Only write the selected images as BMP files into an existing directory.
+ *   --check               Only check that 64x64 images round trip at every quality (see run_round_trip_checks()).
+ *
+ * @param argc Number of command-line arguments.
+ * @param argv Array of command-line argument strings.
+ * @return SUCCESS if every benchmark ran, otherwise FAILURE.
+ */
+int main(int argc, char *argv[]) {
+    Bench_Options options;
+    init_bench_options(&options);
+    const char *output = NULL;
+    const char *corpus_dir = NULL;
+    int check = 0;
+
+    int arg = 1;
+    while (arg < argc) {
+        if (strcmp(argv[arg], "--optimize") == 0) {
+            options.encoder.optimize_huffman = 1;
+            arg += 1;
+            continue;
+        }
+        if (strcmp(argv[arg], "--check") == 0) {
+            check = 1;
+            arg += 1;
+            continue;
+        }
+
+        const char *value = arg + 1 < argc ? argv[arg + 1] : NULL;
+        if (!value) {
+            printf("Invalid option: %s\n", argv[arg]);
+            exit(FAILURE);
+        }
+
+        if (strcmp(argv[arg], "--iterations") == 0 && parse_count(value, 0, &options.iterations) == SUCCESS) {
+            arg += 2;
+        } else if (strcmp(argv[arg], "--warmup") == 0 && parse_count(value, 1, &options.warmup) == SUCCESS) {
+            arg += 2;
+        } else if (strcmp(argv[arg], "--threads") == 0 && parse_thread_count(value, &options.threads) == SUCCESS) {
+            arg += 2;
+        } else if (strcmp(argv[arg], "--sizes") == 0 && parse_sizes(value, &options.size_mask) == SUCCESS) {
+            arg += 2;
+        } else if (strcmp(argv[arg], "--patterns") == 0 && parse_patterns(value, &options.pattern_mask) == SUCCESS) {
+            arg += 2;
+        } else if (strcmp(argv[arg], "--dct") == 0 && parse_dct_method(value, &options.encoder.dct_method) == SUCCESS) {
+            arg += 2;
+        } else if (strcmp(argv[arg], "--restart") == 0 &&
+                   parse_stripe_interval(value, &options.encoder.restart_interval) == SUCCESS) {
+            arg += 2;
+        } else if (strcmp(argv[arg], "--index") == 0 &&
+                   parse_stripe_interval(value, &options.encoder.index_interval) == SUCCESS) {
+            arg += 2;
+        } else if (strcmp(argv[arg], "--quality") == 0 && parse_quality(value, &options.encoder.quality) == SUCCESS) {
+            arg += 2;
+        } else if (strcmp(argv[arg], "--output") == 0) {
+            output = value;
+            arg += 2;
+        } else if (strcmp(argv[arg], "--corpus") == 0) {
+            corpus_dir = value;
+            arg += 2;
+        } else {
+            printf("Invalid option: %s\n", argv[arg]);
+            printf("Usage: %s [--iterations n] [--warmup n] [--threads n] [--sizes list] [--patterns list]\n"
+                   "          [--dct matrix|fast] [--restart n] [--index n] [--optimize] [--quality 1-100]\n"
+                   "          [--output file.json] [--corpus dir] [--check]\n"
+                   "Sizes: 64x64,256x256,vga,1080p,4k,8k. Patterns: noise,gradient,text,photo.\n", argv[0]);
+            exit(FAILURE);
+        }
+    }
+
+    if (check) {
+        if (run_round_trip_checks(&options) != SUCCESS) exit(FAILURE);
+        return SUCCESS;
+    }
+
+    if (corpus_dir) {
+        if (write_corpus(corpus_dir, &options) != SUCCESS) exit(FAILURE);
+        return SUCCESS;
+    }
+
+    FILE *json = output ? fopen(output, "w") : stdout;
+    if (!json) {
+        printf("Error creating output file.\n");
+        exit(FAILURE);
+    }
+
+    int status = run_benchmarks(&options, json);
+    if (output && fclose(json) != 0) status = FAILURE;
+    if (status != SUCCESS) {
+        printf("Benchmark failed.\n");
+        exit(FAILURE);
+    }
+
+    return SUCCESS;
+}
@@ -1,3 +1,4 @@
 cd libjpeg && make clean
 cd ../compressor && make clean
 cd ../decompressor && make clean
+cd ../bench && make clean
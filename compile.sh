@@ -4,3 +4,4 @@ cd ../decompressor && make clean
 cd ../libjpeg && make
 cd ../compressor && make
 cd ../decompressor && make
+cd ../bench && make
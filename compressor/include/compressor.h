@@ -3,12 +3,40 @@
 
 #include "img_functions.h"
 #include "bmp.h"
+#include "dct.h"
+#include "encoder.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+#include "batch.h"
+#include "stats.h"
+
+/**
+ * @brief Options that control the compression pipeline.
+ */
+typedef struct {
+    DCT_Method dct_method;      /* Forward DCT implementation (default: DCT_METHOD_FAST) */
+    int threads;                /* Threads for the transform stages; 0 = one per CPU (default: 1) */
+    int restart_interval;       /* Stripes per restart segment; 0 = no restarts (default: 0) */
+    int index_interval;         /* Stripes between index entries for region decoding; 0 = no index (default: 0) */
+    int optimize_huffman;       /* Code with Huffman tables built for the image, in two passes (default: 0) */
+    int quality;                /* Quality factor scaling the quantization matrices, 1 to 100 (default: 50) */
+    uint64_t target_bytes;      /* Largest output wanted; the quality is searched to fit it. 0 = off (default: 0) */
+    int stats;                  /* Print stage timings and symbol counters as JSON instead of the report (default: 0) */
+} Compress_Options;
+
+/**
+ * @brief Fills a Compress_Options structure with the default settings.
+ *
+ * @param options Pointer to the options to initialize.
+ */
+void init_compress_options(Compress_Options *options);
 
 /**
  * @brief Compresses a BMP file into a BIN file.
  *
- * This function opens the BMP file, reads its header and pixel data,
- * and then compresses the data into BIN format still with the BMP header.
+ * This function opens the BMP file, reads its header and then streams the pixel rows,
+ * top to bottom, through a Stream_Encoder into BIN format still with the BMP header.
+ * Uses the default options (see init_compress_options()).
  * 
  * @param input_bmp Path to the input BMP file.
  * @param output_bin Path to the output BIN file.
@@ -17,51 +45,33 @@
 int compress_bmp(const char *input_bmp, const char *output_bin);
 
 /**
- * @brief Applies DCT, quantization, and zig-zag ordering to Y, Cb, and Cr image channels.
+ * @brief Compresses a BMP file into a BIN file using the given options.
  *
- * This function receives a linear array of pixels in the YCbCr color space,
- * splits them into blocks, applies the Discrete Cosine Transform (DCT)
- * to each block, quantizes the resulting coefficients, and finally
- * reorders them in zig-zag order for compression.
+ * With options->stats, the report is replaced by a JSON object with the file
+ * sizes and the Pipeline_Stats of the run (see stats.h).
  *
- * @param pixels_YCrCb Pointer to the input pixel array in YCbCr color space.
- * @param width Width of the image in pixels (must be divisible by BLOCK_SIZE).
- * @param height Height of the image in pixels (must be divisible by BLOCK_SIZE).
- * @param Ct Precomputed matrix used in the DCT calculation.
- * @return Pointer to a dynamically allocated Blocks_ZigZag struct containing the processed data,
- *         or NULL if a memory allocation fails.
- */
-Blocks_ZigZag *process_channels(YCbCr_Pixel *pixels_YCrCb, int width, int height, double Ct[BLOCK_SIZE][BLOCK_SIZE]);
-
-/**
- * @brief Applies RLE (Run-Length Encoding) on ZigZag vectors.
- *
- * This function takes the zigzag blocks for each color channel (Y, Cb, Cr),
- * performs run-length encoding (RLE) on the AC coefficients of each block, and stores the result.
- * The size of each RLE-compressed block is also recorded.
- *
- * The encoding follows JPEG-style RLE, encoding (SKIP, CATEGORY, VALUE) for each non-zero AC coefficient.
- * It also handles special cases like long runs of zeros (ZRL) and End-Of-Block (EOB) markers.
- *
- * @param blocks Pointer to the structure containing zigzag vectors for Y, Cb, and Cr components.
- * @return Pointer to a RLE structure containing encoded data and sizes for each block,
- *         or NULL if a memory allocation or encoding step fails.
+ * @param input_bmp Path to the input BMP file.
+ * @param output_bin Path to the output BIN file.
+ * @param options Compression options.
+ * @return SUCCESS if the compression is successful, otherwise FAILURE; also FAILURE when even the lowest
+ *         quality does not fit options->target_bytes (the file is then written at that quality).
  */
-RLE *process_zigzag_vectors(Blocks_ZigZag *blocks);
+int compress_bmp_with_options(const char *input_bmp, const char *output_bin, const Compress_Options *options);
 
 /**
- * @brief Writes RLE-compressed DCT coefficients of a channel to a binary stream using Huffman coding.
+ * @brief Compresses many BMP files in one process, several at a time.
  *
- * For each block, the function encodes the DC coefficient using the DC Huffman table,
- * and the AC coefficients using the AC Huffman table (both specified in the code).
- * Encoded bits are written using the bit writer structure.
+ * The inputs come from a directory (its .bmp files), a glob pattern or a list file
+ * (see collect_batch_inputs()); each one is written to 'output_dir' as <name>.bin.
+ * The largest images are started first, and a throughput summary is printed at the end;
+ * with options->stats, the JSON report of the whole batch is printed instead.
  *
- * @param bw Pointer to the Bit_Read_Write structure used to write bits to file.
- * @param sizes Array with the number of encoded RLE coefficients for each block.
- * @param rle 2D array of RLE-encoded coefficients for each block.
- * @param num_blocks Number of blocks in the channel.
- * @return SUCCESS (0) on success, or FAILURE (non-zero) on error.
+ * @param source Directory, glob pattern or list file with the input BMP files.
+ * @param output_dir Directory receiving the BIN files (created if needed).
+ * @param options Compression options, applied to every file.
+ * @param jobs Files compressed concurrently; 0 = one per CPU.
+ * @return SUCCESS if every file was compressed, otherwise FAILURE.
  */
-int write_channel_blocks(Bit_Read_Write *bw, int *sizes, RLE_coef **rle, int num_blocks);
+int compress_batch(const char *source, const char *output_dir, const Compress_Options *options, int jobs);
 
 #endif /* COMPRESSOR_H */
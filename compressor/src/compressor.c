@@ -1,9 +1,11 @@
 #include "compressor.h"
 
+#include <pthread.h>
+
 /**
- * Compression Process:
- * 1) RGB to YCbCr
- * 2) Subsample 4:2:0
+ * Compression Process (streamed, one 16-row stripe at a time, see encoder.h):
+ * 1) RGB to YCbCr, subsampling Cb and Cr 4:2:0 in the same pass
+ * 2) Split each plane into 8x8 blocks (chroma planes have a quarter of the blocks)
  * 3) DCT using pre-calculated matrices
  * 4) Quantization
  * 5) Apply zigzag algorithm
@@ -11,10 +13,48 @@
  * 7) RLE encoding on AC coefficients
  * 8) Write compressed file (header + [Huffman code + value])
  */
+void init_compress_options(Compress_Options *options) {
+    options->dct_method = DCT_METHOD_FAST;
+    options->threads = 1;
+    options->restart_interval = 0;
+    options->index_interval = 0;
+    options->optimize_huffman = 0;
+    options->quality = DEFAULT_QUALITY;
+    options->target_bytes = 0;
+    options->stats = 0;
+}
+
 int compress_bmp(const char *input_bmp, const char *output_bin) {
+    Compress_Options options;
+    init_compress_options(&options);
+    return compress_bmp_with_options(input_bmp, output_bin, &options);
+}
 
-    FILE *file = fopen(input_bmp, "rb");
-    if (!file) {
+// Bytes of the stdio buffer given to each BIN output of a batch, so most files reach the disk in one write()
+#define BATCH_OUTPUT_BUFFER_SIZE (1024 * 1024)
+
+/**
+ * Batch jobs share the options and, with options->stats, sum the stats of
+ * every file they compress.
+ */
+typedef struct {
+    const Compress_Options *options;
+    pthread_mutex_t lock;
+    Pipeline_Stats stats;
+} Batch_Context;
+
+// Compresses one file without printing a report; 'out_buffer' (optional) becomes the stdio buffer of the output,
+// 'stats' (optional) receives the stage timings of the whole run, reading and writing included, and 'quality'
+// (optional) the quality factor used. Returns ENCODER_TARGET_MISSED when the file is written but larger than the
+// target size
+static int compress_file(const char *input_bmp, const char *output_bin, const Compress_Options *options,
+                         char *out_buffer, size_t buffer_size, long *input_size, long *output_size,
+                         Pipeline_Stats *stats, int *quality) {
+    double start = stage_start(stats);
+
+    // The pixels are read in place from the mapping; nothing is copied before color conversion
+    Mapped_File input;
+    if (map_file(input_bmp, &input) != SUCCESS) {
         printf("Error opening BMP file.\n");
         return FAILURE;
     }
@@ -22,124 +62,105 @@ int compress_bmp(const char *input_bmp, const char *output_bin) {
     BMPFILEHEADER fileHeader;
     BMPINFOHEADER infoHeader;
 
-    if (readHeader(file, &fileHeader) != SUCCESS) {
+    if (parse_bmp_headers(input.data, input.size, &fileHeader, &infoHeader) != SUCCESS) {
         printf("Error reading BMP header.\n");
-        fclose(file);
-        return FAILURE;
-    }
-
-    if (readInfoHeader(file, &infoHeader) != SUCCESS) {
-        printf("Error reading BMP info header.\n");
-        fclose(file);
+        unmap_file(&input);
         return FAILURE;
     }
 
     int width = infoHeader.biWidth;
     int height = infoHeader.biHeight;
-    int total_pixels = width * height;
 
-    RGB_Pixel *pixels = read_pixels(file, &fileHeader, width, height);
-    if (!pixels) {
-        printf("Error allocating RGB pixels.\n");
-        fclose(file);
+    size_t top_offset;
+    ptrdiff_t stride;
+    if (bmp_pixel_rows(input.size, &fileHeader, width, height, &top_offset, &stride) != SUCCESS) {
+        printf("Error reading BMP pixels.\n");
+        unmap_file(&input);
         return FAILURE;
     }
 
-    long file_lenght_in = ftell(file);
-    fclose(file);
+    // The encoder resets the stats, so the read time is added once it is done
+    double read_seconds = stats ? monotonic_seconds() - start : 0;
 
-    YCbCr_Pixel *pixels_YCrCb = rgb_to_YCrCb(pixels, total_pixels);
-    if (!pixels_YCrCb) {
-        printf("Error allocating YCbCr pixels.\n");
-        free(pixels);
+    FILE *out = fopen(output_bin, "wb");
+    if (!out) {
+        printf("Error creating output file.\n");
+        unmap_file(&input);
         return FAILURE;
     }
-
-    // Considering width and height multiples of 2
-    subsample_4_2_0(pixels_YCrCb, width, height);
-
-    double Ct[BLOCK_SIZE][BLOCK_SIZE];
-    transpose((double (*)[BLOCK_SIZE])C, Ct); // Ct = C^T
-
-    // Create 3 matrices (Y, Cb, Cr) that hold the 'num_blocks' zigzag vectors (64 elements each = 8x8)
-    Blocks_ZigZag *zigzag_vectors = process_channels(pixels_YCrCb, width, height, Ct);
-    if (!zigzag_vectors) {
-        printf("Error allocating zigzag vectors.\n");
-        free(pixels_YCrCb);
-        free(pixels);
+    if (out_buffer) setvbuf(out, out_buffer, _IOFBF, buffer_size);
+
+    Encoder_Config config;
+    init_encoder_config(&config);
+    config.dct_method = options->dct_method;
+    config.threads = options->threads;
+    config.restart_interval = options->restart_interval;
+    config.index_interval = options->index_interval;
+    config.optimize_huffman = options->optimize_huffman;
+    config.quality = options->quality;
+    config.target_bytes = options->target_bytes;
+    config.stats = stats;
+
+    Stream_Encoder *encoder = stream_encoder_create(out, &fileHeader, &infoHeader, &config);
+    if (!encoder) {
+        printf("Error creating encoder.\n");
+        fclose(out);
+        unmap_file(&input);
         return FAILURE;
     }
 
-    int num_blocks = zigzag_vectors->num_blocks;
-
-    delta_encoding_DC(zigzag_vectors);
-
-    RLE *rle_result = process_zigzag_vectors(zigzag_vectors);
-    if (!rle_result) {
-        printf("Error allocating rle blocks.\n");
-        free_BlocosZigZag(zigzag_vectors); 
-        free(pixels_YCrCb);
-        free(pixels); 
+    int status = stream_encoder_write_image(encoder, input.data + top_offset, stride);
+    if (status == SUCCESS) status = stream_encoder_finish(encoder);
+    if (status != SUCCESS && status != ENCODER_TARGET_MISSED) {
+        printf("Error writing compressed data.\n");
+        stream_encoder_free(encoder);
+        fclose(out);
+        unmap_file(&input);
         return FAILURE;
     }
 
-    FILE *out = fopen(output_bin, "wb");
-    if (!file) {
-        printf("Error creating output file.\n");
-        free_rle(rle_result, num_blocks);
-        free_BlocosZigZag(zigzag_vectors); 
-        free(pixels_YCrCb);
-        free(pixels);
+    *input_size = (long)input.size;
+    if (quality) *quality = stream_encoder_quality(encoder);
+    stream_encoder_free(encoder);
+    unmap_file(&input);
+
+    *output_size = ftell(out);
+    double t = stage_start(stats);
+    if (fclose(out) != 0) {
+        printf("Error writing compressed data.\n");
         return FAILURE;
     }
 
-    Bit_Read_Write bw;
-    init_bitwriter(&bw, out);
-
-    // Write BMP headers
-    fwrite(&fileHeader, sizeof(fileHeader), 1, out);
-    fwrite(&infoHeader, sizeof(infoHeader), 1, out);
+    if (stats) {
+        stage_lap(stats, STAGE_WRITE, t);
+        stats->seconds[STAGE_READ] += read_seconds;
+        stats->elapsed_seconds = monotonic_seconds() - start;
+    }
+    return status;
+}
 
-    int temp;
+// JSON report of a run: file count, total sizes and the pipeline stats summed over the files
+static void print_stats_report(int files, uint64_t input_bytes, uint64_t output_bytes, const Pipeline_Stats *stats) {
+    printf("{\"operation\": \"compress\", \"files\": %d, \"input_bytes\": %llu, \"output_bytes\": %llu, "
+           "\"pipeline\": ", files, (unsigned long long)input_bytes, (unsigned long long)output_bytes);
+    write_pipeline_stats_json(stdout, stats);
+    printf("}\n");
+}
 
-    // Write each channel
-    temp = write_channel_blocks(&bw, rle_result->Y_sizes, rle_result->Y_rle, num_blocks);
-    if (temp != SUCCESS) {
-        printf("Error writing channel Y.\n");
-        free_rle(rle_result, num_blocks);
-        free_BlocosZigZag(zigzag_vectors); 
-        free(pixels_YCrCb);
-        free(pixels);
-        fclose(out);
-        return FAILURE;
-    }
-    
-    temp = write_channel_blocks(&bw, rle_result->Cb_sizes, rle_result->Cb_rle, num_blocks);
-    if (temp != SUCCESS) {
-        printf("Error writing channel Cb.\n");
-        free_rle(rle_result, num_blocks);
-        free_BlocosZigZag(zigzag_vectors); 
-        free(pixels_YCrCb);
-        free(pixels);
-        fclose(out);
-        return FAILURE;
-    }
+int compress_bmp_with_options(const char *input_bmp, const char *output_bin, const Compress_Options *options) {
+    long file_lenght_in, file_lenght_out;
+    int quality;
+    Pipeline_Stats stats;
+    int status = compress_file(input_bmp, output_bin, options, NULL, 0, &file_lenght_in, &file_lenght_out,
+                               options->stats ? &stats : NULL, &quality);
+    if (status != SUCCESS && status != ENCODER_TARGET_MISSED) return FAILURE;
 
-    temp = write_channel_blocks(&bw, rle_result->Cr_sizes, rle_result->Cr_rle, num_blocks);
-    if (temp != SUCCESS) {
-        printf("Error writing channel Cr.\n");
-        free_rle(rle_result, num_blocks);
-        free_BlocosZigZag(zigzag_vectors); 
-        free(pixels_YCrCb);
-        free(pixels);
-        fclose(out);
-        return FAILURE;
+    if (options->stats) {
+        print_stats_report(1, (uint64_t)file_lenght_in, (uint64_t)file_lenght_out, &stats);
+        if (status == ENCODER_TARGET_MISSED) printf("The target size is below what the lowest quality reaches.\n");
+        return status == SUCCESS ? SUCCESS : FAILURE;
     }
 
-    flush_bits(&bw);
-    long file_lenght_out = ftell(out);
-    fclose(out);
-
     printf("Compression Successful.\n");
     
     printf("Input File Lenght: %ld bytes\n", file_lenght_in);
@@ -147,233 +168,67 @@ int compress_bmp(const char *input_bmp, const char *output_bin) {
 
     printf("Compression Ratio = %.2f%%\n", 100.0 * (1.0 - ((float)file_lenght_out / file_lenght_in)));
 
-    free_rle(rle_result, num_blocks);
-    free_BlocosZigZag(zigzag_vectors); 
-    free(pixels_YCrCb);
-    free(pixels);
+    if (options->target_bytes > 0) {
+        printf("Quality: %d (target: %llu bytes)\n", quality, (unsigned long long)options->target_bytes);
+    }
+    if (status == ENCODER_TARGET_MISSED) {
+        printf("The target size is below what the lowest quality reaches.\n");
+        return FAILURE;
+    }
 
     return SUCCESS;
 }
 
-Blocks_ZigZag *process_channels(YCbCr_Pixel *pixels_YCrCb, int width, int height, double Ct[BLOCK_SIZE][BLOCK_SIZE]) {
-    int blocos_x = width / BLOCK_SIZE;
-    int blocos_y = height / BLOCK_SIZE;
-    int num_blocks = blocos_x * blocos_y;
-
-    Blocks_ZigZag *result = malloc(sizeof(Blocks_ZigZag));
-    if (!result) return NULL;
-
-    result->Y_blocks  = malloc(sizeof(int*) * num_blocks);
-    if (!result->Y_blocks) {
-        free(result);
-        return NULL;
-    }
-    result->Cb_blocks = malloc(sizeof(int*) * num_blocks);
-    if (!result->Cb_blocks) {
-        free(result->Y_blocks);
-        free(result);
-        return NULL;
-    }
-    result->Cr_blocks = malloc(sizeof(int*) * num_blocks);
-    if (!result->Cr_blocks) {
-        free(result->Y_blocks);
-        free(result->Cb_blocks);
-        free(result);
-        return NULL;
+// Batch job: the worker's scratch buffer is reused as the stdio buffer of every output it writes
+static int compress_batch_file(void *context, Batch_Scratch *scratch, const char *input, const char *output) {
+    Batch_Context *batch = context;
+    char *buffer = batch_scratch_reserve(scratch, BATCH_OUTPUT_BUFFER_SIZE);
+    long input_size, output_size;
+    Pipeline_Stats stats;
+
+    int status = compress_file(input, output, batch->options, buffer, buffer ? BATCH_OUTPUT_BUFFER_SIZE : 0,
+                               &input_size, &output_size, batch->options->stats ? &stats : NULL, NULL);
+    if (status == ENCODER_TARGET_MISSED) {
+        printf("%s: the target size is below what the lowest quality reaches.\n", input);
+        return FAILURE;
     }
-    result->num_blocks = num_blocks;
-
-    int block_idx = 0;
-
-    for (int j = 0; j < height; j += BLOCK_SIZE) {
-        for (int i = 0; i < width; i += BLOCK_SIZE) {
-            double block_Y[BLOCK_SIZE][BLOCK_SIZE];
-            double block_Cb[BLOCK_SIZE][BLOCK_SIZE];
-            double block_Cr[BLOCK_SIZE][BLOCK_SIZE];
-
-            double dct_Y[BLOCK_SIZE][BLOCK_SIZE];
-            double dct_Cb[BLOCK_SIZE][BLOCK_SIZE];
-            double dct_Cr[BLOCK_SIZE][BLOCK_SIZE];
-
-            int output_Y[BLOCK_SIZE][BLOCK_SIZE];
-            int output_Cb[BLOCK_SIZE][BLOCK_SIZE];
-            int output_Cr[BLOCK_SIZE][BLOCK_SIZE];
-
-            for (int y = 0; y < BLOCK_SIZE; y++) {
-                for (int x = 0; x < BLOCK_SIZE; x++) {
-                    int dy = j + y;
-                    int dx = i + x;
-                    block_Y[x][y] = pixels_YCrCb[dy * width + dx].Y - 128.0;
-                    block_Cb[x][y] = pixels_YCrCb[dy * width + dx].Cb - 128.0;
-                    block_Cr[x][y] = pixels_YCrCb[dy * width + dx].Cr - 128.0;
-                }
-            }
-
-            apply_matrix_dct(block_Y, dct_Y, Ct);
-            apply_matrix_dct(block_Cb, dct_Cb, Ct);
-            apply_matrix_dct(block_Cr, dct_Cr, Ct);
-
-            quantize(dct_Y, lumin_matrix, output_Y);
-            quantize(dct_Cb, chrom_matrix, output_Cb);
-            quantize(dct_Cr, chrom_matrix, output_Cr);
-
-            result->Y_blocks[block_idx] = malloc(sizeof(int) * 64);
-            if (!result->Y_blocks[block_idx]) {
-                for (int k = 0; k <= block_idx; k++) {
-                    free(result->Y_blocks[k]);
-                }
-                free(result->Y_blocks);
-                free(result->Cb_blocks);
-                free(result->Cr_blocks);
-                free(result);
-                return NULL;
-            }
-
-            result->Cb_blocks[block_idx] = malloc(sizeof(int) * 64);
-            if (!result->Y_blocks[block_idx]) {
-                for (int k = 0; k <= block_idx; k++) {
-                    free(result->Y_blocks[k]);
-                    free(result->Cb_blocks[k]);
-                }
-                free(result->Y_blocks);
-                free(result->Cb_blocks);
-                free(result->Cr_blocks);
-                free(result);
-                return NULL;
-            }
-            
-            result->Cr_blocks[block_idx] = malloc(sizeof(int) * 64);
-            if (!result->Y_blocks[block_idx]) {
-                for (int k = 0; k <= block_idx; k++) {
-                    free(result->Y_blocks[k]);
-                    free(result->Cb_blocks[k]);
-                    free(result->Cr_blocks[k]);
-                }
-                free(result->Y_blocks);
-                free(result->Cb_blocks);
-                free(result->Cr_blocks);
-                free(result);
-                return NULL;
-            }
-
-            zigzag(output_Y,  result->Y_blocks[block_idx],  0);
-            zigzag(output_Cb, result->Cb_blocks[block_idx], 0);
-            zigzag(output_Cr, result->Cr_blocks[block_idx], 0);
-
-            block_idx++;
-        }
+    if (status == SUCCESS && batch->options->stats) {
+        pthread_mutex_lock(&batch->lock);
+        add_pipeline_stats(&batch->stats, &stats);
+        pthread_mutex_unlock(&batch->lock);
     }
-
-    return result;
+    return status;
 }
 
-RLE *process_zigzag_vectors(Blocks_ZigZag *blocks) {
-    RLE *result = malloc(sizeof(RLE));
-    if (!result) return NULL;
+int compress_batch(const char *source, const char *output_dir, const Compress_Options *options, int jobs) {
+    Batch_List list;
+    if (collect_batch_inputs(source, ".bmp", &list) != SUCCESS) return FAILURE;
 
-    result->Y_sizes = malloc(sizeof(int) * blocks->num_blocks);
-    if (!result->Y_sizes) {
-        free(result);
-        return NULL;
-    }
+    Batch_Context context;
+    context.options = options;
+    pthread_mutex_init(&context.lock, NULL);
+    init_pipeline_stats(&context.stats);
 
-    result->Cb_sizes = malloc(sizeof(int) * blocks->num_blocks);
-    if (!result->Cb_sizes) {
-        free(result->Y_sizes);
-        free(result);
-        return NULL;
-    }
+    Batch_Summary summary;
+    int status = run_batch(&list, output_dir, ".bin", jobs, compress_batch_file, &context, &summary);
+    free_batch_list(&list);
+    pthread_mutex_destroy(&context.lock);
 
-    result->Cr_sizes = malloc(sizeof(int) * blocks->num_blocks);
-    if (!result->Cr_sizes) {
-        free(result->Y_sizes);
-        free(result->Cb_sizes);
-        free(result);
-        return NULL;
-    }
+    // Nothing ran if the outputs could not be set up
+    if (summary.workers == 0) return FAILURE;
 
-    result->Y_rle = process_AC_coef(blocks->Y_blocks, blocks->num_blocks, result->Y_sizes);
-    if (!result->Y_rle) {
-        free(result->Y_sizes);
-        free(result->Cb_sizes);
-        free(result->Cr_sizes);
-        free(result);
-        return NULL;
+    // The files overlap, so the elapsed time is the batch's own
+    if (options->stats) {
+        context.stats.elapsed_seconds = summary.seconds;
+        print_stats_report(summary.files, summary.input_bytes, summary.output_bytes, &context.stats);
+        return status;
     }
 
-    result->Cb_rle = process_AC_coef(blocks->Cb_blocks, blocks->num_blocks, result->Cb_sizes);
-    if (!result->Cb_rle) {
-        for (int i = 0; i < blocks->num_blocks; i++) free(result->Y_rle[i]);
-        free(result->Y_rle);
-        free(result->Y_sizes);
-        free(result->Cb_sizes);
-        free(result->Cr_sizes);
-        free(result);
-        return NULL;
+    print_batch_summary(&summary);
+    if (summary.input_bytes > 0) {
+        printf("Compression Ratio = %.2f%%\n", 100.0 * (1.0 - ((double)summary.output_bytes / summary.input_bytes)));
     }
 
-    result->Cr_rle = process_AC_coef(blocks->Cr_blocks, blocks->num_blocks, result->Cr_sizes);
-    if (!result->Cr_rle) {
-        for (int i = 0; i < blocks->num_blocks; i++) {
-            free(result->Y_rle[i]);
-            free(result->Cb_rle[i]);
-        }
-        free(result->Y_rle);
-        free(result->Cb_rle);
-        free(result->Y_sizes);
-        free(result->Cb_sizes);
-        free(result->Cr_sizes);
-        free(result);
-        return NULL;
-    }
-
-    return result;
+    return status;
 }
 
-int write_channel_blocks(Bit_Read_Write *bw, int *sizes, RLE_coef **rle, int num_blocks) {
-    for (int i = 0; i < num_blocks; i++) {
-        int dc_value = rle[i][0].value;
-        int dc_category = rle[i][0].category;
-
-        if (dc_category < 0 || dc_category > 10) {
-            printf("DC Huffman Prefix not found");
-            return FAILURE;
-        }
-
-        const char *dc_prefix = dc_table[dc_category].prefix;
-
-        // DC: prefix + value in bits
-        write_bits(bw, dc_prefix);
-        if (dc_category > 0) {
-            write_bits_complement1(bw, dc_value, dc_category);
-        }
-
-        // AC
-        for (int j = 1; j < sizes[i]; j++) {
-            RLE_coef coef = rle[i][j];
-            if (coef.skip == 0 && coef.category == 0) {
-                write_bits(bw, "1010"); // EOB
-                break;
-            }
-            
-            const char *ac_prefix = NULL;
-
-            // Skip + category => prefix
-            for (int k = 0; k < 162; k++) {
-                if (ac_table[k].zeros == coef.skip && ac_table[k].category == coef.category) {
-                    ac_prefix = ac_table[k].prefix;
-                }
-            }            
-
-            if (ac_prefix == NULL) {
-                printf("AC Huffman Prefix not found");
-                return FAILURE;
-            }
-
-            write_bits(bw, ac_prefix);
-            write_bits_complement1(bw, coef.value, coef.category);
-        }
-    }
-
-    return SUCCESS;
-}
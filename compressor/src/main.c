@@ -5,17 +5,83 @@
  *
  * This function validates command-line arguments and initiates the compression process.
  *
+ * Options:
+ *   --dct <matrix|fast>   Forward DCT implementation (default: fast).
+ *   --threads <n>         Threads for the transform stages, 0 = one per CPU (default: 1).
+ *   --restart <n>         Restart segment every n 16-row stripes, 0 = none (default: 0).
+ *   --index <n>           Index entry every n 16-row stripes for region decoding, 0 = none (default: 0).
+ *   --optimize            Two passes, with Huffman tables built for the image (keeps 3 bytes per pixel in memory).
+ *   --quality <1-100>     Quality factor scaling the quantization matrices (default: 50, the standard ones).
+ *   --target-bytes <n>    Pick the highest quality whose output fits in n bytes (overrides --quality; keeps 3 bytes
+ *                         per pixel in memory).
+ *   --batch               Compress every BMP of <inputs> (a directory, a glob or a list file) into <output_dir>.
+ *   --jobs <n>            Batch mode: files compressed concurrently, 0 = one per CPU (default: 0).
+ *   --stats               Print per-stage timings and symbol counters as JSON instead of the report.
+ *
  * @param argc Number of command-line arguments.
  * @param argv Array of command-line argument strings.
  * @return SUCCESS if the compression is successful, otherwise FAILURE.
  */
 int main(int argc, char *argv[]) {
-    if (argc != 3) {
-        printf("Usage: %s <input.bmp> <output.bin>\n", argv[0]);
+    Compress_Options options;
+    init_compress_options(&options);
+    int batch = 0;
+    int jobs = 0;
+
+    int arg = 1;
+    while (arg < argc && strncmp(argv[arg], "--", 2) == 0) {
+        if (strcmp(argv[arg], "--dct") == 0 && arg + 1 < argc &&
+            parse_dct_method(argv[arg + 1], &options.dct_method) == SUCCESS) {
+            arg += 2;
+        } else if (strcmp(argv[arg], "--threads") == 0 && arg + 1 < argc &&
+                   parse_thread_count(argv[arg + 1], &options.threads) == SUCCESS) {
+            arg += 2;
+        } else if (strcmp(argv[arg], "--restart") == 0 && arg + 1 < argc &&
+                   parse_stripe_interval(argv[arg + 1], &options.restart_interval) == SUCCESS) {
+            arg += 2;
+        } else if (strcmp(argv[arg], "--index") == 0 && arg + 1 < argc &&
+                   parse_stripe_interval(argv[arg + 1], &options.index_interval) == SUCCESS) {
+            arg += 2;
+        } else if (strcmp(argv[arg], "--quality") == 0 && arg + 1 < argc &&
+                   parse_quality(argv[arg + 1], &options.quality) == SUCCESS) {
+            arg += 2;
+        } else if (strcmp(argv[arg], "--target-bytes") == 0 && arg + 1 < argc &&
+                   parse_target_bytes(argv[arg + 1], &options.target_bytes) == SUCCESS) {
+            arg += 2;
+        } else if (strcmp(argv[arg], "--optimize") == 0) {
+            options.optimize_huffman = 1;
+            arg += 1;
+        } else if (strcmp(argv[arg], "--batch") == 0) {
+            batch = 1;
+            arg += 1;
+        } else if (strcmp(argv[arg], "--jobs") == 0 && arg + 1 < argc &&
+                   parse_thread_count(argv[arg + 1], &jobs) == SUCCESS) {
+            arg += 2;
+        } else if (strcmp(argv[arg], "--stats") == 0) {
+            options.stats = 1;
+            arg += 1;
+        } else {
+            printf("Invalid option: %s\n", argv[arg]);
+            exit(FAILURE);
+        }
+    }
+
+    if (argc - arg != 2) {
+        printf("Usage: %s [--dct matrix|fast] [--threads n] [--restart n] [--index n] [--optimize]\n"
+               "          [--quality 1-100 | --target-bytes n] [--stats] <input.bmp> <output.bin>\n"
+               "       %s [options] --batch [--jobs n] <directory|glob|list file> <output_dir>\n", argv[0], argv[0]);
         exit(FAILURE);
     }
 
-    if (compress_bmp(argv[1], argv[2]) != SUCCESS) {
+    if (batch) {
+        if (compress_batch(argv[arg], argv[arg + 1], &options, jobs) != SUCCESS) {
+            printf("Error compressing the batch.\n");
+            exit(FAILURE);
+        }
+        return SUCCESS;
+    }
+
+    if (compress_bmp_with_options(argv[arg], argv[arg + 1], &options) != SUCCESS) {
         printf("Error compressing the BMP file.\n");
         exit(FAILURE);
     }
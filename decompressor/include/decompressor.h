@@ -3,12 +3,36 @@
 
 #include "img_functions.h"
 #include "bmp.h"
+#include "dct.h"
+#include "decoder.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+#include "batch.h"
+#include "stats.h"
+
+/**
+ * @brief Options that control the decompression pipeline.
+ */
+typedef struct {
+    DCT_Method idct_method;     /* Inverse DCT implementation (default: DCT_METHOD_FAST) */
+    int threads;                /* Threads for segment decoding and the IDCT; 0 = one per CPU (default: 1) */
+    int scale;                  /* Output size divisor: 1, 2, 4 or 8 (default: 1) */
+    int stats;                  /* Print stage timings and symbol counters as JSON instead of the report (default: 0) */
+} Decompress_Options;
+
+/**
+ * @brief Fills a Decompress_Options structure with the default settings.
+ *
+ * @param options Pointer to the options to initialize.
+ */
+void init_decompress_options(Decompress_Options *options);
 
 /**
  * @brief Decompresses a binary-encoded image file and writes the decompressed result as a BMP image.
  *
  * This function opens the BIN file, reads its header and compressed data,
  * and then decompresses the data into BMP format.
+ * Uses the default options (see init_decompress_options()).
  * 
  * @param input_bin Path to the input binary file that contains the compressed image.
  * @param output_bmp Path to the output BMP file where the decompressed image will be saved.
@@ -20,32 +44,88 @@
 int decompress_bin(const char *input_bin, const char *output_bmp);
 
 /**
- * @brief Reads all RLE-encoded blocks from the input binary file.
+ * @brief Decompresses a BIN file into a BMP file using the given options.
+ *
+ * @param input_bin Path to the input binary file that contains the compressed image.
+ * @param output_bmp Path to the output BMP file.
+ * @param options Decompression options.
+ * @return SUCCESS if decompression and writing are successful, or FAILURE on error.
+ */
+int decompress_bin_with_options(const char *input_bin, const char *output_bmp, const Decompress_Options *options);
+
+/**
+ * @brief Decompresses a rectangle of a BIN file into a BMP file of the rectangle's size.
+ *
+ * Only the stripes and block columns around the rectangle are reconstructed. Files
+ * compressed with an index (or restart segments) are entropy decoded from the closest
+ * entry before the rectangle instead of from the start. Needs a striped BIN file.
+ * With a scale, the rectangle is given in the coordinates of the scaled image.
+ * With options->stats, the report is replaced by a JSON object with the file
+ * sizes, the IDCT kernel counters and the Pipeline_Stats of the run (see stats.h).
+ *
+ * @param input_bin Path to the input binary file that contains the compressed image.
+ * @param output_bmp Path to the output BMP file.
+ * @param x Left column of the rectangle.
+ * @param y Top row of the rectangle.
+ * @param width Width of the rectangle (0 decodes the whole image).
+ * @param height Height of the rectangle.
+ * @param options Decompression options.
+ * @return SUCCESS if decompression and writing are successful, or FAILURE on error.
+ */
+int decompress_region(const char *input_bin, const char *output_bmp, int x, int y, int width, int height,
+                      const Decompress_Options *options);
+
+/**
+ * @brief Decompresses many BIN files in one process, several at a time.
+ *
+ * The inputs come from a directory (its .bin files), a glob pattern or a list file
+ * (see collect_batch_inputs()); each one is written to 'output_dir' as <name>.bmp.
+ * The largest files are started first, and a throughput summary is printed at the end;
+ * with options->stats, the JSON report of the whole batch is printed instead.
+ *
+ * @param source Directory, glob pattern or list file with the input BIN files.
+ * @param output_dir Directory receiving the BMP files (created if needed).
+ * @param options Decompression options, applied to every file.
+ * @param jobs Files decompressed concurrently; 0 = one per CPU.
+ * @return SUCCESS if every file was decompressed, otherwise FAILURE.
+ */
+int decompress_batch(const char *source, const char *output_dir, const Decompress_Options *options, int jobs);
+
+/**
+ * @brief Reads all RLE-encoded blocks from the coded data of a binary file.
+ *
+ * This function initializes a bitreader on the data and reads the Run-Length Encoded (RLE)
+ * data for all blocks of a legacy whole-channel file (Y, then Cb, then Cr), storing
+ * per channel the blocks in raster order, with the number of coefficients of each
+ * block, in dynamically allocated arrays. Striped files are read by the streaming
+ * decoder instead (see decoder.h).
  *
- * This function initializes a bitreader and reads the Run-Length Encoded (RLE)
- * data for all blocks in the file. It separately reads the Y, Cb, and Cr
- * components for each block, storing the data and the number of coefficients in
- * dynamically allocated arrays.
+ * The AC codes are the ones those files were written with (see
+ * build_legacy_ac_decoder()). As in the first decoder, a block with an invalid
+ * code or past the end of the data is decoded as empty; a warning gives their number.
  *
- * @param file Pointer to the binary input file opened for reading.
- * @param num_blocks Total number of blocks to read for each channel.
+ * @param data The coded data that follows the BIN headers.
+ * @param size Bytes in 'data'.
+ * @param layout Geometry of the stream.
  * @return A pointer to an allocated RLE structure containing the RLE data
  *         for each component (Y, Cb, Cr), or NULL on failure.
  */
-RLE *read_all_blocks(FILE *file, int num_blocks);
+RLE *read_all_blocks(const uint8_t *data, size_t size, const Stream_Layout *layout);
 
 /**
  * @brief Converts RLE-encoded blocks into zigzag-ordered coefficient arrays.
  *
  * This function takes RLE data for Y, Cb, and Cr components and converts each block
  * into an array of 64 coefficients ordered according to the zigzag pattern.
+ * It also records, per block, the zigzag index of the last non-zero coefficient.
  *
  * @param rle_blocks Pointer to the RLE structure containing RLE coefficients.
- * @param num_blocks Number of blocks to convert per channel.
- * @return A pointer to a Blocks_ZigZag structure containing arrays of 64 integer
- *         coefficients for each channel, or NULL on failure.
+ * @param num_blocks Number of Y blocks to convert.
+ * @param num_chroma_blocks Number of Cb and Cr blocks to convert.
+ * @return A pointer to a Blocks_ZigZag structure holding one slab of 64-coefficient
+ *         blocks per channel, or NULL on failure.
  */
-Blocks_ZigZag *rle_to_blocks(RLE *rle_blocks, int num_blocks);
+Blocks_ZigZag *rle_to_blocks(RLE *rle_blocks, int num_blocks, int num_chroma_blocks);
 
 /**
  * @brief Converts DCT coefficient blocks to spatial-domain YCbCr pixels.
@@ -53,19 +133,22 @@ Blocks_ZigZag *rle_to_blocks(RLE *rle_blocks, int num_blocks);
  * This function processes all DCT blocks by:
  * 1. Undo the zigzag ordering of coefficients
  * 2. Dequantize the coefficients using the luminance and chrominance quantization matrices
- * 3. Apply the inverse DCT using precomputed matrices
+ * 3. Apply the inverse DCT selected by the engine (see idct_block())
  * 4. Convert each block back to Y, Cb, and Cr pixel values
  *
- * The result is a linear array of YCbCr_Pixel structures representing the entire image.
+ * The result is a set of 8-bit Y, Cb and Cr planes representing the entire image,
+ * with the chroma planes at their coded resolution (upsampled later by YCbCr_to_rgb()).
  *
  * @param blocks Pointer to the zigzag-ordered DCT coefficient blocks.
  * @param width Width of the image in pixels.
  * @param height Height of the image in pixels.
- * @param total_pixels Total number of pixels (width * height).
- * @param Ct Precomputed matrix for 8x8 DCT calculation.
- * @return A pointer to a dynamically allocated array of YCbCr_Pixel values,
+ * @param chroma_width Width of the coded Cb and Cr planes.
+ * @param chroma_height Height of the coded Cb and Cr planes.
+ * @param engine Inverse DCT engine; its stats count the kernel used per block.
+ * @return A pointer to dynamically allocated YCbCr planes (see free_planes()),
  *         or NULL on memory allocation failure.
  */
-YCbCr_Pixel *blocks_to_pixels(Blocks_ZigZag *blocks, int width, int height, int total_pixels, double Ct[BLOCK_SIZE][BLOCK_SIZE]);
+YCbCr_Planes *blocks_to_pixels(Blocks_ZigZag *blocks, int width, int height, int chroma_width, int chroma_height,
+                               IDCT_Engine *engine);
 
 #endif /* DECOMPRESSOR_H */
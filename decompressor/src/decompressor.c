@@ -1,20 +1,144 @@
 #include "decompressor.h"
 
+#include <pthread.h>
+
 /**
+ * Striped streams are decoded row by row by the streaming decoder (see decoder.h);
+ * legacy whole-channel files go through the steps below on the whole image. Either
+ * way the output BMP is created at its final size and mapped, and the last color
+ * conversion pass writes its padded, bottom-up rows in place.
+ *
  * Decompression Process:
  * 1) Read compressed file (header + [Huffman code + value])
  * 2) Redo the RLE encoding structure with the DC and AC coefficients
  * 3) Redo the zigzag blocks structure
  * 4) Undo the delta encoding on DC coefficients
- * 5) Undo the zigzag algorithm
- * 6) Dequantize
- * 7) IDCT using pre-calculated matrices
- * 8) YCbCr to RGB
- * 9) Write BMP decompressed file (with losses)
+ * 5) Dequantize, undo the zigzag and IDCT (kernel picked from the last non-zero coefficient)
+ * 6) YCbCr to RGB into the mapped BMP file (with losses), upsampling the 4:2:0 chroma planes row by row
  */
+void init_decompress_options(Decompress_Options *options) {
+    options->idct_method = DCT_METHOD_FAST;
+    options->threads = 1;
+    options->scale = 1;
+    options->stats = 0;
+}
+
 int decompress_bin(const char *input_bin, const char *output_bmp) {
-    FILE *file = fopen(input_bin, "rb");
-    if (!file) {
+    Decompress_Options options;
+    init_decompress_options(&options);
+    return decompress_bin_with_options(input_bin, output_bmp, &options);
+}
+
+// Creates the output BMP at its final size, mapped, with its headers stored; the rows are then converted in place
+static int create_bmp_output(const char *output_bmp, const BMPFILEHEADER *fileHeader, const BMPINFOHEADER *infoHeader,
+                             Mapped_Output *output, uint8_t **top_row, ptrdiff_t *stride) {
+    int width = infoHeader->biWidth;
+    int height = infoHeader->biHeight;
+    uint64_t size = bmp_file_size(fileHeader, width, height);
+    size_t top_offset;
+
+    if (size > SIZE_MAX || create_mapped_output(output_bmp, (size_t)size, output) != SUCCESS) {
+        printf("Error creating output file.\n");
+        return FAILURE;
+    }
+
+    store_bmp_headers(output->data, fileHeader, infoHeader);
+    if (bmp_pixel_rows(output->size, fileHeader, width, height, &top_offset, stride) != SUCCESS) {
+        close_mapped_output(output);
+        return FAILURE;
+    }
+    *top_row = output->data + top_offset;
+    return SUCCESS;
+}
+
+// Streams the rows of a striped BIN file, or of a region of it ('width' = 0 for the whole image), into the output BMP
+static int decompress_stream(const Mapped_File *input, const BMPFILEHEADER *fileHeader, const BMPINFOHEADER *infoHeader,
+                             const char *output_bmp, const Decompress_Options *options,
+                             int x, int y, int width, int height, IDCT_Stats *stats, Pipeline_Stats *pipeline,
+                             long *output_size) {
+    Decoder_Config config;
+    init_decoder_config(&config);
+    config.idct_method = options->idct_method;
+    config.threads = options->threads;
+    config.scale = options->scale;
+    config.stats = pipeline;
+
+    Stream_Decoder *decoder = stream_decoder_create(input->data, input->size, fileHeader, infoHeader, &config);
+    if (!decoder) {
+        printf("Error creating the stream decoder.\n");
+        return FAILURE;
+    }
+
+    if (width == 0) {
+        stream_decoder_output_size(decoder, &width, &height);
+    } else if (stream_decoder_set_region(decoder, x, y, width, height) != SUCCESS) {
+        stream_decoder_free(decoder);
+        return FAILURE;
+    }
+
+    // The output header is the BIN one with the format flags cleared and the size of the (scaled) region
+    BMPFILEHEADER outHeader = *fileHeader;
+    BMPINFOHEADER outInfo = *infoHeader;
+    outHeader.bfReserved1 = 0;
+    outHeader.bfReserved2 = 0;
+    if (width != infoHeader->biWidth || height != infoHeader->biHeight) {
+        uint64_t image_size = (((uint64_t)width * 3 + 3) & ~3ULL) * (uint64_t)height;
+        outInfo.biWidth = width;
+        outInfo.biHeight = height;
+        outInfo.biSizeImage = image_size <= UINT32_MAX ? (unsigned int)image_size : 0;
+        outHeader.bfSize = image_size + outHeader.bfOffBits <= UINT32_MAX
+                         ? (unsigned int)(image_size + outHeader.bfOffBits) : 0;
+    }
+
+    Mapped_Output output;
+    uint8_t *top_row;
+    ptrdiff_t stride;
+    if (create_bmp_output(output_bmp, &outHeader, &outInfo, &output, &top_row, &stride) != SUCCESS) {
+        stream_decoder_free(decoder);
+        return FAILURE;
+    }
+
+    // The last color conversion pass writes the padded, bottom-up rows straight into the file
+    int status = stream_decoder_read_rows_strided(decoder, top_row, stride, height);
+
+    stream_decoder_stats(decoder, stats);
+    stream_decoder_free(decoder);
+
+    *output_size = (long)output.size;
+    double t = stage_start(pipeline);
+    if (close_mapped_output(&output) != SUCCESS && status == SUCCESS) {
+        printf("Error writing BMP file.\n");
+        status = FAILURE;
+    }
+    stage_lap(pipeline, STAGE_WRITE, t);
+    return status;
+}
+
+int decompress_bin_with_options(const char *input_bin, const char *output_bmp, const Decompress_Options *options) {
+    return decompress_region(input_bin, output_bmp, 0, 0, 0, 0, options);
+}
+
+/**
+ * Batch jobs share the options and, with options->stats, sum the counters of
+ * every file they decompress.
+ */
+typedef struct {
+    const Decompress_Options *options;
+    pthread_mutex_t lock;
+    IDCT_Stats idct;
+    Pipeline_Stats stats;
+} Batch_Context;
+
+// Decompresses one file, or a region of it, without printing a report; 'stats' receives the IDCT kernel counters,
+// and 'pipeline' (optional) the stage timings of the whole run, reading and writing included
+static int decompress_file(const char *input_bin, const char *output_bmp, int x, int y, int width, int height,
+                           const Decompress_Options *options, IDCT_Stats *stats, Pipeline_Stats *pipeline,
+                           long *input_size, long *output_size) {
+    double start = stage_start(pipeline);
+
+    // The coded data is read in place from the mapping
+    Mapped_File input;
+    if (map_file(input_bin, &input) != SUCCESS) {
         printf("Error opening BIN file.\n");
         return FAILURE;
     }
@@ -22,155 +146,363 @@ int decompress_bin(const char *input_bin, const char *output_bmp) {
     BMPFILEHEADER fileHeader;
     BMPINFOHEADER infoHeader;
 
-    if (readHeader(file, &fileHeader) != SUCCESS) {
+    if (parse_bmp_headers(input.data, input.size, &fileHeader, &infoHeader) != SUCCESS) {
         printf("Error reading BMP header.\n");
-        fclose(file);
+        unmap_file(&input);
+        return FAILURE;
+    }
+
+    // The reserved field tells how the stream was laid out; the output BMP gets it cleared
+    unsigned short flags = fileHeader.bfReserved1;
+    if (flags & ~BIN_KNOWN_FLAGS) {
+        printf("Unsupported BIN format flags: 0x%x.\n", flags);
+        unmap_file(&input);
+        return FAILURE;
+    }
+
+    // Striped streams interleave 4:2:0 block rows; legacy files code chroma at full resolution
+    if (((flags & BIN_FLAG_STRIPES) && !(flags & BIN_FLAG_CHROMA_420)) ||
+        ((flags & (BIN_FLAG_RESTART | BIN_FLAG_INDEX | BIN_FLAG_HUFFMAN | BIN_FLAG_QUALITY)) &&
+         !(flags & BIN_FLAG_STRIPES))) {
+        printf("Unsupported BIN format flags: 0x%x.\n", flags);
+        unmap_file(&input);
         return FAILURE;
     }
 
-    if (readInfoHeader(file, &infoHeader) != SUCCESS) {
-        printf("Error reading BMP info header.\n");
-        fclose(file);
+    // The decoder resets the stats, so the read time is added once it is done
+    double read_seconds = pipeline ? monotonic_seconds() - start : 0;
+    *input_size = (long)input.size;
+
+    if (flags & BIN_FLAG_STRIPES) {
+        int status = decompress_stream(&input, &fileHeader, &infoHeader, output_bmp, options, x, y, width, height,
+                                       stats, pipeline, output_size);
+        unmap_file(&input);
+
+        if (pipeline) {
+            pipeline->seconds[STAGE_READ] += read_seconds;
+            pipeline->elapsed_seconds = monotonic_seconds() - start;
+        }
+        return status;
+    }
+
+    if (width != 0 || options->scale != 1) {
+        printf("Region and scaled decoding need a striped BIN file; compress the image again.\n");
+        unmap_file(&input);
         return FAILURE;
     }
+    fileHeader.bfReserved1 = 0;
+
+    width = infoHeader.biWidth;
+    height = infoHeader.biHeight;
+
+    Stream_Layout layout;
+    init_stream_layout(&layout, width, height, flags);
 
-    int width = infoHeader.biWidth;
-    int height = infoHeader.biHeight;
-    int total_pixels = width * height;
+    int chroma_width = layout.chroma_width;
+    int chroma_height = layout.chroma_height;
+    int num_blocks = layout.num_blocks;
+    int num_chroma_blocks = layout.num_chroma_blocks;
 
-    int num_blocks = total_pixels / (BLOCK_SIZE * BLOCK_SIZE);
+    // Whole-image steps, timed as a whole; the color stage includes the chroma upsampling
+    if (pipeline) {
+        init_pipeline_stats(pipeline);
+        pipeline->pixels = (uint64_t)width * (uint64_t)height;
+        pipeline->seconds[STAGE_READ] = read_seconds;
+    }
+    double t = stage_start(pipeline);
 
     // Redo the RLE structure
-    RLE *rle_blocks = read_all_blocks(file, num_blocks);
+    RLE *rle_blocks = read_all_blocks(input.data + BMP_HEADERS_SIZE, input.size - BMP_HEADERS_SIZE, &layout);
+    unmap_file(&input);
     if(!rle_blocks) return FAILURE;
+    t = stage_lap(pipeline, STAGE_HUFFMAN, t);
 
     // Redo the ZigZag blocks structure
-    Blocks_ZigZag *blocks = rle_to_blocks(rle_blocks, num_blocks);
+    Blocks_ZigZag *blocks = rle_to_blocks(rle_blocks, num_blocks, num_chroma_blocks);
+    if (!blocks) {
+        printf("Error allocating coefficient blocks.\n");
+        free_rle(rle_blocks, num_blocks, num_chroma_blocks);
+        return FAILURE;
+    }
 
     // Undo delta encoding on DC values
-    delta_decoding(blocks);
+    delta_decoding(blocks, &layout);
+    t = stage_lap(pipeline, STAGE_RLE, t);
 
-    double Ct[BLOCK_SIZE][BLOCK_SIZE];
-    transpose((double (*)[BLOCK_SIZE])C, Ct); // Ct = C^T
+    for (int i = 0; pipeline && i < num_blocks; i++) {
+        count_block_symbols(pipeline, rle_blocks->Y_rle[i], rle_blocks->Y_sizes[i]);
+    }
+    for (int i = 0; pipeline && i < num_chroma_blocks; i++) {
+        count_block_symbols(pipeline, rle_blocks->Cb_rle[i], rle_blocks->Cb_sizes[i]);
+        count_block_symbols(pipeline, rle_blocks->Cr_rle[i], rle_blocks->Cr_sizes[i]);
+    }
+    free_rle(rle_blocks, num_blocks, num_chroma_blocks);
+
+    IDCT_Engine engine;
+    init_idct_engine(&engine, options->idct_method, DEFAULT_QUALITY);
 
-    YCbCr_Pixel *pixels_YCrCb = blocks_to_pixels(blocks, width, height, total_pixels, Ct);
+    t = stage_start(pipeline);
+    YCbCr_Planes *pixels_YCrCb = blocks_to_pixels(blocks, width, height, chroma_width, chroma_height, &engine);
+    free_BlocosZigZag(blocks);
     if(!pixels_YCrCb) return FAILURE;
+    t = stage_lap(pipeline, STAGE_TRANSFORM, t);
     
-    RGB_Pixel *pixels = YCbCr_to_rgb(pixels_YCrCb, total_pixels);
-    if(!pixels) return FAILURE;
-
-    FILE *dst = fopen(output_bmp, "wb");
-    if (!dst) {
-        printf("Error creating output file.\n");
-        free(pixels);
+    Mapped_Output output;
+    uint8_t *top_row;
+    ptrdiff_t stride;
+    if (create_bmp_output(output_bmp, &fileHeader, &infoHeader, &output, &top_row, &stride) != SUCCESS) {
+        free_planes(pixels_YCrCb);
         return FAILURE;
     }
-    
-    if (write_bmp(dst, &fileHeader, &infoHeader, pixels) != SUCCESS) {
+
+    int status = YCbCr_to_rgb_rows(pixels_YCrCb, top_row, stride);
+    free_planes(pixels_YCrCb);
+    t = stage_lap(pipeline, STAGE_COLOR, t);
+
+    *output_size = (long)output.size;
+    if (close_mapped_output(&output) != SUCCESS || status != SUCCESS) {
         printf("Error writing BMP file.\n");
-        fclose(dst);
-        free(pixels);
         return FAILURE;
     }
 
-    printf("Decompression Successful.\n");
-
+    if (pipeline) {
+        stage_lap(pipeline, STAGE_WRITE, t);
+        pipeline->elapsed_seconds = monotonic_seconds() - start;
+    }
+    *stats = engine.stats;
     return SUCCESS;
 }
 
-RLE *read_all_blocks(FILE *file, int num_blocks) {
-    Bit_Read_Write br;
-    init_bitreader(&br, file);
+// JSON report of a run: file count, total sizes, IDCT kernel counters and the pipeline stats summed over the files
+static void print_stats_report(int files, uint64_t input_bytes, uint64_t output_bytes, const IDCT_Stats *idct,
+                               const Pipeline_Stats *stats) {
+    printf("{\"operation\": \"decompress\", \"files\": %d, \"input_bytes\": %llu, \"output_bytes\": %llu, "
+           "\"idct_kernels\": {\"dc_only\": %ld, \"low_2x2\": %ld, \"low_4x4\": %ld, \"full\": %ld}, "
+           "\"pipeline\": ", files, (unsigned long long)input_bytes, (unsigned long long)output_bytes,
+           idct->dc_only, idct->low_2x2, idct->low_4x4, idct->full);
+    write_pipeline_stats_json(stdout, stats);
+    printf("}\n");
+}
 
-    RLE *rle = malloc(sizeof(RLE));
-    rle->Y_rle = malloc(num_blocks * sizeof(RLE_coef *));
-    rle->Y_sizes = malloc(num_blocks * sizeof(int));
-    rle->Cb_rle = malloc(num_blocks * sizeof(RLE_coef *));
-    rle->Cb_sizes = malloc(num_blocks * sizeof(int));
-    rle->Cr_rle = malloc(num_blocks * sizeof(RLE_coef *));
-    rle->Cr_sizes = malloc(num_blocks * sizeof(int));
+int decompress_region(const char *input_bin, const char *output_bmp, int x, int y, int width, int height,
+                      const Decompress_Options *options) {
+    IDCT_Stats stats;
+    Pipeline_Stats pipeline;
+    long input_size, output_size;
+    if (decompress_file(input_bin, output_bmp, x, y, width, height, options, &stats,
+                        options->stats ? &pipeline : NULL, &input_size, &output_size) != SUCCESS) {
+        return FAILURE;
+    }
 
-    for (int i = 0; i < num_blocks; i++) {
-        rle->Y_rle[i] = read_rle_block(&br, &rle->Y_sizes[i]);
+    if (options->stats) {
+        print_stats_report(1, (uint64_t)input_size, (uint64_t)output_size, &stats, &pipeline);
+        return SUCCESS;
     }
-    for (int i = 0; i < num_blocks; i++) {
-        rle->Cb_rle[i] = read_rle_block(&br, &rle->Cb_sizes[i]);
+
+    printf("Decompression Successful.\n");
+    printf("IDCT kernels: DC-only %ld, 2x2 %ld, 4x4 %ld, full %ld\n",
+           stats.dc_only, stats.low_2x2, stats.low_4x4, stats.full);
+
+    return SUCCESS;
+}
+
+// Batch job: decoded rows go straight into each mapped output, so the worker's scratch buffer is not needed
+static int decompress_batch_file(void *context, Batch_Scratch *scratch, const char *input, const char *output) {
+    Batch_Context *batch = context;
+    IDCT_Stats stats;
+    Pipeline_Stats pipeline;
+    long input_size, output_size;
+    (void)scratch;
+
+    int status = decompress_file(input, output, 0, 0, 0, 0, batch->options, &stats,
+                                 batch->options->stats ? &pipeline : NULL, &input_size, &output_size);
+    if (status == SUCCESS && batch->options->stats) {
+        pthread_mutex_lock(&batch->lock);
+        batch->idct.dc_only += stats.dc_only;
+        batch->idct.low_2x2 += stats.low_2x2;
+        batch->idct.low_4x4 += stats.low_4x4;
+        batch->idct.full += stats.full;
+        add_pipeline_stats(&batch->stats, &pipeline);
+        pthread_mutex_unlock(&batch->lock);
     }
-    for (int i = 0; i < num_blocks; i++) {
-        rle->Cr_rle[i] = read_rle_block(&br, &rle->Cr_sizes[i]);
+    return status;
+}
+
+int decompress_batch(const char *source, const char *output_dir, const Decompress_Options *options, int jobs) {
+    Batch_List list;
+    if (collect_batch_inputs(source, ".bin", &list) != SUCCESS) return FAILURE;
+
+    Batch_Context context;
+    context.options = options;
+    pthread_mutex_init(&context.lock, NULL);
+    context.idct = (IDCT_Stats){0, 0, 0, 0};
+    init_pipeline_stats(&context.stats);
+
+    Batch_Summary summary;
+    int status = run_batch(&list, output_dir, ".bmp", jobs, decompress_batch_file, &context, &summary);
+    free_batch_list(&list);
+    pthread_mutex_destroy(&context.lock);
+
+    // Nothing ran if the outputs could not be set up
+    if (summary.workers == 0) return FAILURE;
+
+    // The files overlap, so the elapsed time is the batch's own
+    if (options->stats) {
+        context.stats.elapsed_seconds = summary.seconds;
+        print_stats_report(summary.files, summary.input_bytes, summary.output_bytes, &context.idct, &context.stats);
+        return status;
     }
 
-    return rle;
+    print_batch_summary(&summary);
+    return status;
 }
 
-Blocks_ZigZag *rle_to_blocks(RLE *rle_blocks, int num_blocks) {
-    Blocks_ZigZag *blocks = malloc(sizeof(Blocks_ZigZag));
-    blocks->num_blocks = num_blocks;
+// Bits the first decoder's bit-by-bit search read before giving up on an invalid DC or AC code
+#define LEGACY_DC_SEARCH_BITS 8
+#define LEGACY_AC_SEARCH_BITS 26
+
+// Reads the RLE symbols of one block as the first decoder did. It never stopped on an invalid code: its search
+// consumed LEGACY_*_SEARCH_BITS bits and the block was decoded as empty. Returns FAILURE for such a block, with the
+// same bits consumed
+static int read_legacy_symbols(Bit_Read_Write *br, const Huffman_Decoder *dc_dec, const Huffman_Decoder *ac_dec,
+                               RLE_coef *coefs, int *size) {
+    int category;
+    if (!decode_dc(br, dc_dec, &category)) {
+        read_n_bits(br, LEGACY_DC_SEARCH_BITS);
+        return FAILURE;
+    }
 
-    blocks->Y_blocks = malloc(num_blocks * sizeof(int *));
-    blocks->Cb_blocks = malloc(num_blocks * sizeof(int *));
-    blocks->Cr_blocks = malloc(num_blocks * sizeof(int *));
-    
+    int index = 0;
+    coefs[index++] = (RLE_coef){0, category, read_bits_complement1(br, category)};
 
-    for (int i = 0; i < num_blocks; i++) {
-        blocks->Y_blocks[i] = rle_to_block(rle_blocks->Y_rle[i], rle_blocks->Y_sizes[i]);
-        blocks->Cb_blocks[i] = rle_to_block(rle_blocks->Cb_rle[i], rle_blocks->Cb_sizes[i]);
-        blocks->Cr_blocks[i] = rle_to_block(rle_blocks->Cr_rle[i], rle_blocks->Cr_sizes[i]);
+    while (index < 64) {
+        int skip;
+        if (!decode_ac(br, ac_dec, &skip, &category)) {
+            read_n_bits(br, LEGACY_AC_SEARCH_BITS);
+            return FAILURE;
+        }
+
+        coefs[index++] = (RLE_coef){skip, category, read_bits_complement1(br, category)};
+        if (skip == 0 && category == 0) break; // EOB
     }
 
-    return blocks;
+    *size = index;
+    return SUCCESS;
 }
 
-YCbCr_Pixel *blocks_to_pixels(Blocks_ZigZag *blocks, int width, int height, int total_pixels, double Ct[BLOCK_SIZE][BLOCK_SIZE]) {
+// Reads the RLE symbols of 'count' blocks of a channel, starting at raster index 'first'. Blocks with an invalid
+// code, or past the end of the data, are left empty (a DC equal to the predictor, then the EOB) and counted in
+// '*damaged'
+static int read_block_run(Bit_Read_Write *br, const Huffman_Decoder *dc_dec, const Huffman_Decoder *ac_dec,
+                          RLE_coef **rle, int *sizes, int first, int count, int *damaged) {
+    for (int i = first; i < first + count; i++) {
+        rle[i] = malloc(64 * sizeof(RLE_coef));
+        if (!rle[i]) return 0;
+
+        if (read_legacy_symbols(br, dc_dec, ac_dec, rle[i], &sizes[i]) != SUCCESS) {
+            rle[i][0] = rle[i][1] = (RLE_coef){0, 0, 0};
+            sizes[i] = 2;
+            (*damaged)++;
+        }
+    }
+    return 1;
+}
 
-    YCbCr_Pixel *values = malloc(sizeof(YCbCr_Pixel) * total_pixels);
-    if (!values) return NULL;
+RLE *read_all_blocks(const uint8_t *data, size_t size, const Stream_Layout *layout) {
+    int num_blocks = layout->num_blocks;
+    int num_chroma_blocks = layout->num_chroma_blocks;
 
-    int idx = 0;
+    // Every block codes at least a DC and an end-of-block symbol, of one bit or more each
+    uint64_t total_blocks = (uint64_t)num_blocks + 2 * (uint64_t)num_chroma_blocks;
+    if (total_blocks * 2 > (uint64_t)size * 8) {
+        printf("Error decoding Huffman data: %d x %d image does not fit in %zu bytes.\n", layout->width,
+               layout->height, size);
+        return NULL;
+    }
 
-    for (int j = 0; j < height; j += BLOCK_SIZE) {
-        for (int i = 0; i < width; i += BLOCK_SIZE) {
+    Bit_Read_Write br;
+    init_bitreader_memory(&br, data, size);
 
-            int temp_Y[BLOCK_SIZE][BLOCK_SIZE];
-            int temp_Cb[BLOCK_SIZE][BLOCK_SIZE];
-            int temp_Cr[BLOCK_SIZE][BLOCK_SIZE];
+    Huffman_Decoder dc_dec, ac_dec;
+    if (build_dc_decoder(&dc_dec, dc_table, 11) != SUCCESS) return NULL;
+    if (build_legacy_ac_decoder(&ac_dec) != SUCCESS) {
+        free_huffman_decoder(&dc_dec);
+        return NULL;
+    }
 
-            double dct_Y[BLOCK_SIZE][BLOCK_SIZE];
-            double dct_Cb[BLOCK_SIZE][BLOCK_SIZE];
-            double dct_Cr[BLOCK_SIZE][BLOCK_SIZE];
+    RLE *rle = calloc(1, sizeof(RLE));
+    if (rle) {
+        rle->Y_rle = calloc(num_blocks, sizeof(RLE_coef *));
+        rle->Y_sizes = malloc((size_t)num_blocks * sizeof(int));
+        rle->Cb_rle = calloc(num_chroma_blocks, sizeof(RLE_coef *));
+        rle->Cb_sizes = malloc((size_t)num_chroma_blocks * sizeof(int));
+        rle->Cr_rle = calloc(num_chroma_blocks, sizeof(RLE_coef *));
+        rle->Cr_sizes = malloc((size_t)num_chroma_blocks * sizeof(int));
+    }
+    if (!rle || !rle->Y_rle || !rle->Y_sizes || !rle->Cb_rle || !rle->Cb_sizes || !rle->Cr_rle || !rle->Cr_sizes) {
+        printf("Error allocating RLE blocks.\n");
+        free_huffman_decoder(&dc_dec);
+        free_huffman_decoder(&ac_dec);
+        if (rle) free_rle(rle, 0, 0);
+        return NULL;
+    }
 
-            double original_Y[BLOCK_SIZE][BLOCK_SIZE];
-            double original_Cb[BLOCK_SIZE][BLOCK_SIZE];
-            double original_Cr[BLOCK_SIZE][BLOCK_SIZE];
+    // The first encoder left out the end-of-block after a last coefficient in position 63, so the decoder reads
+    // the next block's symbols as part of that one and some of its files end before the last blocks. Its decoder
+    // went on through invalid codes; the same blocks are decoded the same way, but reported
+    int damaged = 0;
+    int ok = read_block_run(&br, &dc_dec, &ac_dec, rle->Y_rle, rle->Y_sizes, 0, num_blocks, &damaged) &&
+             read_block_run(&br, &dc_dec, &ac_dec, rle->Cb_rle, rle->Cb_sizes, 0, num_chroma_blocks, &damaged) &&
+             read_block_run(&br, &dc_dec, &ac_dec, rle->Cr_rle, rle->Cr_sizes, 0, num_chroma_blocks, &damaged);
+    if (ok && damaged > 0) {
+        printf("Warning: %d blocks have an invalid Huffman code or lie past the end of the data; they are decoded "
+               "as empty blocks.\n", damaged);
+    }
 
-            zigzag(temp_Y , blocks->Y_blocks[idx], 1);
-            zigzag(temp_Cb, blocks->Cb_blocks[idx], 1);
-            zigzag(temp_Cr, blocks->Cr_blocks[idx], 1);
+    if (!ok) {
+        printf("Error decoding Huffman data.\n");
+        free_huffman_decoder(&dc_dec);
+        free_huffman_decoder(&ac_dec);
+        free_rle(rle, num_blocks, num_chroma_blocks);
+        return NULL;
+    }
 
-            idx++;
+    free_huffman_decoder(&dc_dec);
+    free_huffman_decoder(&ac_dec);
 
+    return rle;
+}
 
-            dequantize(temp_Y, lumin_matrix, dct_Y);
-            dequantize(temp_Cb, chrom_matrix, dct_Cb);
-            dequantize(temp_Cr, chrom_matrix, dct_Cr);
+Blocks_ZigZag *rle_to_blocks(RLE *rle_blocks, int num_blocks, int num_chroma_blocks) {
+    Blocks_ZigZag *blocks = alloc_BlocosZigZag(num_blocks, num_chroma_blocks, 1);
+    if (!blocks) return NULL;
 
+    for (int i = 0; i < num_blocks; i++) {
+        rle_to_block(rle_blocks->Y_rle[i], rle_blocks->Y_sizes[i], block_coefs(blocks->Y_blocks, i), &blocks->Y_last[i]);
+    }
 
-            apply_matrix_idct(dct_Y, original_Y, Ct);
-            apply_matrix_idct(dct_Cb, original_Cb, Ct);
-            apply_matrix_idct(dct_Cr, original_Cr, Ct);
+    for (int i = 0; i < num_chroma_blocks; i++) {
+        rle_to_block(rle_blocks->Cb_rle[i], rle_blocks->Cb_sizes[i], block_coefs(blocks->Cb_blocks, i), &blocks->Cb_last[i]);
+        rle_to_block(rle_blocks->Cr_rle[i], rle_blocks->Cr_sizes[i], block_coefs(blocks->Cr_blocks, i), &blocks->Cr_last[i]);
+    }
 
-            for (int y = 0; y < BLOCK_SIZE; y++) {
-                for (int x = 0; x < BLOCK_SIZE; x++) {
-                    int dy = j + y;
-                    int dx = i + x;
-                    values[dy * width + dx].Y = original_Y[x][y] + 128.0;
-                    values[dy * width + dx].Cb = original_Cb[x][y] + 128.0;
-                    values[dy * width + dx].Cr = original_Cr[x][y] + 128.0;
-                }
-            }
+    return blocks;
+}
 
-        }
-    }
+YCbCr_Planes *blocks_to_pixels(Blocks_ZigZag *blocks, int width, int height, int chroma_width, int chroma_height,
+                               IDCT_Engine *engine) {
+
+    YCbCr_Planes *values = alloc_planes(width, height, chroma_width, chroma_height);
+    if (!values) return NULL;
+
+    idct_plane(engine, blocks->Y_blocks, blocks->Y_last, &engine->lumin, 128,
+                      values->Y, width, height);
+
+    // Undo the level shift and restore the +128 offset of the chroma planes
+    idct_plane(engine, blocks->Cb_blocks, blocks->Cb_last, &engine->chrom, 256,
+                      values->Cb, chroma_width, chroma_height);
+    idct_plane(engine, blocks->Cr_blocks, blocks->Cr_last, &engine->chrom, 256,
+                      values->Cr, chroma_width, chroma_height);
 
     return values;
 }
@@ -1,21 +1,89 @@
 #include "decompressor.h"
 
+// Parses "x,y,w,h" with a non-negative corner and a positive size
+static int parse_region(const char *text, int region[4]) {
+    char end;
+    if (sscanf(text, "%d,%d,%d,%d%c", &region[0], &region[1], &region[2], &region[3], &end) != 4 ||
+        region[0] < 0 || region[1] < 0 || region[2] < 1 || region[3] < 1) {
+        return FAILURE;
+    }
+    return SUCCESS;
+}
+
 /**
  * @brief Main entry point for the BMP decompressor.
  *
  * This function validates command-line arguments and initiates the decompression process.
  *
+ * Options:
+ *   --idct <matrix|fast>  Inverse DCT implementation (default: fast).
+ *   --threads <n>         Threads for segment decoding and the IDCT, 0 = one per CPU (default: 1).
+ *   --scale <1|2|4|8>     Decode at 1/scale of the image size (default: 1).
+ *   --region <x,y,w,h>    Decode only this rectangle of the (scaled) image.
+ *   --batch               Decompress every BIN of <inputs> (a directory, a glob or a list file) into <output_dir>.
+ *   --jobs <n>            Batch mode: files decompressed concurrently, 0 = one per CPU (default: 0).
+ *   --stats               Print per-stage timings and symbol counters as JSON instead of the report.
+ *
  * @param argc Number of command-line arguments.
  * @param argv Array of command-line argument strings.
  * @return SUCCESS if the compression is successful, otherwise FAILURE.
  */
 int main(int argc, char *argv[]) {
-    if (argc != 3) {
-        printf("Uso: %s <input.bin> <output.bmp>\n", argv[0]);
+    Decompress_Options options;
+    init_decompress_options(&options);
+    int region[4] = {0, 0, 0, 0};
+    int batch = 0;
+    int jobs = 0;
+
+    int arg = 1;
+    while (arg < argc && strncmp(argv[arg], "--", 2) == 0) {
+        if (strcmp(argv[arg], "--idct") == 0 && arg + 1 < argc &&
+            parse_dct_method(argv[arg + 1], &options.idct_method) == SUCCESS) {
+            arg += 2;
+        } else if (strcmp(argv[arg], "--threads") == 0 && arg + 1 < argc &&
+                   parse_thread_count(argv[arg + 1], &options.threads) == SUCCESS) {
+            arg += 2;
+        } else if (strcmp(argv[arg], "--scale") == 0 && arg + 1 < argc &&
+                   parse_decode_scale(argv[arg + 1], &options.scale) == SUCCESS) {
+            arg += 2;
+        } else if (strcmp(argv[arg], "--region") == 0 && arg + 1 < argc &&
+                   parse_region(argv[arg + 1], region) == SUCCESS) {
+            arg += 2;
+        } else if (strcmp(argv[arg], "--batch") == 0) {
+            batch = 1;
+            arg += 1;
+        } else if (strcmp(argv[arg], "--jobs") == 0 && arg + 1 < argc &&
+                   parse_thread_count(argv[arg + 1], &jobs) == SUCCESS) {
+            arg += 2;
+        } else if (strcmp(argv[arg], "--stats") == 0) {
+            options.stats = 1;
+            arg += 1;
+        } else {
+            printf("Invalid option: %s\n", argv[arg]);
+            exit(FAILURE);
+        }
+    }
+
+    if (argc - arg != 2) {
+        printf("Uso: %s [--idct matrix|fast] [--threads n] [--scale 1|2|4|8]\n"
+               "          [--region x,y,w,h] [--stats] <input.bin> <output.bmp>\n"
+               "       %s [options] --batch [--jobs n] <directory|glob|list file> <output_dir>\n", argv[0], argv[0]);
         exit(FAILURE);
     }
 
-    if (decompress_bin(argv[1], argv[2]) != SUCCESS) {
+    if (batch) {
+        if (region[2] != 0) {
+            printf("--region cannot be used with --batch.\n");
+            exit(FAILURE);
+        }
+        if (decompress_batch(argv[arg], argv[arg + 1], &options, jobs) != SUCCESS) {
+            printf("Error decompressing the batch.\n");
+            exit(FAILURE);
+        }
+        return SUCCESS;
+    }
+
+    if (decompress_region(argv[arg], argv[arg + 1], region[0], region[1], region[2], region[3], &options) != SUCCESS) {
         printf("Error decompressing the BIN file.\n");
         exit(FAILURE);
     }
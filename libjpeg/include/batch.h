@@ -0,0 +1,125 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "types.h"
+
+/**
+ * Batch processing of many files in one process.
+ *
+ * The inputs are taken from a list file (one path per line), a directory or a
+ * glob pattern, and each one is written under an output directory with its
+ * extension replaced. Files are independent, so they run concurrently on a
+ * pool of workers, one file per worker at a time: the files are sorted by size,
+ * largest first, and every idle worker claims the next one, so the big images
+ * start early and the small ones fill the gaps at the end.
+ *
+ * Each worker owns a scratch buffer that is handed to every file it runs and
+ * only grows, so steady-state batches allocate nothing per file for it.
+ */
+
+/**
+ * @brief Input file of a batch.
+ */
+typedef struct {
+    char *path;
+    uint64_t size;              /* File size in bytes, used for scheduling and the summary */
+} Batch_File;
+
+/**
+ * @brief Input files of a batch.
+ */
+typedef struct {
+    Batch_File *files;
+    int count;
+    int capacity;
+} Batch_List;
+
+/**
+ * @brief Per-worker buffer reused across the files run by that worker.
+ */
+typedef struct {
+    void *data;
+    size_t size;
+} Batch_Scratch;
+
+/**
+ * @brief Function run for every file of a batch.
+ *
+ * @param context Pointer given to run_batch().
+ * @param scratch Scratch buffer of the worker running the file (see batch_scratch_reserve()).
+ * @param input Path of the input file.
+ * @param output Path of the output file.
+ * @return SUCCESS, or FAILURE if the file could not be processed.
+ */
+typedef int (*Batch_Job)(void *context, Batch_Scratch *scratch, const char *input, const char *output);
+
+/**
+ * @brief Totals of a finished batch.
+ */
+typedef struct {
+    int files;                  /* Files processed successfully */
+    int failed;                 /* Files that could not be processed */
+    uint64_t input_bytes;       /* Size of the inputs processed successfully */
+    uint64_t output_bytes;      /* Size of their outputs */
+    double seconds;             /* Wall-clock time of the whole batch */
+    int workers;                /* Files run concurrently */
+} Batch_Summary;
+
+/**
+ * @brief Lists the input files of a batch.
+ *
+ * 'source' is a directory (its regular files ending in 'extension' are taken),
+ * a glob pattern (when it contains '*', '?' or '[' and is not an existing path)
+ * or a list file with one path per line. The files are sorted largest first.
+ *
+ * @param source Directory, glob pattern or list file.
+ * @param extension Extension of the inputs taken from a directory, e.g. ".bmp" (case-insensitive).
+ * @param list Output for the files; release it with free_batch_list().
+ * @return SUCCESS, or FAILURE if the source cannot be read, a listed file is
+ *         missing or an allocation fails.
+ */
+int collect_batch_inputs(const char *source, const char *extension, Batch_List *list);
+
+/**
+ * @brief Frees the files of a batch list.
+ *
+ * @param list Pointer to the list.
+ */
+void free_batch_list(Batch_List *list);
+
+/**
+ * @brief Makes a scratch buffer at least 'size' bytes long, keeping it if it already is.
+ *
+ * @param scratch Pointer to the scratch buffer.
+ * @param size Bytes needed.
+ * @return Pointer to the buffer, or NULL if it cannot be grown.
+ */
+void *batch_scratch_reserve(Batch_Scratch *scratch, size_t size);
+
+/**
+ * @brief Runs 'job' for every file of the list, 'workers' files at a time.
+ *
+ * The output of each file is 'output_dir'/<input name without its extension><'extension'>.
+ * The output directory is created if it does not exist. A file that fails is
+ * reported and counted; the others still run.
+ *
+ * @param list Input files, largest first (see collect_batch_inputs()).
+ * @param output_dir Directory receiving the outputs.
+ * @param extension Extension of the outputs, e.g. ".bin".
+ * @param workers Files run concurrently; 0 = one per CPU.
+ * @param job Function run for every file.
+ * @param context Pointer passed to every call of 'job'.
+ * @param summary Output for the totals of the batch.
+ * @return SUCCESS if every file was processed, otherwise FAILURE.
+ */
+int run_batch(const Batch_List *list, const char *output_dir, const char *extension, int workers,
+              Batch_Job job, void *context, Batch_Summary *summary);
+
+/**
+ * @brief Prints the totals and the throughput of a batch.
+ *
+ * @param summary Totals of the batch.
+ */
+void print_batch_summary(const Batch_Summary *summary);
+
+#endif /* BATCH_H */
@@ -6,17 +6,71 @@
 /**
  * @brief Initializes a Bit_Read_Write structure for writing bits to a file.
  *
- * Sets the internal buffer and bit counter to 0 and associates the bit writer with a file.
+ * Clears the accumulator and the byte buffer and associates the bit writer with a file.
+ * Nothing reaches the file until the buffer fills up or flush_bits() is called.
  *
  * @param bw Pointer to the Bit_Read_Write structure to initialize.
  * @param fp FILE pointer to the output binary file.
  */
 void init_bitwriter(Bit_Read_Write *bw, FILE *fp);
 
+/**
+ * @brief Moves the bytes accumulated in the bit writer buffer to the file.
+ *
+ * Called automatically when the buffer is full; only complete 32-bit words are
+ * ever stored in the buffer, so pending bits in the accumulator are not affected.
+ *
+ * @param bw Pointer to the Bit_Read_Write structure.
+ */
+void drain_bit_buffer(Bit_Read_Write *bw);
+
+/**
+ * @brief Writes the 'length' low bits of 'code' to the bitstream, MSB first.
+ *
+ * This is the fast path used for Huffman codes and magnitude bits: the bits are
+ * shifted into a 64-bit accumulator and a whole 32-bit word is stored in the
+ * memory buffer every time the accumulator holds at least 32 bits.
+ *
+ * @param bw Pointer to the Bit_Read_Write structure.
+ * @param code The bits to write (only the 'length' least significant bits are used).
+ * @param length Number of bits to write (0 to 32).
+ */
+static inline void write_code(Bit_Read_Write *bw, uint32_t code, int length) {
+    bw->acc = (bw->acc << length) | (code & ((1ULL << length) - 1));
+    bw->bit_count += length;
+
+    if (bw->bit_count >= 32) {
+        bw->bit_count -= 32;
+        uint32_t word = (uint32_t)(bw->acc >> bw->bit_count);
+        uint8_t *out = bw->buffer + bw->pos;
+        out[0] = (uint8_t)(word >> 24);
+        out[1] = (uint8_t)(word >> 16);
+        out[2] = (uint8_t)(word >> 8);
+        out[3] = (uint8_t)word;
+        bw->pos += 4;
+        if (bw->pos == BIT_BUFFER_SIZE) drain_bit_buffer(bw);
+    }
+}
+
+/**
+ * @brief Returns the "complement-1" representation of a signed value on 'n_bits' bits.
+ *
+ * Positive values are kept as is; negative values become the inverted bits of their
+ * absolute value, which is (value - 1) in two's complement.
+ *
+ * @param value The signed value.
+ * @param n_bits The number of bits (the value category).
+ * @return The bits to write, already masked to 'n_bits'.
+ */
+static inline uint32_t complement1_bits(int value, int n_bits) {
+    int bits = (value < 0) ? value - 1 : value;
+    return (uint32_t)bits & (uint32_t)((1ULL << n_bits) - 1);
+}
+
 /**
  * @brief Writes a single bit to the bitstream.
  *
- * Buffers bits until a full byte is accumulated, then writes the byte to the file.
+ * Bits are accumulated in memory and written to the file in large chunks.
  *
  * @param bw Pointer to the Bit_Read_Write structure.
  * @param bit The bit to write (0 or 1).
@@ -45,7 +99,8 @@ void write_bits(Bit_Read_Write *bw, const char *bits);
 void write_n_bits(Bit_Read_Write *bw, int value, int n);
 
 /**
- * @brief Flushes the remaining bits in the buffer by padding with zeros and writing to file.
+ * @brief Flushes the remaining bits by padding the last byte with zeros and writing
+ *        the whole buffer to the file.
  *
  * This must be called at the end of writing to ensure all bits are flushed to the file.
  *
@@ -53,6 +108,16 @@ void write_n_bits(Bit_Read_Write *bw, int value, int n);
  */
 void flush_bits(Bit_Read_Write *bw);
 
+/**
+ * @brief Returns where the next bit will be written, in bits from the start of the file.
+ *
+ * Counts the bytes already in the file, those still in the buffer and the pending bits.
+ *
+ * @param bw Pointer to the Bit_Read_Write structure.
+ * @return Bit offset of the next bit, or UINT64_MAX if the file position is unknown.
+ */
+uint64_t bit_writer_position(Bit_Read_Write *bw);
+
 /**
  * @brief Writes a signed value in "complement-1" binary format used in JPEG.
  *
@@ -68,13 +133,69 @@ void write_bits_complement1(Bit_Read_Write *bw, int value, int n_bits);
 /**
  * @brief Initializes a Bit_Read_Write structure for reading bits from a file.
  *
- * Sets the internal buffer and bit counter to zero and associates the structure with the given file.
+ * Sets the accumulator and bit counter to zero and associates the structure with the given file.
+ * Bytes are pulled from the file in BIT_BUFFER_SIZE chunks as the accumulator drains.
  *
  * @param br Pointer to the Bit_Read_Write structure to initialize.
  * @param fp FILE pointer to the input binary file.
  */
 void init_bitreader(Bit_Read_Write *br, FILE *fp);
 
+/**
+ * @brief Initializes a Bit_Read_Write structure for reading bits from memory.
+ *
+ * The bytes are read in place (e.g. from a mapped file, see mapped_file.h), with no
+ * copy through the internal buffer; they must stay valid while the reader is used.
+ *
+ * @param br Pointer to the Bit_Read_Write structure to initialize.
+ * @param data The bytes to read.
+ * @param size Number of bytes in 'data'; reading past them gives zero padding bits.
+ */
+void init_bitreader_memory(Bit_Read_Write *br, const uint8_t *data, size_t size);
+
+/**
+ * @brief Moves the bit reader to a bit offset of its file or memory, dropping any buffered bits.
+ *
+ * @param br Pointer to the Bit_Read_Write structure.
+ * @param bit_offset Offset of the next bit to read, in bits from the start of the file (or of 'data').
+ * @return SUCCESS, or FAILURE if the file cannot be seeked or ends before the offset.
+ */
+int seek_bitreader(Bit_Read_Write *br, uint64_t bit_offset);
+
+/**
+ * @brief Refills the reader accumulator so that it holds at least 57 bits.
+ *
+ * Past the end of the file the accumulator is padded with zero bits, which are
+ * tracked in 'pad_bits' so that consuming them can be reported as an error.
+ *
+ * @param br Pointer to the Bit_Read_Write structure.
+ */
+void fill_bits(Bit_Read_Write *br);
+
+/**
+ * @brief Returns the next 'n' bits of the bitstream without consuming them.
+ *
+ * @param br Pointer to the Bit_Read_Write structure.
+ * @param n Number of bits to look at (1 to 32).
+ * @return The bits, MSB first, as an unsigned integer.
+ */
+static inline uint32_t peek_bits(Bit_Read_Write *br, int n) {
+    if (br->bit_count < n) fill_bits(br);
+    return (uint32_t)(br->acc >> (br->bit_count - n)) & (uint32_t)((1ULL << n) - 1);
+}
+
+/**
+ * @brief Consumes 'n' bits previously inspected with peek_bits().
+ *
+ * @param br Pointer to the Bit_Read_Write structure.
+ * @param n Number of bits to consume (must not exceed the peeked amount).
+ * @return 1 if the consumed bits came from the file, 0 if they ran past its end.
+ */
+static inline int skip_bits(Bit_Read_Write *br, int n) {
+    br->bit_count -= n;
+    return br->bit_count >= br->pad_bits;
+}
+
 /**
  * @brief Reads a single bit from the bitstream.
  *
@@ -7,7 +7,8 @@
 /**
  * @brief Reads the BMP file header from the given file.
  *
- * This function reads the BMP file header and verifies the magic number.
+ * This function reads the BMP file header in a single call and verifies the magic number
+ * and that the pixel data starts after the headers.
  *
  * @param F Pointer to the BMP file opened in binary mode.
  * @param H Pointer to a BMPFILEHEADER structure where the header data will be stored.
@@ -18,9 +19,9 @@ int readHeader(FILE *F, BMPFILEHEADER *H);
 /**
  * @brief Reads the BMP file information header.
  *
- * This function reads the BMP info header from the file and performs validations:
- * - Checks that the width and height are multiples of 8.
- * - Ensures the dimensions are within the allowed range (8x8 to 1280x800).
+ * This function reads the BMP info header in a single call and performs validations:
+ * - Checks that the width and height are positive (any size, not only multiples of 8).
+ * - Ensures the number of 8x8 blocks fits in an int.
  * - Confirms that the image has 24 bits per pixel and uses no compression.
  *
  * @param F Pointer to the BMP file opened in binary mode.
@@ -29,11 +30,72 @@ int readHeader(FILE *F, BMPFILEHEADER *H);
  */
 int readInfoHeader(FILE *F, BMPINFOHEADER *H);
 
+/**
+ * @brief Parses and validates both headers from a file held in memory (see mapped_file.h).
+ *
+ * Performs the checks of readHeader() and readInfoHeader().
+ *
+ * @param data File contents.
+ * @param size Bytes in 'data'.
+ * @param fileHeader Output for the BMP file header.
+ * @param infoHeader Output for the BMP info header.
+ * @return SUCCESS if the headers are present and valid, otherwise FAILURE.
+ */
+int parse_bmp_headers(const uint8_t *data, size_t size, BMPFILEHEADER *fileHeader, BMPINFOHEADER *infoHeader);
+
+/**
+ * @brief Locates the pixel rows of a BMP file held in memory (mapped or being written).
+ *
+ * Row y (from the top) starts at 'top_offset' + y * stride and holds 'width'
+ * B, G, R triplets, i.e. it can be used as an RGB_Pixel array in place. The
+ * stride is negative, since BMP stores the rows from bottom to top.
+ *
+ * @param size Bytes in the file.
+ * @param H Pointer to the BMP file header containing the offset to the pixel data.
+ * @param width Image width.
+ * @param height Image height.
+ * @param top_offset Output for the file offset of the top row.
+ * @param stride Output for the distance in bytes from a row to the one below it.
+ * @return SUCCESS, or FAILURE if the file is too short for the pixel data.
+ */
+int bmp_pixel_rows(size_t size, const BMPFILEHEADER *H, int width, int height, size_t *top_offset,
+                   ptrdiff_t *stride);
+
+/**
+ * @brief Size of a BMP file: the pixel data offset plus the padded rows.
+ *
+ * @param H Pointer to the BMP file header containing the offset to the pixel data.
+ * @param width Image width.
+ * @param height Image height.
+ * @return File size in bytes.
+ */
+uint64_t bmp_file_size(const BMPFILEHEADER *H, int width, int height);
+
+/**
+ * @brief Stores both headers at the start of a BMP file held in memory.
+ *
+ * @param data File contents (at least BMP_HEADERS_SIZE bytes).
+ * @param fileHeader Pointer to the BMP file header.
+ * @param infoHeader Pointer to the BMP information header.
+ */
+void store_bmp_headers(uint8_t *data, const BMPFILEHEADER *fileHeader, const BMPINFOHEADER *infoHeader);
+
+/**
+ * @brief Fills the headers of a 24-bit, uncompressed, bottom-up BMP image of the given size.
+ *
+ * @param fileHeader Output for the BMP file header.
+ * @param infoHeader Output for the BMP information header.
+ * @param width Image width.
+ * @param height Image height.
+ * @return SUCCESS, or FAILURE if the size is not valid (see parse_bmp_headers()).
+ */
+int init_bmp_headers(BMPFILEHEADER *fileHeader, BMPINFOHEADER *infoHeader, int width, int height);
+
 /**
  * @brief Reads pixel data from a BMP file.
  *
- * This function calculates the row padding (each row must have a size that is a multiple of 4 bytes)
- * and reads the pixel data from the BMP file in bottom-to-top order, which is how BMP stores its data.
+ * Reads the image one row per call (see read_pixel_row()), skipping the padding that makes
+ * each row a multiple of 4 bytes; the rows are returned top to bottom.
  *
  * @param file Pointer to the BMP file opened in binary mode.
  * @param H Pointer to the BMP file header containing the offset to the pixel data.
@@ -43,6 +105,39 @@ int readInfoHeader(FILE *F, BMPINFOHEADER *H);
  */
 RGB_Pixel *read_pixels(FILE *file, BMPFILEHEADER *H, int width, int height);
 
+/**
+ * @brief Reads one pixel row from a BMP file.
+ *
+ * Rows are addressed top to bottom ('y' = 0 is the top row of the image), seeking
+ * to the row inside the bottom-to-top pixel data, so an image can be streamed
+ * row by row without holding it in memory.
+ *
+ * @param file Pointer to the BMP file opened in binary mode.
+ * @param H Pointer to the BMP file header containing the offset to the pixel data.
+ * @param width Image width.
+ * @param height Image height.
+ * @param y Index of the row to read, from the top.
+ * @param row Output array of 'width' pixels.
+ * @return SUCCESS if the row was read, otherwise FAILURE.
+ */
+int read_pixel_row(FILE *file, const BMPFILEHEADER *H, int width, int height, int y, RGB_Pixel *row);
+
+/**
+ * @brief Writes one pixel row, with its padding, into a BMP file.
+ *
+ * The counterpart of read_pixel_row(): rows are addressed top to bottom and
+ * seeked to, so an image can be written row by row after write_bmp_headers().
+ *
+ * @param file Pointer to the BMP file opened in binary mode for writing.
+ * @param H Pointer to the BMP file header containing the offset to the pixel data.
+ * @param width Image width.
+ * @param height Image height.
+ * @param y Index of the row to write, from the top.
+ * @param row Array of 'width' pixels.
+ * @return SUCCESS if the row was written, otherwise FAILURE.
+ */
+int write_pixel_row(FILE *file, const BMPFILEHEADER *H, int width, int height, int y, const RGB_Pixel *row);
+
 /**
  * @brief Frees memory allocated for pixel data.
  *
@@ -50,6 +145,16 @@ RGB_Pixel *read_pixels(FILE *file, BMPFILEHEADER *H, int width, int height);
  */
 void free_pixels(RGB_Pixel *pixels);
 
+/**
+ * @brief Writes the BMP file header and info header.
+ *
+ * @param dst Pointer to the destination file already opened in "wb" mode.
+ * @param fileHeader Pointer to the BMP file header.
+ * @param infoHeader Pointer to the BMP information header.
+ * @return SUCCESS if the operation is successful, otherwise FAILURE.
+ */
+int write_bmp_headers(FILE *dst, const BMPFILEHEADER *fileHeader, const BMPINFOHEADER *infoHeader);
+
 /**
  * @brief Writes a BMP file based on the provided headers and pixel array.
  *
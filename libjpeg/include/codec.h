@@ -0,0 +1,175 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+#include "types.h"
+#include "encoder.h"
+#include "decoder.h"
+
+/**
+ * In-memory encoding and decoding, for applications that link the library.
+ *
+ * Images are encoded from a pixel buffer of any row stride and channel order
+ * into a growable memory buffer or through a write callback, and BIN streams
+ * are decoded from memory straight into a caller-supplied pixel buffer. No file
+ * is touched, and nothing is printed: every function returns a Codec_Status.
+ * The library's other diagnostics go through the message handler (see
+ * messages.h), which an application can redirect or silence.
+ *
+ * The functions keep no state between calls and can run concurrently.
+ */
+
+/**
+ * @brief Result of a codec call; CODEC_OK is SUCCESS.
+ */
+typedef enum {
+    CODEC_OK = SUCCESS,
+    CODEC_ERROR_ARGUMENT,       /* Invalid image, buffer or setting */
+    CODEC_ERROR_MEMORY,         /* An allocation failed */
+    CODEC_ERROR_IO,             /* The write or read callback failed */
+    CODEC_ERROR_FORMAT,         /* The data is not a valid BIN stream */
+    CODEC_ERROR_UNSUPPORTED,    /* Valid BIN data the codec cannot decode (legacy whole-channel files) */
+    CODEC_ERROR_TARGET          /* Even MIN_QUALITY does not fit config->target_bytes; the stream is still complete */
+} Codec_Status;
+
+/**
+ * @brief Byte order of the channels of a pixel.
+ */
+typedef enum {
+    PIXEL_BGR,                  /* 3 bytes: blue, green, red (BMP order) */
+    PIXEL_RGB,                  /* 3 bytes: red, green, blue */
+    PIXEL_BGRA,                 /* 4 bytes: blue, green, red, alpha */
+    PIXEL_RGBA                  /* 4 bytes: red, green, blue, alpha */
+} Pixel_Order;
+
+/**
+ * @brief A pixel buffer owned by the caller.
+ *
+ * Row y (from the top) starts at 'pixels' + y * 'stride'. Alpha is ignored
+ * when encoding and set to 255 when decoding.
+ */
+typedef struct {
+    uint8_t *pixels;            /* First pixel of the top row */
+    int width;
+    int height;
+    ptrdiff_t stride;           /* Bytes from a row to the one below it (negative for bottom-up buffers) */
+    Pixel_Order order;
+} Pixel_Image;
+
+/**
+ * @brief Growable memory buffer receiving an encoded stream (or holding one to decode).
+ *
+ * 'data' is a malloc() block owned by the caller; start with all fields zero.
+ * The codec reallocates it when it is too small and never shrinks it, so a
+ * buffer reused across calls stops allocating once it has grown. Free 'data'
+ * with free().
+ */
+typedef struct {
+    uint8_t *data;
+    size_t size;                /* Bytes of valid data */
+    size_t capacity;            /* Bytes allocated */
+} Memory_Buffer;
+
+/**
+ * @brief Receives the next bytes of an encoded stream.
+ *
+ * @param user Pointer given to encode_image_to_callback().
+ * @param data The bytes.
+ * @param size Number of bytes.
+ * @return SUCCESS, or FAILURE to abort the encoding.
+ */
+typedef int (*Write_Callback)(void *user, const uint8_t *data, size_t size);
+
+/**
+ * @brief Supplies the next bytes of an encoded stream.
+ *
+ * @param user Pointer given to read_to_memory().
+ * @param data Output for up to 'size' bytes.
+ * @param size Bytes wanted.
+ * @return Bytes stored in 'data': 0 at the end of the stream, or (size_t)-1 on error.
+ */
+typedef size_t (*Read_Callback)(void *user, uint8_t *data, size_t size);
+
+/**
+ * @brief Returns the number of bytes of one pixel (3 or 4).
+ *
+ * @param order Channel order.
+ * @return Bytes per pixel.
+ */
+int pixel_size(Pixel_Order order);
+
+/**
+ * @brief Encodes an image into a memory buffer.
+ *
+ * BGR images are color converted straight from the caller's buffer; other
+ * orders are converted one stripe at a time.
+ *
+ * @param image The image to encode.
+ * @param config Encoder settings, or NULL for the defaults (see init_encoder_config()).
+ * @param out Buffer receiving the BIN stream; its previous contents are replaced.
+ * @return CODEC_OK, CODEC_ERROR_ARGUMENT, CODEC_ERROR_MEMORY or CODEC_ERROR_TARGET (with the whole stream,
+ *         coded at MIN_QUALITY, in 'out').
+ */
+Codec_Status encode_image_to_memory(const Pixel_Image *image, const Encoder_Config *config, Memory_Buffer *out);
+
+/**
+ * @brief Encodes an image, handing the BIN stream to a callback as it is produced.
+ *
+ * The callback output cannot seek, so restart segments (which need their offset
+ * table filled in at the end) are not available; an index is.
+ *
+ * @param image The image to encode.
+ * @param config Encoder settings, or NULL for the defaults; restart_interval must be 0.
+ * @param write Function receiving the bytes, in order.
+ * @param user Pointer passed to every call of 'write'.
+ * @return CODEC_OK, CODEC_ERROR_ARGUMENT, CODEC_ERROR_MEMORY, CODEC_ERROR_IO or CODEC_ERROR_TARGET (after
+ *         handing over the whole stream, coded at MIN_QUALITY).
+ */
+Codec_Status encode_image_to_callback(const Pixel_Image *image, const Encoder_Config *config,
+                                      Write_Callback write, void *user);
+
+/**
+ * @brief Reads a whole stream from a callback into a memory buffer, e.g. before decode_image().
+ *
+ * @param read Function supplying the bytes.
+ * @param user Pointer passed to every call of 'read'.
+ * @param buffer Buffer receiving the stream; its previous contents are replaced.
+ * @return CODEC_OK, CODEC_ERROR_MEMORY or CODEC_ERROR_IO.
+ */
+Codec_Status read_to_memory(Read_Callback read, void *user, Memory_Buffer *buffer);
+
+/**
+ * @brief Returns the size of the image a BIN stream decodes to at a given scale.
+ *
+ * @param data The BIN stream.
+ * @param size Bytes in 'data'.
+ * @param scale Output size divisor: 1, 2, 4 or 8.
+ * @param width Output for the decoded width.
+ * @param height Output for the decoded height.
+ * @return CODEC_OK, CODEC_ERROR_ARGUMENT, CODEC_ERROR_FORMAT or CODEC_ERROR_UNSUPPORTED.
+ */
+Codec_Status read_image_info(const uint8_t *data, size_t size, int scale, int *width, int *height);
+
+/**
+ * @brief Decodes a BIN stream held in memory into a caller-supplied pixel buffer.
+ *
+ * The image size must be the one given by read_image_info() for the scale of
+ * 'config'. BGR rows are color converted straight into the buffer; other orders
+ * are converted one stripe at a time.
+ *
+ * @param data The BIN stream; only read.
+ * @param size Bytes in 'data'.
+ * @param config Decoder settings, or NULL for the defaults (see init_decoder_config()).
+ * @param image Pixel buffer receiving the image.
+ * @return CODEC_OK, CODEC_ERROR_ARGUMENT, CODEC_ERROR_MEMORY, CODEC_ERROR_FORMAT or CODEC_ERROR_UNSUPPORTED.
+ */
+Codec_Status decode_image(const uint8_t *data, size_t size, const Decoder_Config *config, const Pixel_Image *image);
+
+/**
+ * @brief Returns a short description of a status, e.g. for a log.
+ *
+ * @param status The status.
+ * @return A static string.
+ */
+const char *codec_status_text(Codec_Status status);
+
+#endif /* CODEC_H */
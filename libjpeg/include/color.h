@@ -0,0 +1,69 @@
+#ifndef COLOR_H
+#define COLOR_H
+
+#include "types.h"
+
+#include <stddef.h>
+
+/**
+ * Fixed-point color conversion between packed BGR pixels and 8-bit Y, Cb, Cr planes.
+ *
+ * Coefficients are the BT-601 ones used by the rest of the library, scaled by
+ * 2^COLOR_SCALE_BITS so they fit in 16 bits. Cb and Cr planes are stored with a
+ * +128 offset. Every kernel performs the same integer arithmetic, so the SIMD
+ * and scalar paths produce identical output.
+ */
+#define COLOR_SCALE_BITS 14
+
+/**
+ * @brief Available color conversion kernels.
+ */
+typedef enum {
+    COLOR_KERNEL_AUTO = 0,      /* Best kernel supported by the running CPU */
+    COLOR_KERNEL_SCALAR,        /* Portable C, one pixel at a time */
+    COLOR_KERNEL_SSSE3,         /* 16 pixels per iteration (SSE2 arithmetic, SSSE3 byte shuffles) */
+    COLOR_KERNEL_AVX2           /* 32 pixels per iteration */
+} Color_Kernel;
+
+/**
+ * @brief Returns the fastest color kernel supported by the running CPU.
+ *
+ * @return COLOR_KERNEL_AVX2, COLOR_KERNEL_SSSE3 or COLOR_KERNEL_SCALAR.
+ */
+Color_Kernel detect_color_kernel(void);
+
+/**
+ * @brief Returns a printable name for a color kernel ("scalar", "ssse3", "avx2" or "auto").
+ *
+ * @param kernel The color kernel.
+ * @return Constant string with the kernel name.
+ */
+const char *color_kernel_name(Color_Kernel kernel);
+
+/**
+ * @brief Converts packed BGR pixels to Y, Cb and Cr planes.
+ *
+ * @param rgb Input pixels.
+ * @param Y Output luminance plane ('count' bytes).
+ * @param Cb Output blue-difference plane ('count' bytes, +128 offset).
+ * @param Cr Output red-difference plane ('count' bytes, +128 offset).
+ * @param count Number of pixels to convert.
+ * @param kernel Kernel to use; COLOR_KERNEL_AUTO picks detect_color_kernel().
+ */
+void rgb_to_ycbcr_planes(const RGB_Pixel *rgb, uint8_t *Y, uint8_t *Cb, uint8_t *Cr,
+                         size_t count, Color_Kernel kernel);
+
+/**
+ * @brief Converts Y, Cb and Cr planes back to packed BGR pixels, saturating to [0, 255].
+ *
+ * @param Y Input luminance plane.
+ * @param Cb Input blue-difference plane (+128 offset).
+ * @param Cr Input red-difference plane (+128 offset).
+ * @param rgb Output pixels ('count' entries).
+ * @param count Number of pixels to convert.
+ * @param kernel Kernel to use; COLOR_KERNEL_AUTO picks detect_color_kernel().
+ */
+void ycbcr_planes_to_rgb(const uint8_t *Y, const uint8_t *Cb, const uint8_t *Cr, RGB_Pixel *rgb,
+                         size_t count, Color_Kernel kernel);
+
+#endif /* COLOR_H */
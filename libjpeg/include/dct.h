@@ -0,0 +1,258 @@
+#ifndef DCT_H
+#define DCT_H
+
+#include "types.h"
+#include "quant.h"
+
+/**
+ * @brief Available DCT/IDCT implementations.
+ */
+typedef enum {
+    DCT_METHOD_MATRIX = 0,  /* Reference: two 8x8 double matrix products (C * B * C^T) */
+    DCT_METHOD_FAST         /* Separable fixed-point AAN transform with scaling folded into (de)quantization */
+} DCT_Method;
+
+/*
+ * Blocks enter and leave the transforms as integer samples (level shifted), so
+ * with DCT_METHOD_FAST the whole pipeline, from BGR pixels to the bitstream and
+ * back, runs in integer arithmetic and gives the same output on every compiler
+ * and CPU. Only DCT_METHOD_MATRIX computes in double, as the reference; it
+ * rounds its samples to integers when it is done.
+ */
+
+/**
+ * @brief Quantization matrix together with the tables derived from it.
+ *
+ * The derived tables are in zigzag order, as the kernels of quant.h expect.
+ * 'fdct_reciprocal' holds, for the fast FDCT, 1 / (q * AAN row scale * AAN column scale)
+ * in fixed point (FDCT_RECIPROCAL_BITS fraction bits), so quantizing is one multiply and a shift.
+ * 'idct_multiplier' holds, for the fast IDCT, q * AAN row scale * AAN column scale / 8
+ * in fixed point (IDCT_SCALE_BITS fraction bits), so dequantizing is one multiply.
+ * 'divisor' holds q itself, for the other inverse kernels.
+ */
+typedef struct {
+    uint8_t matrix[BLOCK_SIZE][BLOCK_SIZE];
+    int32_t fdct_reciprocal[BLOCK_SIZE * BLOCK_SIZE];
+    int32_t idct_multiplier[BLOCK_SIZE * BLOCK_SIZE];
+    int32_t divisor[BLOCK_SIZE * BLOCK_SIZE];
+} Quant_Table;
+
+#define IDCT_SCALE_BITS 8
+
+// Quality factor of the standard matrices (lumin_matrix and chrom_matrix), and the accepted range
+#define DEFAULT_QUALITY 50
+#define MIN_QUALITY 1
+#define MAX_QUALITY 100
+
+typedef struct FDCT_Engine FDCT_Engine;
+
+/**
+ * @brief Forward DCT + quantization + zigzag kernel.
+ *
+ * @param engine The engine the kernel belongs to.
+ * @param block Input block in the spatial domain (level shifted).
+ * @param table Quantization table for the block's channel.
+ * @param coef Output: 64 quantized coefficients in zigzag order.
+ */
+typedef void (*FDCT_Kernel)(const FDCT_Engine *engine, const int16_t block[BLOCK_SIZE][BLOCK_SIZE],
+                            const Quant_Table *table, int16_t coef[BLOCK_SIZE * BLOCK_SIZE]);
+
+/**
+ * @brief Forward transform selected at runtime, with its quantization tables.
+ */
+struct FDCT_Engine {
+    DCT_Method method;
+    FDCT_Kernel transform;                  /* Kernel for 'method' */
+    Quant_Kernel quant_kernel;              /* Quantization kernel of the fast method, picked for the CPU */
+    double Ct[BLOCK_SIZE][BLOCK_SIZE];      /* C^T, used by the matrix kernel */
+    Quant_Table lumin;                      /* Y channel quantization */
+    Quant_Table chrom;                      /* Cb and Cr channel quantization */
+};
+
+/**
+ * @brief Initializes a forward DCT engine with the standard quantization matrices scaled to a quality.
+ *
+ * @param engine Pointer to the engine to initialize.
+ * @param method Which forward DCT implementation to use.
+ * @param quality Quality factor (see scale_quant_matrix()).
+ */
+void init_fdct_engine(FDCT_Engine *engine, DCT_Method method, int quality);
+
+/**
+ * @brief Scales a quantization matrix to a quality factor, as the IJG libjpeg does.
+ *
+ * Quality 50 leaves the matrix unchanged; below it the entries are multiplied by
+ * 50 / quality, above it by (100 - quality) / 50. Entries are kept between 3 and
+ * 255: chroma DC coefficients reach -2048 (the planes are level shifted by 256),
+ * and with a divisor of 3 every DC difference still fits category 10, the
+ * largest the standard DC table can code.
+ *
+ * @param matrix Matrix to scale.
+ * @param quality Quality factor, from MIN_QUALITY to MAX_QUALITY.
+ * @param scaled Output matrix.
+ */
+void scale_quant_matrix(const uint8_t matrix[BLOCK_SIZE][BLOCK_SIZE], int quality,
+                        uint8_t scaled[BLOCK_SIZE][BLOCK_SIZE]);
+
+/**
+ * @brief Fills a Quant_Table from an 8x8 quantization matrix.
+ *
+ * @param table Pointer to the table to fill.
+ * @param matrix 8x8 quantization matrix.
+ */
+void init_quant_table(Quant_Table *table, const uint8_t matrix[BLOCK_SIZE][BLOCK_SIZE]);
+
+/**
+ * @brief Reference kernel: apply_matrix_dct(), then the double division and round() of quantize(),
+ * written in zigzag order.
+ *
+ * @param engine The engine (provides C^T).
+ * @param block Input block in the spatial domain.
+ * @param table Quantization table.
+ * @param coef Output: 64 quantized coefficients in zigzag order.
+ */
+void fdct_quantize_matrix(const FDCT_Engine *engine, const int16_t block[BLOCK_SIZE][BLOCK_SIZE],
+                          const Quant_Table *table, int16_t coef[BLOCK_SIZE * BLOCK_SIZE]);
+
+/**
+ * @brief Fast kernel: fixed-point AAN (Arai-Agui-Nakajima) DCT and fused reciprocal quantization + zigzag.
+ *
+ * The block is scaled up by 2^PASS1_BITS and transformed with the factored 1-D DCT
+ * (5 multiplications per 8 samples) on rows and then on columns. The AAN output
+ * scale factors are folded into the quantization reciprocals, and quantize_zigzag()
+ * writes the coefficients in scan order, so no extra pass is needed.
+ *
+ * @param engine The engine (provides the quantization kernel).
+ * @param block Input block in the spatial domain.
+ * @param table Quantization table.
+ * @param coef Output: 64 quantized coefficients in zigzag order.
+ */
+void fdct_quantize_fast(const FDCT_Engine *engine, const int16_t block[BLOCK_SIZE][BLOCK_SIZE],
+                        const Quant_Table *table, int16_t coef[BLOCK_SIZE * BLOCK_SIZE]);
+
+/**
+ * @brief Counts how many blocks went through each inverse transform kernel.
+ */
+typedef struct {
+    long dc_only;       /* Only the DC coefficient: constant fill */
+    long low_2x2;       /* Non-zero coefficients within the top-left 2x2 */
+    long low_4x4;       /* Non-zero coefficients within the top-left 4x4 */
+    long full;          /* Full 8x8 transform */
+} IDCT_Stats;
+
+/**
+ * @brief Inverse transform selected at runtime, with its dequantization tables.
+ */
+typedef struct {
+    DCT_Method method;
+    double Ct[BLOCK_SIZE][BLOCK_SIZE];      /* C^T, used by the matrix kernel */
+    Quant_Table lumin;                      /* Y channel dequantization */
+    Quant_Table chrom;                      /* Cb and Cr channel dequantization */
+    IDCT_Stats stats;                       /* Kernel usage counters */
+} IDCT_Engine;
+
+/**
+ * @brief Initializes an inverse DCT engine with the standard quantization matrices scaled to a quality.
+ *
+ * @param engine Pointer to the engine to initialize.
+ * @param method Which inverse DCT implementation to use.
+ * @param quality Quality factor the stream was encoded with (see scale_quant_matrix()).
+ */
+void init_idct_engine(IDCT_Engine *engine, DCT_Method method, int quality);
+
+/**
+ * @brief Dequantizes and inverse transforms one block of zigzag-ordered coefficients.
+ *
+ * With DCT_METHOD_FAST, 'last' (the zigzag index of the last coded coefficient)
+ * selects the cheapest exact kernel: a constant fill when only DC is present,
+ * a 2x2 or 4x4 low-frequency kernel when every coefficient lies in that corner,
+ * and the full fixed-point AAN IDCT otherwise. The choice is counted in engine->stats.
+ *
+ * @param engine The inverse DCT engine.
+ * @param coef 64 quantized coefficients in zigzag order.
+ * @param last Zigzag index of the last coded coefficient (63 if unknown).
+ * @param table Quantization table of the block's channel.
+ * @param block Output 8x8 block of rounded samples in the spatial domain (not level shifted).
+ */
+void idct_block(IDCT_Engine *engine, const int16_t coef[BLOCK_SIZE * BLOCK_SIZE], int last,
+                const Quant_Table *table, int32_t block[BLOCK_SIZE][BLOCK_SIZE]);
+
+/**
+ * @brief Reduced inverse DCT: reconstructs a block at 1/2, 1/4 or 1/8 of its size.
+ *
+ * Only the top-left 'size' x 'size' coefficients are used, as a 'size'-point IDCT
+ * scaled so that the output approximates the average of each (8 / size)^2 group
+ * of full-size samples: size 1 is the DC coefficient alone, size 2 and 4 run a
+ * 2x2 or 4x4 IDCT on the low-frequency corner. The same kernel serves both
+ * DCT methods, and is counted as DC-only, 2x2 or 4x4 in the engine stats.
+ *
+ * @param engine Inverse DCT engine; its stats count the kernel used.
+ * @param coef 64 quantized coefficients in zigzag order.
+ * @param last Zigzag index of the last coded coefficient (63 if unknown).
+ * @param table Quantization table of the block's channel.
+ * @param size Output samples per side: 1, 2 or 4.
+ * @param block Output: the top-left 'size' x 'size' rounded samples (not level shifted).
+ */
+void idct_block_reduced(IDCT_Engine *engine, const int16_t coef[BLOCK_SIZE * BLOCK_SIZE], int last,
+                        const Quant_Table *table, int size, int32_t block[BLOCK_SIZE][BLOCK_SIZE]);
+
+/**
+ * @brief Inverse transforms every block of a plane, in raster order, into 8-bit samples.
+ *
+ * Samples are saturated after adding 'level_shift'; the samples of
+ * padded blocks past the right or bottom edge of the plane are dropped.
+ *
+ * @param engine Inverse DCT engine; its stats count the kernel used per block.
+ * @param coefs Channel slab of zigzag-ordered blocks covering the plane.
+ * @param last Zigzag index of the last non-zero coefficient of each block.
+ * @param table Dequantization table of the channel.
+ * @param level_shift Value added to every reconstructed sample.
+ * @param plane Output plane ('plane_width' x 'plane_height' samples).
+ * @param plane_width Width of the plane.
+ * @param plane_height Height of the plane.
+ */
+void idct_plane(IDCT_Engine *engine, int16_t *coefs, const int *last, const Quant_Table *table,
+                int level_shift, uint8_t *plane, int plane_width, int plane_height);
+
+/**
+ * @brief Like idct_plane(), but only for a range of block columns and optionally at a reduced size.
+ *
+ * Samples outside the columns are left untouched. With 'block_size' below
+ * BLOCK_SIZE every block yields 'block_size' x 'block_size' samples (see
+ * idct_block_reduced()), and the plane is the reduced one.
+ *
+ * @param engine Inverse DCT engine; its stats count the kernel used per block.
+ * @param coefs Channel slab of zigzag-ordered blocks covering the plane.
+ * @param last Zigzag index of the last non-zero coefficient of each block.
+ * @param table Dequantization table of the channel.
+ * @param level_shift Value added to every reconstructed sample.
+ * @param plane Output plane ('plane_width' x 'plane_height' samples).
+ * @param plane_width Width of the plane.
+ * @param plane_height Height of the plane.
+ * @param first_col First block column to reconstruct.
+ * @param num_cols Number of block columns to reconstruct.
+ * @param block_size Samples per block side: BLOCK_SIZE, or 4, 2 or 1 for a reduced plane.
+ */
+void idct_plane_columns(IDCT_Engine *engine, int16_t *coefs, const int *last, const Quant_Table *table,
+                        int level_shift, uint8_t *plane, int plane_width, int plane_height,
+                        int first_col, int num_cols, int block_size);
+
+/**
+ * @brief Parses a DCT method name ("matrix" or "fast").
+ *
+ * @param name The method name.
+ * @param method Output for the parsed method.
+ * @return SUCCESS if the name is known, otherwise FAILURE.
+ */
+int parse_dct_method(const char *name, DCT_Method *method);
+
+/**
+ * @brief Parses a quality factor option (MIN_QUALITY to MAX_QUALITY).
+ *
+ * @param text The option value.
+ * @param quality Output for the parsed quality.
+ * @return SUCCESS if the value is valid, otherwise FAILURE.
+ */
+int parse_quality(const char *text, int *quality);
+
+#endif /* DCT_H */
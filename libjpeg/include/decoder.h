@@ -0,0 +1,158 @@
+#ifndef DECODER_H
+#define DECODER_H
+
+#include "types.h"
+#include "dct.h"
+#include "stats.h"
+
+/**
+ * Streaming (pull-style) decoder for striped streams (BIN_FLAG_STRIPES).
+ *
+ * The decoder reads the BIN file in place from memory, typically a mapping
+ * (see mapped_file.h): restart segments and index entries are reached by
+ * pointer, without seeking or copying.
+ *
+ * Rows are read top to bottom. Stripes are decoded a batch at a time (one
+ * stripe, or one restart segment, per thread) and only two batches are kept,
+ * so memory use grows with the image width only. Entropy decoding runs on the
+ * caller's thread, or on the pool for restart segments; the inverse DCT always
+ * runs on the pool. The output does not depend on the thread count.
+ *
+ * A region of the image can be decoded instead (stream_decoder_set_region()):
+ * only the stripes and block columns around it are reconstructed, and entropy
+ * decoding starts from the closest index entry (BIN_FLAG_INDEX) or restart
+ * segment rather than from the first stripe.
+ *
+ * With a scale of 2, 4 or 8, every block is reconstructed straight at 4x4, 2x2
+ * or 1x1 samples from its low-frequency coefficients (idct_block_reduced()), so
+ * a downscaled image costs a fraction of a full decode and no full-resolution
+ * buffer is ever allocated.
+ *
+ * With config->stats set, the stats are reset by stream_decoder_create() and
+ * updated by every call that decodes rows; they must stay valid until the
+ * decoder is freed. The read and write stages are left to the caller.
+ */
+typedef struct Stream_Decoder Stream_Decoder;
+
+/**
+ * @brief Settings of the streaming decoder.
+ */
+typedef struct {
+    DCT_Method idct_method;     /* Inverse DCT implementation (default: DCT_METHOD_FAST) */
+    int threads;                /* Threads for entropy decoding of segments and the IDCT; 0 = one per CPU (default: 1) */
+    int scale;                  /* Output size divisor: 1, 2, 4 or 8 (default: 1) */
+    Pipeline_Stats *stats;      /* Receives the stage timings and symbol counters; NULL = off (default: NULL) */
+} Decoder_Config;
+
+/**
+ * @brief Fills a Decoder_Config structure with the default settings.
+ *
+ * @param config Pointer to the settings to initialize.
+ */
+void init_decoder_config(Decoder_Config *config);
+
+/**
+ * @brief Parses a decode scale option (1, 2, 4 or 8).
+ *
+ * @param text The option value.
+ * @param scale Output for the parsed scale.
+ * @return SUCCESS if the value is valid, otherwise FAILURE.
+ */
+int parse_decode_scale(const char *text, int *scale);
+
+/**
+ * @brief Creates a streaming decoder for the stream that follows the BIN headers.
+ *
+ * Reads the restart table when BIN_FLAG_RESTART is set and the index footer when
+ * BIN_FLAG_INDEX is set.
+ *
+ * @param data The whole BIN file, headers included; must stay valid until stream_decoder_free().
+ * @param size Bytes in 'data'.
+ * @param fileHeader BIN file header; bfReserved1 holds the format flags.
+ * @param infoHeader BIN info header with the image size.
+ * @param config Decoder settings.
+ * @return Pointer to the new decoder, or NULL if the stream is not striped, the
+ *         scale is invalid, the restart table or the index is invalid or an allocation fails.
+ */
+Stream_Decoder *stream_decoder_create(const uint8_t *data, size_t size, const BMPFILEHEADER *fileHeader,
+                                      const BMPINFOHEADER *infoHeader, const Decoder_Config *config);
+
+/**
+ * @brief Returns the size of the decoded image: the coded size divided by the scale, rounded up.
+ *
+ * @param decoder Pointer to the decoder.
+ * @param width Output for the decoded width.
+ * @param height Output for the decoded height.
+ */
+void stream_decoder_output_size(const Stream_Decoder *decoder, int *width, int *height);
+
+/**
+ * @brief Restricts decoding to a rectangle of the (scaled) image.
+ *
+ * Must be called before the first row is read. stream_decoder_read_rows() then
+ * returns the 'height' rows of the rectangle, 'width' pixels each; they are the
+ * same pixels a full decode gives.
+ *
+ * @param decoder Pointer to the decoder.
+ * @param x Left column of the rectangle.
+ * @param y Top row of the rectangle.
+ * @param width Width of the rectangle.
+ * @param height Height of the rectangle.
+ * @return SUCCESS, or FAILURE if the rectangle is outside the image, decoding has
+ *         started or the data before the rectangle is invalid.
+ */
+int stream_decoder_set_region(Stream_Decoder *decoder, int x, int y, int width, int height);
+
+/**
+ * @brief Decodes the next rows of the image (or of its region), top to bottom.
+ *
+ * @param decoder Pointer to the decoder.
+ * @param rows Output for 'count' consecutive rows of 'width' pixels each (the region width, if set).
+ * @param count Number of rows.
+ * @return SUCCESS, or FAILURE past the last row or on invalid data.
+ */
+int stream_decoder_read_rows(Stream_Decoder *decoder, RGB_Pixel *rows, int count);
+
+/**
+ * @brief Like stream_decoder_read_rows(), but with rows placed 'stride' bytes apart.
+ *
+ * Rows can then be converted straight into their place in an output image, e.g.
+ * the padded, bottom-up rows of a mapped BMP file (negative stride, see bmp_pixel_rows()).
+ *
+ * @param decoder Pointer to the decoder.
+ * @param first_row Output for the first of the 'count' rows.
+ * @param stride Bytes from the start of a row to the start of the next one.
+ * @param count Number of rows.
+ * @return SUCCESS, or FAILURE past the last row or on invalid data.
+ */
+int stream_decoder_read_rows_strided(Stream_Decoder *decoder, uint8_t *first_row, ptrdiff_t stride, int count);
+
+/**
+ * @brief Returns how many blocks went through each inverse DCT kernel so far.
+ *
+ * @param decoder Pointer to the decoder.
+ * @param stats Output for the kernel counters.
+ */
+void stream_decoder_stats(const Stream_Decoder *decoder, IDCT_Stats *stats);
+
+/**
+ * @brief Frees a streaming decoder.
+ *
+ * @param decoder Pointer to the decoder to free (may be NULL).
+ */
+void stream_decoder_free(Stream_Decoder *decoder);
+
+/**
+ * @brief Reads the restart table that follows the headers of a BIN_FLAG_RESTART stream.
+ *
+ * Sets the restart interval of the layout and checks that the table matches it.
+ *
+ * @param data The whole BIN file, headers included.
+ * @param size Bytes in 'data'.
+ * @param layout Geometry of the stream; receives the restart interval.
+ * @return Dynamically allocated array of 'layout->num_segments' segment file offsets,
+ *         or NULL if the table is invalid or an allocation fails.
+ */
+uint64_t *read_restart_table(const uint8_t *data, size_t size, Stream_Layout *layout);
+
+#endif /* DECODER_H */
@@ -0,0 +1,174 @@
+#ifndef ENCODER_H
+#define ENCODER_H
+
+#include "types.h"
+#include "dct.h"
+#include "stats.h"
+
+/**
+ * Streaming (push-style) encoder.
+ *
+ * Rows are pushed top to bottom. Each time STRIPE_ROWS rows have arrived, the
+ * stripe is color converted, transformed, quantized and entropy coded straight
+ * into the output file, so memory use grows with the image width only (except
+ * with optimize_huffman or target_bytes, see below). The stream is written
+ * with BIN_FLAG_CHROMA_420 | BIN_FLAG_STRIPES.
+ *
+ * With several threads, a batch of one stripe per thread is transformed by a
+ * thread pool while the previous batch is entropy coded in order on the
+ * caller's thread; the output is byte-identical for any thread count.
+ *
+ * With a restart interval, the stripes are grouped in independent segments
+ * (BIN_FLAG_RESTART) that the pool also entropy codes, one per task. This needs
+ * a seekable output, since the segment offsets are written at the end.
+ *
+ * With an index interval, the bit offset and DC predictors of every
+ * 'index_interval'-th stripe are written in a footer (BIN_FLAG_INDEX), so a
+ * decoder can start close to any stripe (see stream_decoder_set_region()).
+ *
+ * With optimize_huffman, every stripe is kept as coefficients and only its
+ * symbols are counted; stream_encoder_finish() then builds the luma and chroma
+ * tables of the image (BIN_FLAG_HUFFMAN), writes the headers and codes the kept
+ * stripes. Nothing is written before then, and memory grows with the whole
+ * image: the kept coefficients take 3 bytes per pixel (2 for luma, 1 for the
+ * 4:2:0 chroma), e.g. about 100 MB for an 8K image. The standard tables are kept when the image's own would not make the
+ * file smaller.
+ *
+ * The quantization matrices are scaled to config->quality (BIN_FLAG_QUALITY,
+ * unless it is DEFAULT_QUALITY). With a target size, the quality is chosen
+ * instead: the stripes are kept quantized with a divisor of 1, and
+ * stream_encoder_finish() searches the highest quality whose exact coded size
+ * (see rate.h) fits, requantizes the stripes to it and only then entropy codes
+ * them. When no quality fits, the image is coded at MIN_QUALITY and
+ * stream_encoder_finish() returns ENCODER_TARGET_MISSED. Like optimized coding,
+ * this delays every write to stream_encoder_finish() and keeps the whole image
+ * in memory. The two can be combined: the size of each quality tried is then
+ * that of the tables the image would get at that quality, table bytes included.
+ *
+ * With config->stats set, the stats are reset by stream_encoder_create() and
+ * filled as the stripes are coded; they are complete once stream_encoder_finish()
+ * returns, and must stay valid until then. The read stage is left to the caller.
+ */
+typedef struct Stream_Encoder Stream_Encoder;
+
+/**
+ * @brief Returned by stream_encoder_finish() when the stream is complete but larger than the target size.
+ */
+#define ENCODER_TARGET_MISSED 2
+
+/**
+ * @brief Settings of the streaming encoder.
+ */
+typedef struct {
+    DCT_Method dct_method;      /* Forward DCT implementation (default: DCT_METHOD_FAST) */
+    int threads;                /* Threads used for the transform stages; 0 = one per CPU (default: 1) */
+    int restart_interval;       /* Stripes per restart segment; 0 = no restarts (default: 0) */
+    int index_interval;         /* Stripes between index entries; 0 = no index (default: 0) */
+    int optimize_huffman;       /* Non-zero: two passes, with Huffman tables built for the image; keeps the
+                                   coefficients of the whole image, 3 bytes per pixel (default: 0) */
+    int quality;                /* Quality factor, MIN_QUALITY to MAX_QUALITY (default: DEFAULT_QUALITY) */
+    uint64_t target_bytes;      /* Largest file wanted; the quality is searched to fit it, keeping the coefficients
+                                   of the whole image, 3 bytes per pixel. 0 = off (default: 0) */
+    Pipeline_Stats *stats;      /* Receives the stage timings and symbol counters; NULL = off (default: NULL) */
+} Encoder_Config;
+
+/**
+ * @brief Fills an Encoder_Config structure with the default settings.
+ *
+ * @param config Pointer to the settings to initialize.
+ */
+void init_encoder_config(Encoder_Config *config);
+
+/**
+ * @brief Parses a target size option (a positive number of bytes).
+ *
+ * @param text The option value.
+ * @param bytes Output for the parsed size.
+ * @return SUCCESS if the value is valid, otherwise FAILURE.
+ */
+int parse_target_bytes(const char *text, uint64_t *bytes);
+
+/**
+ * @brief Parses a restart or index interval option (a number of stripes from 0 to 65535, 0 = off).
+ *
+ * @param text The option value.
+ * @param interval Output for the parsed interval.
+ * @return SUCCESS if the value is valid, otherwise FAILURE.
+ */
+int parse_stripe_interval(const char *text, int *interval);
+
+/**
+ * @brief Creates a streaming encoder and writes the BIN header to the output.
+ *
+ * The image size is taken from the info header; the format flags are set in the
+ * copy of the file header that is written. With optimized Huffman tables or a
+ * target size, the header is only written by stream_encoder_finish().
+ *
+ * @param out Output file, opened for binary writing (not closed by the encoder).
+ * @param fileHeader BMP file header of the source image.
+ * @param infoHeader BMP info header of the source image.
+ * @param config Encoder settings.
+ * @return Pointer to the new encoder, or NULL on an invalid quality, allocation or write failure.
+ */
+Stream_Encoder *stream_encoder_create(FILE *out, const BMPFILEHEADER *fileHeader,
+                                      const BMPINFOHEADER *infoHeader, const Encoder_Config *config);
+
+/**
+ * @brief Pushes the next rows of the image, top to bottom.
+ *
+ * @param encoder Pointer to the encoder.
+ * @param rows 'count' consecutive rows of 'width' pixels each.
+ * @param count Number of rows.
+ * @return SUCCESS, or FAILURE if more rows than the image height are pushed or coding fails.
+ */
+int stream_encoder_write_rows(Stream_Encoder *encoder, const RGB_Pixel *rows, int count);
+
+/**
+ * @brief Pushes the whole image by reference instead of copying its rows.
+ *
+ * Row y (from the top) is read at 'top_row' + y * 'stride', so a BMP mapped in
+ * memory (see bmp_pixel_rows()) is color converted straight from the mapping. The
+ * rows must stay valid until stream_encoder_finish() returns, and no rows may
+ * have been pushed with stream_encoder_write_rows() before.
+ *
+ * @param encoder Pointer to the encoder.
+ * @param top_row First pixel of the top row.
+ * @param stride Bytes from a row to the one below it (negative for bottom-up images).
+ * @return SUCCESS, or FAILURE if rows were already pushed or coding fails.
+ */
+int stream_encoder_write_image(Stream_Encoder *encoder, const uint8_t *top_row, ptrdiff_t stride);
+
+/**
+ * @brief Checks that every row was pushed and flushes the remaining bits to the output.
+ *
+ * With restarts, also fills in the segment offsets table; with an index, appends
+ * the index footer. With optimized Huffman tables or a target size, this writes
+ * the whole stream.
+ *
+ * @param encoder Pointer to the encoder.
+ * @return SUCCESS if the stream is complete, ENCODER_TARGET_MISSED if it is complete but even MIN_QUALITY
+ *         does not fit the target size, otherwise FAILURE.
+ */
+int stream_encoder_finish(Stream_Encoder *encoder);
+
+/**
+ * @brief Returns the quality factor the image is coded with.
+ *
+ * With a target size, this is the chosen quality once stream_encoder_finish()
+ * has returned. When even MIN_QUALITY does not fit, the image is coded at
+ * MIN_QUALITY, the file is larger than the target and stream_encoder_finish()
+ * returns ENCODER_TARGET_MISSED.
+ *
+ * @param encoder Pointer to the encoder.
+ * @return The quality factor.
+ */
+int stream_encoder_quality(const Stream_Encoder *encoder);
+
+/**
+ * @brief Frees a streaming encoder.
+ *
+ * @param encoder Pointer to the encoder to free (may be NULL).
+ */
+void stream_encoder_free(Stream_Encoder *encoder);
+
+#endif /* ENCODER_H */
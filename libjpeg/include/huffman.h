@@ -0,0 +1,282 @@
+#ifndef HUFFMAN_H
+#define HUFFMAN_H
+
+#include "types.h"
+#include "bit_functions.h"
+
+// Number of bits resolved by the first-level decoding table
+#define HUFFMAN_ROOT_BITS 9
+
+// Longest code accepted by the decoder builder
+#define HUFFMAN_MAX_CODE_LENGTH 24
+
+/**
+ * @brief Table-driven Huffman decoder.
+ *
+ * The first HUFFMAN_ROOT_BITS bits of the stream index 'root' directly. Each entry
+ * holds the decoded symbol in its low 8 bits and the code length in bits 8-12
+ * (a length of 0 marks an invalid code). Codes longer than HUFFMAN_ROOT_BITS are
+ * resolved by a second lookup: the root entry has HUFFMAN_SUBTABLE_FLAG set and
+ * its low bits select a subtable in 'sub', indexed by the next 'sub_bits' bits.
+ */
+typedef struct {
+    uint16_t root[1 << HUFFMAN_ROOT_BITS];
+    uint16_t *sub;      /* Second-level tables, (1 << sub_bits) entries each */
+    int sub_bits;       /* Longest code length minus HUFFMAN_ROOT_BITS (0 if no long codes) */
+} Huffman_Decoder;
+
+#define HUFFMAN_SUBTABLE_FLAG 0x8000
+
+// Longest code of the tables stored in a BIN file (BIN_FLAG_HUFFMAN)
+#define HUFFMAN_SPEC_MAX_LENGTH 16
+
+// DC categories that can have a code (0 to 11) and AC categories (0 to 10)
+#define DC_CATEGORIES 12
+#define AC_CATEGORIES 11
+
+// Channel classes with their own tables: luma (Y), then chroma (Cb and Cr)
+#define NUM_HUFFMAN_CLASSES 2
+
+/**
+ * @brief Canonical Huffman table, as stored after the BIN headers with BIN_FLAG_HUFFMAN.
+ *
+ * In the file, a table is HUFFMAN_SPEC_MAX_LENGTH bytes giving the number of
+ * codes of each length (1 to 16 bits), followed by one byte per symbol. Codes
+ * are assigned in symbol order, shortest first, each one the previous code plus
+ * one (shifted left when the length grows), as in the DHT segment of JPEG. DC
+ * symbols are categories; AC symbols are (zeros << 4) | category.
+ */
+typedef struct {
+    uint8_t counts[HUFFMAN_SPEC_MAX_LENGTH];    /* Codes of each length, from 1 bit to 16 */
+    uint8_t symbols[256];       /* Symbols by increasing code length */
+    int num_symbols;
+} Huffman_Spec;
+
+/**
+ * @brief Codes written by the encoder for one channel class.
+ *
+ * A length of 0 marks a symbol without a code.
+ */
+typedef struct {
+    Huffman_Code dc[DC_CATEGORIES];             /* By DC category */
+    Huffman_Code ac[16][AC_CATEGORIES];         /* By run of zeros and category (15/0 is ZRL, 0/0 is EOB) */
+} Huffman_Encoder;
+
+/**
+ * @brief Number of times each symbol of one channel class is coded.
+ */
+typedef struct {
+    uint64_t dc[DC_CATEGORIES];     /* By DC category */
+    uint64_t ac[256];               /* By AC symbol, (zeros << 4) | category */
+} Symbol_Histogram;
+
+/**
+ * @brief Builds a decoder for the DC Huffman table.
+ *
+ * The decoded symbol is the DC category.
+ *
+ * @param dec Pointer to the decoder to build.
+ * @param table DC Huffman table.
+ * @param count Number of entries in the table.
+ * @return SUCCESS if the decoder is built, otherwise FAILURE.
+ */
+int build_dc_decoder(Huffman_Decoder *dec, const DC_Huffman_Code *table, int count);
+
+/**
+ * @brief Builds a decoder for the AC Huffman table.
+ *
+ * The decoded symbol is (zeros << 4) | category.
+ *
+ * @param dec Pointer to the decoder to build.
+ * @param table AC Huffman table.
+ * @param count Number of entries in the table.
+ * @return SUCCESS if the decoder is built, otherwise FAILURE.
+ */
+int build_ac_decoder(Huffman_Decoder *dec, const AC_Huffman_Code *table, int count);
+
+/**
+ * @brief Code of the 2/10 AC symbol in files with whole-channel block order.
+ *
+ * Those files come from versions that coded 2/10 as 0x7FC7/15, which is a
+ * prefix of the 2/9 code, and 14/10 as 0x1FFE4/17, which extends the 14/8 code.
+ */
+#define LEGACY_AC_2_10_CODE 0x7FC7
+#define LEGACY_AC_2_10_LENGTH 15
+
+/**
+ * @brief Builds a decoder for the AC codes of files with whole-channel block order.
+ *
+ * Uses ac_table with 2/10 coded as LEGACY_AC_2_10_CODE. The 2/9 and 14/10
+ * codes are left out: the shorter 2/10 and 14/8 codes hid them, so those
+ * versions could never decode them either.
+ *
+ * @param dec Pointer to the decoder to build.
+ * @return SUCCESS if the decoder is built, otherwise FAILURE.
+ */
+int build_legacy_ac_decoder(Huffman_Decoder *dec);
+
+/**
+ * @brief Builds a decoder from parallel arrays of codes, code lengths and symbols.
+ *
+ * The codes must be prefix-free: when a code is a prefix of another one (or
+ * appears twice), the longer code could never be decoded, so the table is
+ * rejected instead of silently shadowing it.
+ *
+ * @param dec Pointer to the decoder to build.
+ * @param codes Huffman codes (MSB first).
+ * @param lengths Length of each code in bits (1 to HUFFMAN_MAX_CODE_LENGTH).
+ * @param symbols Symbol returned for each code.
+ * @param count Number of codes.
+ * @return SUCCESS if the decoder is built, otherwise FAILURE (invalid length, colliding codes or allocation failure).
+ */
+int build_huffman_decoder(Huffman_Decoder *dec, const uint32_t *codes, const int *lengths,
+                          const uint8_t *symbols, int count);
+
+/**
+ * @brief Builds a decoder from a canonical table.
+ *
+ * @param dec Pointer to the decoder to build.
+ * @param spec The table.
+ * @return SUCCESS if the decoder is built, otherwise FAILURE (e.g. more codes than the lengths allow).
+ */
+int build_spec_decoder(Huffman_Decoder *dec, const Huffman_Spec *spec);
+
+/**
+ * @brief Fills an encoder with the standard DC and AC tables (dc_table and ac_encode_table).
+ *
+ * @param codes Pointer to the codes to fill.
+ */
+void init_standard_huffman_encoder(Huffman_Encoder *codes);
+
+/**
+ * @brief Fills an encoder with the codes of a DC and an AC canonical table.
+ *
+ * @param codes Pointer to the codes to fill.
+ * @param dc DC table.
+ * @param ac AC table.
+ * @return SUCCESS, or FAILURE if a table is invalid.
+ */
+int spec_huffman_encoder(Huffman_Encoder *codes, const Huffman_Spec *dc, const Huffman_Spec *ac);
+
+/**
+ * @brief Builds the optimal canonical table of a set of symbol counts, with codes of at most 16 bits.
+ *
+ * Code lengths come from the Huffman algorithm, then the longest codes are
+ * shortened as in Annex K.2 of the JPEG standard. Symbols never counted get no
+ * code; a single symbol gets a 1-bit code.
+ *
+ * @param counts Times each symbol is coded, indexed by symbol.
+ * @param num_symbols Number of entries in 'counts' (at most 256).
+ * @param spec Output table.
+ */
+void build_huffman_spec(const uint64_t *counts, int num_symbols, Huffman_Spec *spec);
+
+/**
+ * @brief Returns the size of a table in the file.
+ *
+ * @param spec The table.
+ * @return Size in bytes.
+ */
+size_t huffman_spec_size(const Huffman_Spec *spec);
+
+/**
+ * @brief Writes a table in its file form.
+ *
+ * @param out Output file.
+ * @param spec The table.
+ * @return SUCCESS if written, otherwise FAILURE.
+ */
+int write_huffman_spec(FILE *out, const Huffman_Spec *spec);
+
+/**
+ * @brief Reads a table in its file form and checks it.
+ *
+ * Every symbol must be a DC category (dc != 0) or an AC symbol that
+ * write_rle_block() can produce, and appear once.
+ *
+ * @param data Start of the table.
+ * @param size Bytes available from 'data'.
+ * @param dc Non-zero for a DC table, 0 for an AC table.
+ * @param spec Output table.
+ * @return Bytes taken by the table, or 0 if it is truncated or invalid.
+ */
+size_t parse_huffman_spec(const uint8_t *data, size_t size, int dc, Huffman_Spec *spec);
+
+/**
+ * @brief Counts the symbols of one block, exactly as write_rle_block() would code them.
+ *
+ * @param histogram Counts of the block's channel class.
+ * @param rle RLE symbols of the block (see RLE_encode_AC()).
+ * @param size Number of symbols.
+ */
+void count_rle_symbols(Symbol_Histogram *histogram, const RLE_coef *rle, int size);
+
+/**
+ * @brief Counts the symbols of one block straight from its coefficients, exactly as write_coef_block() would code them.
+ *
+ * @param histogram Counts of the block's channel class.
+ * @param coef 64 quantized coefficients in zigzag order; coef[0] is ignored.
+ * @param dc_diff Difference between the block's DC and the channel predictor.
+ */
+void count_coef_symbols(Symbol_Histogram *histogram, const int16_t *coef, int dc_diff);
+
+/**
+ * @brief Adds the counts of 'part' to 'total'.
+ *
+ * @param total Histogram receiving the sums.
+ * @param part Histogram to add.
+ */
+void add_symbol_histogram(Symbol_Histogram *total, const Symbol_Histogram *part);
+
+/**
+ * @brief Returns the Huffman code bits needed to code the counted symbols, value bits excluded.
+ *
+ * @param histogram Symbol counts.
+ * @param codes Codes of the channel class.
+ * @return Number of bits, or UINT64_MAX if a counted symbol has no code.
+ */
+uint64_t histogram_code_bits(const Symbol_Histogram *histogram, const Huffman_Encoder *codes);
+
+/**
+ * @brief Frees the second-level tables of a decoder.
+ *
+ * @param dec Pointer to the decoder.
+ */
+void free_huffman_decoder(Huffman_Decoder *dec);
+
+/**
+ * @brief Decodes the next Huffman symbol from the bitstream.
+ *
+ * Resolves the symbol with one table lookup, or two for codes longer than
+ * HUFFMAN_ROOT_BITS, then consumes the code bits.
+ *
+ * @param br Pointer to the bitstream reader.
+ * @param dec Pointer to the decoder.
+ * @return The decoded symbol, or -1 on an invalid code or end of file.
+ */
+static inline int decode_symbol(Bit_Read_Write *br, const Huffman_Decoder *dec) {
+    uint16_t entry = dec->root[peek_bits(br, HUFFMAN_ROOT_BITS)];
+
+    if (entry & HUFFMAN_SUBTABLE_FLAG) {
+        uint32_t bits = peek_bits(br, HUFFMAN_ROOT_BITS + dec->sub_bits);
+        uint32_t index = bits & ((1u << dec->sub_bits) - 1);
+        entry = dec->sub[((size_t)(entry & ~HUFFMAN_SUBTABLE_FLAG) << dec->sub_bits) + index];
+    }
+
+    int length = (entry >> 8) & 0x1F;
+    if (length == 0 || !skip_bits(br, length)) return -1;
+
+    return entry & 0xFF;
+}
+
+/**
+ * @brief Returns the category of a non-zero coefficient or DC difference, like coef_category().
+ *
+ * @param value The value (not 0).
+ * @return Number of bits of its magnitude.
+ */
+static inline int value_category(int value) {
+    return 32 - __builtin_clz((unsigned int)(value < 0 ? -value : value));
+}
+
+#endif /* HUFFMAN_H */
@@ -3,6 +3,9 @@
 
 #include "types.h"
 #include "bit_functions.h"
+#include "huffman.h"
+#include "color.h"
+#include "stats.h"
 
 #include <string.h>
 #include <math.h>
@@ -31,29 +34,90 @@ void multiply_matrix(double A[BLOCK_SIZE][BLOCK_SIZE], double B[BLOCK_SIZE][BLOC
 void transpose(double A[BLOCK_SIZE][BLOCK_SIZE], double B[BLOCK_SIZE][BLOCK_SIZE]);
 
 /**
- * @brief Converts an array of RGB pixels to YCbCr color space.
+ * @brief Allocates a YCbCr_Planes structure.
  *
- * Applies standard color transformation from RGB to YCbCr for each pixel,
- * using the ITU-R BT-601 formula.
+ * @param width Width of the Y plane in pixels.
+ * @param height Height of the Y plane in pixels.
+ * @param chroma_width Width of the Cb and Cr planes.
+ * @param chroma_height Height of the Cb and Cr planes.
+ * @return Pointer to the allocated planes, or NULL on allocation failure.
+ */
+YCbCr_Planes *alloc_planes(int width, int height, int chroma_width, int chroma_height);
+
+/**
+ * @brief Number of 8x8 blocks needed to cover a plane (partial blocks are padded).
+ *
+ * @param width Width of the plane.
+ * @param height Height of the plane.
+ * @return Number of blocks, in raster order.
+ */
+int plane_blocks(int width, int height);
+
+/**
+ * @brief Fills the geometry of a coded stream from the image size and the BIN format flags.
+ *
+ * The stream starts without restarts or index; see set_restart_interval() and set_index_interval().
+ *
+ * @param layout Pointer to the layout to fill.
+ * @param width Width of the image in pixels.
+ * @param height Height of the image in pixels.
+ * @param flags BIN format flags (BIN_FLAG_*); chroma is full resolution without BIN_FLAG_CHROMA_420.
+ */
+void init_stream_layout(Stream_Layout *layout, int width, int height, unsigned short flags);
+
+/**
+ * @brief Groups the stripes of a striped stream in restart segments.
+ *
+ * Sets or clears BIN_FLAG_RESTART and computes the number of segments.
+ *
+ * @param layout Pointer to the layout (BIN_FLAG_STRIPES).
+ * @param interval Stripes per segment; 0 disables restarts.
+ */
+void set_restart_interval(Stream_Layout *layout, int interval);
+
+/**
+ * @brief Records an index entry every 'interval' stripes of a striped stream.
+ *
+ * Sets or clears BIN_FLAG_INDEX and computes the number of index entries.
+ *
+ * @param layout Pointer to the layout (BIN_FLAG_STRIPES).
+ * @param interval Stripes between entries; 0 disables the index.
+ */
+void set_index_interval(Stream_Layout *layout, int interval);
+
+/**
+ * @brief Frees a YCbCr_Planes structure and its planes.
+ *
+ * @param planes Pointer to the planes to free (may be NULL).
+ */
+void free_planes(YCbCr_Planes *planes);
+
+/**
+ * @brief Converts an array of RGB pixels to YCbCr color space with 4:2:0 chroma subsampling.
  *
- * @param rgb Pointer to input array of RGB_Pixel structures.
- * @param total_pixels Total number of pixels to convert.
- * @return Pointer to dynamically allocated array of YCbCr_Pixel structures,
- *         or NULL on allocation failure.
+ * Applies the ITU-R BT-601 transformation in 16-bit fixed point, using the
+ * fastest SIMD kernel available on the running CPU (see color.h). Each pair of
+ * rows is converted and its chroma immediately averaged over 2x2 groups, so the
+ * Cb and Cr planes are produced directly at half width and half height.
+ *
+ * @param pixels Pointer to input array of RGB_Pixel structures.
+ * @param width Width of the image in pixels.
+ * @param height Height of the image in pixels.
+ * @return Pointer to dynamically allocated YCbCr planes, or NULL on allocation failure.
  */
-YCbCr_Pixel *rgb_to_YCrCb(RGB_Pixel *pixels, int total_pixels);
+YCbCr_Planes *rgb_to_YCrCb(RGB_Pixel *pixels, int width, int height);
 
 /**
- * @brief Applies 4:2:0 chroma subsampling on YCbCr pixel data.
+ * @brief Averages each 2x2 group of two full-resolution chroma rows into one half-width row.
  *
- * Reduces the resolution of the Cb and Cr channels by averaging each 2x2 block
- * and assigning the average value to all four pixels in the block.
+ * The result is rounded; an odd last column pairs with itself.
  *
- * @param pixels_YCrCb Array of YCbCr_Pixel structures.
- * @param width Width of the image in pixels (must be divisible by 2).
- * @param height Height of the image in pixels (must be divisible by 2).
+ * @param row0 First full-resolution row ('width' samples).
+ * @param row1 Second full-resolution row (pass 'row0' again for an odd last row).
+ * @param out Output row ((width + 1) / 2 samples).
+ * @param width Width of the full-resolution rows.
  */
-void subsample_4_2_0(YCbCr_Pixel *pixels_YCrCb, int width, int height);
+void downsample_row_pair(const uint8_t *row0, const uint8_t *row1, uint8_t *out, int width);
 
 /**
  * @brief Applies 2D Discrete Cosine Transform using matrix multiplication.
@@ -89,10 +153,31 @@ void quantize(double dct[BLOCK_SIZE][BLOCK_SIZE], const uint8_t matrix[BLOCK_SIZ
  * zigzag-ordered array back into an 8x8 block.
  *
  * @param block Input/output 8x8 block of coefficients.
- * @param v Input/output array of 64 integers.
+ * @param v Input/output array of 64 coefficients.
  * @param type Conversion type: 0 = block => array, non-zero = array => block.
  */
-void zigzag(int block[8][8], int v[64], int type);
+void zigzag(int block[8][8], int16_t v[64], int type);
+
+/**
+ * @brief Allocates a Blocks_ZigZag structure with one zeroed coefficient slab per channel.
+ *
+ * @param num_blocks Number of Y blocks.
+ * @param num_chroma_blocks Number of blocks in each of Cb and Cr.
+ * @param with_last Non-zero to also allocate the per-block last coefficient arrays (decoder).
+ * @return Pointer to the allocated structure, or NULL on allocation failure.
+ */
+Blocks_ZigZag *alloc_BlocosZigZag(int num_blocks, int num_chroma_blocks, int with_last);
+
+/**
+ * @brief Returns the 64 zigzag-ordered coefficients of block 'index' in a channel slab.
+ *
+ * @param slab Channel slab (e.g. blocks->Y_blocks).
+ * @param index Block index, in raster order.
+ * @return Pointer to the block's first coefficient.
+ */
+static inline int16_t *block_coefs(int16_t *slab, int index) {
+    return slab + (size_t)index * (BLOCK_SIZE * BLOCK_SIZE);
+}
 
 /**
  * @brief Applies delta encoding to the DC coefficients of all blocks.
@@ -120,74 +205,114 @@ int coef_category(int value);
  *
  * This function compresses the AC coefficients of a block (zigzag ordered) into a list of
  * (SKIP, CATEGORY, VALUE) tuples. It handles zero runs and appends
- * an End-Of-Block (EOB) marker if necessary.
+ * an End-Of-Block (EOB) marker if necessary. A block never needs more than 64 symbols.
  *
- * @param coef Pointer to a 64-element array of quantized coefficients.
- * @param out_size Pointer to an integer where the number of encoded symbols will be stored.
- * @return Pointer to an array of RLE_coef structures, or NULL on memory allocation failure.
+ * @param coef Pointer to a 64-element array of quantized coefficients (DC already delta coded).
+ * @param encoded Output array of at least 64 RLE_coef entries.
+ * @return Number of encoded symbols.
  */
-RLE_coef* RLE_encode_AC(int *coef, int *out_size);
+int RLE_encode_AC(const int16_t *coef, RLE_coef *encoded);
 
 /**
- * @brief Applies run-length encoding (RLE) to a set of quantized coefficient blocks.
- *
- * For each block, this function performs RLE using the JPEG AC coefficient encoding pattern.
- * It stores the resulting encoded symbols (skip, category, value) and their sizes.
+ * @brief Writes one RLE-encoded block to the bitstream using Huffman coding.
  *
- * Memory is dynamically allocated for the output. If any encoding fails, previously allocated
- * memory is released and NULL is returned.
+ * The DC symbol uses the DC codes and the AC symbols the AC codes of the block's
+ * channel class; each prefix is merged with its value bits into a single write.
  *
- * @param blocks Array of pointers to 64-element coefficient arrays (zigzag ordered).
- * @param num_blocks Number of blocks to process.
- * @param sizes Output array to hold the size (number of RLE symbols) for each block.
- * @return A dynamically allocated array of RLE-encoded blocks, or NULL on failure.
+ * @param bw Pointer to the bit writer.
+ * @param rle RLE symbols of the block (see RLE_encode_AC()).
+ * @param size Number of symbols.
+ * @param codes Huffman codes (see init_standard_huffman_encoder()).
+ * @return SUCCESS, or FAILURE if a symbol has no Huffman code.
  */
-RLE_coef **process_AC_coef(int **blocks, int num_blocks, int *sizes);
+int write_rle_block(Bit_Read_Write *bw, const RLE_coef *rle, int size, const Huffman_Encoder *codes);
+
+/**
+ * @brief Huffman codes one block straight from its coefficients, in a single pass.
+ *
+ * Writes the same bits as RLE_encode_AC() followed by write_rle_block(), without
+ * building RLE symbols: the DC difference, the AC symbols and their value bits go
+ * to the bit writer as the coefficients are scanned. Runs of 16 zeros are held
+ * back until a non-zero coefficient follows them, so trailing ones fold into the EOB.
+ *
+ * @param bw Pointer to the bit writer.
+ * @param coef 64 quantized coefficients in zigzag order; coef[0] is ignored.
+ * @param dc_diff Difference between the block's DC and the channel predictor.
+ * @param codes Huffman codes (see init_standard_huffman_encoder()).
+ * @param stats Stats receiving the block's symbol counts (see count_block_symbols()), or NULL.
+ * @return SUCCESS, or FAILURE if a symbol has no Huffman code.
+ */
+int write_coef_block(Bit_Read_Write *bw, const int16_t *coef, int dc_diff, const Huffman_Encoder *codes,
+                     Pipeline_Stats *stats);
 
 /**
  * @brief Decodes a DC coefficient prefix and retrieves its category.
  *
  * @param br Pointer to the bitstream reader.
+ * @param dc_dec DC Huffman decoder (see build_dc_decoder()).
  * @param category Output pointer to store the decoded category.
  * @return 1 if decoding is successful, 0 otherwise.
  */
-int decode_dc(Bit_Read_Write *br, int *category);
+int decode_dc(Bit_Read_Write *br, const Huffman_Decoder *dc_dec, int *category);
 
 /**
  * @brief Decodes an AC coefficient prefix, retrieving the number of preceding zeros (skip)
  *        and the value category.
  *
  * @param br Pointer to the bitstream reader.
+ * @param ac_dec AC Huffman decoder (see build_ac_decoder()).
  * @param skip Output pointer to store the number of zero coefficients before this one.
  * @param category Output pointer to store the category of the AC coefficient.
  * @return 1 if decoding is successful, 0 otherwise.
  */
-int decode_ac(Bit_Read_Write *br, int *skip, int *category);
+int decode_ac(Bit_Read_Write *br, const Huffman_Decoder *ac_dec, int *skip, int *category);
 
 /**
  * @brief Reads a block of RLE-encoded DCT coefficients from the bitstream.
  *
  * @param br Pointer to the bitstream reader.
+ * @param dc_dec DC Huffman decoder.
+ * @param ac_dec AC Huffman decoder.
  * @param size Output pointer to store the number of RLE entries read.
  * @return Pointer to an array of RLE_coef representing the block, or NULL on failure.
  */
-RLE_coef *read_rle_block(Bit_Read_Write *br, int *size);
+RLE_coef *read_rle_block(Bit_Read_Write *br, const Huffman_Decoder *dc_dec,
+                         const Huffman_Decoder *ac_dec, int *size);
+
+/**
+ * @brief Reads the RLE symbols of one block into a caller-provided array.
+ *
+ * Symbols are read until an EOB or 64 symbols, as in read_rle_block().
+ *
+ * @param br Pointer to the bitstream reader.
+ * @param dc_dec DC Huffman decoder.
+ * @param ac_dec AC Huffman decoder.
+ * @param coefs Output array of at least 64 RLE_coef entries.
+ * @param size Output pointer to store the number of RLE entries read.
+ * @return SUCCESS, or FAILURE on an invalid code.
+ */
+int read_rle_symbols(Bit_Read_Write *br, const Huffman_Decoder *dc_dec,
+                     const Huffman_Decoder *ac_dec, RLE_coef *coefs, int *size);
 
 /**
  * @brief Reverses delta encoding on the DC coefficients of each block.
  *
+ * The DC predictor restarts at zero at the first block of every restart segment.
+ *
  * @param blocks Pointer to the Blocks_ZigZag structure containing the Y, Cb, and Cr blocks.
+ * @param layout Geometry of the stream (restart segments).
  */
-void delta_decoding(Blocks_ZigZag *blocks);
+void delta_decoding(Blocks_ZigZag *blocks, const Stream_Layout *layout);
 
 /**
  * @brief Converts a sequence of RLE coefficients back into a full 64-element block.
  *
  * @param rle Array of RLE_coef structures.
  * @param size Number of RLE entries in the array.
- * @return Pointer to a 64-element integer array representing the block (in zigzag order).
+ * @param block Output 64-element block (in zigzag order), already zeroed.
+ * @param last Output: zigzag index of the last non-zero coefficient (0 if only DC). May be NULL.
  */
-int *rle_to_block(RLE_coef *rle, int size);
+void rle_to_block(RLE_coef *rle, int size, int16_t *block, int *last);
 
 /**
  * @brief Dequantizes a DCT block by multiplying each coefficient by the corresponding quantization factor.
@@ -210,18 +335,64 @@ void apply_matrix_idct(double dct[BLOCK_SIZE][BLOCK_SIZE], double block[BLOCK_SI
                             double Ct[BLOCK_SIZE][BLOCK_SIZE]);
 
 /**
- * @brief Converts an array of YCbCr pixels to RGB format.
+ * @brief Converts YCbCr planes to an array of RGB pixels.
+ *
+ * Uses the same fixed-point kernels as rgb_to_YCrCb(), saturating to [0, 255].
+ * Subsampled 4:2:0 chroma planes are upsampled with a triangle filter, one
+ * output row at a time, right before that row is converted.
  *
- * @param ycbcr Pointer to the input YCbCr pixel array.
- * @param total_pixels Number of pixels in the array.
+ * @param ycbcr Pointer to the input YCbCr planes.
  * @return Pointer to the newly allocated array of RGB_Pixel or NULL if allocation fails.
  */
-RGB_Pixel *YCbCr_to_rgb(YCbCr_Pixel *ycbcr, int total_pixels);
+RGB_Pixel *YCbCr_to_rgb(YCbCr_Planes *ycbcr);
+
+/**
+ * @brief Converts YCbCr planes to RGB rows placed 'stride' bytes apart.
+ *
+ * Same conversion as YCbCr_to_rgb(), written straight into an existing image,
+ * e.g. the padded, bottom-up rows of a mapped BMP file (see bmp_pixel_rows()).
+ *
+ * @param ycbcr Pointer to the input YCbCr planes.
+ * @param first_row Output for the top row.
+ * @param stride Bytes from the start of a row to the start of the one below it.
+ * @return SUCCESS, or FAILURE if allocation fails.
+ */
+int YCbCr_to_rgb_rows(YCbCr_Planes *ycbcr, uint8_t *first_row, ptrdiff_t stride);
+
+/**
+ * @brief Triangle-filter upsampling of one output row from a half-width, half-height chroma plane.
+ *
+ * Chroma samples sit between two luma rows: output row y uses chroma row y / 2 as
+ * 'near' and, as 'far', the row above it for even y or the row below it for odd y
+ * (clamped to the plane).
+ *
+ * @param near Chroma row closest to the output row.
+ * @param far The other chroma row of the pair.
+ * @param chroma_width Width of the chroma rows.
+ * @param out Output row ('width' samples).
+ * @param width Width of the output row.
+ */
+void upsample_row_h2v2(const uint8_t *near, const uint8_t *far, int chroma_width, uint8_t *out, int width);
+
+/**
+ * @brief upsample_row_h2v2() restricted to the output samples [first_x, first_x + count).
+ *
+ * Reads only the chroma samples around the range, so the rest of the rows may be unset.
+ *
+ * @param near Chroma row closest to the output row.
+ * @param far The other chroma row of the pair.
+ * @param chroma_width Width of the chroma rows.
+ * @param out Output ('count' samples).
+ * @param first_x First output sample, in full-resolution columns.
+ * @param count Number of output samples.
+ */
+void upsample_row_h2v2_range(const uint8_t *near, const uint8_t *far, int chroma_width, uint8_t *out,
+                             int first_x, int count);
 
 /**
  * @brief Frees memory allocated for all Y, Cb, and Cr blocks in a Blocks_ZigZag structure.
  *
- * @param blocks Pointer to the structure to free.
+ * @param blocks Pointer to the structure to free (may be NULL).
  */
 void free_BlocosZigZag(Blocks_ZigZag *blocks);
 
@@ -229,8 +400,9 @@ void free_BlocosZigZag(Blocks_ZigZag *blocks);
  * @brief Frees memory allocated for RLE data in an RLE structure.
  *
  * @param rle Pointer to the structure to free.
- * @param num_blocks Number of RLE blocks in each channel.
+ * @param num_blocks Number of RLE blocks in the Y channel.
+ * @param num_chroma_blocks Number of RLE blocks in each of the Cb and Cr channels.
  */
-void free_rle(RLE *rle, int num_blocks);
+void free_rle(RLE *rle, int num_blocks, int num_chroma_blocks);
 
 #endif /* IMG_FUNCTIONS_H */
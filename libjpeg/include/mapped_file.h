@@ -0,0 +1,67 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include "types.h"
+
+/**
+ * Read-only view of a whole input file.
+ *
+ * Regular files are memory mapped, so their bytes are paged in on demand and
+ * never copied; inputs that cannot be mapped (pipes, character devices, empty
+ * files) are read into one heap buffer with large read() calls instead.
+ */
+typedef struct {
+    const uint8_t *data;        /* File contents */
+    size_t size;                /* Bytes in 'data' */
+    int mapped;                 /* Non-zero if 'data' is a mapping, zero if it is a heap buffer */
+} Mapped_File;
+
+/**
+ * @brief Maps a file for reading, or reads it into memory if it cannot be mapped.
+ *
+ * @param path Path of the file.
+ * @param file Output for the file view; release it with unmap_file().
+ * @return SUCCESS, or FAILURE if the file cannot be opened or read.
+ */
+int map_file(const char *path, Mapped_File *file);
+
+/**
+ * @brief Releases a file view created by map_file().
+ *
+ * @param file Pointer to the file view (its data pointer may be NULL).
+ */
+void unmap_file(Mapped_File *file);
+
+/**
+ * Writable view of an output file of known size.
+ *
+ * Regular files are sized up front with ftruncate() and mapped shared, so the
+ * bytes stored in 'data' are the file contents; other outputs (pipes, devices)
+ * get a zeroed heap buffer that close_mapped_output() writes out.
+ */
+typedef struct {
+    uint8_t *data;              /* File contents, zero-filled on creation */
+    size_t size;
+    int mapped;                 /* Non-zero if 'data' is a mapping, zero if it is a heap buffer */
+    int fd;
+} Mapped_Output;
+
+/**
+ * @brief Creates (or truncates) a file of 'size' bytes and maps it for writing.
+ *
+ * @param path Path of the file.
+ * @param size Final size of the file, in bytes (at least 1).
+ * @param file Output for the file view; release it with close_mapped_output().
+ * @return SUCCESS, or FAILURE if the file cannot be created, sized or allocated.
+ */
+int create_mapped_output(const char *path, size_t size, Mapped_Output *file);
+
+/**
+ * @brief Unmaps (or writes out) an output created by create_mapped_output() and closes it.
+ *
+ * @param file Pointer to the file view.
+ * @return SUCCESS, or FAILURE if the data could not be written.
+ */
+int close_mapped_output(Mapped_Output *file);
+
+#endif /* MAPPED_FILE_H */
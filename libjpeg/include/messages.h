@@ -0,0 +1,46 @@
+#ifndef MESSAGES_H
+#define MESSAGES_H
+
+#include "types.h"
+
+/**
+ * Diagnostics of the library.
+ *
+ * Library functions describe why they failed with report_error() before
+ * returning FAILURE (or NULL). The messages are printed to stdout by default,
+ * like the programs' own messages; an application embedding the library (see
+ * codec.h) can send them to its own log, or drop them, with set_message_handler().
+ */
+
+/**
+ * @brief Function receiving each library diagnostic.
+ *
+ * @param message The message, without a trailing newline.
+ */
+typedef void (*Message_Handler)(const char *message);
+
+/**
+ * @brief The default handler: prints the message and a newline to stdout.
+ *
+ * @param message The message.
+ */
+void print_message(const char *message);
+
+/**
+ * @brief Sets the function receiving the library diagnostics, for the whole process.
+ *
+ * Set it before the library is used from several threads; the handler itself
+ * may be called from any thread that runs library code.
+ *
+ * @param handler The new handler, or NULL to drop the messages.
+ */
+void set_message_handler(Message_Handler handler);
+
+/**
+ * @brief Formats a diagnostic like printf() and passes it to the message handler.
+ *
+ * @param format printf() format of the message, without a trailing newline.
+ */
+void report_error(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+#endif /* MESSAGES_H */
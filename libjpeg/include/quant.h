@@ -0,0 +1,65 @@
+#ifndef QUANT_H
+#define QUANT_H
+
+#include "types.h"
+
+/**
+ * Fused quantization and zigzag scan, and its inverse.
+ *
+ * The per-channel tables of a Quant_Table (see dct.h) are stored in zigzag
+ * order, so both kernels walk the coefficients sequentially and reach the
+ * natural-order transform samples through the static zigzag_order table: the
+ * forward kernel writes int16 coefficients straight in scan order, and the
+ * inverse one scatters them back while dequantizing. Every forward kernel
+ * performs the same integer arithmetic, so the SIMD and scalar paths produce
+ * identical output.
+ */
+
+// Fraction bits of the forward reciprocals
+#define FDCT_RECIPROCAL_BITS 20
+
+/**
+ * @brief Available forward quantization kernels.
+ */
+typedef enum {
+    QUANT_KERNEL_AUTO = 0,      /* Best kernel supported by the running CPU */
+    QUANT_KERNEL_SCALAR,        /* Portable C, one coefficient at a time */
+    QUANT_KERNEL_AVX2           /* 8 coefficients per iteration, gathered through the zigzag table */
+} Quant_Kernel;
+
+/**
+ * @brief Returns the fastest quantization kernel supported by the running CPU.
+ *
+ * @return QUANT_KERNEL_AVX2 or QUANT_KERNEL_SCALAR.
+ */
+Quant_Kernel detect_quant_kernel(void);
+
+/**
+ * @brief Quantizes a transformed block and writes it in zigzag order.
+ *
+ * Coefficient k of the output is data[zigzag_order[k]] * reciprocal[k] / 2^FDCT_RECIPROCAL_BITS,
+ * rounded half away from zero like round() and saturated to int16. The rounded
+ * quotients must fit in 31 bits, as they do by far for the fast FDCT outputs.
+ *
+ * @param data 64 transform outputs in natural (row-major) order.
+ * @param reciprocal 64 fixed-point reciprocals of the divisors, in zigzag order (below 2^31).
+ * @param coef Output: 64 quantized coefficients in zigzag order.
+ * @param kernel Kernel to use; QUANT_KERNEL_AUTO picks detect_quant_kernel().
+ */
+void quantize_zigzag(const int32_t data[BLOCK_SIZE * BLOCK_SIZE], const int32_t reciprocal[BLOCK_SIZE * BLOCK_SIZE],
+                     int16_t coef[BLOCK_SIZE * BLOCK_SIZE], Quant_Kernel kernel);
+
+/**
+ * @brief Dequantizes zigzag-ordered coefficients back into natural order.
+ *
+ * Only the coefficients up to 'last' are read; every other output is zero.
+ *
+ * @param coef 64 quantized coefficients in zigzag order.
+ * @param last Zigzag index of the last coded coefficient (63 if unknown).
+ * @param multiplier 64 dequantization multipliers, in zigzag order.
+ * @param data Output: 64 dequantized coefficients in natural order.
+ */
+void dequantize_unzigzag(const int16_t coef[BLOCK_SIZE * BLOCK_SIZE], int last,
+                         const int32_t multiplier[BLOCK_SIZE * BLOCK_SIZE], int32_t data[BLOCK_SIZE * BLOCK_SIZE]);
+
+#endif /* QUANT_H */
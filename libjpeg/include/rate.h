@@ -0,0 +1,92 @@
+#ifndef RATE_H
+#define RATE_H
+
+#include "types.h"
+#include "huffman.h"
+
+/**
+ * Coded size estimation, for encoding to a target size.
+ *
+ * The encoder keeps every block quantized with a divisor of 1 and requantizes
+ * it for each quality it tries. The estimator prices every symbol at the length
+ * of its code plus its category (its value bits) as it walks the coefficients,
+ * without building RLE symbols or writing any bits, so trying a quality costs
+ * one pass over the coefficients. The symbols are the ones RLE_encode_AC()
+ * would produce for the requantized block, so the count matches what the codes
+ * the costs were built from would write. With optimized coding, the symbols of
+ * a quality are counted first, so the costs can come from the image's tables.
+ */
+
+/**
+ * @brief Bits taken by each symbol: its code plus its value bits.
+ */
+typedef struct {
+    uint8_t dc[DC_CATEGORIES];          /* By DC category; 0 = no code */
+    uint8_t ac[16][AC_CATEGORIES];      /* By run of zeros and category; 0 = no code (15/0 is ZRL, 0/0 is EOB) */
+} Symbol_Costs;
+
+/**
+ * @brief Divisors of a quantization matrix in zigzag order, as exact reciprocals.
+ */
+typedef struct {
+    uint64_t reciprocal[BLOCK_SIZE * BLOCK_SIZE];   /* ceil(2^32 / divisor) */
+    uint32_t half[BLOCK_SIZE * BLOCK_SIZE];         /* divisor / 2, for rounding */
+} Requant_Table;
+
+/**
+ * @brief Fills the costs of a set of codes: the code length plus the category of each symbol.
+ *
+ * @param costs Pointer to the costs to fill.
+ * @param codes Codes of the channel class (see init_standard_huffman_encoder()); symbols without a code cost 0.
+ */
+void init_symbol_costs(Symbol_Costs *costs, const Huffman_Encoder *codes);
+
+/**
+ * @brief Fills a requantization table from an 8x8 quantization matrix (row-major).
+ *
+ * @param table Pointer to the table to fill.
+ * @param matrix 8x8 quantization matrix.
+ */
+void init_requant_table(Requant_Table *table, const uint8_t matrix[BLOCK_SIZE][BLOCK_SIZE]);
+
+/**
+ * @brief Divides coefficients kept with a divisor of 1 by a matrix, rounding half away from zero as quantize() does.
+ *
+ * @param slab Channel slab of zigzag-ordered blocks, requantized in place.
+ * @param num_blocks Number of blocks.
+ * @param table Divisors of the channel.
+ */
+void requantize_blocks(int16_t *slab, int num_blocks, const Requant_Table *table);
+
+/**
+ * @brief Counts the symbols of blocks requantized by a matrix, as the first pass of optimized coding would.
+ *
+ * The DC values are delta coded against '*last_dc', which is updated as
+ * code_blocks() in the encoder does.
+ *
+ * @param slab Channel slab of zigzag-ordered blocks, kept with a divisor of 1.
+ * @param num_blocks Number of blocks.
+ * @param table Divisors of the channel.
+ * @param histogram Counts of the channel class.
+ * @param last_dc DC predictor of the channel (requantized).
+ */
+void count_requantized_symbols(const int16_t *slab, int num_blocks, const Requant_Table *table,
+                               Symbol_Histogram *histogram, int *last_dc);
+
+/**
+ * @brief Returns the bits that coding blocks requantized by a matrix would take, without changing them.
+ *
+ * The DC values are delta coded against '*last_dc', which is updated as
+ * code_blocks() in the encoder does.
+ *
+ * @param slab Channel slab of zigzag-ordered blocks, kept with a divisor of 1.
+ * @param num_blocks Number of blocks.
+ * @param table Divisors of the channel.
+ * @param costs Bits of each symbol.
+ * @param last_dc DC predictor of the channel (requantized).
+ * @return Number of bits, or UINT64_MAX if a symbol has no code.
+ */
+uint64_t estimate_blocks_bits(const int16_t *slab, int num_blocks, const Requant_Table *table,
+                              const Symbol_Costs *costs, int *last_dc);
+
+#endif /* RATE_H */
@@ -0,0 +1,120 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "types.h"
+
+/**
+ * Per-stage timings and entropy coding counters of one encode or decode.
+ *
+ * The encoder and the decoder fill a Pipeline_Stats when their config points
+ * at one (see Encoder_Config and Decoder_Config); otherwise no clock is read
+ * and nothing is counted. Stage times come from the monotonic clock and are
+ * summed over the threads that ran the stage, so with several threads they
+ * can add up to more than the elapsed time.
+ */
+
+/**
+ * @brief Stages of the pipeline; the decoder runs the mirror of each encoder stage.
+ */
+typedef enum {
+    STAGE_READ = 0,             /* Mapping the input and parsing its headers (timed by the application) */
+    STAGE_COLOR,                /* RGB to YCbCr / YCbCr to RGB */
+    STAGE_SUBSAMPLE,            /* 4:2:0 chroma downsampling / upsampling */
+    STAGE_TRANSFORM,            /* DCT, quantization and zigzag / dequantization and IDCT */
+    STAGE_RLE,                  /* RLE expansion and DC prediction (decoder only: see STAGE_HUFFMAN) */
+    STAGE_HUFFMAN,              /* DC delta, RLE and Huffman coding into the bit writer, in one pass /
+                                   bit reading and Huffman decoding */
+    STAGE_WRITE,                /* Flushing the output */
+    NUM_PIPELINE_STAGES
+} Pipeline_Stage;
+
+/**
+ * @brief Timings and counters of an encode or decode.
+ */
+typedef struct {
+    double seconds[NUM_PIPELINE_STAGES];    /* Time spent in each stage */
+    double elapsed_seconds;     /* Wall-clock time of the whole operation */
+    uint64_t pixels;            /* Pixels encoded or decoded */
+    uint64_t blocks;            /* 8x8 blocks entropy coded, all channels */
+    uint64_t eob_blocks;        /* Blocks ended by an EOB symbol */
+    uint64_t zrl_symbols;       /* ZRL symbols (runs of 16 zeros) */
+    uint64_t symbols;           /* Huffman symbols: DC, AC, ZRL and EOB */
+} Pipeline_Stats;
+
+/**
+ * @brief Resets every timing and counter to zero.
+ *
+ * @param stats Pointer to the stats to reset.
+ */
+void init_pipeline_stats(Pipeline_Stats *stats);
+
+/**
+ * @brief Adds the timings and counters of 'part' to 'total', e.g. to merge per-thread or per-file stats.
+ *
+ * @param total Stats receiving the sums.
+ * @param part Stats to add.
+ */
+void add_pipeline_stats(Pipeline_Stats *total, const Pipeline_Stats *part);
+
+/**
+ * @brief Returns the name of a stage, as used in the JSON output.
+ *
+ * @param stage The stage.
+ * @return A static string.
+ */
+const char *pipeline_stage_name(Pipeline_Stage stage);
+
+/**
+ * @brief Reads the monotonic clock.
+ *
+ * @return Seconds since an arbitrary starting point.
+ */
+double monotonic_seconds(void);
+
+/**
+ * @brief Counts the symbols of one block, as produced by RLE_encode_AC() or read_rle_symbols().
+ *
+ * @param stats Stats receiving the counts.
+ * @param rle The DC entry followed by the AC entries of the block.
+ * @param size Number of entries.
+ */
+void count_block_symbols(Pipeline_Stats *stats, const RLE_coef *rle, int size);
+
+/**
+ * @brief Writes the stats as one JSON object (no trailing newline).
+ *
+ * Times are in milliseconds; the average number of symbols per block and the
+ * throughput in megapixels per second are derived from the counters.
+ *
+ * @param out Output stream.
+ * @param stats The stats to write.
+ */
+void write_pipeline_stats_json(FILE *out, const Pipeline_Stats *stats);
+
+/**
+ * @brief Starts timing a stage.
+ *
+ * @param stats Stats being collected, or NULL when they are off.
+ * @return The current time, or 0 without stats.
+ */
+static inline double stage_start(const Pipeline_Stats *stats) {
+    return stats ? monotonic_seconds() : 0;
+}
+
+/**
+ * @brief Adds the time since 'start' to a stage and returns the current time, which starts the next stage.
+ *
+ * @param stats Stats being collected, or NULL when they are off.
+ * @param stage Stage that just ran.
+ * @param start Value returned by stage_start() or by the previous stage_lap().
+ * @return The current time, or 0 without stats.
+ */
+static inline double stage_lap(Pipeline_Stats *stats, Pipeline_Stage stage, double start) {
+    if (!stats) return 0;
+
+    double now = monotonic_seconds();
+    stats->seconds[stage] += now - start;
+    return now;
+}
+
+#endif /* STATS_H */
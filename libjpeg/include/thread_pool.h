@@ -0,0 +1,81 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include "types.h"
+
+/**
+ * Reusable pthread worker pool running one set of indexed tasks at a time.
+ *
+ * A pool of N threads starts N - 1 workers: the thread that calls
+ * thread_pool_wait() runs the remaining tasks too, so a pool of size 1 simply
+ * runs everything inline in thread_pool_wait().
+ */
+typedef struct Thread_Pool Thread_Pool;
+
+/**
+ * @brief Function run for every index of a submitted task set.
+ *
+ * @param context Pointer given to thread_pool_submit().
+ * @param index Task index, in [0, count).
+ */
+typedef void (*Pool_Task)(void *context, int index);
+
+/**
+ * @brief Number of CPUs available to the process (at least 1).
+ *
+ * @return Number of online processors.
+ */
+int available_cpus(void);
+
+/**
+ * @brief Parses a thread count option (a non-negative integer, 0 = one per CPU).
+ *
+ * @param text The option value.
+ * @param threads Output for the parsed count.
+ * @return SUCCESS if the value is valid, otherwise FAILURE.
+ */
+int parse_thread_count(const char *text, int *threads);
+
+/**
+ * @brief Creates a pool of 'num_threads' threads (including the waiting caller).
+ *
+ * @param num_threads Total number of threads; 0 or less uses available_cpus().
+ * @return Pointer to the new pool, or NULL if a thread or allocation fails.
+ */
+Thread_Pool *thread_pool_create(int num_threads);
+
+/**
+ * @brief Returns the total number of threads of the pool, including the waiting caller.
+ *
+ * @param pool Pointer to the pool.
+ * @return Number of threads.
+ */
+int thread_pool_size(const Thread_Pool *pool);
+
+/**
+ * @brief Starts running 'task' for every index in [0, count) and returns immediately.
+ *
+ * Waits for the previous task set first, so at most one set is in flight.
+ *
+ * @param pool Pointer to the pool.
+ * @param task Function to run for each index.
+ * @param context Pointer passed to every call of 'task'.
+ * @param count Number of tasks.
+ */
+void thread_pool_submit(Thread_Pool *pool, Pool_Task task, void *context, int count);
+
+/**
+ * @brief Runs the tasks still queued on the calling thread and waits for the others to finish.
+ *
+ * @param pool Pointer to the pool.
+ */
+void thread_pool_wait(Thread_Pool *pool);
+
+/**
+ * @brief Waits for the current task set, stops the workers and frees the pool.
+ *
+ * @param pool Pointer to the pool to destroy (may be NULL).
+ */
+void thread_pool_destroy(Thread_Pool *pool);
+
+#endif /* THREAD_POOL_H */
@@ -7,6 +7,25 @@
 #define BLOCK_SIZE 8
 #define MAX_LEN_MATRIX_LINE_SIZE 65
 
+// Size of the in-memory buffer used by the bit writer/reader before touching the file
+#define BIT_BUFFER_SIZE (64 * 1024)
+
+// Alignment (bytes) of the per-channel coefficient slabs
+#define COEF_SLAB_ALIGNMENT 64
+
+// Format flags stored in the bfReserved1 field of the BIN header (0 = original format)
+#define BIN_FLAG_CHROMA_420 0x0001      /* Cb and Cr coded at half width and half height */
+#define BIN_FLAG_STRIPES 0x0002         /* Blocks interleaved per 16-row stripe (needs BIN_FLAG_CHROMA_420) */
+#define BIN_FLAG_RESTART 0x0004         /* Stripes grouped in restart segments (needs BIN_FLAG_STRIPES) */
+#define BIN_FLAG_INDEX 0x0008           /* Stripe index footer at the end of the file (needs BIN_FLAG_STRIPES) */
+#define BIN_FLAG_HUFFMAN 0x0010         /* Huffman tables of the image after the headers (needs BIN_FLAG_STRIPES) */
+#define BIN_FLAG_QUALITY 0x0020         /* Matrices scaled to the quality in bfReserved2 (needs BIN_FLAG_STRIPES) */
+#define BIN_KNOWN_FLAGS (BIN_FLAG_CHROMA_420 | BIN_FLAG_STRIPES | BIN_FLAG_RESTART | BIN_FLAG_INDEX | \
+                         BIN_FLAG_HUFFMAN | BIN_FLAG_QUALITY)
+
+// Image rows covered by one stripe: two Y block rows and one (4:2:0) Cb/Cr block row
+#define STRIPE_ROWS (2 * BLOCK_SIZE)
+
 #include <stdio.h>
 #include <stdint.h>
 #include <stddef.h>
@@ -46,6 +65,9 @@ typedef struct {                /**** BMP file info structure ****/
     unsigned int biClrImportant;    /* Number of important colors */
 } __attribute__((packed)) BMPINFOHEADER;
 
+// Bytes taken by the two headers at the start of a BMP or BIN file
+#define BMP_HEADERS_SIZE (sizeof(BMPFILEHEADER) + sizeof(BMPINFOHEADER))
+
 /**
  * @brief Structure representing an RGB pixel.
  *
@@ -57,19 +79,103 @@ typedef struct {
     uint8_t r;  /* Red component */
 } RGB_Pixel;
 
+/**
+ * @brief Image stored as three 8-bit planes.
+ *
+ * Cb and Cr are stored with a +128 offset so they fit an unsigned byte, and may
+ * have a lower resolution than Y (half width and half height for 4:2:0).
+ */
 typedef struct {
-    double Y;
-    double Cb;
-    double Cr;
-} YCbCr_Pixel;
+    uint8_t *Y;             /* Luminance plane (width * height) */
+    uint8_t *Cb;            /* Blue-difference plane (chroma_width * chroma_height) */
+    uint8_t *Cr;            /* Red-difference plane (chroma_width * chroma_height) */
+    int width;
+    int height;
+    int chroma_width;
+    int chroma_height;
+} YCbCr_Planes;
 
+/**
+ * @brief Quantized coefficients of every block, in zigzag order.
+ *
+ * Each channel is one contiguous, COEF_SLAB_ALIGNMENT-aligned slab of
+ * int16_t[num][64]; use block_coefs() to reach block i.
+ */
 typedef struct {
-    int **Y_blocks;
-    int **Cb_blocks;
-    int **Cr_blocks;
-    int num_blocks;
+    int16_t *Y_blocks;      /* num_blocks * 64 coefficients */
+    int16_t *Cb_blocks;     /* num_chroma_blocks * 64 coefficients */
+    int16_t *Cr_blocks;     /* num_chroma_blocks * 64 coefficients */
+    int *Y_last;        /* Zigzag index of the last coded coefficient of each block (decoder only, else NULL) */
+    int *Cb_last;
+    int *Cr_last;
+    int num_blocks;         /* Number of Y blocks */
+    int num_chroma_blocks;  /* Number of blocks in each of Cb and Cr */
 } Blocks_ZigZag;
 
+/**
+ * @brief Geometry and block order of a coded stream.
+ *
+ * Without BIN_FLAG_STRIPES every Y block is coded in raster order, then every Cb
+ * block, then every Cr block. With it, the stream is a sequence of STRIPE_ROWS-row
+ * stripes, each holding its Y blocks (raster order over two block rows), then its
+ * row of Cb blocks, then its row of Cr blocks. DC prediction always follows the
+ * raster order of each channel, so both layouts code the same symbols. With
+ * BIN_FLAG_RESTART the stripes are grouped in segments of 'restart_interval'
+ * stripes, and DC prediction restarts at the first block of every segment. With
+ * BIN_FLAG_INDEX an index entry is recorded every 'index_interval' stripes. With
+ * BIN_FLAG_HUFFMAN the luma DC, luma AC, chroma DC and chroma AC tables follow
+ * the headers (and the restart table), and replace the standard tables.
+ */
+typedef struct {
+    int width;
+    int height;
+    int chroma_width;
+    int chroma_height;
+    int blocks_x;               /* Y blocks per row */
+    int blocks_y;               /* Y block rows */
+    int chroma_blocks_x;        /* Cb/Cr blocks per row */
+    int chroma_blocks_y;        /* Cb/Cr block rows */
+    int num_blocks;             /* blocks_x * blocks_y */
+    int num_chroma_blocks;      /* chroma_blocks_x * chroma_blocks_y */
+    int num_stripes;            /* STRIPE_ROWS-row stripes covering the image */
+    int restart_interval;       /* Stripes per restart segment (0 = no restarts) */
+    int num_segments;           /* Restart segments (1 without restarts) */
+    int index_interval;         /* Stripes between index entries (0 = no index) */
+    int num_index_entries;      /* Index entries (0 without an index) */
+    unsigned short flags;       /* BIN_FLAG_* */
+} Stream_Layout;
+
+/**
+ * @brief Restart table that follows the BMP headers when BIN_FLAG_RESTART is set.
+ *
+ * It is followed by 'num_segments' uint64_t file offsets, one per segment. Every
+ * segment starts on a byte boundary with all DC predictors reset to zero, so the
+ * segments can be entropy coded and decoded independently.
+ */
+typedef struct {
+    unsigned int restart_interval;  /* Stripes per segment (the last one may have fewer) */
+    unsigned int num_segments;
+} __attribute__((packed)) Restart_Header;
+
+/**
+ * @brief Index entry: where a stripe starts in the file and the DC predictors it starts from.
+ *
+ * Entry i describes stripe i * index_interval. Decoding can start at any entry by
+ * seeking to 'bit_offset' and loading the predictors, instead of from the first block.
+ */
+typedef struct {
+    uint64_t bit_offset;            /* File offset, in bits, of the first block of the stripe */
+    int16_t last_dc[3];             /* DC predictors of Y, Cb and Cr before that block */
+} __attribute__((packed)) Index_Entry;
+
+/**
+ * @brief Last bytes of the file when BIN_FLAG_INDEX is set, right after the 'num_entries' Index_Entry.
+ */
+typedef struct {
+    unsigned int index_interval;    /* Stripes between entries */
+    unsigned int num_entries;
+} __attribute__((packed)) Index_Footer;
+
 typedef struct {
     int skip;
     int category;
@@ -90,6 +196,8 @@ typedef struct {
     const char *prefix;
     int total_length;
     int mantissa_bits;
+    uint32_t code;      /* Prefix as an integer, MSB first */
+    int code_length;    /* Number of bits in the prefix */
 } DC_Huffman_Code;
 
 typedef struct {
@@ -97,12 +205,34 @@ typedef struct {
     int category;
     const char *prefix;
     int total_length;
+    uint32_t code;      /* Prefix as an integer, MSB first */
+    int code_length;    /* Number of bits in the prefix */
 } AC_Huffman_Code;
 
+/**
+ * @brief Huffman code as an integer (MSB first) and its length in bits.
+ */
+typedef struct {
+    uint32_t code;
+    int length;
+} Huffman_Code;
+
+/**
+ * @brief Bitstream state shared by the bit writer and the bit reader.
+ *
+ * Bits are kept MSB-first in a 64-bit accumulator and moved to/from the file
+ * through a large byte buffer, so the hot paths never call stdio per bit. A
+ * reader can also take its bytes straight from memory ('file' is then NULL).
+ */
 typedef struct {
     FILE *file;
-    unsigned char buffer;
-    int bit_count;
+    const uint8_t *data;                /* Reader without a file: the bytes to read, in place of 'buffer' */
+    uint64_t acc;                       /* Bit accumulator (the low 'bit_count' bits are valid) */
+    int bit_count;                      /* Number of pending bits in 'acc' */
+    int pad_bits;                       /* Zero bits appended to 'acc' past the end of the file (reader) */
+    size_t pos;                         /* Bytes used in 'buffer' (writer) / read cursor (reader) */
+    size_t len;                         /* Bytes available in 'buffer' or 'data' (reader) */
+    uint8_t buffer[BIT_BUFFER_SIZE];
 } Bit_Read_Write;
 
 extern const uint8_t lumin_matrix[BLOCK_SIZE][BLOCK_SIZE];
@@ -116,5 +246,10 @@ extern const DC_Huffman_Code dc_table[11];
 
 extern const AC_Huffman_Code ac_table[162];
 
+extern const Huffman_Code ac_encode_table[16][11];
+
+// Row-major position (row * 8 + column) of each coefficient in zigzag order
+extern const uint8_t zigzag_order[BLOCK_SIZE * BLOCK_SIZE];
+
 
 #endif /* TYPES_H */
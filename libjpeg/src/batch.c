@@ -0,0 +1,363 @@
+// stat(), mkdir(), opendir(), glob(), getline(), strdup(), pthreads and clock_gettime()
+#define _POSIX_C_SOURCE 200809L
+
+#include "batch.h"
+#include "messages.h"
+#include "thread_pool.h"
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <glob.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+/**
+ * Shared state of a running batch. Workers claim files in list order (largest
+ * first) through 'next'; each file's status and output size are only written
+ * by the worker that claimed it.
+ */
+typedef struct {
+    const Batch_List *list;
+    char **outputs;
+    Batch_Job job;
+    void *context;
+    Batch_Scratch *scratch;     /* One per worker */
+    int *status;
+    uint64_t *output_sizes;
+    pthread_mutex_t lock;
+    int next;                   /* Next file to claim */
+} Batch_Run;
+
+// Appends a regular file to the list; other entries are skipped unless 'required'
+static int add_file(Batch_List *list, const char *path, int required) {
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+        if (!required) return SUCCESS;
+        report_error("Not a regular file: %s", path);
+        return FAILURE;
+    }
+
+    if (list->count == list->capacity) {
+        int capacity = list->capacity > 0 ? list->capacity * 2 : 64;
+        Batch_File *files = realloc(list->files, (size_t)capacity * sizeof(Batch_File));
+        if (!files) return FAILURE;
+        list->files = files;
+        list->capacity = capacity;
+    }
+
+    char *copy = strdup(path);
+    if (!copy) return FAILURE;
+    list->files[list->count].path = copy;
+    list->files[list->count].size = (uint64_t)st.st_size;
+    list->count++;
+    return SUCCESS;
+}
+
+// Case-insensitive check of the end of a file name
+static int has_extension(const char *name, const char *extension) {
+    size_t name_len = strlen(name);
+    size_t ext_len = strlen(extension);
+    if (name_len <= ext_len) return 0;
+
+    const char *tail = name + name_len - ext_len;
+    for (size_t i = 0; i < ext_len; i++) {
+        if (tolower((unsigned char)tail[i]) != tolower((unsigned char)extension[i])) return 0;
+    }
+    return 1;
+}
+
+static int collect_directory(const char *dir_path, const char *extension, Batch_List *list) {
+    DIR *dir = opendir(dir_path);
+    if (!dir) {
+        report_error("Error opening directory: %s", dir_path);
+        return FAILURE;
+    }
+
+    size_t dir_len = strlen(dir_path);
+    int status = SUCCESS;
+    struct dirent *entry;
+    while (status == SUCCESS && (entry = readdir(dir)) != NULL) {
+        if (!has_extension(entry->d_name, extension)) continue;
+
+        char *path = malloc(dir_len + strlen(entry->d_name) + 2);
+        if (!path) {
+            status = FAILURE;
+            break;
+        }
+        sprintf(path, "%s/%s", dir_path, entry->d_name);
+        status = add_file(list, path, 0);
+        free(path);
+    }
+
+    closedir(dir);
+    return status;
+}
+
+static int collect_glob(const char *pattern, Batch_List *list) {
+    glob_t matches;
+    int result = glob(pattern, 0, NULL, &matches);
+    if (result == GLOB_NOMATCH) {
+        report_error("No files match: %s", pattern);
+        return FAILURE;
+    }
+    if (result != 0) {
+        report_error("Error expanding pattern: %s", pattern);
+        return FAILURE;
+    }
+
+    int status = SUCCESS;
+    for (size_t i = 0; i < matches.gl_pathc && status == SUCCESS; i++) {
+        status = add_file(list, matches.gl_pathv[i], 0);
+    }
+
+    globfree(&matches);
+    return status;
+}
+
+// One path per line; blank lines are skipped
+static int collect_list_file(const char *list_path, Batch_List *list) {
+    FILE *file = fopen(list_path, "r");
+    if (!file) {
+        report_error("Error opening list file: %s", list_path);
+        return FAILURE;
+    }
+
+    char *line = NULL;
+    size_t line_size = 0;
+    ssize_t len;
+    int status = SUCCESS;
+    while (status == SUCCESS && (len = getline(&line, &line_size, file)) != -1) {
+        while (len > 0 && isspace((unsigned char)line[len - 1])) line[--len] = '\0';
+        if (len == 0) continue;
+        status = add_file(list, line, 1);
+    }
+
+    free(line);
+    fclose(file);
+    return status;
+}
+
+// Largest first; equal sizes by path, so the order does not depend on the listing
+static int compare_files(const void *a, const void *b) {
+    const Batch_File *fa = a;
+    const Batch_File *fb = b;
+    if (fa->size != fb->size) return fa->size > fb->size ? -1 : 1;
+    return strcmp(fa->path, fb->path);
+}
+
+int collect_batch_inputs(const char *source, const char *extension, Batch_List *list) {
+    list->files = NULL;
+    list->count = 0;
+    list->capacity = 0;
+
+    struct stat st;
+    int status;
+    if (stat(source, &st) == 0 && S_ISDIR(st.st_mode)) {
+        status = collect_directory(source, extension, list);
+    } else if (stat(source, &st) != 0 && strpbrk(source, "*?[")) {
+        status = collect_glob(source, list);
+    } else {
+        status = collect_list_file(source, list);
+    }
+
+    if (status == SUCCESS && list->count == 0) {
+        report_error("No input files in: %s", source);
+        status = FAILURE;
+    }
+    if (status != SUCCESS) {
+        free_batch_list(list);
+        return FAILURE;
+    }
+
+    qsort(list->files, list->count, sizeof(Batch_File), compare_files);
+    return SUCCESS;
+}
+
+void free_batch_list(Batch_List *list) {
+    for (int i = 0; i < list->count; i++) {
+        free(list->files[i].path);
+    }
+    free(list->files);
+    list->files = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
+
+void *batch_scratch_reserve(Batch_Scratch *scratch, size_t size) {
+    if (scratch->size >= size) return scratch->data;
+
+    void *grown = realloc(scratch->data, size);
+    if (!grown) return NULL;
+    scratch->data = grown;
+    scratch->size = size;
+    return grown;
+}
+
+// 'output_dir'/<input file name without its extension><'extension'>
+static char *output_path(const char *input, const char *output_dir, const char *extension) {
+    const char *name = strrchr(input, '/');
+    name = name ? name + 1 : input;
+    const char *dot = strrchr(name, '.');
+    size_t stem_len = (dot && dot != name) ? (size_t)(dot - name) : strlen(name);
+
+    size_t dir_len = strlen(output_dir);
+    char *path = malloc(dir_len + stem_len + strlen(extension) + 2);
+    if (!path) return NULL;
+
+    sprintf(path, "%s/%.*s%s", output_dir, (int)stem_len, name, extension);
+    return path;
+}
+
+static int compare_strings(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// Two inputs with the same name in different directories would overwrite each other's output
+static int check_unique_outputs(char **outputs, int count) {
+    char **sorted = malloc((size_t)count * sizeof(char *));
+    if (!sorted) return FAILURE;
+    memcpy(sorted, outputs, (size_t)count * sizeof(char *));
+    qsort(sorted, count, sizeof(char *), compare_strings);
+
+    int status = SUCCESS;
+    for (int i = 1; i < count; i++) {
+        if (strcmp(sorted[i - 1], sorted[i]) == 0) {
+            report_error("Several inputs have the same output: %s", sorted[i]);
+            status = FAILURE;
+            break;
+        }
+    }
+
+    free(sorted);
+    return status;
+}
+
+static int make_output_dir(const char *output_dir) {
+    struct stat st;
+    if (mkdir(output_dir, 0777) != 0 && errno != EEXIST) return FAILURE;
+    return (stat(output_dir, &st) == 0 && S_ISDIR(st.st_mode)) ? SUCCESS : FAILURE;
+}
+
+// Pool task: worker 'index' runs files until none is left
+static void batch_worker(void *context, int index) {
+    Batch_Run *run = context;
+    Batch_Scratch *scratch = &run->scratch[index];
+
+    for (;;) {
+        pthread_mutex_lock(&run->lock);
+        int i = run->next < run->list->count ? run->next++ : -1;
+        pthread_mutex_unlock(&run->lock);
+        if (i < 0) break;
+
+        const char *input = run->list->files[i].path;
+        run->status[i] = run->job(run->context, scratch, input, run->outputs[i]);
+
+        struct stat st;
+        if (run->status[i] == SUCCESS && stat(run->outputs[i], &st) == 0) {
+            run->output_sizes[i] = (uint64_t)st.st_size;
+        }
+        if (run->status[i] != SUCCESS) report_error("Failed: %s", input);
+    }
+}
+
+static double elapsed_seconds(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int run_batch(const Batch_List *list, const char *output_dir, const char *extension, int workers,
+              Batch_Job job, void *context, Batch_Summary *summary) {
+    memset(summary, 0, sizeof(*summary));
+    int count = list->count;
+    if (count == 0) return SUCCESS;
+
+    if (make_output_dir(output_dir) != SUCCESS) {
+        report_error("Error creating output directory: %s", output_dir);
+        return FAILURE;
+    }
+
+    Batch_Run run;
+    memset(&run, 0, sizeof(run));
+    run.list = list;
+    run.job = job;
+    run.context = context;
+    run.outputs = calloc(count, sizeof(char *));
+    run.status = calloc(count, sizeof(int));
+    run.output_sizes = calloc(count, sizeof(uint64_t));
+
+    int status = (run.outputs && run.status && run.output_sizes) ? SUCCESS : FAILURE;
+    for (int i = 0; i < count && status == SUCCESS; i++) {
+        run.outputs[i] = output_path(list->files[i].path, output_dir, extension);
+        if (!run.outputs[i]) status = FAILURE;
+    }
+    if (status == SUCCESS) status = check_unique_outputs(run.outputs, count);
+
+    // Never more workers than files
+    if (workers <= 0) workers = available_cpus();
+    if (workers > count) workers = count;
+
+    Thread_Pool *pool = NULL;
+    if (status == SUCCESS) {
+        pool = thread_pool_create(workers);
+        run.scratch = calloc(workers, sizeof(Batch_Scratch));
+        if (!pool || !run.scratch) status = FAILURE;
+    }
+
+    if (status == SUCCESS) {
+        pthread_mutex_init(&run.lock, NULL);
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        thread_pool_submit(pool, batch_worker, &run, workers);
+        thread_pool_wait(pool);
+        summary->seconds = elapsed_seconds(&start);
+        summary->workers = workers;
+
+        pthread_mutex_destroy(&run.lock);
+
+        for (int i = 0; i < count; i++) {
+            if (run.status[i] == SUCCESS) {
+                summary->files++;
+                summary->input_bytes += list->files[i].size;
+                summary->output_bytes += run.output_sizes[i];
+            } else {
+                summary->failed++;
+            }
+        }
+        if (summary->failed > 0) status = FAILURE;
+    }
+
+    thread_pool_destroy(pool);
+    if (run.scratch) {
+        for (int w = 0; w < workers; w++) {
+            free(run.scratch[w].data);
+        }
+        free(run.scratch);
+    }
+    if (run.outputs) {
+        for (int i = 0; i < count; i++) {
+            free(run.outputs[i]);
+        }
+        free(run.outputs);
+    }
+    free(run.status);
+    free(run.output_sizes);
+
+    return status;
+}
+
+void print_batch_summary(const Batch_Summary *summary) {
+    double seconds = summary->seconds > 0 ? summary->seconds : 1e-9;
+    double input_mb = summary->input_bytes / 1e6;
+    double output_mb = summary->output_bytes / 1e6;
+
+    printf("Batch: %d files processed, %d failed, %d workers, %.3f s\n",
+           summary->files, summary->failed, summary->workers, summary->seconds);
+    printf("Input: %.2f MB, Output: %.2f MB\n", input_mb, output_mb);
+    printf("Throughput: %.2f files/s, %.2f MB/s in, %.2f MB/s out\n",
+           summary->files / seconds, input_mb / seconds, output_mb / seconds);
+}
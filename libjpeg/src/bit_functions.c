@@ -2,84 +2,135 @@
 
 void init_bitwriter(Bit_Read_Write *bw, FILE *fp) {
     bw->file = fp;
-    bw->buffer = 0;
+    bw->acc = 0;
     bw->bit_count = 0;
+    bw->pos = 0;
 }
 
-void write_bit(Bit_Read_Write *bw, int bit) {
-    bw->buffer <<= 1;
-    if (bit) bw->buffer |= 1;
-    bw->bit_count++;
-
-    if (bw->bit_count == 8) {
-        fputc(bw->buffer, bw->file);
-        bw->bit_count = 0;
-        bw->buffer = 0;
+void drain_bit_buffer(Bit_Read_Write *bw) {
+    if (bw->pos > 0) {
+        fwrite(bw->buffer, 1, bw->pos, bw->file);
+        bw->pos = 0;
     }
 }
 
+void write_bit(Bit_Read_Write *bw, int bit) {
+    write_code(bw, bit ? 1 : 0, 1);
+}
+
 void write_bits(Bit_Read_Write *bw, const char *bits) {
+    uint32_t code = 0;
+    int length = 0;
+
+    // Pack the string into words so the accumulator is touched once per 32 bits
     while (*bits) {
-        write_bit(bw, *bits == '1');
+        code = (code << 1) | (*bits == '1');
+        length++;
         bits++;
+        if (length == 32) {
+            write_code(bw, code, length);
+            code = 0;
+            length = 0;
+        }
     }
+    if (length > 0) write_code(bw, code, length);
 }
 
 void write_n_bits(Bit_Read_Write *bw, int value, int n) {
-    for (int i = n - 1; i >= 0; i--) {
-        write_bit(bw, (value >> i) & 1);
-    }
+    write_code(bw, (uint32_t)value, n);
 }
 
 void flush_bits(Bit_Read_Write *bw) {
+    // Move the remaining whole bytes, then the last partial byte padded with zeros
+    while (bw->bit_count >= 8) {
+        bw->bit_count -= 8;
+        bw->buffer[bw->pos++] = (uint8_t)(bw->acc >> bw->bit_count);
+        if (bw->pos == BIT_BUFFER_SIZE) drain_bit_buffer(bw);
+    }
     if (bw->bit_count > 0) {
-        bw->buffer <<= (8 - bw->bit_count);
-        fputc(bw->buffer, bw->file);
+        bw->buffer[bw->pos++] = (uint8_t)(bw->acc << (8 - bw->bit_count));
+        bw->bit_count = 0;
     }
+    drain_bit_buffer(bw);
+    bw->acc = 0;
 }
 
-void write_bits_complement1(Bit_Read_Write *bw, int value, int n_bits) {
-    int mask = (1 << n_bits) - 1;
-    int absval = abs(value);
+uint64_t bit_writer_position(Bit_Read_Write *bw) {
+    long offset = ftell(bw->file);
+    if (offset < 0) return UINT64_MAX;
 
-    if (value >= 0) {
-        write_n_bits(bw, absval & mask, n_bits);
-    } else {
-        int inverted = (~absval) & mask;
-        write_n_bits(bw, inverted, n_bits);
-    }
+    return ((uint64_t)offset + bw->pos) * 8 + (uint64_t)bw->bit_count;
+}
+
+void write_bits_complement1(Bit_Read_Write *bw, int value, int n_bits) {
+    write_code(bw, complement1_bits(value, n_bits), n_bits);
 }
 
 void init_bitreader(Bit_Read_Write *br, FILE *fp) {
     br->file = fp;
-    br->buffer = 0;
+    br->data = NULL;
+    br->acc = 0;
     br->bit_count = 0;
+    br->pad_bits = 0;
+    br->pos = 0;
+    br->len = 0;
 }
 
-int read_bit(Bit_Read_Write *br) {
-    if (br->bit_count == 0) {
-        int c = fgetc(br->file);
-        if (c == EOF) return -1; // EOF
-        br->buffer = c;
-        br->bit_count = 8;
+void init_bitreader_memory(Bit_Read_Write *br, const uint8_t *data, size_t size) {
+    init_bitreader(br, NULL);
+    br->data = data;
+    br->len = size;
+}
+
+int seek_bitreader(Bit_Read_Write *br, uint64_t bit_offset) {
+    if (br->file) {
+        if (fseek(br->file, (long)(bit_offset / 8), SEEK_SET) != 0) return FAILURE;
+        init_bitreader(br, br->file);
+    } else {
+        if (bit_offset / 8 > br->len) return FAILURE;
+        init_bitreader_memory(br, br->data, br->len);
+        br->pos = (size_t)(bit_offset / 8);
     }
-    int bit = (br->buffer >> 7) & 1;
-    br->buffer <<= 1;
-    br->bit_count--;
+
+    int skip = (int)(bit_offset % 8);
+    return (skip == 0 || read_n_bits(br, skip) != -1) ? SUCCESS : FAILURE;
+}
+
+void fill_bits(Bit_Read_Write *br) {
+    const uint8_t *bytes = br->file ? br->buffer : br->data;
+
+    while (br->bit_count <= 56) {
+        if (br->pos == br->len && br->file) {
+            br->len = fread(br->buffer, 1, BIT_BUFFER_SIZE, br->file);
+            br->pos = 0;
+        }
+        if (br->pos == br->len) { // EOF: pad with zeros
+            br->acc <<= 8;
+            br->bit_count += 8;
+            br->pad_bits += 8;
+            continue;
+        }
+        br->acc = (br->acc << 8) | bytes[br->pos++];
+        br->bit_count += 8;
+    }
+}
+
+int read_bit(Bit_Read_Write *br) {
+    int bit = (int)peek_bits(br, 1);
+    if (!skip_bits(br, 1)) return -1; // EOF
     return bit;
 }
 
 int read_n_bits(Bit_Read_Write *br, int n) {
-    int value = 0;
-    for (int i = 0; i < n; i++) {
-        int bit = read_bit(br);
-        if (bit == -1) return -1; // EOF
-        value = (value << 1) | bit;
-    }
+    if (n == 0) return 0;
+    int value = (int)peek_bits(br, n);
+    if (!skip_bits(br, n)) return -1; // EOF
     return value;
 }
 
 int read_bits_complement1(Bit_Read_Write *br, int n_bits) {
+    if (n_bits == 0) return 0;
+
     int positive = read_n_bits(br, n_bits);
     if (positive == -1) return 0; // Error
 
@@ -91,4 +142,4 @@ int read_bits_complement1(Bit_Read_Write *br, int n_bits) {
         int inverted = (~positive) & ((1 << n_bits) - 1);
         return -inverted; // Negative value in complement-1 format
     }
-}
\ No newline at end of file
+}
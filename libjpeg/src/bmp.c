@@ -1,167 +1,193 @@
 #include "bmp.h"
+#include "messages.h"
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
-int readHeader(FILE *F, BMPFILEHEADER *H) {
-    fread(&H->bfType,sizeof (unsigned short int),1,F);
-
+// Magic number check: 0x4d42 corresponds to "BM" in little-endian format
+static int check_header(const BMPFILEHEADER *H) {
+    if (H->bfType != 0x4d42) {
+        report_error("The file is not a BMP file.");
+        return FAILURE;
+    }
 
-    // Magic number check: 0x4d42 corresponds to "BM" in little-endian format
-    if(H->bfType != 0x4d42) {
-        printf("The file is not a BMP file.\n");
+    // The pixel data cannot overlap the headers
+    if (H->bfOffBits < BMP_HEADERS_SIZE) {
+        report_error("Invalid BMP pixel data offset (%u).", H->bfOffBits);
         return FAILURE;
     }
-    
-    fread(&H->bfSize,sizeof (unsigned int),1,F);
-    fread(&H->bfReserved1,sizeof (unsigned short int),1,F);
-    fread(&H->bfReserved2,sizeof (unsigned short int),1,F);
-    fread(&H->bfOffBits,sizeof (unsigned int),1,F);
-
-    
-    // Debug output
-    
-    // printf("\nBMP File Header:\n");
-    // printf("Type: 0x%x\n", H->bfType);
-    // printf("Size: %u\n", H->bfSize);
-    // printf("Reserved1: %hu\n", H->bfReserved1);
-    // printf("Reserved1: %hu\n", H->bfReserved2);
-    // printf("OffBits: %u\n", H->bfOffBits);
-    
     return SUCCESS;
 }
 
-int readInfoHeader(FILE *F, BMPINFOHEADER *H) {
-    fread(&H->biSize,sizeof (unsigned int),1,F);
-    fread(&H->biWidth,sizeof (int),1,F);
-    fread(&H->biHeight,sizeof (int),1,F);
+static int check_info_header(const BMPINFOHEADER *H) {
+    // Any size is allowed: partial edge blocks are padded when coding and cropped when decoding
+    if (H->biWidth < 1 || H->biHeight < 1) {
+        report_error("Image width and height must be positive (top-down BMPs are not supported).");
+        return FAILURE;
+    }
 
-    // Validate that width and height are multiples of 8
-    if((H->biWidth % 8 != 0) || (H->biHeight % 8 != 0)) {
-        printf("Image width or height is not a multiple of 8.\n");
+    // Block counts are kept in an int
+    uint64_t blocks = (((uint64_t)H->biWidth + 7) / 8) * (((uint64_t)H->biHeight + 7) / 8);
+    if (blocks > INT32_MAX) {
+        report_error("Image is too large (%d x %d).", H->biWidth, H->biHeight);
         return FAILURE;
     }
 
-    
-    // Validate allowed dimensions: from 8x8 to 1280x800
-    if (H->biWidth < 8 || H->biHeight < 8 ||
-        H->biWidth > 1280 || H->biHeight > 800) {
-        printf("Dimensions are outside the allowed range (8x8 to 1280x800).\n");
+    if (H->biBitCount != 24) {
+        report_error("The BMP file does not have 24 bits per pixel.");
         return FAILURE;
     }
 
-    fread(&H->biPlanes,sizeof (unsigned short int),1,F);
-    fread(&H->biBitCount,sizeof (unsigned short int),1,F);
+    if (H->biCompression != 0) {
+        report_error("The BMP file uses compression, which is not allowed.");
+        return FAILURE;
+    }
 
-    if(H->biBitCount != 24) {
-        printf("The BMP file does not have 24 bits per pixel.\n");
+    return SUCCESS;
+}
+
+// The packed header structures match the little-endian file layout, so each is read in one call
+int readHeader(FILE *F, BMPFILEHEADER *H) {
+    if (fread(H, sizeof(BMPFILEHEADER), 1, F) != 1) {
+        report_error("The file is not a BMP file.");
         return FAILURE;
     }
+    return check_header(H);
+}
 
-    fread(&H->biCompression,sizeof (unsigned int),1,F);
+int readInfoHeader(FILE *F, BMPINFOHEADER *H) {
+    if (fread(H, sizeof(BMPINFOHEADER), 1, F) != 1) {
+        report_error("The BMP info header is truncated.");
+        return FAILURE;
+    }
+    return check_info_header(H);
+}
 
-    if(H->biCompression != 0) {
-        printf("The BMP file uses compression, which is not allowed.\n");
+int parse_bmp_headers(const uint8_t *data, size_t size, BMPFILEHEADER *fileHeader, BMPINFOHEADER *infoHeader) {
+    if (size < BMP_HEADERS_SIZE) {
+        report_error("The file is not a BMP file.");
         return FAILURE;
     }
 
-    fread(&H->biSizeImage,sizeof (unsigned int),1,F);
-    fread(&H->biXPelsPerMeter,sizeof (int),1,F);
-    fread(&H->biYPelsPerMeter,sizeof (int),1,F);
-    fread(&H->biClrUsed,sizeof (unsigned int),1,F);
-    fread(&H->biClrImportant,sizeof (unsigned int),1,F);
-
-    // Debug output
-
-    // printf("\nBMP File Header Info:\n");
-    // printf("Size: %u\n", H->biSize);
-    // printf("Width: %d\n", H->biWidth);
-    // printf("Height: %d\n", H->biHeight);
-    // printf("Planes: %hu\n", H->biPlanes);
-    // printf("BitCount: %hu\n", H->biBitCount);
-    // printf("Compression: %u\n", H->biCompression);
-    // printf("SizeImage: %u\n", H->biSizeImage);
-    // printf("XPelsPerMeter: %d\n", H->biXPelsPerMeter);
-    // printf("YPelsPerMeter: %d\n", H->biYPelsPerMeter);
-    // printf("ClrUsed: %u\n", H->biClrUsed);
-    // printf("ClrImportant: %u\n", H->biClrImportant);
-    
+    memcpy(fileHeader, data, sizeof(BMPFILEHEADER));
+    memcpy(infoHeader, data + sizeof(BMPFILEHEADER), sizeof(BMPINFOHEADER));
+
+    if (check_header(fileHeader) != SUCCESS || check_info_header(infoHeader) != SUCCESS) return FAILURE;
     return SUCCESS;
 }
 
-RGB_Pixel *read_pixels(FILE *file, BMPFILEHEADER *H, int width, int height) {
-    
-    // Calculate padding: each row must be a multiple of 4 bytes
-    int padding = (4 - (width * 3) % 4) % 4;
+// Rows are padded to a multiple of 4 bytes
+static uint64_t row_bytes(int width) {
+    return ((uint64_t)width * 3 + 3) & ~3ULL;
+}
 
-    RGB_Pixel *pixels = malloc(width * height * sizeof(RGB_Pixel));
+int bmp_pixel_rows(size_t size, const BMPFILEHEADER *H, int width, int height, size_t *top_offset,
+                   ptrdiff_t *stride) {
+    // BMP stores the rows from bottom to top
+    uint64_t top = (uint64_t)H->bfOffBits + (uint64_t)(height - 1) * row_bytes(width);
+    if (top + (uint64_t)width * 3 > size || row_bytes(width) > PTRDIFF_MAX) {
+        report_error("The BMP pixel data is truncated.");
+        return FAILURE;
+    }
 
-    if (!pixels) return NULL;
+    *top_offset = (size_t)top;
+    *stride = -(ptrdiff_t)row_bytes(width);
+    return SUCCESS;
+}
 
+uint64_t bmp_file_size(const BMPFILEHEADER *H, int width, int height) {
+    return (uint64_t)H->bfOffBits + row_bytes(width) * (uint64_t)height;
+}
 
-    // Move to the beginning of the image data
-    fseek(file, H->bfOffBits, SEEK_SET);
+void store_bmp_headers(uint8_t *data, const BMPFILEHEADER *fileHeader, const BMPINFOHEADER *infoHeader) {
+    memcpy(data, fileHeader, sizeof(BMPFILEHEADER));
+    memcpy(data + sizeof(BMPFILEHEADER), infoHeader, sizeof(BMPINFOHEADER));
+}
 
+int init_bmp_headers(BMPFILEHEADER *fileHeader, BMPINFOHEADER *infoHeader, int width, int height) {
+    memset(fileHeader, 0, sizeof(*fileHeader));
+    memset(infoHeader, 0, sizeof(*infoHeader));
+
+    infoHeader->biSize = sizeof(BMPINFOHEADER);
+    infoHeader->biWidth = width;
+    infoHeader->biHeight = height;
+    infoHeader->biPlanes = 1;
+    infoHeader->biBitCount = 24;
+    if (check_info_header(infoHeader) != SUCCESS) return FAILURE;
+
+    // Sizes that do not fit the 32-bit fields are stored as 0, as readers recompute them
+    uint64_t image_size = row_bytes(width) * (uint64_t)height;
+    fileHeader->bfType = 0x4d42;
+    fileHeader->bfOffBits = BMP_HEADERS_SIZE;
+    fileHeader->bfSize = image_size + BMP_HEADERS_SIZE <= UINT32_MAX ? (unsigned int)(image_size + BMP_HEADERS_SIZE) : 0;
+    infoHeader->biSizeImage = image_size <= UINT32_MAX ? (unsigned int)image_size : 0;
+    return SUCCESS;
+}
 
-    //BMP stores pixel rows from bottom to top
-    for(int y = height - 1; y >= 0; y--) {
-        for(int x = 0; x < width; x++) {
-            fread(&pixels[y * width + x].b, sizeof(uint8_t), 1, file);
-            fread(&pixels[y * width + x].g, sizeof(uint8_t), 1, file);
-            fread(&pixels[y * width + x].r, sizeof(uint8_t), 1, file);
-        }     
+RGB_Pixel *read_pixels(FILE *file, BMPFILEHEADER *H, int width, int height) {
+    RGB_Pixel *pixels = malloc((size_t)width * height * sizeof(RGB_Pixel));
+    if (!pixels) return NULL;
 
-        // Skip the padding bytes at the end of each row
-        fseek(file, padding, SEEK_CUR);
+    // One read per row: the rows are seeked to, so their padding is never read
+    for (int y = 0; y < height; y++) {
+        if (read_pixel_row(file, H, width, height, y, &pixels[(size_t)y * width]) != SUCCESS) {
+            free(pixels);
+            return NULL;
+        }
     }
     return pixels;
 }
 
+int read_pixel_row(FILE *file, const BMPFILEHEADER *H, int width, int height, int y, RGB_Pixel *row) {
+    // Rows are padded to a multiple of 4 bytes and stored from bottom to top
+    long stride = ((long)width * 3 + 3) & ~3L;
+    long offset = (long)H->bfOffBits + (long)(height - 1 - y) * stride;
+
+    if (fseek(file, offset, SEEK_SET) != 0) return FAILURE;
+    if (fread(row, sizeof(RGB_Pixel), width, file) != (size_t)width) return FAILURE;
+
+    return SUCCESS;
+}
+
+int write_pixel_row(FILE *file, const BMPFILEHEADER *H, int width, int height, int y, const RGB_Pixel *row) {
+    long stride = ((long)width * 3 + 3) & ~3L;
+    long offset = (long)H->bfOffBits + (long)(height - 1 - y) * stride;
+    static const uint8_t zero[3] = {0, 0, 0};
+    size_t padding = (size_t)(stride - (long)width * 3);
+
+    if (fseek(file, offset, SEEK_SET) != 0) return FAILURE;
+    if (fwrite(row, sizeof(RGB_Pixel), width, file) != (size_t)width) return FAILURE;
+    if (padding && fwrite(zero, 1, padding, file) != padding) return FAILURE;
+
+    return SUCCESS;
+}
+
 void free_pixels(RGB_Pixel *pixels) {
     free(pixels);
 }
 
+int write_bmp_headers(FILE *dst, const BMPFILEHEADER *fileHeader, const BMPINFOHEADER *infoHeader) {
+    // The packed structures are the on-disk layout
+    if (fwrite(fileHeader, sizeof(BMPFILEHEADER), 1, dst) != 1) return FAILURE;
+    if (fwrite(infoHeader, sizeof(BMPINFOHEADER), 1, dst) != 1) return FAILURE;
+
+    return SUCCESS;
+}
+
 int write_bmp(FILE *dst, BMPFILEHEADER *fileHeader, BMPINFOHEADER *infoHeader, RGB_Pixel *pixels) {
+    if (write_bmp_headers(dst, fileHeader, infoHeader) != SUCCESS) return FAILURE;
 
-    // Header BMP
-    if (fwrite(&fileHeader->bfType, sizeof(unsigned short), 1, dst) != 1) return FAILURE;
-    if (fwrite(&fileHeader->bfSize, sizeof(unsigned int), 1, dst) != 1) return FAILURE;
-    if (fwrite(&fileHeader->bfReserved1, sizeof(unsigned short), 1, dst) != 1) return FAILURE;
-    if (fwrite(&fileHeader->bfReserved2, sizeof(unsigned short), 1, dst) != 1) return FAILURE;
-    if (fwrite(&fileHeader->bfOffBits, sizeof(unsigned int), 1, dst) != 1) return FAILURE;
-    
-    // Info Header BMP
-    if (fwrite(&infoHeader->biSize, sizeof(unsigned int), 1, dst) != 1) return FAILURE;
-    if (fwrite(&infoHeader->biWidth, sizeof(int), 1, dst) != 1) return FAILURE;
-    if (fwrite(&infoHeader->biHeight, sizeof(int), 1, dst) != 1) return FAILURE;
-    if (fwrite(&infoHeader->biPlanes, sizeof(unsigned short), 1, dst) != 1) return FAILURE;
-    if (fwrite(&infoHeader->biBitCount, sizeof(unsigned short), 1, dst) != 1) return FAILURE;
-    if (fwrite(&infoHeader->biCompression, sizeof(unsigned int), 1, dst) != 1) return FAILURE;
-    if (fwrite(&infoHeader->biSizeImage, sizeof(unsigned int), 1, dst) != 1) return FAILURE;
-    if (fwrite(&infoHeader->biXPelsPerMeter, sizeof(int), 1, dst) != 1) return FAILURE;
-    if (fwrite(&infoHeader->biYPelsPerMeter, sizeof(int), 1, dst) != 1) return FAILURE;
-    if (fwrite(&infoHeader->biClrUsed, sizeof(unsigned int), 1, dst) != 1) return FAILURE;
-    if (fwrite(&infoHeader->biClrImportant, sizeof(unsigned int), 1, dst) != 1) return FAILURE;
-    
     int width = infoHeader->biWidth;
     int height = infoHeader->biHeight;
-    
-    // Calculate the padding: each row must have a size that is a multiple of 4 bytes
-    int padding = (4 - (width * 3) % 4) % 4;
-    
-    // Write the pixels to the destination file (remember that BMP stores the pixels from bottom to top)
-    for (int y = height - 1; y >= 0; y--) {
-        for (int x = 0; x < width; x++) {
-            RGB_Pixel *p = &pixels[y * width + x];
-            if (fwrite(&p->b, sizeof(uint8_t), 1, dst) != 1) return FAILURE;
-            if (fwrite(&p->g, sizeof(uint8_t), 1, dst) != 1) return FAILURE;
-            if (fwrite(&p->r, sizeof(uint8_t), 1, dst) != 1) return FAILURE;
-        }
 
-        // Write the padding bytes (zero)
-        uint8_t zero = 0;
-        for (int p = 0; p < padding; p++) {
-            if (fwrite(&zero, sizeof(uint8_t), 1, dst) != 1) return FAILURE;
-        }
+    static const uint8_t zero[3] = {0, 0, 0};
+    size_t padding = (size_t)(row_bytes(width) - (uint64_t)width * 3);
+
+    // One write per row and one for its padding; BMP stores the rows from bottom to top
+    for (int y = height - 1; y >= 0; y--) {
+        if (fwrite(&pixels[(size_t)y * width], sizeof(RGB_Pixel), width, dst) != (size_t)width) return FAILURE;
+        if (padding && fwrite(zero, 1, padding, dst) != padding) return FAILURE;
     }
-    
+
     return SUCCESS;
-}
\ No newline at end of file
+}
@@ -0,0 +1,366 @@
+// fopencookie()
+#define _GNU_SOURCE
+
+#include "codec.h"
+#include "bmp.h"
+
+#include <string.h>
+
+// First allocation of an empty Memory_Buffer
+#define MEMORY_BUFFER_MIN_CAPACITY (64 * 1024)
+
+/**
+ * stdio cookie of a Memory_Buffer output: writes land at 'position', which
+ * seeks can move back (the encoder fills in its restart table at the end).
+ */
+typedef struct {
+    Memory_Buffer *buffer;
+    size_t position;
+    int failed;                 /* An allocation failed */
+} Memory_Sink;
+
+/**
+ * stdio cookie of a Write_Callback output: bytes are passed on in order, and
+ * the only seek allowed is reading the position (ftell()).
+ */
+typedef struct {
+    Write_Callback write;
+    void *user;
+    uint64_t position;
+    int failed;                 /* The callback returned FAILURE */
+} Callback_Sink;
+
+int pixel_size(Pixel_Order order) {
+    return (order == PIXEL_BGRA || order == PIXEL_RGBA) ? 4 : 3;
+}
+
+const char *codec_status_text(Codec_Status status) {
+    switch (status) {
+        case CODEC_OK: return "success";
+        case CODEC_ERROR_ARGUMENT: return "invalid argument";
+        case CODEC_ERROR_MEMORY: return "out of memory";
+        case CODEC_ERROR_IO: return "I/O callback failed";
+        case CODEC_ERROR_FORMAT: return "invalid BIN data";
+        case CODEC_ERROR_UNSUPPORTED: return "unsupported BIN format";
+        case CODEC_ERROR_TARGET: return "target size below the lowest quality";
+    }
+    return "unknown status";
+}
+
+// Grows the buffer to hold at least 'size' bytes, doubling its capacity
+static int reserve_memory(Memory_Buffer *buffer, size_t size) {
+    if (size <= buffer->capacity) return SUCCESS;
+
+    size_t capacity = buffer->capacity > 0 ? buffer->capacity : MEMORY_BUFFER_MIN_CAPACITY;
+    while (capacity < size) {
+        capacity = capacity <= SIZE_MAX / 2 ? capacity * 2 : size;
+    }
+
+    uint8_t *data = realloc(buffer->data, capacity);
+    if (!data) return FAILURE;
+    buffer->data = data;
+    buffer->capacity = capacity;
+    return SUCCESS;
+}
+
+static ssize_t memory_write(void *cookie, const char *data, size_t size) {
+    Memory_Sink *sink = cookie;
+    if (size > SIZE_MAX - sink->position || reserve_memory(sink->buffer, sink->position + size) != SUCCESS) {
+        sink->failed = 1;
+        return 0;
+    }
+
+    memcpy(sink->buffer->data + sink->position, data, size);
+    sink->position += size;
+    if (sink->position > sink->buffer->size) sink->buffer->size = sink->position;
+    return (ssize_t)size;
+}
+
+static int memory_seek(void *cookie, off64_t *offset, int whence) {
+    Memory_Sink *sink = cookie;
+    off64_t base = whence == SEEK_SET ? 0 : whence == SEEK_CUR ? (off64_t)sink->position : (off64_t)sink->buffer->size;
+    off64_t target = base + *offset;
+    if (target < 0 || (uint64_t)target > sink->buffer->size) return -1;
+
+    sink->position = (size_t)target;
+    *offset = target;
+    return 0;
+}
+
+static ssize_t callback_write(void *cookie, const char *data, size_t size) {
+    Callback_Sink *sink = cookie;
+    if (sink->write(sink->user, (const uint8_t *)data, size) != SUCCESS) {
+        sink->failed = 1;
+        return 0;
+    }
+
+    sink->position += size;
+    return (ssize_t)size;
+}
+
+static int callback_seek(void *cookie, off64_t *offset, int whence) {
+    Callback_Sink *sink = cookie;
+    if (whence != SEEK_CUR || *offset != 0) return -1;
+
+    *offset = (off64_t)sink->position;
+    return 0;
+}
+
+static Codec_Status check_image(const Pixel_Image *image) {
+    if (!image || !image->pixels || image->width < 1 || image->height < 1 ||
+        image->order < PIXEL_BGR || image->order > PIXEL_RGBA) {
+        return CODEC_ERROR_ARGUMENT;
+    }
+
+    uint64_t row = (uint64_t)image->width * pixel_size(image->order);
+    uint64_t stride = image->stride < 0 ? -(uint64_t)image->stride : (uint64_t)image->stride;
+    return stride >= row ? CODEC_OK : CODEC_ERROR_ARGUMENT;
+}
+
+// Offsets of blue and red in a pixel; green is always in the middle
+static void channel_offsets(Pixel_Order order, int *blue, int *red) {
+    int bgr = order == PIXEL_BGR || order == PIXEL_BGRA;
+    *blue = bgr ? 0 : 2;
+    *red = bgr ? 2 : 0;
+}
+
+// Other channel orders are pushed a stripe at a time through a BGR copy
+static int write_converted_rows(Stream_Encoder *encoder, const Pixel_Image *image) {
+    int width = image->width;
+    int bytes = pixel_size(image->order);
+    int blue, red;
+    channel_offsets(image->order, &blue, &red);
+
+    RGB_Pixel *rows = malloc((size_t)STRIPE_ROWS * width * sizeof(RGB_Pixel));
+    if (!rows) return FAILURE;
+
+    int status = SUCCESS;
+    for (int y = 0; y < image->height && status == SUCCESS; y += STRIPE_ROWS) {
+        int count = image->height - y < STRIPE_ROWS ? image->height - y : STRIPE_ROWS;
+        for (int r = 0; r < count; r++) {
+            const uint8_t *src = image->pixels + (ptrdiff_t)(y + r) * image->stride;
+            RGB_Pixel *dst = rows + (size_t)r * width;
+            for (int x = 0; x < width; x++, src += bytes) {
+                dst[x].b = src[blue];
+                dst[x].g = src[1];
+                dst[x].r = src[red];
+            }
+        }
+        status = stream_encoder_write_rows(encoder, rows, count);
+    }
+
+    free(rows);
+    return status;
+}
+
+static int check_encoder_config(const Encoder_Config *config) {
+    if (config->dct_method != DCT_METHOD_MATRIX && config->dct_method != DCT_METHOD_FAST) return FAILURE;
+    if (config->restart_interval < 0 || config->restart_interval > 65535) return FAILURE;
+    if (config->index_interval < 0 || config->index_interval > 65535) return FAILURE;
+    if (config->quality < MIN_QUALITY || config->quality > MAX_QUALITY) return FAILURE;
+    return SUCCESS;
+}
+
+// Encodes into an already opened output; a FAILURE is an allocation or output failure, ENCODER_TARGET_MISSED a
+// complete stream larger than the target size
+static int encode_to_stream(const Pixel_Image *image, const BMPFILEHEADER *fileHeader, const BMPINFOHEADER *infoHeader,
+                            const Encoder_Config *config, FILE *out) {
+    Stream_Encoder *encoder = stream_encoder_create(out, fileHeader, infoHeader, config);
+    if (!encoder) return FAILURE;
+
+    int status = image->order == PIXEL_BGR
+               ? stream_encoder_write_image(encoder, image->pixels, image->stride)
+               : write_converted_rows(encoder, image);
+    if (status == SUCCESS) status = stream_encoder_finish(encoder);
+
+    stream_encoder_free(encoder);
+    return status;
+}
+
+// Checks the image, builds the headers of the stream and fills in the default settings when 'config' is NULL
+static Codec_Status prepare_encode(const Pixel_Image *image, BMPFILEHEADER *fileHeader, BMPINFOHEADER *infoHeader,
+                                   const Encoder_Config **config, Encoder_Config *defaults) {
+    if (check_image(image) != CODEC_OK) return CODEC_ERROR_ARGUMENT;
+
+    if (!*config) {
+        init_encoder_config(defaults);
+        *config = defaults;
+    }
+    if (check_encoder_config(*config) != SUCCESS) return CODEC_ERROR_ARGUMENT;
+
+    // The block counts are kept in an int
+    if (init_bmp_headers(fileHeader, infoHeader, image->width, image->height) != SUCCESS) return CODEC_ERROR_ARGUMENT;
+    return CODEC_OK;
+}
+
+Codec_Status encode_image_to_memory(const Pixel_Image *image, const Encoder_Config *config, Memory_Buffer *out) {
+    BMPFILEHEADER fileHeader;
+    BMPINFOHEADER infoHeader;
+    Encoder_Config defaults;
+    if (!out) return CODEC_ERROR_ARGUMENT;
+    Codec_Status status = prepare_encode(image, &fileHeader, &infoHeader, &config, &defaults);
+    if (status != CODEC_OK) return status;
+
+    Memory_Sink sink = {out, 0, 0};
+    cookie_io_functions_t functions = {NULL, memory_write, memory_seek, NULL};
+    out->size = 0;
+
+    FILE *stream = fopencookie(&sink, "w", functions);
+    if (!stream) return CODEC_ERROR_MEMORY;
+
+    // The bit writer already hands over large blocks, so they are not copied through a stdio buffer
+    setvbuf(stream, NULL, _IONBF, 0);
+    int result = encode_to_stream(image, &fileHeader, &infoHeader, config, stream);
+    if (fclose(stream) != 0) result = FAILURE;
+
+    if (result == ENCODER_TARGET_MISSED) return CODEC_ERROR_TARGET;
+    return result == SUCCESS ? CODEC_OK : CODEC_ERROR_MEMORY;
+}
+
+Codec_Status encode_image_to_callback(const Pixel_Image *image, const Encoder_Config *config,
+                                      Write_Callback write, void *user) {
+    BMPFILEHEADER fileHeader;
+    BMPINFOHEADER infoHeader;
+    Encoder_Config defaults;
+    if (!write) return CODEC_ERROR_ARGUMENT;
+    Codec_Status status = prepare_encode(image, &fileHeader, &infoHeader, &config, &defaults);
+    if (status != CODEC_OK) return status;
+    if (config->restart_interval > 0) return CODEC_ERROR_ARGUMENT;
+
+    Callback_Sink sink = {write, user, 0, 0};
+    cookie_io_functions_t functions = {NULL, callback_write, callback_seek, NULL};
+
+    FILE *stream = fopencookie(&sink, "w", functions);
+    if (!stream) return CODEC_ERROR_MEMORY;
+
+    setvbuf(stream, NULL, _IONBF, 0);
+    int result = encode_to_stream(image, &fileHeader, &infoHeader, config, stream);
+    if (fclose(stream) != 0) result = FAILURE;
+
+    if (sink.failed) return CODEC_ERROR_IO;
+    if (result == ENCODER_TARGET_MISSED) return CODEC_ERROR_TARGET;
+    return result == SUCCESS ? CODEC_OK : CODEC_ERROR_MEMORY;
+}
+
+Codec_Status read_to_memory(Read_Callback read, void *user, Memory_Buffer *buffer) {
+    if (!read || !buffer) return CODEC_ERROR_ARGUMENT;
+    buffer->size = 0;
+
+    for (;;) {
+        if (buffer->size == buffer->capacity && reserve_memory(buffer, buffer->size + 1) != SUCCESS) {
+            return CODEC_ERROR_MEMORY;
+        }
+
+        size_t got = read(user, buffer->data + buffer->size, buffer->capacity - buffer->size);
+        if (got == (size_t)-1 || got > buffer->capacity - buffer->size) return CODEC_ERROR_IO;
+        if (got == 0) return CODEC_OK;
+        buffer->size += got;
+    }
+}
+
+// Parses the headers of a BIN stream and checks that the streaming decoder can read it
+static Codec_Status parse_stream(const uint8_t *data, size_t size, BMPFILEHEADER *fileHeader,
+                                 BMPINFOHEADER *infoHeader) {
+    if (!data) return CODEC_ERROR_ARGUMENT;
+    if (parse_bmp_headers(data, size, fileHeader, infoHeader) != SUCCESS) return CODEC_ERROR_FORMAT;
+
+    unsigned short flags = fileHeader->bfReserved1;
+    if (flags & ~BIN_KNOWN_FLAGS) return CODEC_ERROR_FORMAT;
+    if (!(flags & BIN_FLAG_STRIPES)) {
+        unsigned short striped_only = BIN_FLAG_RESTART | BIN_FLAG_INDEX | BIN_FLAG_HUFFMAN | BIN_FLAG_QUALITY;
+        return (flags & striped_only) ? CODEC_ERROR_FORMAT : CODEC_ERROR_UNSUPPORTED;
+    }
+    return (flags & BIN_FLAG_CHROMA_420) ? CODEC_OK : CODEC_ERROR_FORMAT;
+}
+
+static int valid_scale(int scale) {
+    return scale == 1 || scale == 2 || scale == 4 || scale == 8;
+}
+
+// Decoded size: the coded size divided by the scale, rounded up (see stream_decoder_output_size())
+static void scaled_size(const BMPINFOHEADER *infoHeader, int scale, int *width, int *height) {
+    *width = (infoHeader->biWidth + scale - 1) / scale;
+    *height = (infoHeader->biHeight + scale - 1) / scale;
+}
+
+Codec_Status read_image_info(const uint8_t *data, size_t size, int scale, int *width, int *height) {
+    if (!width || !height || !valid_scale(scale)) return CODEC_ERROR_ARGUMENT;
+
+    BMPFILEHEADER fileHeader;
+    BMPINFOHEADER infoHeader;
+    Codec_Status status = parse_stream(data, size, &fileHeader, &infoHeader);
+    if (status != CODEC_OK) return status;
+
+    scaled_size(&infoHeader, scale, width, height);
+    return CODEC_OK;
+}
+
+// Other channel orders are decoded a stripe at a time into 'rows' (STRIPE_ROWS BGR rows), then converted
+static int read_converted_rows(Stream_Decoder *decoder, const Pixel_Image *image, uint8_t *rows) {
+    int width = image->width;
+    int bytes = pixel_size(image->order);
+    int blue, red;
+    channel_offsets(image->order, &blue, &red);
+
+    ptrdiff_t row_size = (ptrdiff_t)width * 3;
+    int status = SUCCESS;
+    for (int y = 0; y < image->height && status == SUCCESS; y += STRIPE_ROWS) {
+        int count = image->height - y < STRIPE_ROWS ? image->height - y : STRIPE_ROWS;
+        status = stream_decoder_read_rows_strided(decoder, rows, row_size, count);
+
+        for (int r = 0; r < count && status == SUCCESS; r++) {
+            const uint8_t *src = rows + r * row_size;
+            uint8_t *dst = image->pixels + (ptrdiff_t)(y + r) * image->stride;
+            for (int x = 0; x < width; x++, src += 3, dst += bytes) {
+                dst[blue] = src[0];
+                dst[1] = src[1];
+                dst[red] = src[2];
+                if (bytes == 4) dst[3] = 255;
+            }
+        }
+    }
+
+    return status;
+}
+
+Codec_Status decode_image(const uint8_t *data, size_t size, const Decoder_Config *config, const Pixel_Image *image) {
+    Decoder_Config defaults;
+    if (!config) {
+        init_decoder_config(&defaults);
+        config = &defaults;
+    }
+    if (check_image(image) != CODEC_OK || !valid_scale(config->scale) ||
+        (config->idct_method != DCT_METHOD_MATRIX && config->idct_method != DCT_METHOD_FAST)) {
+        return CODEC_ERROR_ARGUMENT;
+    }
+
+    BMPFILEHEADER fileHeader;
+    BMPINFOHEADER infoHeader;
+    Codec_Status status = parse_stream(data, size, &fileHeader, &infoHeader);
+    if (status != CODEC_OK) return status;
+
+    int width, height;
+    scaled_size(&infoHeader, config->scale, &width, &height);
+    if (image->width != width || image->height != height) return CODEC_ERROR_ARGUMENT;
+
+    // BGR rows are converted in place; other orders go through one stripe of BGR rows
+    uint8_t *rows = NULL;
+    if (image->order != PIXEL_BGR) {
+        rows = malloc((size_t)STRIPE_ROWS * width * 3);
+        if (!rows) return CODEC_ERROR_MEMORY;
+    }
+
+    // The stream was checked above, so a decoder that cannot be created means a bad restart table or index
+    Stream_Decoder *decoder = stream_decoder_create(data, size, &fileHeader, &infoHeader, config);
+    if (!decoder) {
+        free(rows);
+        return CODEC_ERROR_FORMAT;
+    }
+
+    int result = rows ? read_converted_rows(decoder, image, rows)
+                      : stream_decoder_read_rows_strided(decoder, image->pixels, image->stride, height);
+
+    stream_decoder_free(decoder);
+    free(rows);
+    return result == SUCCESS ? CODEC_OK : CODEC_ERROR_FORMAT;
+}
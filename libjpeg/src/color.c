@@ -0,0 +1,352 @@
+#include "color.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define COLOR_X86 1
+#include <immintrin.h>
+#endif
+
+// Forward coefficients (COLOR_SCALE_BITS fraction bits); each Cb/Cr row sums to zero
+#define Y_R   4899
+#define Y_G   9617
+#define Y_B   1868
+#define CB_R -2763
+#define CB_G -5424
+#define CB_B  8187
+#define CR_R  8189
+#define CR_G -6857
+#define CR_B -1332
+
+// Inverse coefficients
+#define R_CR  22970     /* 1.402 */
+#define G_CB  -5636     /* -0.344 */
+#define G_CR -11698     /* -0.714 */
+#define B_CB  29032     /* 1.772 */
+
+#define ONE_HALF (1 << (COLOR_SCALE_BITS - 1))
+
+// Offset that keeps the sums non-negative so '>>' is a floor, as in the SIMD kernels
+#define FLOOR_BIAS (256 << COLOR_SCALE_BITS)
+
+static inline uint8_t clamp_u8(int v) {
+    return (uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+static void rgb_to_ycbcr_scalar(const RGB_Pixel *rgb, uint8_t *Y, uint8_t *Cb, uint8_t *Cr, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        int r = rgb[i].r, g = rgb[i].g, b = rgb[i].b;
+
+        Y[i]  = clamp_u8((Y_R * r + Y_G * g + Y_B * b + ONE_HALF) >> COLOR_SCALE_BITS);
+        Cb[i] = clamp_u8(((CB_R * r + CB_G * g + CB_B * b + ONE_HALF + FLOOR_BIAS) >> COLOR_SCALE_BITS) - 128);
+        Cr[i] = clamp_u8(((CR_R * r + CR_G * g + CR_B * b + ONE_HALF + FLOOR_BIAS) >> COLOR_SCALE_BITS) - 128);
+    }
+}
+
+static void ycbcr_to_rgb_scalar(const uint8_t *Y, const uint8_t *Cb, const uint8_t *Cr, RGB_Pixel *rgb, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        int y = Y[i] << COLOR_SCALE_BITS;
+        int cb = Cb[i] - 128;
+        int cr = Cr[i] - 128;
+
+        rgb[i].r = clamp_u8(((y + R_CR * cr + ONE_HALF + FLOOR_BIAS) >> COLOR_SCALE_BITS) - 256);
+        rgb[i].g = clamp_u8(((y + G_CB * cb + G_CR * cr + ONE_HALF + FLOOR_BIAS) >> COLOR_SCALE_BITS) - 256);
+        rgb[i].b = clamp_u8(((y + B_CB * cb + ONE_HALF + FLOOR_BIAS) >> COLOR_SCALE_BITS) - 256);
+    }
+}
+
+#ifdef COLOR_X86
+
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+// pshufb masks gathering one channel of 16 packed BGR pixels: [channel][source 16-byte chunk]
+static const int8_t deinterleave_mask[3][3][16] = {
+    {{   0,    3,    6,    9,   12,   15, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128},
+     {-128, -128, -128, -128, -128, -128,    2,    5,    8,   11,   14, -128, -128, -128, -128, -128},
+     {-128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128,    1,    4,    7,   10,   13}},
+    {{   1,    4,    7,   10,   13, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128},
+     {-128, -128, -128, -128, -128,    0,    3,    6,    9,   12,   15, -128, -128, -128, -128, -128},
+     {-128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128,    2,    5,    8,   11,   14}},
+    {{   2,    5,    8,   11,   14, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128},
+     {-128, -128, -128, -128, -128,    1,    4,    7,   10,   13, -128, -128, -128, -128, -128, -128},
+     {-128, -128, -128, -128, -128, -128, -128, -128, -128, -128,    0,    3,    6,    9,   12,   15}}
+};
+
+// pshufb masks scattering each channel into packed BGR: [destination 16-byte chunk][channel]
+static const int8_t interleave_mask[3][3][16] = {
+    {{   0, -128, -128,    1, -128, -128,    2, -128, -128,    3, -128, -128,    4, -128, -128,    5},
+     {-128,    0, -128, -128,    1, -128, -128,    2, -128, -128,    3, -128, -128,    4, -128, -128},
+     {-128, -128,    0, -128, -128,    1, -128, -128,    2, -128, -128,    3, -128, -128,    4, -128}},
+    {{-128, -128,    6, -128, -128,    7, -128, -128,    8, -128, -128,    9, -128, -128,   10, -128},
+     {   5, -128, -128,    6, -128, -128,    7, -128, -128,    8, -128, -128,    9, -128, -128,   10},
+     {-128,    5, -128, -128,    6, -128, -128,    7, -128, -128,    8, -128, -128,    9, -128, -128}},
+    {{-128,   11, -128, -128,   12, -128, -128,   13, -128, -128,   14, -128, -128,   15, -128, -128},
+     {-128, -128,   11, -128, -128,   12, -128, -128,   13, -128, -128,   14, -128, -128,   15, -128},
+     {  10, -128, -128,   11, -128, -128,   12, -128, -128,   13, -128, -128,   14, -128, -128,   15}}
+};
+
+// Packs two 16-bit coefficients into the 32-bit pattern expected by pmaddwd
+#define PAIR(lo, hi) ((int32_t)(((uint32_t)(uint16_t)(hi) << 16) | (uint16_t)(lo)))
+
+/* ---- 128-bit kernels ---- */
+
+static inline TARGET_SSSE3 __m128i sse_load_mask(const int8_t mask[16]) {
+    return _mm_loadu_si128((const __m128i *)mask);
+}
+
+// (a * ka + b * kb + c * kc + ONE_HALF) >> COLOR_SCALE_BITS on 8 int16 lanes, plus 'offset'
+static inline TARGET_SSSE3 __m128i sse_weighted_sum(__m128i a, __m128i b, __m128i c, int16_t ka, int16_t kb,
+                                                    int16_t kc, __m128i offset) {
+    const __m128i one = _mm_set1_epi16(1);
+    __m128i k_ab = _mm_set1_epi32(PAIR(ka, kb));
+    __m128i k_c1 = _mm_set1_epi32(PAIR(kc, ONE_HALF));
+
+    __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(a, b), k_ab),
+                               _mm_madd_epi16(_mm_unpacklo_epi16(c, one), k_c1));
+    __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(a, b), k_ab),
+                               _mm_madd_epi16(_mm_unpackhi_epi16(c, one), k_c1));
+
+    lo = _mm_srai_epi32(lo, COLOR_SCALE_BITS);
+    hi = _mm_srai_epi32(hi, COLOR_SCALE_BITS);
+    return _mm_adds_epi16(_mm_packs_epi32(lo, hi), offset);
+}
+
+// Same weighted sum on 16 unsigned bytes, saturated back to bytes
+static inline TARGET_SSSE3 __m128i sse_weighted_u8(__m128i a, __m128i b, __m128i c, int16_t ka, int16_t kb,
+                                                   int16_t kc, __m128i offset) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lo = sse_weighted_sum(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero),
+                                  _mm_unpacklo_epi8(c, zero), ka, kb, kc, offset);
+    __m128i hi = sse_weighted_sum(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero),
+                                  _mm_unpackhi_epi8(c, zero), ka, kb, kc, offset);
+    return _mm_packus_epi16(lo, hi);
+}
+
+static inline TARGET_SSSE3 __m128i sse_gather_channel(__m128i v0, __m128i v1, __m128i v2, int channel) {
+    return _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v0, sse_load_mask(deinterleave_mask[channel][0])),
+                                     _mm_shuffle_epi8(v1, sse_load_mask(deinterleave_mask[channel][1]))),
+                        _mm_shuffle_epi8(v2, sse_load_mask(deinterleave_mask[channel][2])));
+}
+
+static inline TARGET_SSSE3 __m128i sse_scatter_chunk(__m128i b, __m128i g, __m128i r, int chunk) {
+    return _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(b, sse_load_mask(interleave_mask[chunk][0])),
+                                     _mm_shuffle_epi8(g, sse_load_mask(interleave_mask[chunk][1]))),
+                        _mm_shuffle_epi8(r, sse_load_mask(interleave_mask[chunk][2])));
+}
+
+static TARGET_SSSE3 void rgb_to_ycbcr_ssse3(const RGB_Pixel *rgb, uint8_t *Y, uint8_t *Cb, uint8_t *Cr, size_t count) {
+    const __m128i no_offset = _mm_setzero_si128();
+    const __m128i chroma_offset = _mm_set1_epi16(128);
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        const uint8_t *src = (const uint8_t *)(rgb + i);
+        __m128i v0 = _mm_loadu_si128((const __m128i *)src);
+        __m128i v1 = _mm_loadu_si128((const __m128i *)(src + 16));
+        __m128i v2 = _mm_loadu_si128((const __m128i *)(src + 32));
+
+        __m128i b = sse_gather_channel(v0, v1, v2, 0);
+        __m128i g = sse_gather_channel(v0, v1, v2, 1);
+        __m128i r = sse_gather_channel(v0, v1, v2, 2);
+
+        _mm_storeu_si128((__m128i *)(Y + i), sse_weighted_u8(r, g, b, Y_R, Y_G, Y_B, no_offset));
+        _mm_storeu_si128((__m128i *)(Cb + i), sse_weighted_u8(r, g, b, CB_R, CB_G, CB_B, chroma_offset));
+        _mm_storeu_si128((__m128i *)(Cr + i), sse_weighted_u8(r, g, b, CR_R, CR_G, CR_B, chroma_offset));
+    }
+
+    rgb_to_ycbcr_scalar(rgb + i, Y + i, Cb + i, Cr + i, count - i);
+}
+
+static TARGET_SSSE3 void ycbcr_to_rgb_ssse3(const uint8_t *Y, const uint8_t *Cb, const uint8_t *Cr, RGB_Pixel *rgb, size_t count) {
+    const __m128i no_offset = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi8((char)0x80);
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        __m128i y = _mm_loadu_si128((const __m128i *)(Y + i));
+        // Centered chroma as signed bytes, sign-extended to 16 bits below
+        __m128i cb = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(Cb + i)), bias);
+        __m128i cr = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(Cr + i)), bias);
+
+        __m128i y_lo = _mm_unpacklo_epi8(y, _mm_setzero_si128());
+        __m128i y_hi = _mm_unpackhi_epi8(y, _mm_setzero_si128());
+        __m128i cb_lo = _mm_srai_epi16(_mm_unpacklo_epi8(cb, cb), 8);
+        __m128i cb_hi = _mm_srai_epi16(_mm_unpackhi_epi8(cb, cb), 8);
+        __m128i cr_lo = _mm_srai_epi16(_mm_unpacklo_epi8(cr, cr), 8);
+        __m128i cr_hi = _mm_srai_epi16(_mm_unpackhi_epi8(cr, cr), 8);
+
+        const int16_t unit = 1 << COLOR_SCALE_BITS;
+        const __m128i zero = _mm_setzero_si128();
+        __m128i r = _mm_packus_epi16(sse_weighted_sum(y_lo, cr_lo, zero, unit, R_CR, 0, no_offset),
+                                     sse_weighted_sum(y_hi, cr_hi, zero, unit, R_CR, 0, no_offset));
+        __m128i g = _mm_packus_epi16(sse_weighted_sum(y_lo, cb_lo, cr_lo, unit, G_CB, G_CR, no_offset),
+                                     sse_weighted_sum(y_hi, cb_hi, cr_hi, unit, G_CB, G_CR, no_offset));
+        __m128i b = _mm_packus_epi16(sse_weighted_sum(y_lo, cb_lo, zero, unit, B_CB, 0, no_offset),
+                                     sse_weighted_sum(y_hi, cb_hi, zero, unit, B_CB, 0, no_offset));
+
+        uint8_t *dst = (uint8_t *)(rgb + i);
+        _mm_storeu_si128((__m128i *)dst, sse_scatter_chunk(b, g, r, 0));
+        _mm_storeu_si128((__m128i *)(dst + 16), sse_scatter_chunk(b, g, r, 1));
+        _mm_storeu_si128((__m128i *)(dst + 32), sse_scatter_chunk(b, g, r, 2));
+    }
+
+    ycbcr_to_rgb_scalar(Y + i, Cb + i, Cr + i, rgb + i, count - i);
+}
+
+/* ---- 256-bit kernels: two groups of 16 pixels, one per 128-bit lane ---- */
+
+static inline TARGET_AVX2 __m256i avx_load_mask(const int8_t mask[16]) {
+    return _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)mask));
+}
+
+static inline TARGET_AVX2 __m256i avx_load_lanes(const uint8_t *lane0, const uint8_t *lane1) {
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)lane0)),
+                                   _mm_loadu_si128((const __m128i *)lane1), 1);
+}
+
+static inline TARGET_AVX2 void avx_store_lanes(uint8_t *lane0, uint8_t *lane1, __m256i v) {
+    _mm_storeu_si128((__m128i *)lane0, _mm256_castsi256_si128(v));
+    _mm_storeu_si128((__m128i *)lane1, _mm256_extracti128_si256(v, 1));
+}
+
+static inline TARGET_AVX2 __m256i avx_weighted_sum(__m256i a, __m256i b, __m256i c, int16_t ka, int16_t kb,
+                                                   int16_t kc, __m256i offset) {
+    const __m256i one = _mm256_set1_epi16(1);
+    __m256i k_ab = _mm256_set1_epi32(PAIR(ka, kb));
+    __m256i k_c1 = _mm256_set1_epi32(PAIR(kc, ONE_HALF));
+
+    __m256i lo = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), k_ab),
+                                  _mm256_madd_epi16(_mm256_unpacklo_epi16(c, one), k_c1));
+    __m256i hi = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), k_ab),
+                                  _mm256_madd_epi16(_mm256_unpackhi_epi16(c, one), k_c1));
+
+    lo = _mm256_srai_epi32(lo, COLOR_SCALE_BITS);
+    hi = _mm256_srai_epi32(hi, COLOR_SCALE_BITS);
+    return _mm256_adds_epi16(_mm256_packs_epi32(lo, hi), offset);
+}
+
+static inline TARGET_AVX2 __m256i avx_weighted_u8(__m256i a, __m256i b, __m256i c, int16_t ka, int16_t kb,
+                                                  int16_t kc, __m256i offset) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i lo = avx_weighted_sum(_mm256_unpacklo_epi8(a, zero), _mm256_unpacklo_epi8(b, zero),
+                                  _mm256_unpacklo_epi8(c, zero), ka, kb, kc, offset);
+    __m256i hi = avx_weighted_sum(_mm256_unpackhi_epi8(a, zero), _mm256_unpackhi_epi8(b, zero),
+                                  _mm256_unpackhi_epi8(c, zero), ka, kb, kc, offset);
+    return _mm256_packus_epi16(lo, hi);
+}
+
+static inline TARGET_AVX2 __m256i avx_gather_channel(__m256i v0, __m256i v1, __m256i v2, int channel) {
+    return _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(v0, avx_load_mask(deinterleave_mask[channel][0])),
+                                           _mm256_shuffle_epi8(v1, avx_load_mask(deinterleave_mask[channel][1]))),
+                           _mm256_shuffle_epi8(v2, avx_load_mask(deinterleave_mask[channel][2])));
+}
+
+static inline TARGET_AVX2 __m256i avx_scatter_chunk(__m256i b, __m256i g, __m256i r, int chunk) {
+    return _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(b, avx_load_mask(interleave_mask[chunk][0])),
+                                           _mm256_shuffle_epi8(g, avx_load_mask(interleave_mask[chunk][1]))),
+                           _mm256_shuffle_epi8(r, avx_load_mask(interleave_mask[chunk][2])));
+}
+
+static TARGET_AVX2 void rgb_to_ycbcr_avx2(const RGB_Pixel *rgb, uint8_t *Y, uint8_t *Cb, uint8_t *Cr, size_t count) {
+    const __m256i no_offset = _mm256_setzero_si256();
+    const __m256i chroma_offset = _mm256_set1_epi16(128);
+    size_t i = 0;
+
+    for (; i + 32 <= count; i += 32) {
+        const uint8_t *src = (const uint8_t *)(rgb + i);
+        __m256i v0 = avx_load_lanes(src, src + 48);
+        __m256i v1 = avx_load_lanes(src + 16, src + 64);
+        __m256i v2 = avx_load_lanes(src + 32, src + 80);
+
+        __m256i b = avx_gather_channel(v0, v1, v2, 0);
+        __m256i g = avx_gather_channel(v0, v1, v2, 1);
+        __m256i r = avx_gather_channel(v0, v1, v2, 2);
+
+        _mm256_storeu_si256((__m256i *)(Y + i), avx_weighted_u8(r, g, b, Y_R, Y_G, Y_B, no_offset));
+        _mm256_storeu_si256((__m256i *)(Cb + i), avx_weighted_u8(r, g, b, CB_R, CB_G, CB_B, chroma_offset));
+        _mm256_storeu_si256((__m256i *)(Cr + i), avx_weighted_u8(r, g, b, CR_R, CR_G, CR_B, chroma_offset));
+    }
+
+    rgb_to_ycbcr_scalar(rgb + i, Y + i, Cb + i, Cr + i, count - i);
+}
+
+static TARGET_AVX2 void ycbcr_to_rgb_avx2(const uint8_t *Y, const uint8_t *Cb, const uint8_t *Cr, RGB_Pixel *rgb, size_t count) {
+    const __m256i no_offset = _mm256_setzero_si256();
+    const __m256i bias = _mm256_set1_epi8((char)0x80);
+    const __m256i zero = _mm256_setzero_si256();
+    const int16_t unit = 1 << COLOR_SCALE_BITS;
+    size_t i = 0;
+
+    for (; i + 32 <= count; i += 32) {
+        __m256i y = _mm256_loadu_si256((const __m256i *)(Y + i));
+        __m256i cb = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(Cb + i)), bias);
+        __m256i cr = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(Cr + i)), bias);
+
+        __m256i y_lo = _mm256_unpacklo_epi8(y, zero);
+        __m256i y_hi = _mm256_unpackhi_epi8(y, zero);
+        __m256i cb_lo = _mm256_srai_epi16(_mm256_unpacklo_epi8(cb, cb), 8);
+        __m256i cb_hi = _mm256_srai_epi16(_mm256_unpackhi_epi8(cb, cb), 8);
+        __m256i cr_lo = _mm256_srai_epi16(_mm256_unpacklo_epi8(cr, cr), 8);
+        __m256i cr_hi = _mm256_srai_epi16(_mm256_unpackhi_epi8(cr, cr), 8);
+
+        __m256i r = _mm256_packus_epi16(avx_weighted_sum(y_lo, cr_lo, zero, unit, R_CR, 0, no_offset),
+                                        avx_weighted_sum(y_hi, cr_hi, zero, unit, R_CR, 0, no_offset));
+        __m256i g = _mm256_packus_epi16(avx_weighted_sum(y_lo, cb_lo, cr_lo, unit, G_CB, G_CR, no_offset),
+                                        avx_weighted_sum(y_hi, cb_hi, cr_hi, unit, G_CB, G_CR, no_offset));
+        __m256i b = _mm256_packus_epi16(avx_weighted_sum(y_lo, cb_lo, zero, unit, B_CB, 0, no_offset),
+                                        avx_weighted_sum(y_hi, cb_hi, zero, unit, B_CB, 0, no_offset));
+
+        // Pixels of the first lane go to bytes 0-47, those of the second lane to bytes 48-95
+        uint8_t *dst = (uint8_t *)(rgb + i);
+        avx_store_lanes(dst, dst + 48, avx_scatter_chunk(b, g, r, 0));
+        avx_store_lanes(dst + 16, dst + 64, avx_scatter_chunk(b, g, r, 1));
+        avx_store_lanes(dst + 32, dst + 80, avx_scatter_chunk(b, g, r, 2));
+    }
+
+    ycbcr_to_rgb_scalar(Y + i, Cb + i, Cr + i, rgb + i, count - i);
+}
+
+#endif /* COLOR_X86 */
+
+Color_Kernel detect_color_kernel(void) {
+#ifdef COLOR_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return COLOR_KERNEL_AVX2;
+    if (__builtin_cpu_supports("ssse3")) return COLOR_KERNEL_SSSE3;
+#endif
+    return COLOR_KERNEL_SCALAR;
+}
+
+const char *color_kernel_name(Color_Kernel kernel) {
+    switch (kernel) {
+        case COLOR_KERNEL_SCALAR: return "scalar";
+        case COLOR_KERNEL_SSSE3: return "ssse3";
+        case COLOR_KERNEL_AVX2: return "avx2";
+        default: return "auto";
+    }
+}
+
+void rgb_to_ycbcr_planes(const RGB_Pixel *rgb, uint8_t *Y, uint8_t *Cb, uint8_t *Cr,
+                         size_t count, Color_Kernel kernel) {
+    if (kernel == COLOR_KERNEL_AUTO) kernel = detect_color_kernel();
+
+    switch (kernel) {
+#ifdef COLOR_X86
+        case COLOR_KERNEL_AVX2: rgb_to_ycbcr_avx2(rgb, Y, Cb, Cr, count); break;
+        case COLOR_KERNEL_SSSE3: rgb_to_ycbcr_ssse3(rgb, Y, Cb, Cr, count); break;
+#endif
+        default: rgb_to_ycbcr_scalar(rgb, Y, Cb, Cr, count); break;
+    }
+}
+
+void ycbcr_planes_to_rgb(const uint8_t *Y, const uint8_t *Cb, const uint8_t *Cr, RGB_Pixel *rgb,
+                         size_t count, Color_Kernel kernel) {
+    if (kernel == COLOR_KERNEL_AUTO) kernel = detect_color_kernel();
+
+    switch (kernel) {
+#ifdef COLOR_X86
+        case COLOR_KERNEL_AVX2: ycbcr_to_rgb_avx2(Y, Cb, Cr, rgb, count); break;
+        case COLOR_KERNEL_SSSE3: ycbcr_to_rgb_ssse3(Y, Cb, Cr, rgb, count); break;
+#endif
+        default: ycbcr_to_rgb_scalar(Y, Cb, Cr, rgb, count); break;
+    }
+}
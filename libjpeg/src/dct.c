@@ -0,0 +1,423 @@
+#include "dct.h"
+#include "img_functions.h"
+
+// Fixed-point precision of the AAN constants and extra precision kept on the input samples
+#define CONST_BITS 13
+#define PASS1_BITS 2
+
+#define FIX(x) ((int32_t)((x) * (1 << CONST_BITS) + 0.5))
+#define MULTIPLY(v, c) (((v) * (c) + (1 << (CONST_BITS - 1))) >> CONST_BITS)
+
+#define FIX_0_382683433 FIX(0.382683433)
+#define FIX_0_541196100 FIX(0.541196100)
+#define FIX_0_707106781 FIX(0.707106781)
+#define FIX_1_306562965 FIX(1.306562965)
+
+// AAN output scale factors: cos(k * PI / 16) * sqrt(2) for k > 0, 1 for k = 0
+static const double aan_scale[BLOCK_SIZE] = {
+    1.0, 1.387039845, 1.306562965, 1.175875602,
+    1.0, 0.785694958, 0.541196100, 0.275899379
+};
+
+void init_quant_table(Quant_Table *table, const uint8_t matrix[BLOCK_SIZE][BLOCK_SIZE]) {
+    memcpy(table->matrix, matrix, sizeof(table->matrix));
+
+    for (int k = 0; k < BLOCK_SIZE * BLOCK_SIZE; k++) {
+        int i = zigzag_order[k] / BLOCK_SIZE;
+        int j = zigzag_order[k] % BLOCK_SIZE;
+        table->divisor[k] = matrix[i][j];
+
+        // The fast FDCT output is 8 * 2^PASS1_BITS * aan[i] * aan[j] times the orthonormal DCT
+        double divisor = matrix[i][j] * aan_scale[i] * aan_scale[j] * 8.0 * (1 << PASS1_BITS);
+        table->fdct_reciprocal[k] = (int32_t)((1 << FDCT_RECIPROCAL_BITS) / divisor + 0.5);
+
+        // The fast IDCT expects its input premultiplied by aan[i] * aan[j] / 8
+        double multiplier = matrix[i][j] * aan_scale[i] * aan_scale[j] / 8.0;
+        table->idct_multiplier[k] = (int32_t)(multiplier * (1 << IDCT_SCALE_BITS) + 0.5);
+    }
+}
+
+void scale_quant_matrix(const uint8_t matrix[BLOCK_SIZE][BLOCK_SIZE], int quality,
+                        uint8_t scaled[BLOCK_SIZE][BLOCK_SIZE]) {
+    int percent = quality < 50 ? 5000 / quality : 200 - 2 * quality;
+
+    for (int i = 0; i < BLOCK_SIZE; i++) {
+        for (int j = 0; j < BLOCK_SIZE; j++) {
+            int value = (matrix[i][j] * percent + 50) / 100;
+            scaled[i][j] = (uint8_t)(value < 3 ? 3 : (value > 255 ? 255 : value));
+        }
+    }
+}
+
+// Quantization tables of the luma and chroma matrices scaled to a quality
+static void init_scaled_tables(Quant_Table *lumin, Quant_Table *chrom, int quality) {
+    uint8_t matrix[BLOCK_SIZE][BLOCK_SIZE];
+
+    scale_quant_matrix(lumin_matrix, quality, matrix);
+    init_quant_table(lumin, (const uint8_t (*)[BLOCK_SIZE])matrix);
+    scale_quant_matrix(chrom_matrix, quality, matrix);
+    init_quant_table(chrom, (const uint8_t (*)[BLOCK_SIZE])matrix);
+}
+
+void init_fdct_engine(FDCT_Engine *engine, DCT_Method method, int quality) {
+    engine->method = method;
+    engine->transform = (method == DCT_METHOD_FAST) ? fdct_quantize_fast : fdct_quantize_matrix;
+    engine->quant_kernel = detect_quant_kernel();
+    transpose((double (*)[BLOCK_SIZE])C, engine->Ct); // Ct = C^T
+    init_scaled_tables(&engine->lumin, &engine->chrom, quality);
+}
+
+void fdct_quantize_matrix(const FDCT_Engine *engine, const int16_t block[BLOCK_SIZE][BLOCK_SIZE],
+                          const Quant_Table *table, int16_t coef[BLOCK_SIZE * BLOCK_SIZE]) {
+    double samples[BLOCK_SIZE][BLOCK_SIZE];
+    double dct[BLOCK_SIZE][BLOCK_SIZE];
+
+    for (int i = 0; i < BLOCK_SIZE; i++) {
+        for (int j = 0; j < BLOCK_SIZE; j++) samples[i][j] = block[i][j];
+    }
+    apply_matrix_dct(samples, dct, (double (*)[BLOCK_SIZE])engine->Ct);
+    for (int k = 0; k < BLOCK_SIZE * BLOCK_SIZE; k++) {
+        int pos = zigzag_order[k];
+        coef[k] = (int16_t)round(dct[pos / BLOCK_SIZE][pos % BLOCK_SIZE] / table->divisor[k]);
+    }
+}
+
+/**
+ * 1-D AAN forward DCT on 8 values spaced by 'stride'.
+ * Output k is scaled by sqrt(8) * aan_scale[k] relative to the orthonormal 1-D DCT.
+ */
+static inline void fdct_1d(int32_t *d, int stride) {
+    int32_t tmp0 = d[0 * stride] + d[7 * stride];
+    int32_t tmp7 = d[0 * stride] - d[7 * stride];
+    int32_t tmp1 = d[1 * stride] + d[6 * stride];
+    int32_t tmp6 = d[1 * stride] - d[6 * stride];
+    int32_t tmp2 = d[2 * stride] + d[5 * stride];
+    int32_t tmp5 = d[2 * stride] - d[5 * stride];
+    int32_t tmp3 = d[3 * stride] + d[4 * stride];
+    int32_t tmp4 = d[3 * stride] - d[4 * stride];
+
+    // Even part
+    int32_t tmp10 = tmp0 + tmp3;
+    int32_t tmp13 = tmp0 - tmp3;
+    int32_t tmp11 = tmp1 + tmp2;
+    int32_t tmp12 = tmp1 - tmp2;
+
+    d[0 * stride] = tmp10 + tmp11;
+    d[4 * stride] = tmp10 - tmp11;
+
+    int32_t z1 = MULTIPLY(tmp12 + tmp13, FIX_0_707106781);
+    d[2 * stride] = tmp13 + z1;
+    d[6 * stride] = tmp13 - z1;
+
+    // Odd part
+    tmp10 = tmp4 + tmp5;
+    tmp11 = tmp5 + tmp6;
+    tmp12 = tmp6 + tmp7;
+
+    int32_t z5 = MULTIPLY(tmp10 - tmp12, FIX_0_382683433);
+    int32_t z2 = MULTIPLY(tmp10, FIX_0_541196100) + z5;
+    int32_t z4 = MULTIPLY(tmp12, FIX_1_306562965) + z5;
+    int32_t z3 = MULTIPLY(tmp11, FIX_0_707106781);
+
+    int32_t z11 = tmp7 + z3;
+    int32_t z13 = tmp7 - z3;
+
+    d[5 * stride] = z13 + z2;
+    d[3 * stride] = z13 - z2;
+    d[1 * stride] = z11 + z4;
+    d[7 * stride] = z11 - z4;
+}
+
+void fdct_quantize_fast(const FDCT_Engine *engine, const int16_t block[BLOCK_SIZE][BLOCK_SIZE],
+                        const Quant_Table *table, int16_t coef[BLOCK_SIZE * BLOCK_SIZE]) {
+    int32_t data[BLOCK_SIZE * BLOCK_SIZE];
+
+    for (int i = 0; i < BLOCK_SIZE; i++) {
+        for (int j = 0; j < BLOCK_SIZE; j++) data[i * BLOCK_SIZE + j] = block[i][j] * (1 << PASS1_BITS);
+    }
+
+    for (int i = 0; i < BLOCK_SIZE; i++) fdct_1d(&data[i * BLOCK_SIZE], 1);  // Rows
+    for (int j = 0; j < BLOCK_SIZE; j++) fdct_1d(&data[j], BLOCK_SIZE);      // Columns
+
+    quantize_zigzag(data, table->fdct_reciprocal, coef, engine->quant_kernel);
+}
+
+void init_idct_engine(IDCT_Engine *engine, DCT_Method method, int quality) {
+    engine->method = method;
+    transpose((double (*)[BLOCK_SIZE])C, engine->Ct); // Ct = C^T
+    init_scaled_tables(&engine->lumin, &engine->chrom, quality);
+    memset(&engine->stats, 0, sizeof(engine->stats));
+}
+
+// IDCT constants (CONST_BITS fraction bits)
+#define FIX_1_082392200 FIX(1.082392200)
+#define FIX_1_414213562 FIX(1.414213562)
+#define FIX_1_847759065 FIX(1.847759065)
+#define FIX_2_613125930 FIX(2.613125930)
+
+// Same as MULTIPLY, with a 64-bit product for the wider IDCT intermediates
+#define MULTIPLY64(v, c) ((int32_t)(((int64_t)(v) * (c) + (1 << (CONST_BITS - 1))) >> CONST_BITS))
+
+// Orthonormal 1-D DCT basis c(u, x) for the low frequencies u < 4 (CONST_BITS fraction bits)
+static const int32_t idct_basis[4][BLOCK_SIZE] = {
+    { 2896,  2896,  2896,  2896,  2896,  2896,  2896,  2896},
+    { 4017,  3406,  2276,   799,  -799, -2276, -3406, -4017},
+    { 3784,  1567, -1567, -3784, -3784, -1567,  1567,  3784},
+    { 3406,  -799, -4017, -2276,  2276,  4017,   799, -3406}
+};
+
+// Rounds v / 2^bits half away from zero
+static inline int descale(int64_t v, int bits) {
+    int64_t half = (int64_t)1 << (bits - 1);
+    return (v < 0) ? -(int)((-v + half) >> bits) : (int)((v + half) >> bits);
+}
+
+/**
+ * 1-D AAN inverse DCT on 8 values spaced by 'stride'.
+ * Inputs must be premultiplied by the AAN scale factors (see idct_multiplier).
+ */
+static inline void idct_1d(int32_t *d, int stride) {
+    // Even part
+    int32_t tmp0 = d[0 * stride];
+    int32_t tmp1 = d[2 * stride];
+    int32_t tmp2 = d[4 * stride];
+    int32_t tmp3 = d[6 * stride];
+
+    int32_t tmp10 = tmp0 + tmp2;
+    int32_t tmp11 = tmp0 - tmp2;
+    int32_t tmp13 = tmp1 + tmp3;
+    int32_t tmp12 = MULTIPLY64(tmp1 - tmp3, FIX_1_414213562) - tmp13;
+
+    tmp0 = tmp10 + tmp13;
+    tmp3 = tmp10 - tmp13;
+    tmp1 = tmp11 + tmp12;
+    tmp2 = tmp11 - tmp12;
+
+    // Odd part
+    int32_t z13 = d[5 * stride] + d[3 * stride];
+    int32_t z10 = d[5 * stride] - d[3 * stride];
+    int32_t z11 = d[1 * stride] + d[7 * stride];
+    int32_t z12 = d[1 * stride] - d[7 * stride];
+
+    int32_t tmp7 = z11 + z13;
+    tmp11 = MULTIPLY64(z11 - z13, FIX_1_414213562);
+
+    int32_t z5 = MULTIPLY64(z10 + z12, FIX_1_847759065);
+    tmp10 = MULTIPLY64(z12, FIX_1_082392200) - z5;
+    tmp12 = z5 - MULTIPLY64(z10, FIX_2_613125930);
+
+    int32_t tmp6 = tmp12 - tmp7;
+    int32_t tmp5 = tmp11 - tmp6;
+    int32_t tmp4 = tmp10 + tmp5;
+
+    d[0 * stride] = tmp0 + tmp7;
+    d[7 * stride] = tmp0 - tmp7;
+    d[1 * stride] = tmp1 + tmp6;
+    d[6 * stride] = tmp1 - tmp6;
+    d[2 * stride] = tmp2 + tmp5;
+    d[5 * stride] = tmp2 - tmp5;
+    d[4 * stride] = tmp3 + tmp4;
+    d[3 * stride] = tmp3 - tmp4;
+}
+
+// Full fixed-point AAN IDCT with dequantization folded into the input scaling
+static void idct_full(const int16_t coef[BLOCK_SIZE * BLOCK_SIZE], int last, const Quant_Table *table,
+                      int32_t block[BLOCK_SIZE][BLOCK_SIZE]) {
+    int32_t data[BLOCK_SIZE * BLOCK_SIZE];
+
+    dequantize_unzigzag(coef, last, table->idct_multiplier, data);
+
+    for (int j = 0; j < BLOCK_SIZE; j++) idct_1d(&data[j], BLOCK_SIZE);      // Columns
+    for (int i = 0; i < BLOCK_SIZE; i++) idct_1d(&data[i * BLOCK_SIZE], 1);  // Rows
+
+    for (int i = 0; i < BLOCK_SIZE; i++) {
+        for (int j = 0; j < BLOCK_SIZE; j++) {
+            block[i][j] = descale(data[i * BLOCK_SIZE + j], IDCT_SCALE_BITS);
+        }
+    }
+}
+
+// Fraction bits kept between the two passes of the low-frequency kernels
+#define LOW_PASS1_BITS 4
+
+// IDCT of a block whose non-zero coefficients all lie in the top-left n x n corner.
+// Only n columns carry data in the first pass and each row has n inputs in the second.
+static inline void idct_low(const int16_t coef[BLOCK_SIZE * BLOCK_SIZE], int last, const int n,
+                            const Quant_Table *table, int32_t block[BLOCK_SIZE][BLOCK_SIZE]) {
+    int32_t in[4][4] = {{0}};
+    int32_t tmp[4][BLOCK_SIZE];
+
+    for (int k = 0; k <= last; k++) {
+        int pos = zigzag_order[k];
+        in[pos / BLOCK_SIZE][pos % BLOCK_SIZE] = coef[k] * table->divisor[k];
+    }
+
+    // Along the second index: tmp[u][y] = sum_v in[u][v] * c(v, y)
+    for (int u = 0; u < n; u++) {
+        for (int y = 0; y < BLOCK_SIZE; y++) {
+            int32_t acc = 0;
+            for (int v = 0; v < n; v++) acc += in[u][v] * idct_basis[v][y];
+            tmp[u][y] = (acc + (1 << (CONST_BITS - LOW_PASS1_BITS - 1))) >> (CONST_BITS - LOW_PASS1_BITS);
+        }
+    }
+
+    // Along the first index: block[x][y] = sum_u c(u, x) * tmp[u][y]
+    for (int x = 0; x < BLOCK_SIZE; x++) {
+        for (int y = 0; y < BLOCK_SIZE; y++) {
+            int32_t acc = 0;
+            for (int u = 0; u < n; u++) acc += idct_basis[u][x] * tmp[u][y];
+            block[x][y] = (acc + (1 << (CONST_BITS + LOW_PASS1_BITS - 1))) >> (CONST_BITS + LOW_PASS1_BITS);
+        }
+    }
+}
+
+void idct_block(IDCT_Engine *engine, const int16_t coef[BLOCK_SIZE * BLOCK_SIZE], int last,
+                const Quant_Table *table, int32_t block[BLOCK_SIZE][BLOCK_SIZE]) {
+    if (engine->method == DCT_METHOD_MATRIX) {
+        int32_t data[BLOCK_SIZE * BLOCK_SIZE];
+        double dct[BLOCK_SIZE][BLOCK_SIZE];
+        double samples[BLOCK_SIZE][BLOCK_SIZE];
+
+        dequantize_unzigzag(coef, last, table->divisor, data);
+        for (int k = 0; k < BLOCK_SIZE * BLOCK_SIZE; k++) dct[k / BLOCK_SIZE][k % BLOCK_SIZE] = data[k];
+        apply_matrix_idct(dct, samples, engine->Ct);
+
+        // Rounded half up, so that adding the integer level shift afterwards rounds the same way
+        for (int i = 0; i < BLOCK_SIZE; i++) {
+            for (int j = 0; j < BLOCK_SIZE; j++) block[i][j] = (int32_t)floor(samples[i][j] + 0.5);
+        }
+        engine->stats.full++;
+        return;
+    }
+
+    // Zigzag positions 1-2 lie in the 2x2 corner and 3-9 in the 4x4 corner
+    if (last == 0) {
+        int32_t value = descale((int64_t)coef[0] * table->divisor[0], 3); // DC / 8
+        for (int i = 0; i < BLOCK_SIZE; i++) {
+            for (int j = 0; j < BLOCK_SIZE; j++) block[i][j] = value;
+        }
+        engine->stats.dc_only++;
+    } else if (last <= 2) {
+        idct_low(coef, last, 2, table, block);
+        engine->stats.low_2x2++;
+    } else if (last <= 9) {
+        idct_low(coef, last, 4, table, block);
+        engine->stats.low_4x4++;
+    } else {
+        idct_full(coef, last, table, block);
+        engine->stats.full++;
+    }
+}
+
+// Scaled 'size'-point DCT bases c(u, x) for the reduced IDCT: sqrt(1/8) for u = 0,
+// cos((2x + 1) u PI / (2 size)) / 2 otherwise (CONST_BITS fraction bits)
+static const int32_t reduced_basis_2[2][2] = {
+    {2896,  2896},
+    {2896, -2896}
+};
+
+static const int32_t reduced_basis_4[4][4] = {
+    {2896,  2896,  2896,  2896},
+    {3784,  1567, -1567, -3784},
+    {2896, -2896, -2896,  2896},
+    {1567, -3784,  3784, -1567}
+};
+
+void idct_block_reduced(IDCT_Engine *engine, const int16_t coef[BLOCK_SIZE * BLOCK_SIZE], int last,
+                        const Quant_Table *table, int size, int32_t block[BLOCK_SIZE][BLOCK_SIZE]) {
+    if (size == 1) {
+        block[0][0] = descale((int64_t)coef[0] * table->divisor[0], 3); // DC / 8
+        engine->stats.dc_only++;
+        return;
+    }
+
+    const int32_t *basis = (size == 2) ? &reduced_basis_2[0][0] : &reduced_basis_4[0][0];
+    int32_t in[4][4] = {{0}};
+    int32_t tmp[4][4];
+
+    // Coefficients outside the corner are dropped
+    for (int k = 0; k <= last; k++) {
+        int pos = zigzag_order[k];
+        int u = pos / BLOCK_SIZE;
+        int v = pos % BLOCK_SIZE;
+        if (u < size && v < size) in[u][v] = coef[k] * table->divisor[k];
+    }
+
+    // Same two passes as idct_low(), on 'size' points
+    for (int u = 0; u < size; u++) {
+        for (int y = 0; y < size; y++) {
+            int32_t acc = 0;
+            for (int v = 0; v < size; v++) acc += in[u][v] * basis[v * size + y];
+            tmp[u][y] = (acc + (1 << (CONST_BITS - LOW_PASS1_BITS - 1))) >> (CONST_BITS - LOW_PASS1_BITS);
+        }
+    }
+
+    for (int x = 0; x < size; x++) {
+        for (int y = 0; y < size; y++) {
+            int32_t acc = 0;
+            for (int u = 0; u < size; u++) acc += basis[u * size + x] * tmp[u][y];
+            block[x][y] = (acc + (1 << (CONST_BITS + LOW_PASS1_BITS - 1))) >> (CONST_BITS + LOW_PASS1_BITS);
+        }
+    }
+
+    if (size == 2) engine->stats.low_2x2++;
+    else engine->stats.low_4x4++;
+}
+
+// Saturates a reconstructed sample to a plane byte
+static inline uint8_t to_sample(int32_t v) {
+    return (uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+void idct_plane(IDCT_Engine *engine, int16_t *coefs, const int *last, const Quant_Table *table,
+                int level_shift, uint8_t *plane, int plane_width, int plane_height) {
+    idct_plane_columns(engine, coefs, last, table, level_shift, plane, plane_width, plane_height,
+                       0, (plane_width + BLOCK_SIZE - 1) / BLOCK_SIZE, BLOCK_SIZE);
+}
+
+void idct_plane_columns(IDCT_Engine *engine, int16_t *coefs, const int *last, const Quant_Table *table,
+                        int level_shift, uint8_t *plane, int plane_width, int plane_height,
+                        int first_col, int num_cols, int block_size) {
+    // A reduced plane of ceil(w / s) samples still has ceil(w / 8) blocks per row
+    int blocks_x = (plane_width + block_size - 1) / block_size;
+
+    for (int j = 0; j < plane_height; j += block_size) {
+        for (int col = first_col; col < first_col + num_cols; col++) {
+            int32_t original[BLOCK_SIZE][BLOCK_SIZE];
+            int i = col * block_size;
+            int idx = (j / block_size) * blocks_x + col;
+
+            if (block_size == BLOCK_SIZE) {
+                idct_block(engine, block_coefs(coefs, idx), last[idx], table, original);
+            } else {
+                idct_block_reduced(engine, block_coefs(coefs, idx), last[idx], table, block_size, original);
+            }
+
+            for (int y = 0; y < block_size && j + y < plane_height; y++) {
+                for (int x = 0; x < block_size && i + x < plane_width; x++) {
+                    plane[(size_t)(j + y) * plane_width + (i + x)] = to_sample(original[x][y] + level_shift);
+                }
+            }
+        }
+    }
+}
+
+int parse_dct_method(const char *name, DCT_Method *method) {
+    if (strcmp(name, "matrix") == 0) {
+        *method = DCT_METHOD_MATRIX;
+    } else if (strcmp(name, "fast") == 0) {
+        *method = DCT_METHOD_FAST;
+    } else {
+        return FAILURE;
+    }
+    return SUCCESS;
+}
+
+int parse_quality(const char *text, int *quality) {
+    char *end;
+    long value = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || value < MIN_QUALITY || value > MAX_QUALITY) return FAILURE;
+
+    *quality = (int)value;
+    return SUCCESS;
+}
@@ -0,0 +1,708 @@
+#include "decoder.h"
+#include "img_functions.h"
+#include "messages.h"
+#include "thread_pool.h"
+
+/**
+ * Stripes handed to the thread pool as one task: a single stripe, or a whole
+ * restart segment when the stream has restart intervals.
+ */
+typedef struct {
+    int first_stripe;
+    int num_stripes;
+    YCbCr_Planes *planes;       /* Reconstructed stripes ('stripe_out' luma rows each) */
+    Blocks_ZigZag *coefs;       /* Coefficients of the stripe being reconstructed */
+    const uint8_t *bits;        /* Restart segments only: coded segment, inside the input */
+    size_t bits_size;
+    IDCT_Engine engine;         /* Copy of the decoder's engine, with this task's kernel counters */
+    Pipeline_Stats stats;       /* Stats of the task, merged by decode_batch() */
+    int status;
+} Segment;
+
+/**
+ * Consecutive segments decoded together by the thread pool.
+ */
+typedef struct {
+    Stream_Decoder *decoder;
+    Segment *segments;
+    int count;                  /* Segments holding stripes (0 = empty batch) */
+    int first_stripe;
+    int num_stripes;
+} Segment_Batch;
+
+/**
+ * Rows are produced from the batch holding their stripe. The triangle filter
+ * also needs the chroma row above or below, which may sit in the previous or
+ * the next batch, so two batches are kept: loading a batch never evicts the
+ * one holding the stripe right before it.
+ */
+struct Stream_Decoder {
+    const uint8_t *data;        /* The whole BIN file */
+    size_t size;
+    Stream_Layout layout;
+    int out_width;              /* Decoded image size: 1/scale of the coded one, rounded up */
+    int out_height;
+    int out_chroma_width;
+    int out_chroma_height;
+    int block_out;              /* Decoded samples per block side (BLOCK_SIZE / scale) */
+    int stripe_out;             /* Decoded luma rows per stripe (STRIPE_ROWS / scale) */
+    IDCT_Engine engine;
+    Color_Kernel kernel;
+    Thread_Pool *pool;
+    Huffman_Decoder dc_dec[NUM_HUFFMAN_CLASSES];    /* Luma, then chroma */
+    Huffman_Decoder ac_dec[NUM_HUFFMAN_CLASSES];
+    uint64_t *segment_offsets;  /* Restart segments only */
+    Index_Entry *index;         /* Index entries (BIN_FLAG_INDEX) */
+    size_t data_end;            /* File offset right after the coded stripes */
+    int segment_stripes;        /* Stripes per segment */
+    int batch_size;             /* Segments per batch */
+    Segment_Batch batches[2];
+    int next_stripe;            /* First stripe not decoded yet */
+    int first_stripe;           /* Stripes before it are decoded but not reconstructed */
+    int end_stripe;             /* Stripes from it on are not needed */
+    int region_x;               /* Rectangle returned by stream_decoder_read_rows() */
+    int region_y;
+    int region_width;
+    int region_height;
+    int first_col;              /* Y block columns reconstructed */
+    int num_cols;
+    int first_chroma_col;       /* Cb/Cr block columns reconstructed */
+    int num_chroma_cols;
+    int rows_read;
+    int last_dc[3];             /* DC predictors of Y, Cb and Cr (without restarts) */
+    uint8_t *row_Cb;            /* Upsampled chroma of the row being converted */
+    uint8_t *row_Cr;
+    Pipeline_Stats *stats;      /* Caller's stats, or NULL */
+    double start_time;          /* When the decoder was created, for the elapsed time */
+    Bit_Read_Write br;
+};
+
+void init_decoder_config(Decoder_Config *config) {
+    config->idct_method = DCT_METHOD_FAST;
+    config->threads = 1;
+    config->scale = 1;
+    config->stats = NULL;
+}
+
+int parse_decode_scale(const char *text, int *scale) {
+    char *end;
+    long value = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || (value != 1 && value != 2 && value != 4 && value != 8)) return FAILURE;
+
+    *scale = (int)value;
+    return SUCCESS;
+}
+
+uint64_t *read_restart_table(const uint8_t *data, size_t size, Stream_Layout *layout) {
+    Restart_Header restart;
+    if (size < BMP_HEADERS_SIZE + sizeof(restart)) return NULL;
+
+    memcpy(&restart, data + BMP_HEADERS_SIZE, sizeof(restart));
+    if (restart.restart_interval == 0 || restart.restart_interval > 65535) return NULL;
+
+    set_restart_interval(layout, (int)restart.restart_interval);
+    if (restart.num_segments != (unsigned int)layout->num_segments) return NULL;
+
+    size_t table_size = layout->num_segments * sizeof(uint64_t);
+    if (size - BMP_HEADERS_SIZE - sizeof(restart) < table_size) return NULL;
+
+    uint64_t *offsets = malloc(table_size);
+    if (!offsets) return NULL;
+    memcpy(offsets, data + BMP_HEADERS_SIZE + sizeof(restart), table_size);
+
+    // Segments follow the table, in order
+    uint64_t previous = BMP_HEADERS_SIZE + sizeof(restart) + table_size;
+    for (int i = 0; i < layout->num_segments; i++) {
+        if (offsets[i] < previous) {
+            free(offsets);
+            return NULL;
+        }
+        previous = offsets[i];
+    }
+
+    return offsets;
+}
+
+// Reads the index footer and sets where the coded data, starting at 'data_start', ends
+static int read_index(Stream_Decoder *decoder, size_t data_start) {
+    Index_Footer footer;
+    if (decoder->size - data_start < sizeof(footer)) return FAILURE;
+
+    size_t footer_offset = decoder->size - sizeof(footer);
+    memcpy(&footer, decoder->data + footer_offset, sizeof(footer));
+    if (footer.index_interval == 0 || footer.index_interval > 65535) return FAILURE;
+
+    Stream_Layout *layout = &decoder->layout;
+    set_index_interval(layout, (int)footer.index_interval);
+    if (footer.num_entries != (unsigned int)layout->num_index_entries) return FAILURE;
+
+    size_t index_size = (size_t)footer.num_entries * sizeof(Index_Entry);
+    if (index_size > footer_offset - data_start) return FAILURE;
+    decoder->data_end = footer_offset - index_size;
+
+    decoder->index = malloc(index_size);
+    if (!decoder->index) return FAILURE;
+    memcpy(decoder->index, decoder->data + decoder->data_end, index_size);
+
+    // Entries point into the coded data, in order
+    uint64_t previous = (uint64_t)data_start * 8;
+    for (unsigned int i = 0; i < footer.num_entries; i++) {
+        if (decoder->index[i].bit_offset < previous || decoder->index[i].bit_offset > decoder->data_end * 8) {
+            return FAILURE;
+        }
+        previous = decoder->index[i].bit_offset;
+    }
+
+    return SUCCESS;
+}
+
+// Builds the luma and chroma decoders: from the image's tables at 'data_start', which is moved past them, or standard
+static int build_decoders(Stream_Decoder *decoder, size_t *data_start) {
+    for (int c = 0; c < NUM_HUFFMAN_CLASSES; c++) {
+        if (!(decoder->layout.flags & BIN_FLAG_HUFFMAN)) {
+            if (build_dc_decoder(&decoder->dc_dec[c], dc_table, 11) != SUCCESS ||
+                build_ac_decoder(&decoder->ac_dec[c], ac_table, 162) != SUCCESS) {
+                return FAILURE;
+            }
+            continue;
+        }
+
+        Huffman_Spec dc, ac;
+        size_t dc_size = parse_huffman_spec(decoder->data + *data_start, decoder->size - *data_start, 1, &dc);
+        if (dc_size == 0) return FAILURE;
+        *data_start += dc_size;
+
+        size_t ac_size = parse_huffman_spec(decoder->data + *data_start, decoder->size - *data_start, 0, &ac);
+        if (ac_size == 0) return FAILURE;
+        *data_start += ac_size;
+
+        if (build_spec_decoder(&decoder->dc_dec[c], &dc) != SUCCESS ||
+            build_spec_decoder(&decoder->ac_dec[c], &ac) != SUCCESS) {
+            return FAILURE;
+        }
+    }
+
+    return SUCCESS;
+}
+
+static int alloc_segment(Segment *segment, const Stream_Decoder *decoder, int stripes) {
+    const Stream_Layout *layout = &decoder->layout;
+    segment->planes = alloc_planes(decoder->out_width, stripes * decoder->stripe_out, decoder->out_chroma_width,
+                                   stripes * decoder->stripe_out / 2);
+    segment->coefs = alloc_BlocosZigZag(2 * layout->blocks_x, layout->chroma_blocks_x, 1);
+
+    return (segment->planes && segment->coefs) ? SUCCESS : FAILURE;
+}
+
+static void free_segment(Segment *segment) {
+    free_planes(segment->planes);
+    free_BlocosZigZag(segment->coefs);
+}
+
+Stream_Decoder *stream_decoder_create(const uint8_t *data, size_t size, const BMPFILEHEADER *fileHeader,
+                                      const BMPINFOHEADER *infoHeader, const Decoder_Config *config) {
+    unsigned short flags = fileHeader->bfReserved1;
+    if (!(flags & BIN_FLAG_STRIPES) || !(flags & BIN_FLAG_CHROMA_420) || size < BMP_HEADERS_SIZE) return NULL;
+
+    int scale = config->scale;
+    if (scale != 1 && scale != 2 && scale != 4 && scale != 8) return NULL;
+
+    Stream_Decoder *decoder = calloc(1, sizeof(Stream_Decoder));
+    if (!decoder) return NULL;
+
+    decoder->data = data;
+    decoder->size = size;
+    init_stream_layout(&decoder->layout, infoHeader->biWidth, infoHeader->biHeight, flags);
+
+    // Every block yields BLOCK_SIZE / scale samples per side, partial edge blocks included
+    decoder->out_width = (decoder->layout.width + scale - 1) / scale;
+    decoder->out_height = (decoder->layout.height + scale - 1) / scale;
+    decoder->out_chroma_width = (decoder->layout.chroma_width + scale - 1) / scale;
+    decoder->out_chroma_height = (decoder->layout.chroma_height + scale - 1) / scale;
+    decoder->block_out = BLOCK_SIZE / scale;
+    decoder->stripe_out = STRIPE_ROWS / scale;
+
+    decoder->stats = config->stats;
+    if (decoder->stats) {
+        init_pipeline_stats(decoder->stats);
+        decoder->stats->pixels = (uint64_t)decoder->out_width * (uint64_t)decoder->out_height;
+        decoder->start_time = monotonic_seconds();
+    }
+
+    // Streams without BIN_FLAG_QUALITY use the standard matrices
+    int quality = (flags & BIN_FLAG_QUALITY) ? fileHeader->bfReserved2 : DEFAULT_QUALITY;
+    if (quality < MIN_QUALITY || quality > MAX_QUALITY) {
+        report_error("Invalid quality %d.", quality);
+        free(decoder);
+        return NULL;
+    }
+    init_idct_engine(&decoder->engine, config->idct_method, quality);
+    decoder->kernel = detect_color_kernel();
+
+    const Stream_Layout *layout = &decoder->layout;
+    decoder->pool = thread_pool_create(config->threads);
+    decoder->row_Cb = malloc(decoder->out_width);
+    decoder->row_Cr = malloc(decoder->out_width);
+    if (!decoder->pool || !decoder->row_Cb || !decoder->row_Cr) {
+        stream_decoder_free(decoder);
+        return NULL;
+    }
+
+    size_t data_start = BMP_HEADERS_SIZE;
+    if (flags & BIN_FLAG_RESTART) {
+        decoder->segment_offsets = read_restart_table(data, size, &decoder->layout);
+        if (!decoder->segment_offsets) {
+            report_error("Invalid restart table.");
+            stream_decoder_free(decoder);
+            return NULL;
+        }
+        data_start += sizeof(Restart_Header) + layout->num_segments * sizeof(uint64_t);
+    }
+
+    if (build_decoders(decoder, &data_start) != SUCCESS) {
+        report_error("Invalid Huffman tables.");
+        stream_decoder_free(decoder);
+        return NULL;
+    }
+
+    // The coded data runs to the end of the file, or to the index footer
+    decoder->data_end = size;
+    if ((flags & BIN_FLAG_INDEX) && read_index(decoder, data_start) != SUCCESS) {
+        report_error("Invalid stripe index.");
+        stream_decoder_free(decoder);
+        return NULL;
+    }
+
+    // Bit offsets (index entries) count from the start of the file
+    if (!(flags & BIN_FLAG_RESTART)) {
+        init_bitreader_memory(&decoder->br, data, decoder->data_end);
+        seek_bitreader(&decoder->br, (uint64_t)data_start * 8);
+    }
+
+    decoder->end_stripe = layout->num_stripes;
+    decoder->region_width = decoder->out_width;
+    decoder->region_height = decoder->out_height;
+    decoder->num_cols = layout->blocks_x;
+    decoder->num_chroma_cols = layout->chroma_blocks_x;
+
+    // One segment per thread, never more than the image has
+    int interval = layout->restart_interval;
+    int num_units = interval > 0 ? layout->num_segments : layout->num_stripes;
+    decoder->segment_stripes = (interval > 0 && interval < layout->num_stripes) ? interval
+                             : (interval > 0 ? layout->num_stripes : 1);
+    decoder->batch_size = thread_pool_size(decoder->pool);
+    if (decoder->batch_size > num_units) decoder->batch_size = num_units;
+
+    for (int b = 0; b < 2; b++) {
+        Segment_Batch *batch = &decoder->batches[b];
+        batch->decoder = decoder;
+        batch->segments = calloc(decoder->batch_size, sizeof(Segment));
+        if (!batch->segments) {
+            stream_decoder_free(decoder);
+            return NULL;
+        }
+
+        for (int i = 0; i < decoder->batch_size; i++) {
+            if (alloc_segment(&batch->segments[i], decoder, decoder->segment_stripes) != SUCCESS) {
+                stream_decoder_free(decoder);
+                return NULL;
+            }
+        }
+    }
+
+    return decoder;
+}
+
+// Number of image rows in a stripe (fewer than STRIPE_ROWS only for the last one)
+static int stripe_rows(const Stream_Layout *layout, int stripe) {
+    int rows = layout->height - stripe * STRIPE_ROWS;
+    return rows < STRIPE_ROWS ? rows : STRIPE_ROWS;
+}
+
+// Blocks whose symbols are read before they are expanded, so that stats read the clock once per chunk
+#define DECODE_CHUNK_BLOCKS 8
+
+// Reads 'count' blocks of a channel into a zeroed slab, undoing the DC delta coding
+static int decode_blocks(Bit_Read_Write *br, const Stream_Decoder *decoder, int channel_class, int16_t *slab,
+                         int *last, int count, int *last_dc, Pipeline_Stats *stats) {
+    const Huffman_Decoder *dc_dec = &decoder->dc_dec[channel_class];
+    const Huffman_Decoder *ac_dec = &decoder->ac_dec[channel_class];
+    RLE_coef rle[DECODE_CHUNK_BLOCKS][BLOCK_SIZE * BLOCK_SIZE];
+    int sizes[DECODE_CHUNK_BLOCKS];
+
+    for (int first = 0; first < count; first += DECODE_CHUNK_BLOCKS) {
+        int chunk = (count - first < DECODE_CHUNK_BLOCKS) ? count - first : DECODE_CHUNK_BLOCKS;
+        double t = stage_start(stats);
+
+        for (int k = 0; k < chunk; k++) {
+            if (read_rle_symbols(br, dc_dec, ac_dec, rle[k], &sizes[k]) != SUCCESS) {
+                return FAILURE;
+            }
+        }
+        t = stage_lap(stats, STAGE_HUFFMAN, t);
+
+        for (int k = 0; k < chunk; k++) {
+            int16_t *block = block_coefs(slab, first + k);
+            rle_to_block(rle[k], sizes[k], block, &last[first + k]);
+            block[0] = (int16_t)(block[0] + *last_dc);
+            *last_dc = block[0];
+        }
+        stage_lap(stats, STAGE_RLE, t);
+
+        for (int k = 0; stats && k < chunk; k++) {
+            count_block_symbols(stats, rle[k], sizes[k]);
+        }
+    }
+
+    return SUCCESS;
+}
+
+// Entropy decodes one stripe into the coefficients of a segment: its Y blocks, then Cb, then Cr
+static int decode_stripe(Bit_Read_Write *br, const Stream_Decoder *decoder, Segment *segment, int stripe,
+                         int *last_dc, Pipeline_Stats *stats) {
+    const Stream_Layout *layout = &decoder->layout;
+    Blocks_ZigZag *coefs = segment->coefs;
+    int rows = stripe_rows(layout, stripe);
+    int num_blocks = plane_blocks(layout->width, rows);
+    int num_chroma_blocks = plane_blocks(layout->chroma_width, (rows + 1) / 2);
+    size_t block_bytes = BLOCK_SIZE * BLOCK_SIZE * sizeof(int16_t);
+
+    memset(coefs->Y_blocks, 0, num_blocks * block_bytes);
+    memset(coefs->Cb_blocks, 0, num_chroma_blocks * block_bytes);
+    memset(coefs->Cr_blocks, 0, num_chroma_blocks * block_bytes);
+
+    if (decode_blocks(br, decoder, 0, coefs->Y_blocks, coefs->Y_last, num_blocks, &last_dc[0], stats) != SUCCESS ||
+        decode_blocks(br, decoder, 1, coefs->Cb_blocks, coefs->Cb_last, num_chroma_blocks, &last_dc[1],
+                      stats) != SUCCESS ||
+        decode_blocks(br, decoder, 1, coefs->Cr_blocks, coefs->Cr_last, num_chroma_blocks, &last_dc[2],
+                      stats) != SUCCESS) {
+        return FAILURE;
+    }
+    return SUCCESS;
+}
+
+// Inverse DCT of the decoded stripe into its (possibly reduced) rows of the segment planes
+static void reconstruct_stripe(const Stream_Decoder *decoder, Segment *segment, int stripe) {
+    YCbCr_Planes *planes = segment->planes;
+    Blocks_ZigZag *coefs = segment->coefs;
+    int stripe_out = decoder->stripe_out;
+    int rows = decoder->out_height - stripe * stripe_out;
+    if (rows > stripe_out) rows = stripe_out;
+    int local = stripe - segment->first_stripe;
+    size_t offset = (size_t)local * stripe_out * planes->width;
+    size_t chroma_offset = (size_t)local * (stripe_out / 2) * planes->chroma_width;
+
+    // Stripes before a region are only entropy decoded, for the DC predictors
+    if (stripe < decoder->first_stripe) return;
+    Pipeline_Stats *stats = decoder->stats ? &segment->stats : NULL;
+    double t = stage_start(stats);
+
+    idct_plane_columns(&segment->engine, coefs->Y_blocks, coefs->Y_last, &segment->engine.lumin, 128,
+                       planes->Y + offset, planes->width, rows, decoder->first_col, decoder->num_cols,
+                       decoder->block_out);
+
+    // Undo the level shift and restore the +128 offset of the chroma planes
+    idct_plane_columns(&segment->engine, coefs->Cb_blocks, coefs->Cb_last, &segment->engine.chrom, 256,
+                       planes->Cb + chroma_offset, planes->chroma_width, (rows + 1) / 2,
+                       decoder->first_chroma_col, decoder->num_chroma_cols, decoder->block_out);
+    idct_plane_columns(&segment->engine, coefs->Cr_blocks, coefs->Cr_last, &segment->engine.chrom, 256,
+                       planes->Cr + chroma_offset, planes->chroma_width, (rows + 1) / 2,
+                       decoder->first_chroma_col, decoder->num_chroma_cols, decoder->block_out);
+    stage_lap(stats, STAGE_TRANSFORM, t);
+}
+
+// Pool task: reconstructs a stripe decoded by the caller, or decodes and reconstructs a restart segment
+static void process_segment(void *context, int index) {
+    Segment_Batch *batch = context;
+    const Stream_Decoder *decoder = batch->decoder;
+    Segment *segment = &batch->segments[index];
+
+    if (!segment->bits) {
+        if (segment->status == SUCCESS) reconstruct_stripe(decoder, segment, segment->first_stripe);
+        return;
+    }
+
+    // Each restart segment starts byte aligned with the DC predictors at zero
+    int last_dc[3] = {0, 0, 0};
+    Bit_Read_Write *br = malloc(sizeof(Bit_Read_Write));
+
+    segment->status = br ? SUCCESS : FAILURE;
+    if (segment->status == SUCCESS) {
+        init_bitreader_memory(br, segment->bits, segment->bits_size);
+
+        for (int s = 0; s < segment->num_stripes && segment->status == SUCCESS; s++) {
+            int stripe = segment->first_stripe + s;
+            segment->status = decode_stripe(br, decoder, segment, stripe, last_dc,
+                                            decoder->stats ? &segment->stats : NULL);
+            if (segment->status == SUCCESS) reconstruct_stripe(decoder, segment, stripe);
+        }
+    }
+
+    free(br);
+}
+
+// Points a segment at the coded bytes of restart segment 'k'
+static int load_segment_bits(Stream_Decoder *decoder, Segment *segment, int k) {
+    uint64_t start = decoder->segment_offsets[k];
+    uint64_t end = (k + 1 < decoder->layout.num_segments) ? decoder->segment_offsets[k + 1] : decoder->data_end;
+    if (end < start || end > decoder->data_end) return FAILURE;
+
+    segment->bits = decoder->data + start;
+    segment->bits_size = (size_t)(end - start);
+    return SUCCESS;
+}
+
+// Decodes the next batch of stripes into 'batch'
+static int decode_batch(Stream_Decoder *decoder, Segment_Batch *batch) {
+    const Stream_Layout *layout = &decoder->layout;
+    int restart = layout->restart_interval > 0;
+    int stripe = decoder->next_stripe;
+
+    batch->first_stripe = stripe;
+    batch->count = 0;
+
+    while (batch->count < decoder->batch_size && stripe < decoder->end_stripe) {
+        Segment *segment = &batch->segments[batch->count++];
+        int remaining = decoder->end_stripe - stripe;
+
+        segment->first_stripe = stripe;
+        segment->num_stripes = remaining < decoder->segment_stripes ? remaining : decoder->segment_stripes;
+        segment->engine = decoder->engine;
+        segment->engine.stats = (IDCT_Stats){0, 0, 0, 0};
+        init_pipeline_stats(&segment->stats);
+
+        // Without restarts the stripes are entropy decoded here, in order; the pool only reconstructs them
+        if (restart) {
+            segment->status = load_segment_bits(decoder, segment, stripe / layout->restart_interval);
+        } else {
+            segment->status = decode_stripe(&decoder->br, decoder, segment, stripe, decoder->last_dc,
+                                            decoder->stats ? &segment->stats : NULL);
+        }
+        if (segment->status != SUCCESS) {
+            batch->count = 0;
+            return FAILURE;
+        }
+
+        stripe += segment->num_stripes;
+    }
+
+    thread_pool_submit(decoder->pool, process_segment, batch, batch->count);
+    thread_pool_wait(decoder->pool);
+
+    int status = SUCCESS;
+    for (int i = 0; i < batch->count; i++) {
+        const Segment *segment = &batch->segments[i];
+        if (segment->status != SUCCESS) status = FAILURE;
+
+        decoder->engine.stats.dc_only += segment->engine.stats.dc_only;
+        decoder->engine.stats.low_2x2 += segment->engine.stats.low_2x2;
+        decoder->engine.stats.low_4x4 += segment->engine.stats.low_4x4;
+        decoder->engine.stats.full += segment->engine.stats.full;
+        if (decoder->stats) add_pipeline_stats(decoder->stats, &segment->stats);
+    }
+
+    batch->num_stripes = stripe - batch->first_stripe;
+    decoder->next_stripe = stripe;
+    if (status != SUCCESS) batch->count = 0;
+    return status;
+}
+
+static Segment_Batch *batch_with_stripe(Stream_Decoder *decoder, int stripe) {
+    for (int b = 0; b < 2; b++) {
+        Segment_Batch *batch = &decoder->batches[b];
+        if (batch->count > 0 && stripe >= batch->first_stripe && stripe < batch->first_stripe + batch->num_stripes) {
+            return batch;
+        }
+    }
+    return NULL;
+}
+
+// Returns the batch holding a stripe, decoding batches until it is loaded; a new batch
+// never evicts the one holding the stripe right before it
+static Segment_Batch *load_stripe(Stream_Decoder *decoder, int stripe) {
+    Segment_Batch *batch;
+
+    while (!(batch = batch_with_stripe(decoder, stripe))) {
+        if (stripe < decoder->next_stripe || decoder->next_stripe >= decoder->end_stripe) return NULL;
+
+        Segment_Batch *keep = batch_with_stripe(decoder, decoder->next_stripe - 1);
+        batch = (keep == &decoder->batches[0]) ? &decoder->batches[1] : &decoder->batches[0];
+        if (decode_batch(decoder, batch) != SUCCESS) return NULL;
+    }
+
+    return batch;
+}
+
+// Segment of a loaded batch that holds a stripe
+static const Segment *segment_with_stripe(const Stream_Decoder *decoder, const Segment_Batch *batch, int stripe) {
+    return &batch->segments[(stripe - batch->first_stripe) / decoder->segment_stripes];
+}
+
+void stream_decoder_output_size(const Stream_Decoder *decoder, int *width, int *height) {
+    *width = decoder->out_width;
+    *height = decoder->out_height;
+}
+
+int stream_decoder_set_region(Stream_Decoder *decoder, int x, int y, int width, int height) {
+    const Stream_Layout *layout = &decoder->layout;
+    int out_width = decoder->out_width;
+    int out_height = decoder->out_height;
+    int block_out = decoder->block_out;
+
+    if (decoder->rows_read > 0 || decoder->next_stripe > 0) {
+        report_error("The region must be set before decoding.");
+        return FAILURE;
+    }
+    if (x < 0 || y < 0 || width < 1 || height < 1 || x > out_width - width || y > out_height - height) {
+        report_error("Region %d,%d %dx%d is outside the %dx%d image.", x, y, width, height, out_width, out_height);
+        return FAILURE;
+    }
+
+    decoder->region_x = x;
+    decoder->region_y = y;
+    decoder->region_width = width;
+    decoder->region_height = height;
+    if (decoder->stats) decoder->stats->pixels = (uint64_t)width * (uint64_t)height;
+
+    // Chroma rows and columns the triangle filter reads, one past the region on each side
+    int last_chroma_row = decoder->out_chroma_height - 1;
+    int first_chroma = (y / 2 > 0) ? y / 2 - 1 : 0;
+    int last_chroma = ((y + height - 1) / 2 < last_chroma_row) ? (y + height - 1) / 2 + 1 : last_chroma_row;
+    decoder->first_stripe = first_chroma / (decoder->stripe_out / 2);
+    decoder->end_stripe = last_chroma / (decoder->stripe_out / 2) + 1;
+
+    int last_chroma_col = decoder->out_chroma_width - 1;
+    int first_chroma_x = (x / 2 > 0) ? x / 2 - 1 : 0;
+    int last_chroma_x = ((x + width - 1) / 2 < last_chroma_col) ? (x + width - 1) / 2 + 1 : last_chroma_col;
+    decoder->first_col = x / block_out;
+    decoder->num_cols = (x + width - 1) / block_out - decoder->first_col + 1;
+    decoder->first_chroma_col = first_chroma_x / block_out;
+    decoder->num_chroma_cols = last_chroma_x / block_out - decoder->first_chroma_col + 1;
+
+    // Restart segments are decoded whole, from the one holding the first stripe
+    if (layout->restart_interval > 0) {
+        decoder->next_stripe = decoder->first_stripe / layout->restart_interval * layout->restart_interval;
+        return SUCCESS;
+    }
+
+    // Otherwise start from the closest index entry, or from the first stripe without an index
+    if (decoder->index) {
+        int entry = decoder->first_stripe / layout->index_interval;
+        if (seek_bitreader(&decoder->br, decoder->index[entry].bit_offset) != SUCCESS) {
+            report_error("Invalid stripe index.");
+            return FAILURE;
+        }
+        for (int c = 0; c < 3; c++) decoder->last_dc[c] = decoder->index[entry].last_dc[c];
+        decoder->next_stripe = entry * layout->index_interval;
+    }
+
+    // Stripes up to the region only update the DC predictors
+    Segment *scratch = &decoder->batches[0].segments[0];
+    for (; decoder->next_stripe < decoder->first_stripe; decoder->next_stripe++) {
+        if (decode_stripe(&decoder->br, decoder, scratch, decoder->next_stripe, decoder->last_dc,
+                          decoder->stats) != SUCCESS) {
+            report_error("Error decoding Huffman data.");
+            return FAILURE;
+        }
+    }
+
+    return SUCCESS;
+}
+
+int stream_decoder_read_rows(Stream_Decoder *decoder, RGB_Pixel *rows, int count) {
+    return stream_decoder_read_rows_strided(decoder, (uint8_t *)rows,
+                                            (ptrdiff_t)decoder->region_width * (ptrdiff_t)sizeof(RGB_Pixel), count);
+}
+
+int stream_decoder_read_rows_strided(Stream_Decoder *decoder, uint8_t *first_row, ptrdiff_t stride, int count) {
+    int width = decoder->out_width;
+    int chroma_width = decoder->out_chroma_width;
+    int region_x = decoder->region_x;
+    int region_width = decoder->region_width;
+    int stripe_out = decoder->stripe_out;
+    int half = stripe_out / 2;
+
+    for (int r = 0; r < count; r++) {
+        int y = decoder->region_y + decoder->rows_read;
+        if (decoder->rows_read >= decoder->region_height) {
+            report_error("No rows left to decode.");
+            return FAILURE;
+        }
+
+        int stripe = y / stripe_out;
+        Segment_Batch *batch = load_stripe(decoder, stripe);
+        if (!batch) {
+            report_error("Error decoding Huffman data.");
+            return FAILURE;
+        }
+        const Segment *segment = segment_with_stripe(decoder, batch, stripe);
+
+        // Chroma samples sit between two luma rows: even rows lean on the row above, odd rows on the one below
+        int near = y / 2;
+        int far = (y % 2 == 0) ? near - 1 : near + 1;
+        if (far < 0) far = 0;
+        if (far > decoder->out_chroma_height - 1) far = decoder->out_chroma_height - 1;
+
+        Segment_Batch *far_batch = load_stripe(decoder, far / half);
+        if (!far_batch) {
+            report_error("Error decoding Huffman data.");
+            return FAILURE;
+        }
+        const Segment *far_segment = segment_with_stripe(decoder, far_batch, far / half);
+
+        size_t near_offset = (size_t)(near - segment->first_stripe * half) * chroma_width;
+        size_t far_offset = (size_t)(far - far_segment->first_stripe * half) * chroma_width;
+        size_t offset = (size_t)(y - segment->first_stripe * stripe_out) * width + region_x;
+        double t = stage_start(decoder->stats);
+
+        if (region_width == width) {
+            upsample_row_h2v2(segment->planes->Cb + near_offset, far_segment->planes->Cb + far_offset, chroma_width,
+                              decoder->row_Cb, width);
+            upsample_row_h2v2(segment->planes->Cr + near_offset, far_segment->planes->Cr + far_offset, chroma_width,
+                              decoder->row_Cr, width);
+        } else {
+            upsample_row_h2v2_range(segment->planes->Cb + near_offset, far_segment->planes->Cb + far_offset,
+                                    chroma_width, decoder->row_Cb, region_x, region_width);
+            upsample_row_h2v2_range(segment->planes->Cr + near_offset, far_segment->planes->Cr + far_offset,
+                                    chroma_width, decoder->row_Cr, region_x, region_width);
+        }
+        t = stage_lap(decoder->stats, STAGE_SUBSAMPLE, t);
+
+        ycbcr_planes_to_rgb(segment->planes->Y + offset, decoder->row_Cb, decoder->row_Cr,
+                            (RGB_Pixel *)(first_row + (ptrdiff_t)r * stride), region_width, decoder->kernel);
+        stage_lap(decoder->stats, STAGE_COLOR, t);
+        decoder->rows_read++;
+    }
+
+    if (decoder->stats) decoder->stats->elapsed_seconds = monotonic_seconds() - decoder->start_time;
+    return SUCCESS;
+}
+
+void stream_decoder_stats(const Stream_Decoder *decoder, IDCT_Stats *stats) {
+    *stats = decoder->engine.stats;
+}
+
+void stream_decoder_free(Stream_Decoder *decoder) {
+    if (!decoder) return;
+
+    thread_pool_destroy(decoder->pool);
+
+    for (int b = 0; b < 2; b++) {
+        Segment_Batch *batch = &decoder->batches[b];
+        if (!batch->segments) continue;
+        for (int i = 0; i < decoder->batch_size; i++) {
+            free_segment(&batch->segments[i]);
+        }
+        free(batch->segments);
+    }
+
+    for (int c = 0; c < NUM_HUFFMAN_CLASSES; c++) {
+        free_huffman_decoder(&decoder->dc_dec[c]);
+        free_huffman_decoder(&decoder->ac_dec[c]);
+    }
+    free(decoder->segment_offsets);
+    free(decoder->index);
+    free(decoder->row_Cb);
+    free(decoder->row_Cr);
+    free(decoder);
+}
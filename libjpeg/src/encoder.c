@@ -0,0 +1,911 @@
+// open_memstream()
+#define _POSIX_C_SOURCE 200809L
+
+#include "encoder.h"
+#include "img_functions.h"
+#include "messages.h"
+#include "rate.h"
+#include "thread_pool.h"
+
+#include <errno.h>
+
+/**
+ * Rows handed to the thread pool as one task: a single stripe, or a whole
+ * restart segment when restart intervals are enabled.
+ */
+typedef struct {
+    RGB_Pixel *rgb;             /* Copied input rows (STRIPE_ROWS per stripe), allocated on first use */
+    const uint8_t *src;         /* Input rows used in place (stream_encoder_write_image()), else NULL */
+    ptrdiff_t src_stride;       /* Bytes from a row of 'src' to the next */
+    int rows;                   /* Rows received */
+    int first_stripe;           /* Stripe index of the first row */
+    YCbCr_Planes *planes;       /* STRIPE_ROWS luma rows and STRIPE_ROWS / 2 chroma rows */
+    uint8_t *pair_Cb;           /* Full-resolution chroma of the row pair being converted */
+    uint8_t *pair_Cr;
+    Blocks_ZigZag *coefs;       /* Coefficients of the last transformed stripe */
+    Bit_Read_Write *bw;         /* Restart segments only: writer of the coded segment */
+    char *bits;                 /* Restart segments only: coded segment, byte aligned */
+    size_t bits_size;
+    Index_Entry *stripe_entries;    /* Restart segments with an index: start of each stripe in 'bits' */
+    Symbol_Histogram histogram[NUM_HUFFMAN_CLASSES];   /* Restart segments, first pass: symbols counted */
+    Pipeline_Stats stats;       /* Stats of the task, merged by write_batch() */
+    int status;
+} Segment;
+
+/**
+ * Segments processed together by the thread pool.
+ */
+typedef struct {
+    Stream_Encoder *encoder;
+    Segment *segments;
+    int count;                  /* Segments holding rows */
+} Segment_Batch;
+
+/**
+ * What is done with the transformed stripes.
+ */
+typedef enum {
+    PASS_WRITE = 0,             /* Entropy code them into the output */
+    PASS_COUNT,                 /* Only count their symbols, for the image's Huffman tables */
+    PASS_KEEP                   /* Only keep their coefficients, for the target size search */
+} Encoder_Pass;
+
+/**
+ * Where entropy coded blocks go: a bit writer, or in the first pass of
+ * optimized coding, the symbol counts of each channel class.
+ */
+typedef struct {
+    Bit_Read_Write *bw;
+    const Huffman_Encoder *codes;   /* Luma codes, then chroma codes */
+    Symbol_Histogram *histogram;    /* Non-NULL: count the symbols instead of writing them */
+    Pipeline_Stats *stats;
+} Block_Sink;
+
+/**
+ * Rows fill one batch while the pool processes the other. Without restarts the
+ * pool only transforms, and the caller's thread entropy codes each batch in
+ * order; with restarts every segment is also entropy coded by its task, and the
+ * caller's thread only appends the coded segments and records their offsets.
+ *
+ * Optimized Huffman coding runs this twice: the first pass keeps the
+ * coefficients of every stripe and only counts the symbols, then the headers
+ * and the tables built from the counts are written, and the second pass codes
+ * the kept stripes again without transforming them.
+ *
+ * Encoding to a target size keeps the stripes quantized with a divisor of 1,
+ * searches the quality whose estimated size fits, and replays the stripes
+ * requantized to it (counting them first with optimized tables).
+ */
+struct Stream_Encoder {
+    FILE *out;
+    Stream_Layout layout;
+    FDCT_Engine engine;
+    Color_Kernel kernel;
+    Thread_Pool *pool;
+    int segment_rows;           /* Rows per segment */
+    int batch_size;             /* Segments per batch */
+    Segment_Batch batches[2];
+    int filling;                /* Batch receiving rows */
+    int pending;                /* Non-zero if the other batch still has to be written */
+    int rows_received;          /* Image rows pushed so far */
+    int last_dc[3];             /* DC predictors of Y, Cb and Cr (without restarts) */
+    long table_offset;          /* File offset of the segment offsets table */
+    uint64_t position;          /* File offset of the next coded byte (restarts) */
+    uint64_t *segment_offsets;
+    int segments_written;
+    Index_Entry *index;         /* Index entries (BIN_FLAG_INDEX) */
+    Huffman_Encoder codes[NUM_HUFFMAN_CLASSES];     /* Codes of the luma and chroma blocks */
+    Blocks_ZigZag **stored;     /* Optimized coding or target size: coefficients of every stripe, else NULL */
+    Encoder_Pass pass;
+    int replay;                 /* Stripes are coded from 'stored' instead of being transformed */
+    int quality;                /* Quality factor of the quantization matrices */
+    uint64_t target_bytes;      /* Target file size, 0 = none */
+    int target_missed;          /* Non-zero if even MIN_QUALITY does not fit the target size */
+    int optimize;               /* Huffman tables built for the image */
+    Requant_Table requant[2];   /* Target size: luma and chroma divisors of the next replay, until applied */
+    int requantize;             /* Non-zero until the stored stripes are requantized */
+    Symbol_Histogram histogram[NUM_HUFFMAN_CLASSES];   /* First pass: symbols counted */
+    BMPFILEHEADER file_header;  /* Headers of the source image, written with the format flags */
+    BMPINFOHEADER info_header;
+    Pipeline_Stats *stats;      /* Caller's stats, or NULL */
+    double start_time;          /* When the encoder was created, for the elapsed time */
+    Bit_Read_Write bw;
+};
+
+void init_encoder_config(Encoder_Config *config) {
+    config->dct_method = DCT_METHOD_FAST;
+    config->threads = 1;
+    config->restart_interval = 0;
+    config->index_interval = 0;
+    config->optimize_huffman = 0;
+    config->quality = DEFAULT_QUALITY;
+    config->target_bytes = 0;
+    config->stats = NULL;
+}
+
+int parse_target_bytes(const char *text, uint64_t *bytes) {
+    char *end;
+    errno = 0;
+    unsigned long long value = strtoull(text, &end, 10);
+    if (end == text || *end != '\0' || text[0] == '-' || errno != 0 || value == 0) return FAILURE;
+
+    *bytes = (uint64_t)value;
+    return SUCCESS;
+}
+
+int parse_stripe_interval(const char *text, int *interval) {
+    char *end;
+    long value = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || value < 0 || value > 65535) return FAILURE;
+
+    *interval = (int)value;
+    return SUCCESS;
+}
+
+static int alloc_segment(Segment *segment, const Stream_Layout *layout) {
+    int width = layout->width;
+
+    segment->planes = alloc_planes(width, STRIPE_ROWS, layout->chroma_width, STRIPE_ROWS / 2);
+    segment->pair_Cb = malloc(2 * (size_t)width);
+    segment->pair_Cr = malloc(2 * (size_t)width);
+    segment->coefs = alloc_BlocosZigZag(2 * layout->blocks_x, layout->chroma_blocks_x, 0);
+    if (layout->restart_interval > 0) {
+        segment->bw = malloc(sizeof(Bit_Read_Write));
+        if (!segment->bw) return FAILURE;
+
+        if (layout->index_interval > 0) {
+            segment->stripe_entries = malloc(layout->restart_interval * sizeof(Index_Entry));
+            if (!segment->stripe_entries) return FAILURE;
+        }
+    }
+
+    return (segment->planes && segment->pair_Cb && segment->pair_Cr && segment->coefs) ? SUCCESS : FAILURE;
+}
+
+static void free_segment(Segment *segment) {
+    free(segment->rgb);
+    free_planes(segment->planes);
+    free(segment->pair_Cb);
+    free(segment->pair_Cr);
+    free_BlocosZigZag(segment->coefs);
+    free(segment->bw);
+    free(segment->bits);
+    free(segment->stripe_entries);
+}
+
+// Writes the headers with the format flags, the restart table (offsets filled in at the end) and the image's tables
+static int write_stream_header(Stream_Encoder *encoder, const Huffman_Spec *specs) {
+    FILE *out = encoder->out;
+    BMPFILEHEADER header = encoder->file_header;
+    header.bfReserved1 = encoder->layout.flags;
+    header.bfReserved2 = (encoder->layout.flags & BIN_FLAG_QUALITY) ? (unsigned short)encoder->quality : 0;
+    if (fwrite(&header, sizeof(header), 1, out) != 1 ||
+        fwrite(&encoder->info_header, sizeof(encoder->info_header), 1, out) != 1) {
+        return FAILURE;
+    }
+
+    if (encoder->layout.restart_interval > 0) {
+        int num_segments = encoder->layout.num_segments;
+        Restart_Header restart = {(unsigned int)encoder->layout.restart_interval, (unsigned int)num_segments};
+        if (fwrite(&restart, sizeof(restart), 1, out) != 1) return FAILURE;
+
+        encoder->table_offset = ftell(out);
+        if (encoder->table_offset < 0 ||
+            fwrite(encoder->segment_offsets, sizeof(uint64_t), num_segments, out) != (size_t)num_segments) {
+            return FAILURE;
+        }
+    }
+
+    // Luma DC and AC, then chroma DC and AC
+    for (int t = 0; specs && t < 2 * NUM_HUFFMAN_CLASSES; t++) {
+        if (write_huffman_spec(out, &specs[t]) != SUCCESS) return FAILURE;
+    }
+
+    if (encoder->layout.restart_interval > 0) encoder->position = (uint64_t)ftell(out);
+    init_bitwriter(&encoder->bw, out);
+    return SUCCESS;
+}
+
+Stream_Encoder *stream_encoder_create(FILE *out, const BMPFILEHEADER *fileHeader,
+                                      const BMPINFOHEADER *infoHeader, const Encoder_Config *config) {
+    Stream_Encoder *encoder = calloc(1, sizeof(Stream_Encoder));
+    if (!encoder) return NULL;
+
+    int width = infoHeader->biWidth;
+    int height = infoHeader->biHeight;
+
+    encoder->out = out;
+    encoder->file_header = *fileHeader;
+    encoder->info_header = *infoHeader;
+    encoder->stats = config->stats;
+    if (encoder->stats) {
+        init_pipeline_stats(encoder->stats);
+        encoder->stats->pixels = (uint64_t)width * (uint64_t)height;
+        encoder->start_time = monotonic_seconds();
+    }
+    init_stream_layout(&encoder->layout, width, height, BIN_FLAG_CHROMA_420 | BIN_FLAG_STRIPES);
+
+    // A single segment never needs more stripes than the image has
+    int interval = config->restart_interval;
+    if (interval > encoder->layout.num_stripes) interval = encoder->layout.num_stripes;
+    set_restart_interval(&encoder->layout, interval);
+
+    int index_interval = config->index_interval;
+    if (index_interval > encoder->layout.num_stripes) index_interval = encoder->layout.num_stripes;
+    set_index_interval(&encoder->layout, index_interval);
+
+    encoder->quality = config->quality;
+    encoder->target_bytes = config->target_bytes;
+    encoder->optimize = config->optimize_huffman;
+    if (encoder->quality < MIN_QUALITY || encoder->quality > MAX_QUALITY) {
+        report_error("Invalid quality %d.", encoder->quality);
+        free(encoder);
+        return NULL;
+    }
+    init_fdct_engine(&encoder->engine, config->dct_method, encoder->quality);
+    encoder->kernel = detect_color_kernel();
+
+    // Target size: the quality is searched once every stripe is transformed, quantized with a divisor of 1
+    if (encoder->target_bytes > 0) {
+        uint8_t unit[BLOCK_SIZE][BLOCK_SIZE];
+        memset(unit, 1, sizeof(unit));
+        init_quant_table(&encoder->engine.lumin, (const uint8_t (*)[BLOCK_SIZE])unit);
+        init_quant_table(&encoder->engine.chrom, (const uint8_t (*)[BLOCK_SIZE])unit);
+    }
+    for (int c = 0; c < NUM_HUFFMAN_CLASSES; c++) init_standard_huffman_encoder(&encoder->codes[c]);
+
+    encoder->pool = thread_pool_create(config->threads);
+    if (!encoder->pool) {
+        free(encoder);
+        return NULL;
+    }
+
+    // One segment per thread, never more than the image has
+    int num_units = interval > 0 ? encoder->layout.num_segments : encoder->layout.num_stripes;
+    encoder->segment_rows = (interval > 0 ? interval : 1) * STRIPE_ROWS;
+    encoder->batch_size = thread_pool_size(encoder->pool);
+    if (encoder->batch_size > num_units) encoder->batch_size = num_units;
+
+    for (int b = 0; b < 2; b++) {
+        Segment_Batch *batch = &encoder->batches[b];
+        batch->encoder = encoder;
+        batch->segments = calloc(encoder->batch_size, sizeof(Segment));
+        if (!batch->segments) {
+            stream_encoder_free(encoder);
+            return NULL;
+        }
+
+        for (int i = 0; i < encoder->batch_size; i++) {
+            if (alloc_segment(&batch->segments[i], &encoder->layout) != SUCCESS) {
+                stream_encoder_free(encoder);
+                return NULL;
+            }
+        }
+    }
+
+    if (interval > 0) {
+        encoder->segment_offsets = calloc(encoder->layout.num_segments, sizeof(uint64_t));
+        if (!encoder->segment_offsets) {
+            stream_encoder_free(encoder);
+            return NULL;
+        }
+    }
+
+    if (index_interval > 0) {
+        encoder->index = calloc(encoder->layout.num_index_entries, sizeof(Index_Entry));
+        if (!encoder->index) {
+            stream_encoder_free(encoder);
+            return NULL;
+        }
+    }
+
+    // A target size picks its quality, and sets the flag, once every stripe is transformed
+    if (encoder->target_bytes == 0 && encoder->quality != DEFAULT_QUALITY) encoder->layout.flags |= BIN_FLAG_QUALITY;
+
+    // Optimized coding and target sizes keep every stripe; the headers wait for the tables or the quality
+    if (encoder->optimize || encoder->target_bytes > 0) {
+        int num_stripes = encoder->layout.num_stripes;
+        encoder->pass = encoder->target_bytes > 0 ? PASS_KEEP : PASS_COUNT;
+        encoder->stored = calloc(num_stripes, sizeof(Blocks_ZigZag *));
+        for (int s = 0; encoder->stored && s < num_stripes; s++) {
+            encoder->stored[s] = alloc_BlocosZigZag(2 * encoder->layout.blocks_x, encoder->layout.chroma_blocks_x, 0);
+            if (!encoder->stored[s]) break;
+        }
+        if (!encoder->stored || !encoder->stored[num_stripes - 1]) {
+            report_error("Error allocating the coefficients of the image.");
+            stream_encoder_free(encoder);
+            return NULL;
+        }
+    }
+
+    if (!encoder->stored && write_stream_header(encoder, NULL) != SUCCESS) {
+        stream_encoder_free(encoder);
+        return NULL;
+    }
+
+    return encoder;
+}
+
+// DCT and fused quantization + zigzag of every 8x8 block of a plane into its slab; partial edge blocks repeat the
+// last row/column
+static void transform_plane(const uint8_t *plane, int plane_width, int plane_height, int level_shift,
+                            const FDCT_Engine *engine, const Quant_Table *table, int16_t *slab) {
+    int block_idx = 0;
+
+    for (int j = 0; j < plane_height; j += BLOCK_SIZE) {
+        for (int i = 0; i < plane_width; i += BLOCK_SIZE) {
+            int16_t block[BLOCK_SIZE][BLOCK_SIZE];
+
+            for (int y = 0; y < BLOCK_SIZE; y++) {
+                int dy = (j + y < plane_height) ? j + y : plane_height - 1;
+                for (int x = 0; x < BLOCK_SIZE; x++) {
+                    int dx = (i + x < plane_width) ? i + x : plane_width - 1;
+                    block[x][y] = (int16_t)(plane[(size_t)dy * plane_width + dx] - level_shift);
+                }
+            }
+
+            // DCT + quantization, written in scan order
+            engine->transform(engine, (const int16_t (*)[BLOCK_SIZE])block, table, block_coefs(slab, block_idx));
+            block_idx++;
+        }
+    }
+}
+
+// Delta codes the DC of each block against the channel predictor and Huffman codes its symbols (or counts them),
+// in one pass over the coefficients; the slab is left as is, so that a stored stripe can be coded again
+static int code_blocks(const Block_Sink *sink, int channel_class, int16_t *slab, int num_blocks, int *last_dc) {
+    double t = stage_start(sink->stats);
+
+    for (int b = 0; b < num_blocks; b++) {
+        const int16_t *coef = block_coefs(slab, b);
+        int dc_diff = (int16_t)(coef[0] - *last_dc);
+        *last_dc = coef[0];
+
+        if (sink->histogram) {
+            count_coef_symbols(&sink->histogram[channel_class], coef, dc_diff);
+        } else if (write_coef_block(sink->bw, coef, dc_diff, &sink->codes[channel_class], sink->stats) != SUCCESS) {
+            return FAILURE;
+        }
+    }
+
+    stage_lap(sink->stats, STAGE_HUFFMAN, t);
+    return SUCCESS;
+}
+
+// Color conversion, 4:2:0 downsampling, DCT, quantization and zigzag of one stripe of a segment into 'coefs'
+static void transform_stripe(const Stream_Encoder *encoder, Segment *segment, Blocks_ZigZag *coefs,
+                             const uint8_t *rgb, ptrdiff_t stride, int rows, Pipeline_Stats *stats) {
+    const FDCT_Engine *engine = &encoder->engine;
+    YCbCr_Planes *planes = segment->planes;
+    int width = planes->width;
+    int chroma_rows = (rows + 1) / 2;
+    double t = stage_start(stats);
+
+    for (int y = 0; y < rows; y += 2) {
+        int pair_rows = (y + 1 < rows) ? 2 : 1;
+
+        for (int r = 0; r < pair_rows; r++) {
+            size_t offset = (size_t)(y + r) * width;
+            const RGB_Pixel *row = (const RGB_Pixel *)(rgb + (ptrdiff_t)(y + r) * stride);
+            rgb_to_ycbcr_planes(row, planes->Y + offset, segment->pair_Cb + (size_t)r * width,
+                                segment->pair_Cr + (size_t)r * width, width, encoder->kernel);
+        }
+        t = stage_lap(stats, STAGE_COLOR, t);
+
+        // An odd last row pairs with itself
+        const uint8_t *second_Cb = segment->pair_Cb + (size_t)(pair_rows - 1) * width;
+        const uint8_t *second_Cr = segment->pair_Cr + (size_t)(pair_rows - 1) * width;
+        size_t chroma_offset = (size_t)(y / 2) * planes->chroma_width;
+
+        downsample_row_pair(segment->pair_Cb, second_Cb, planes->Cb + chroma_offset, width);
+        downsample_row_pair(segment->pair_Cr, second_Cr, planes->Cr + chroma_offset, width);
+        t = stage_lap(stats, STAGE_SUBSAMPLE, t);
+    }
+
+    transform_plane(planes->Y, width, rows, 128, engine, &engine->lumin, coefs->Y_blocks);
+
+    // Chroma planes carry a +128 offset on top of the level shift
+    transform_plane(planes->Cb, planes->chroma_width, chroma_rows, 256, engine, &engine->chrom,
+                    coefs->Cb_blocks);
+    transform_plane(planes->Cr, planes->chroma_width, chroma_rows, 256, engine, &engine->chrom,
+                    coefs->Cr_blocks);
+    stage_lap(stats, STAGE_TRANSFORM, t);
+}
+
+// Where a stripe starts in the bitstream, with the predictors its first blocks are coded against
+static Index_Entry index_entry(Bit_Read_Write *bw, const int *last_dc) {
+    Index_Entry entry;
+    entry.bit_offset = bit_writer_position(bw);
+    for (int c = 0; c < 3; c++) entry.last_dc[c] = (int16_t)last_dc[c];
+    return entry;
+}
+
+// Entropy codes a transformed stripe: its Y blocks, then Cb, then Cr
+static int code_stripe(const Block_Sink *sink, const Stream_Layout *layout, Blocks_ZigZag *coefs, int rows,
+                       int *last_dc) {
+    int num_blocks = plane_blocks(layout->width, rows);
+    int num_chroma_blocks = plane_blocks(layout->chroma_width, (rows + 1) / 2);
+
+    if (code_blocks(sink, 0, coefs->Y_blocks, num_blocks, &last_dc[0]) != SUCCESS ||
+        code_blocks(sink, 1, coefs->Cb_blocks, num_chroma_blocks, &last_dc[1]) != SUCCESS ||
+        code_blocks(sink, 1, coefs->Cr_blocks, num_chroma_blocks, &last_dc[2]) != SUCCESS) {
+        return FAILURE;
+    }
+    return SUCCESS;
+}
+
+// Target size: requantizes a stripe kept with a divisor of 1 to the chosen quality
+static void requantize_stripe(const Stream_Encoder *encoder, Blocks_ZigZag *coefs, int rows, Pipeline_Stats *stats) {
+    const Stream_Layout *layout = &encoder->layout;
+    int num_chroma_blocks = plane_blocks(layout->chroma_width, (rows + 1) / 2);
+    double t = stage_start(stats);
+
+    requantize_blocks(coefs->Y_blocks, plane_blocks(layout->width, rows), &encoder->requant[0]);
+    requantize_blocks(coefs->Cb_blocks, num_chroma_blocks, &encoder->requant[1]);
+    requantize_blocks(coefs->Cr_blocks, num_chroma_blocks, &encoder->requant[1]);
+    stage_lap(stats, STAGE_TRANSFORM, t);
+}
+
+// Coefficients of a stripe: kept for the whole image with optimized coding, else in the segment
+static Blocks_ZigZag *stripe_coefs(const Stream_Encoder *encoder, Segment *segment, int stripe) {
+    return encoder->stored ? encoder->stored[stripe] : segment->coefs;
+}
+
+// Pool task: transforms every stripe of a segment; a restart segment is also coded into memory (or counted)
+static void process_segment(void *context, int index) {
+    Segment_Batch *batch = context;
+    const Stream_Encoder *encoder = batch->encoder;
+    Segment *segment = &batch->segments[index];
+    int restart = encoder->layout.restart_interval > 0;
+    Pipeline_Stats *stats = encoder->stats ? &segment->stats : NULL;
+    if (stats) init_pipeline_stats(stats);
+
+    // Each restart segment starts byte aligned with the DC predictors at zero
+    FILE *stream = NULL;
+    int last_dc[3] = {0, 0, 0};
+    Block_Sink sink = {segment->bw, encoder->codes, NULL, stats};
+    segment->status = SUCCESS;
+    if (restart && encoder->pass == PASS_COUNT) {
+        memset(segment->histogram, 0, sizeof(segment->histogram));
+        sink.histogram = segment->histogram;
+    } else if (restart && encoder->pass == PASS_WRITE) {
+        stream = open_memstream(&segment->bits, &segment->bits_size);
+        if (!stream) {
+            segment->status = FAILURE;
+            return;
+        }
+        init_bitwriter(segment->bw, stream);
+    }
+
+    for (int first = 0; first < segment->rows; first += STRIPE_ROWS) {
+        int rows = (segment->rows - first < STRIPE_ROWS) ? segment->rows - first : STRIPE_ROWS;
+        Blocks_ZigZag *coefs = stripe_coefs(encoder, segment, segment->first_stripe + first / STRIPE_ROWS);
+
+        if (!encoder->replay) {
+            const uint8_t *rgb = segment->src ? segment->src : (const uint8_t *)segment->rgb;
+            ptrdiff_t stride = segment->src ? segment->src_stride
+                                            : (ptrdiff_t)encoder->layout.width * (ptrdiff_t)sizeof(RGB_Pixel);
+            transform_stripe(encoder, segment, coefs, rgb + (ptrdiff_t)first * stride, stride, rows, stats);
+        } else if (encoder->requantize) {
+            requantize_stripe(encoder, coefs, rows, stats);
+        }
+
+        if (restart && encoder->pass != PASS_KEEP && segment->status == SUCCESS) {
+            if (segment->stripe_entries && stream) {
+                segment->stripe_entries[first / STRIPE_ROWS] = index_entry(segment->bw, last_dc);
+            }
+            segment->status = code_stripe(&sink, &encoder->layout, coefs, rows, last_dc);
+        }
+    }
+
+    if (stream) {
+        flush_bits(segment->bw);
+        if (fclose(stream) != 0) segment->status = FAILURE;
+    }
+}
+
+// Writes the processed segments of a batch, in image order
+static int write_batch(Stream_Encoder *encoder, Segment_Batch *batch) {
+    const Stream_Layout *layout = &encoder->layout;
+    int status = SUCCESS;
+
+    for (int i = 0; i < batch->count; i++) {
+        Segment *segment = &batch->segments[i];
+        if (encoder->stats) add_pipeline_stats(encoder->stats, &segment->stats);
+
+        if (encoder->pass == PASS_KEEP) {
+            if (segment->status != SUCCESS) status = FAILURE;
+        } else if (layout->restart_interval > 0 && encoder->pass == PASS_COUNT) {
+            if (segment->status != SUCCESS) status = FAILURE;
+            for (int c = 0; c < NUM_HUFFMAN_CLASSES; c++) {
+                add_symbol_histogram(&encoder->histogram[c], &segment->histogram[c]);
+            }
+        } else if (layout->restart_interval > 0) {
+            double t = stage_start(encoder->stats);
+            if (segment->status != SUCCESS ||
+                fwrite(segment->bits, 1, segment->bits_size, encoder->out) != segment->bits_size) {
+                status = FAILURE;
+            }
+            stage_lap(encoder->stats, STAGE_WRITE, t);
+
+            // Stripe offsets were taken inside the segment
+            int stripes = (segment->rows + STRIPE_ROWS - 1) / STRIPE_ROWS;
+            for (int k = 0; segment->stripe_entries && k < stripes; k++) {
+                int stripe = segment->first_stripe + k;
+                if (stripe % layout->index_interval != 0) continue;
+
+                Index_Entry *entry = &encoder->index[stripe / layout->index_interval];
+                *entry = segment->stripe_entries[k];
+                entry->bit_offset += encoder->position * 8;
+            }
+
+            encoder->segment_offsets[encoder->segments_written++] = encoder->position;
+            encoder->position += segment->bits_size;
+            free(segment->bits);
+            segment->bits = NULL;
+        } else if (status == SUCCESS) {
+            if (encoder->index && encoder->pass == PASS_WRITE && segment->first_stripe % layout->index_interval == 0) {
+                encoder->index[segment->first_stripe / layout->index_interval] =
+                    index_entry(&encoder->bw, encoder->last_dc);
+            }
+            Block_Sink sink = {&encoder->bw, encoder->codes, encoder->pass == PASS_COUNT ? encoder->histogram : NULL,
+                               encoder->stats};
+            status = code_stripe(&sink, layout, stripe_coefs(encoder, segment, segment->first_stripe), segment->rows,
+                                 encoder->last_dc);
+        }
+        segment->rows = 0;
+    }
+
+    batch->count = 0;
+    return status;
+}
+
+// Starts processing the filled batch, then writes the previous one while the pool works
+static int dispatch_batch(Stream_Encoder *encoder) {
+    Segment_Batch *filled = &encoder->batches[encoder->filling];
+    Segment_Batch *previous = &encoder->batches[!encoder->filling];
+
+    thread_pool_submit(encoder->pool, process_segment, filled, filled->count);
+
+    if (encoder->pending && write_batch(encoder, previous) != SUCCESS) return FAILURE;
+
+    encoder->pending = 1;
+    encoder->filling = !encoder->filling;
+    return SUCCESS;
+}
+
+int stream_encoder_write_rows(Stream_Encoder *encoder, const RGB_Pixel *rows, int count) {
+    int width = encoder->layout.width;
+    int height = encoder->layout.height;
+
+    for (int r = 0; r < count; r++) {
+        if (encoder->rows_received >= height) {
+            report_error("Too many rows pushed to the encoder.");
+            return FAILURE;
+        }
+
+        Segment_Batch *batch = &encoder->batches[encoder->filling];
+        Segment *segment = &batch->segments[batch->count];
+        if (segment->rows == 0) segment->first_stripe = encoder->rows_received / STRIPE_ROWS;
+        if (!segment->rgb) {
+            segment->rgb = malloc((size_t)encoder->segment_rows * width * sizeof(RGB_Pixel));
+            if (!segment->rgb) {
+                report_error("Error allocating RGB pixels.");
+                return FAILURE;
+            }
+        }
+
+        memcpy(segment->rgb + (size_t)segment->rows * width, rows + (size_t)r * width, (size_t)width * sizeof(RGB_Pixel));
+        segment->rows++;
+        encoder->rows_received++;
+        int last_row = encoder->rows_received == height;
+
+        if (segment->rows == encoder->segment_rows || last_row) {
+            batch->count++;
+            if (batch->count == encoder->batch_size || last_row) {
+                if (dispatch_batch(encoder) != SUCCESS) return FAILURE;
+            }
+        }
+    }
+
+    return SUCCESS;
+}
+
+int stream_encoder_write_image(Stream_Encoder *encoder, const uint8_t *top_row, ptrdiff_t stride) {
+    int height = encoder->layout.height;
+    if (encoder->rows_received != 0) {
+        report_error("Rows were already pushed to the encoder.");
+        return FAILURE;
+    }
+
+    // Each segment points at its rows, which the pool color converts where they are
+    while (encoder->rows_received < height) {
+        Segment_Batch *batch = &encoder->batches[encoder->filling];
+        Segment *segment = &batch->segments[batch->count++];
+        int rows = height - encoder->rows_received;
+        if (rows > encoder->segment_rows) rows = encoder->segment_rows;
+
+        segment->first_stripe = encoder->rows_received / STRIPE_ROWS;
+        segment->src = top_row + (ptrdiff_t)encoder->rows_received * stride;
+        segment->src_stride = stride;
+        segment->rows = rows;
+        encoder->rows_received += rows;
+
+        if (batch->count == encoder->batch_size || encoder->rows_received == height) {
+            if (dispatch_batch(encoder) != SUCCESS) return FAILURE;
+        }
+    }
+
+    return SUCCESS;
+}
+
+// Waits for the last dispatched batch and writes it
+static int flush_batches(Stream_Encoder *encoder) {
+    thread_pool_wait(encoder->pool);
+    if (encoder->pending && write_batch(encoder, &encoder->batches[!encoder->filling]) != SUCCESS) return FAILURE;
+    encoder->pending = 0;
+    return SUCCESS;
+}
+
+// Builds the tables of the image for the counted symbols into 'specs' and 'codes'; returns 0 (standard tables kept)
+// if they save nothing
+static int choose_image_tables(const Symbol_Histogram *histograms, const Huffman_Encoder *standard_codes,
+                               Huffman_Spec *specs, Huffman_Encoder *codes) {
+    uint64_t standard_bits = 0, image_bits = 0;
+
+    for (int c = 0; c < NUM_HUFFMAN_CLASSES; c++) {
+        const Symbol_Histogram *histogram = &histograms[c];
+        Huffman_Spec *dc = &specs[2 * c], *ac = &specs[2 * c + 1];
+        build_huffman_spec(histogram->dc, DC_CATEGORIES, dc);
+        build_huffman_spec(histogram->ac, 256, ac);
+        if (spec_huffman_encoder(&codes[c], dc, ac) != SUCCESS) return 0;
+
+        uint64_t standard = histogram_code_bits(histogram, &standard_codes[c]);
+        standard_bits = (standard == UINT64_MAX || standard_bits == UINT64_MAX) ? UINT64_MAX : standard_bits + standard;
+        image_bits += histogram_code_bits(histogram, &codes[c]) + 8 * (huffman_spec_size(dc) + huffman_spec_size(ac));
+    }
+
+    return image_bits < standard_bits;
+}
+
+// Builds the tables of the image from the first pass counts; returns 0 (standard tables kept) if they save nothing
+static int build_image_tables(Stream_Encoder *encoder, Huffman_Spec *specs) {
+    Huffman_Encoder codes[NUM_HUFFMAN_CLASSES];
+    if (!choose_image_tables(encoder->histogram, encoder->codes, specs, codes)) return 0;
+
+    memcpy(encoder->codes, codes, sizeof(codes));
+    encoder->layout.flags |= BIN_FLAG_HUFFMAN;
+    return 1;
+}
+
+// Codes every stored stripe again, without transforming it, in the current pass
+static int replay_stripes(Stream_Encoder *encoder) {
+    encoder->replay = 1;
+    for (int c = 0; c < 3; c++) encoder->last_dc[c] = 0;
+
+    int height = encoder->layout.height;
+    for (int row = 0; row < height; row += encoder->segment_rows) {
+        Segment_Batch *batch = &encoder->batches[encoder->filling];
+        Segment *segment = &batch->segments[batch->count++];
+        segment->first_stripe = row / STRIPE_ROWS;
+        segment->rows = (height - row < encoder->segment_rows) ? height - row : encoder->segment_rows;
+
+        if (batch->count == encoder->batch_size || row + segment->rows == height) {
+            if (dispatch_batch(encoder) != SUCCESS) return FAILURE;
+        }
+    }
+
+    if (flush_batches(encoder) != SUCCESS) return FAILURE;
+    encoder->requantize = 0;
+    return SUCCESS;
+}
+
+// Luma and chroma divisors of a quality, for the stripes kept with a divisor of 1
+static void init_quality_requant(int quality, Requant_Table *requant) {
+    uint8_t matrix[BLOCK_SIZE][BLOCK_SIZE];
+    scale_quant_matrix(lumin_matrix, quality, matrix);
+    init_requant_table(&requant[0], (const uint8_t (*)[BLOCK_SIZE])matrix);
+    scale_quant_matrix(chrom_matrix, quality, matrix);
+    init_requant_table(&requant[1], (const uint8_t (*)[BLOCK_SIZE])matrix);
+}
+
+// Counts the symbols of every stored stripe requantized by 'requant', as the first pass of optimized coding does
+static void count_stored_symbols(const Stream_Encoder *encoder, const Requant_Table *requant,
+                                 Symbol_Histogram *histogram) {
+    const Stream_Layout *layout = &encoder->layout;
+    memset(histogram, 0, NUM_HUFFMAN_CLASSES * sizeof(*histogram));
+
+    int last_dc[3] = {0, 0, 0};
+    for (int stripe = 0; stripe < layout->num_stripes; stripe++) {
+        if (layout->restart_interval > 0 && stripe % layout->restart_interval == 0) {
+            for (int c = 0; c < 3; c++) last_dc[c] = 0;
+        }
+
+        const Blocks_ZigZag *coefs = encoder->stored[stripe];
+        int rows = (layout->height - stripe * STRIPE_ROWS < STRIPE_ROWS) ? layout->height - stripe * STRIPE_ROWS
+                                                                         : STRIPE_ROWS;
+        int num_blocks = plane_blocks(layout->width, rows);
+        int num_chroma_blocks = plane_blocks(layout->chroma_width, (rows + 1) / 2);
+        count_requantized_symbols(coefs->Y_blocks, num_blocks, &requant[0], &histogram[0], &last_dc[0]);
+        count_requantized_symbols(coefs->Cb_blocks, num_chroma_blocks, &requant[1], &histogram[1], &last_dc[1]);
+        count_requantized_symbols(coefs->Cr_blocks, num_chroma_blocks, &requant[1], &histogram[1], &last_dc[2]);
+    }
+}
+
+// Exact size of the file with the stored stripes requantized by 'requant' and coded at the luma and chroma 'costs'
+static uint64_t estimate_file_size(const Stream_Encoder *encoder, const Requant_Table *requant,
+                                   const Symbol_Costs *costs) {
+    const Stream_Layout *layout = &encoder->layout;
+    uint64_t bytes = BMP_HEADERS_SIZE + (uint64_t)layout->num_index_entries * sizeof(Index_Entry);
+    if (layout->restart_interval > 0) bytes += sizeof(Restart_Header) + layout->num_segments * sizeof(uint64_t);
+    if (layout->index_interval > 0) bytes += sizeof(Index_Footer);
+
+    // Restart segments start byte aligned, with the predictors at zero
+    uint64_t bits = 0;
+    int last_dc[3] = {0, 0, 0};
+    for (int stripe = 0; stripe < layout->num_stripes; stripe++) {
+        if (layout->restart_interval > 0 && stripe % layout->restart_interval == 0) {
+            bytes += (bits + 7) / 8;
+            bits = 0;
+            for (int c = 0; c < 3; c++) last_dc[c] = 0;
+        }
+
+        const Blocks_ZigZag *coefs = encoder->stored[stripe];
+        int rows = (layout->height - stripe * STRIPE_ROWS < STRIPE_ROWS) ? layout->height - stripe * STRIPE_ROWS
+                                                                         : STRIPE_ROWS;
+        int num_blocks = plane_blocks(layout->width, rows);
+        int num_chroma_blocks = plane_blocks(layout->chroma_width, (rows + 1) / 2);
+        uint64_t parts[3] = {
+            estimate_blocks_bits(coefs->Y_blocks, num_blocks, &requant[0], &costs[0], &last_dc[0]),
+            estimate_blocks_bits(coefs->Cb_blocks, num_chroma_blocks, &requant[1], &costs[1], &last_dc[1]),
+            estimate_blocks_bits(coefs->Cr_blocks, num_chroma_blocks, &requant[1], &costs[1], &last_dc[2])
+        };
+        for (int c = 0; c < 3; c++) {
+            if (parts[c] == UINT64_MAX) return UINT64_MAX;
+            bits += parts[c];
+        }
+    }
+
+    return bytes + (bits + 7) / 8;
+}
+
+// Exact size of the file at a quality: with the standard tables, or with optimized coding the tables that
+// build_image_tables() will pick for the symbols of that quality
+static uint64_t estimate_quality_size(const Stream_Encoder *encoder, int quality, const Symbol_Costs *standard_costs) {
+    Requant_Table requant[2];
+    init_quality_requant(quality, requant);
+    if (!encoder->optimize) return estimate_file_size(encoder, requant, standard_costs);
+
+    Symbol_Histogram histogram[NUM_HUFFMAN_CLASSES];
+    Huffman_Spec specs[2 * NUM_HUFFMAN_CLASSES];
+    Huffman_Encoder codes[NUM_HUFFMAN_CLASSES];
+    count_stored_symbols(encoder, requant, histogram);
+    if (!choose_image_tables(histogram, encoder->codes, specs, codes)) {
+        return estimate_file_size(encoder, requant, standard_costs);
+    }
+
+    // The tables follow the headers
+    Symbol_Costs costs[NUM_HUFFMAN_CLASSES];
+    uint64_t table_bytes = 0;
+    for (int c = 0; c < NUM_HUFFMAN_CLASSES; c++) {
+        init_symbol_costs(&costs[c], &codes[c]);
+        table_bytes += huffman_spec_size(&specs[2 * c]) + huffman_spec_size(&specs[2 * c + 1]);
+    }
+    uint64_t bytes = estimate_file_size(encoder, requant, costs);
+    return bytes == UINT64_MAX ? UINT64_MAX : bytes + table_bytes;
+}
+
+// Target size: picks the highest quality whose estimated size fits (the lowest, flagged as missed, if none does)
+static void choose_quality(Stream_Encoder *encoder) {
+    // The codes are still the standard ones
+    Symbol_Costs costs[NUM_HUFFMAN_CLASSES];
+    for (int c = 0; c < NUM_HUFFMAN_CLASSES; c++) init_symbol_costs(&costs[c], &encoder->codes[c]);
+    double t = stage_start(encoder->stats);
+
+    // Sizes grow with the quality, so a binary search needs about 7 estimates
+    int low = MIN_QUALITY, high = MAX_QUALITY;
+    encoder->quality = MIN_QUALITY;
+    encoder->target_missed = 1;
+    while (low <= high) {
+        int quality = (low + high) / 2;
+        if (estimate_quality_size(encoder, quality, costs) <= encoder->target_bytes) {
+            encoder->quality = quality;
+            encoder->target_missed = 0;
+            low = quality + 1;
+        } else {
+            high = quality - 1;
+        }
+    }
+    stage_lap(encoder->stats, STAGE_HUFFMAN, t);
+
+    init_quality_requant(encoder->quality, encoder->requant);
+    encoder->requantize = 1;
+
+    if (encoder->quality != DEFAULT_QUALITY) encoder->layout.flags |= BIN_FLAG_QUALITY;
+}
+
+int stream_encoder_finish(Stream_Encoder *encoder) {
+    if (encoder->rows_received != encoder->layout.height) {
+        report_error("Expected %d rows, got %d.", encoder->layout.height, encoder->rows_received);
+        return FAILURE;
+    }
+
+    // The last dispatched batch is still pending
+    if (flush_batches(encoder) != SUCCESS) return FAILURE;
+
+    // Target size: the stripes are requantized by the replay that follows
+    if (encoder->pass == PASS_KEEP) {
+        choose_quality(encoder);
+        encoder->pass = encoder->optimize ? PASS_COUNT : PASS_WRITE;
+        if (encoder->pass == PASS_COUNT && replay_stripes(encoder) != SUCCESS) return FAILURE;
+    }
+
+    // Optimized coding: the symbols are counted, so the tables and the headers can be written
+    if (encoder->stored) {
+        Huffman_Spec specs[2 * NUM_HUFFMAN_CLASSES];
+        int image_tables = encoder->pass == PASS_COUNT && build_image_tables(encoder, specs);
+
+        encoder->pass = PASS_WRITE;
+        if (write_stream_header(encoder, image_tables ? specs : NULL) != SUCCESS ||
+            replay_stripes(encoder) != SUCCESS) {
+            return FAILURE;
+        }
+    }
+    double t = stage_start(encoder->stats);
+
+    if (encoder->layout.restart_interval > 0) {
+        // Fill in the segment offsets reserved after the headers
+        int num_segments = encoder->layout.num_segments;
+        if (fseek(encoder->out, encoder->table_offset, SEEK_SET) != 0 ||
+            fwrite(encoder->segment_offsets, sizeof(uint64_t), num_segments, encoder->out) != (size_t)num_segments ||
+            fseek(encoder->out, 0, SEEK_END) != 0) {
+            return FAILURE;
+        }
+    } else {
+        flush_bits(&encoder->bw);
+    }
+
+    // Index footer: the entries, then their interval and count
+    if (encoder->index) {
+        Index_Footer footer = {(unsigned int)encoder->layout.index_interval,
+                               (unsigned int)encoder->layout.num_index_entries};
+        if (fwrite(encoder->index, sizeof(Index_Entry), footer.num_entries, encoder->out) != footer.num_entries ||
+            fwrite(&footer, sizeof(footer), 1, encoder->out) != 1) {
+            return FAILURE;
+        }
+    }
+
+    if (encoder->stats) {
+        stage_lap(encoder->stats, STAGE_WRITE, t);
+        encoder->stats->elapsed_seconds = monotonic_seconds() - encoder->start_time;
+    }
+    if (ferror(encoder->out)) return FAILURE;
+    return encoder->target_missed ? ENCODER_TARGET_MISSED : SUCCESS;
+}
+
+int stream_encoder_quality(const Stream_Encoder *encoder) {
+    return encoder->quality;
+}
+
+void stream_encoder_free(Stream_Encoder *encoder) {
+    if (!encoder) return;
+
+    // Joins the workers, which may still be processing a batch
+    thread_pool_destroy(encoder->pool);
+
+    for (int b = 0; b < 2; b++) {
+        Segment_Batch *batch = &encoder->batches[b];
+        if (!batch->segments) continue;
+        for (int i = 0; i < encoder->batch_size; i++) {
+            free_segment(&batch->segments[i]);
+        }
+        free(batch->segments);
+    }
+    for (int s = 0; encoder->stored && s < encoder->layout.num_stripes; s++) {
+        free_BlocosZigZag(encoder->stored[s]);
+    }
+    free(encoder->stored);
+    free(encoder->segment_offsets);
+    free(encoder->index);
+    free(encoder);
+}
@@ -0,0 +1,371 @@
+#include "huffman.h"
+
+#include <string.h>
+
+int build_dc_decoder(Huffman_Decoder *dec, const DC_Huffman_Code *table, int count) {
+    uint32_t codes[256];
+    int lengths[256];
+    uint8_t symbols[256];
+
+    if (count > 256) return FAILURE;
+
+    for (int i = 0; i < count; i++) {
+        codes[i] = table[i].code;
+        lengths[i] = table[i].code_length;
+        symbols[i] = (uint8_t)table[i].category;
+    }
+
+    return build_huffman_decoder(dec, codes, lengths, symbols, count);
+}
+
+int build_ac_decoder(Huffman_Decoder *dec, const AC_Huffman_Code *table, int count) {
+    uint32_t codes[256];
+    int lengths[256];
+    uint8_t symbols[256];
+
+    if (count > 256) return FAILURE;
+
+    for (int i = 0; i < count; i++) {
+        codes[i] = table[i].code;
+        lengths[i] = table[i].code_length;
+        symbols[i] = (uint8_t)((table[i].zeros << 4) | table[i].category);
+    }
+
+    return build_huffman_decoder(dec, codes, lengths, symbols, count);
+}
+
+int build_huffman_decoder(Huffman_Decoder *dec, const uint32_t *codes, const int *lengths,
+                          const uint8_t *symbols, int count) {
+    int max_length = 0;
+    int num_sub = 0;
+
+    memset(dec->root, 0, sizeof(dec->root));
+    dec->sub = NULL;
+    dec->sub_bits = 0;
+
+    for (int i = 0; i < count; i++) {
+        if (lengths[i] < 1 || lengths[i] > HUFFMAN_MAX_CODE_LENGTH) return FAILURE;
+        if (lengths[i] > max_length) max_length = lengths[i];
+    }
+
+    // Count the distinct root prefixes of the long codes to size the second level
+    if (max_length > HUFFMAN_ROOT_BITS) {
+        dec->sub_bits = max_length - HUFFMAN_ROOT_BITS;
+
+        for (int i = 0; i < count; i++) {
+            if (lengths[i] <= HUFFMAN_ROOT_BITS) continue;
+            uint32_t prefix = codes[i] >> (lengths[i] - HUFFMAN_ROOT_BITS);
+            if (!(dec->root[prefix] & HUFFMAN_SUBTABLE_FLAG)) {
+                dec->root[prefix] = HUFFMAN_SUBTABLE_FLAG | (uint16_t)num_sub;
+                num_sub++;
+            }
+        }
+
+        dec->sub = calloc((size_t)num_sub << dec->sub_bits, sizeof(uint16_t));
+        if (!dec->sub) return FAILURE;
+    }
+
+    // Fill from the longest codes to the shortest: an entry that is already taken (or a root entry pointing at a
+    // second-level table) means that a code is a prefix of another one, which could never be decoded
+    int collision = 0;
+    for (int length = max_length; length >= 1 && !collision; length--) {
+        for (int i = 0; i < count && !collision; i++) {
+            if (lengths[i] != length) continue;
+
+            uint16_t entry = (uint16_t)((length << 8) | symbols[i]);
+
+            if (length <= HUFFMAN_ROOT_BITS) {
+                uint32_t first = codes[i] << (HUFFMAN_ROOT_BITS - length);
+                uint32_t n = 1u << (HUFFMAN_ROOT_BITS - length);
+                for (uint32_t k = 0; k < n; k++) {
+                    if (dec->root[first + k] != 0) collision = 1;
+                    dec->root[first + k] = entry;
+                }
+            } else {
+                int extra = length - HUFFMAN_ROOT_BITS;
+                uint16_t root_entry = dec->root[codes[i] >> extra];
+                uint16_t *sub = dec->sub + ((size_t)(root_entry & ~HUFFMAN_SUBTABLE_FLAG) << dec->sub_bits);
+                uint32_t first = (codes[i] & ((1u << extra) - 1)) << (dec->sub_bits - extra);
+                uint32_t n = 1u << (dec->sub_bits - extra);
+                for (uint32_t k = 0; k < n; k++) {
+                    if (sub[first + k] != 0) collision = 1;
+                    sub[first + k] = entry;
+                }
+            }
+        }
+    }
+
+    if (collision) {
+        free_huffman_decoder(dec);
+        return FAILURE;
+    }
+    return SUCCESS;
+}
+
+int build_legacy_ac_decoder(Huffman_Decoder *dec) {
+    uint32_t codes[256];
+    int lengths[256];
+    uint8_t symbols[256];
+    int count = 0;
+
+    for (int i = 0; i < 162; i++) {
+        int zeros = ac_table[i].zeros, category = ac_table[i].category;
+        if ((zeros == 2 && category == 9) || (zeros == 14 && category == 10)) continue;
+
+        codes[count] = ac_table[i].code;
+        lengths[count] = ac_table[i].code_length;
+        if (zeros == 2 && category == 10) {
+            codes[count] = LEGACY_AC_2_10_CODE;
+            lengths[count] = LEGACY_AC_2_10_LENGTH;
+        }
+        symbols[count++] = (uint8_t)((zeros << 4) | category);
+    }
+
+    return build_huffman_decoder(dec, codes, lengths, symbols, count);
+}
+
+// Canonical codes of a table, in the order of its symbols; FAILURE if the lengths allow fewer codes
+static int spec_codes(const Huffman_Spec *spec, uint32_t *codes, int *lengths) {
+    uint32_t code = 0;
+    int n = 0;
+
+    for (int length = 1; length <= HUFFMAN_SPEC_MAX_LENGTH; length++) {
+        for (int k = 0; k < spec->counts[length - 1]; k++) {
+            if (code >= (1u << length)) return FAILURE;
+            codes[n] = code++;
+            lengths[n++] = length;
+        }
+        code <<= 1;
+    }
+
+    return n == spec->num_symbols ? SUCCESS : FAILURE;
+}
+
+int build_spec_decoder(Huffman_Decoder *dec, const Huffman_Spec *spec) {
+    uint32_t codes[256];
+    int lengths[256];
+
+    memset(dec, 0, sizeof(*dec));
+    if (spec_codes(spec, codes, lengths) != SUCCESS) return FAILURE;
+
+    return build_huffman_decoder(dec, codes, lengths, spec->symbols, spec->num_symbols);
+}
+
+void init_standard_huffman_encoder(Huffman_Encoder *codes) {
+    memset(codes, 0, sizeof(*codes));
+
+    for (int i = 0; i < 11; i++) {
+        codes->dc[dc_table[i].category] = (Huffman_Code){dc_table[i].code, dc_table[i].code_length};
+    }
+    for (int zeros = 0; zeros < 16; zeros++) {
+        for (int category = 0; category < AC_CATEGORIES; category++) {
+            codes->ac[zeros][category] = ac_encode_table[zeros][category];
+        }
+    }
+}
+
+int spec_huffman_encoder(Huffman_Encoder *codes, const Huffman_Spec *dc, const Huffman_Spec *ac) {
+    uint32_t dc_codes[256], ac_codes[256];
+    int dc_lengths[256], ac_lengths[256];
+
+    if (spec_codes(dc, dc_codes, dc_lengths) != SUCCESS || spec_codes(ac, ac_codes, ac_lengths) != SUCCESS) {
+        return FAILURE;
+    }
+
+    memset(codes, 0, sizeof(*codes));
+    for (int i = 0; i < dc->num_symbols; i++) {
+        if (dc->symbols[i] >= DC_CATEGORIES) return FAILURE;
+        codes->dc[dc->symbols[i]] = (Huffman_Code){dc_codes[i], dc_lengths[i]};
+    }
+    for (int i = 0; i < ac->num_symbols; i++) {
+        int zeros = ac->symbols[i] >> 4, category = ac->symbols[i] & 0x0F;
+        if (category >= AC_CATEGORIES) return FAILURE;
+        codes->ac[zeros][category] = (Huffman_Code){ac_codes[i], ac_lengths[i]};
+    }
+
+    return SUCCESS;
+}
+
+void build_huffman_spec(const uint64_t *counts, int num_symbols, Huffman_Spec *spec) {
+    uint64_t freq[256];
+    int code_size[256];
+    int others[256];        /* Next symbol of the same subtree, or -1 */
+    int bits[257] = {0};    /* Codes of each length, before limiting them to 16 bits */
+
+    for (int i = 0; i < num_symbols; i++) {
+        freq[i] = counts[i];
+        code_size[i] = 0;
+        others[i] = -1;
+    }
+
+    // Huffman algorithm: merge the two least frequent subtrees until one is left (Annex K, Figure K.1)
+    for (;;) {
+        int c1 = -1, c2 = -1;
+        for (int i = 0; i < num_symbols; i++) {
+            if (freq[i] == 0) continue;
+            if (c1 < 0 || freq[i] <= freq[c1]) {
+                c2 = c1;
+                c1 = i;
+            } else if (c2 < 0 || freq[i] <= freq[c2]) {
+                c2 = i;
+            }
+        }
+        if (c2 < 0) {
+            // A lone symbol still needs a 1-bit code
+            if (c1 >= 0 && code_size[c1] == 0) code_size[c1] = 1;
+            break;
+        }
+
+        freq[c1] += freq[c2];
+        freq[c2] = 0;
+
+        code_size[c1]++;
+        while (others[c1] >= 0) {
+            c1 = others[c1];
+            code_size[c1]++;
+        }
+        others[c1] = c2;
+
+        code_size[c2]++;
+        while (others[c2] >= 0) {
+            c2 = others[c2];
+            code_size[c2]++;
+        }
+    }
+
+    int max_length = 0;
+    for (int i = 0; i < num_symbols; i++) {
+        if (code_size[i] == 0) continue;
+        bits[code_size[i]]++;
+        if (code_size[i] > max_length) max_length = code_size[i];
+    }
+
+    // Shorten the longest codes: two codes of length i become one of length i - 1
+    // and, with a shorter code j moved down a level, two of length j + 1 (Figure K.3)
+    for (int i = max_length; i > HUFFMAN_SPEC_MAX_LENGTH; i--) {
+        while (bits[i] > 0) {
+            int j = i - 2;
+            while (bits[j] == 0) j--;
+
+            bits[i] -= 2;
+            bits[i - 1]++;
+            bits[j + 1] += 2;
+            bits[j]--;
+        }
+    }
+
+    // Symbols by increasing Huffman code length, then by value (Figure K.4)
+    spec->num_symbols = 0;
+    for (int length = 1; length <= max_length; length++) {
+        for (int i = 0; i < num_symbols; i++) {
+            if (code_size[i] == length) spec->symbols[spec->num_symbols++] = (uint8_t)i;
+        }
+    }
+    for (int length = 1; length <= HUFFMAN_SPEC_MAX_LENGTH; length++) {
+        spec->counts[length - 1] = (uint8_t)bits[length];
+    }
+}
+
+size_t huffman_spec_size(const Huffman_Spec *spec) {
+    return HUFFMAN_SPEC_MAX_LENGTH + (size_t)spec->num_symbols;
+}
+
+int write_huffman_spec(FILE *out, const Huffman_Spec *spec) {
+    if (fwrite(spec->counts, 1, HUFFMAN_SPEC_MAX_LENGTH, out) != HUFFMAN_SPEC_MAX_LENGTH ||
+        fwrite(spec->symbols, 1, spec->num_symbols, out) != (size_t)spec->num_symbols) {
+        return FAILURE;
+    }
+    return SUCCESS;
+}
+
+size_t parse_huffman_spec(const uint8_t *data, size_t size, int dc, Huffman_Spec *spec) {
+    if (size < HUFFMAN_SPEC_MAX_LENGTH) return 0;
+
+    memcpy(spec->counts, data, HUFFMAN_SPEC_MAX_LENGTH);
+    spec->num_symbols = 0;
+    for (int length = 0; length < HUFFMAN_SPEC_MAX_LENGTH; length++) {
+        spec->num_symbols += spec->counts[length];
+    }
+    if (spec->num_symbols > 256 || size - HUFFMAN_SPEC_MAX_LENGTH < (size_t)spec->num_symbols) return 0;
+    memcpy(spec->symbols, data + HUFFMAN_SPEC_MAX_LENGTH, spec->num_symbols);
+
+    uint8_t seen[256] = {0};
+    for (int i = 0; i < spec->num_symbols; i++) {
+        int symbol = spec->symbols[i];
+        int category = symbol & 0x0F;
+
+        // AC category 0 only exists as EOB (0/0) and ZRL (15/0)
+        int valid = dc ? symbol < DC_CATEGORIES
+                       : category < AC_CATEGORIES && (category != 0 || symbol == 0x00 || symbol == 0xF0);
+        if (!valid || seen[symbol]) return 0;
+        seen[symbol] = 1;
+    }
+
+    return huffman_spec_size(spec);
+}
+
+void count_rle_symbols(Symbol_Histogram *histogram, const RLE_coef *rle, int size) {
+    // Symbols out of range are left to write_rle_block() to report
+    if (rle[0].category < DC_CATEGORIES) histogram->dc[rle[0].category]++;
+
+    for (int j = 1; j < size; j++) {
+        if (rle[j].category < AC_CATEGORIES) histogram->ac[(rle[j].skip << 4) | rle[j].category]++;
+        if (rle[j].skip == 0 && rle[j].category == 0) break; // EOB
+    }
+}
+
+void count_coef_symbols(Symbol_Histogram *histogram, const int16_t *coef, int dc_diff) {
+    // Symbols out of range are left to write_coef_block() to report
+    int category = dc_diff != 0 ? value_category(dc_diff) : 0;
+    if (category < DC_CATEGORIES) histogram->dc[category]++;
+
+    int run = 0, zrl = 0, count = 1;
+    for (int k = 1; k < BLOCK_SIZE * BLOCK_SIZE; k++) {
+        int value = coef[k];
+        if (value == 0) {
+            if (++run == 16) {
+                zrl++;
+                count++;
+                if (k != 63) run = 0;
+            }
+            continue;
+        }
+
+        category = value_category(value);
+        histogram->ac[0xF0] += (uint64_t)zrl;
+        if (category < AC_CATEGORIES) histogram->ac[(run << 4) | category]++;
+        zrl = 0;
+        count++;
+        if (k != 63) run = 0;
+    }
+
+    if (run > 0 || count < 64) histogram->ac[0x00]++; // EOB
+}
+
+void add_symbol_histogram(Symbol_Histogram *total, const Symbol_Histogram *part) {
+    for (int i = 0; i < DC_CATEGORIES; i++) total->dc[i] += part->dc[i];
+    for (int i = 0; i < 256; i++) total->ac[i] += part->ac[i];
+}
+
+uint64_t histogram_code_bits(const Symbol_Histogram *histogram, const Huffman_Encoder *codes) {
+    uint64_t bits = 0;
+
+    for (int i = 0; i < DC_CATEGORIES; i++) {
+        if (histogram->dc[i] == 0) continue;
+        if (codes->dc[i].length == 0) return UINT64_MAX;
+        bits += histogram->dc[i] * (uint64_t)codes->dc[i].length;
+    }
+    for (int i = 0; i < 256; i++) {
+        if (histogram->ac[i] == 0) continue;
+        int category = i & 0x0F;
+        if (category >= AC_CATEGORIES || codes->ac[i >> 4][category].length == 0) return UINT64_MAX;
+        bits += histogram->ac[i] * (uint64_t)codes->ac[i >> 4][category].length;
+    }
+
+    return bits;
+}
+
+void free_huffman_decoder(Huffman_Decoder *dec) {
+    free(dec->sub);
+    dec->sub = NULL;
+}
@@ -1,4 +1,8 @@
+// posix_memalign()
+#define _POSIX_C_SOURCE 200112L
+
 #include "img_functions.h"
+#include "messages.h"
 
 void multiply_matrix(double A[BLOCK_SIZE][BLOCK_SIZE], double B[BLOCK_SIZE][BLOCK_SIZE], 
                           double C[BLOCK_SIZE][BLOCK_SIZE]) {
@@ -20,47 +24,134 @@ void transpose(double A[BLOCK_SIZE][BLOCK_SIZE], double B[BLOCK_SIZE][BLOCK_SIZE
     }
 }
 
-YCbCr_Pixel *rgb_to_YCrCb(RGB_Pixel *rgb, int total_pixels) {
-    YCbCr_Pixel *values = malloc(sizeof(YCbCr_Pixel) * total_pixels);
-    if (!values) return NULL;
+YCbCr_Planes *alloc_planes(int width, int height, int chroma_width, int chroma_height) {
+    YCbCr_Planes *planes = malloc(sizeof(YCbCr_Planes));
+    if (!planes) return NULL;
+
+    size_t chroma_size = (size_t)chroma_width * chroma_height;
+    planes->width = width;
+    planes->height = height;
+    planes->chroma_width = chroma_width;
+    planes->chroma_height = chroma_height;
+    planes->Y = malloc((size_t)width * height);
+    planes->Cb = malloc(chroma_size);
+    planes->Cr = malloc(chroma_size);
+
+    if (!planes->Y || !planes->Cb || !planes->Cr) {
+        free_planes(planes);
+        return NULL;
+    }
+
+    return planes;
+}
+
+void free_planes(YCbCr_Planes *planes) {
+    if (!planes) return;
+
+    free(planes->Y);
+    free(planes->Cb);
+    free(planes->Cr);
+    free(planes);
+}
+
+// Rounds up in 64 bits, so dimensions near INT_MAX do not overflow
+static int ceil_div(int value, int divisor) {
+    return (int)(((int64_t)value + divisor - 1) / divisor);
+}
+
+int plane_blocks(int width, int height) {
+    return ceil_div(width, BLOCK_SIZE) * ceil_div(height, BLOCK_SIZE);
+}
+
+void init_stream_layout(Stream_Layout *layout, int width, int height, unsigned short flags) {
+    layout->width = width;
+    layout->height = height;
+    layout->chroma_width = (flags & BIN_FLAG_CHROMA_420) ? ceil_div(width, 2) : width;
+    layout->chroma_height = (flags & BIN_FLAG_CHROMA_420) ? ceil_div(height, 2) : height;
+    layout->blocks_x = ceil_div(width, BLOCK_SIZE);
+    layout->blocks_y = ceil_div(height, BLOCK_SIZE);
+    layout->chroma_blocks_x = ceil_div(layout->chroma_width, BLOCK_SIZE);
+    layout->chroma_blocks_y = ceil_div(layout->chroma_height, BLOCK_SIZE);
+    layout->num_blocks = layout->blocks_x * layout->blocks_y;
+    layout->num_chroma_blocks = layout->chroma_blocks_x * layout->chroma_blocks_y;
+    layout->num_stripes = ceil_div(height, STRIPE_ROWS);
+    layout->restart_interval = 0;
+    layout->num_segments = 1;
+    layout->index_interval = 0;
+    layout->num_index_entries = 0;
+    layout->flags = flags & ~(BIN_FLAG_RESTART | BIN_FLAG_INDEX);
+}
 
-    for (int i = 0; i < total_pixels; i++) {
+void set_restart_interval(Stream_Layout *layout, int interval) {
+    if (interval > 0) {
+        layout->restart_interval = interval;
+        layout->num_segments = (layout->num_stripes + interval - 1) / interval;
+        layout->flags |= BIN_FLAG_RESTART;
+    } else {
+        layout->restart_interval = 0;
+        layout->num_segments = 1;
+        layout->flags &= ~BIN_FLAG_RESTART;
+    }
+}
 
-        values[i].Y  = 0.299 * rgb[i].r + 0.587 * rgb[i].g + 0.114 * rgb[i].b;
-        values[i].Cb = 0.564 * (rgb[i].b - values[i].Y);
-        values[i].Cr = 0.713 * (rgb[i].r - values[i].Y);
+void set_index_interval(Stream_Layout *layout, int interval) {
+    if (interval > 0) {
+        layout->index_interval = interval;
+        layout->num_index_entries = (layout->num_stripes + interval - 1) / interval;
+        layout->flags |= BIN_FLAG_INDEX;
+    } else {
+        layout->index_interval = 0;
+        layout->num_index_entries = 0;
+        layout->flags &= ~BIN_FLAG_INDEX;
     }
+}
 
-    return values;
+void downsample_row_pair(const uint8_t *row0, const uint8_t *row1, uint8_t *out, int width) {
+    int x = 0;
+    for (; x + 1 < width; x += 2) {
+        out[x / 2] = (uint8_t)((row0[x] + row0[x + 1] + row1[x] + row1[x + 1] + 2) >> 2);
+    }
+    if (x < width) out[x / 2] = (uint8_t)((row0[x] + row1[x] + 1) >> 1);
 }
 
-void subsample_4_2_0(YCbCr_Pixel *pixels_YCrCb, int width, int height) {
+YCbCr_Planes *rgb_to_YCrCb(RGB_Pixel *rgb, int width, int height) {
+    YCbCr_Planes *values = alloc_planes(width, height, (width + 1) / 2, (height + 1) / 2);
+    if (!values) return NULL;
+
+    // Full-resolution chroma for the two rows being converted
+    uint8_t *rows_Cb = malloc(2 * (size_t)width);
+    uint8_t *rows_Cr = malloc(2 * (size_t)width);
+    if (!rows_Cb || !rows_Cr) {
+        free(rows_Cb);
+        free(rows_Cr);
+        free_planes(values);
+        return NULL;
+    }
+
+    Color_Kernel kernel = detect_color_kernel();
+
     for (int y = 0; y < height; y += 2) {
-        for (int x = 0; x < width; x += 2) {
-            int i1 = (y) * width + (x);
-            int i2 = (y) * width + (x + 1);
-            int i3 = (y + 1) * width + (x);
-            int i4 = (y + 1) * width + (x + 1);
-
-            // Calcula média dos Cb e Cr dos 4 pixels
-            double cb_avg = (pixels_YCrCb[i1].Cb + pixels_YCrCb[i2].Cb +
-                             pixels_YCrCb[i3].Cb + pixels_YCrCb[i4].Cb) / 4.0;
-
-            double cr_avg = (pixels_YCrCb[i1].Cr + pixels_YCrCb[i2].Cr +
-                             pixels_YCrCb[i3].Cr + pixels_YCrCb[i4].Cr) / 4.0;
-
-            // Atribui a média aos 4 pixels
-            pixels_YCrCb[i1].Cb = cb_avg;
-            pixels_YCrCb[i2].Cb = cb_avg;
-            pixels_YCrCb[i3].Cb = cb_avg;
-            pixels_YCrCb[i4].Cb = cb_avg;
-
-            pixels_YCrCb[i1].Cr = cr_avg;
-            pixels_YCrCb[i2].Cr = cr_avg;
-            pixels_YCrCb[i3].Cr = cr_avg;
-            pixels_YCrCb[i4].Cr = cr_avg;
+        int rows = (y + 1 < height) ? 2 : 1;
+
+        for (int r = 0; r < rows; r++) {
+            size_t offset = (size_t)(y + r) * width;
+            rgb_to_ycbcr_planes(rgb + offset, values->Y + offset, rows_Cb + (size_t)r * width,
+                                rows_Cr + (size_t)r * width, width, kernel);
         }
+
+        // An odd last row pairs with itself
+        const uint8_t *second_Cb = rows_Cb + (size_t)(rows - 1) * width;
+        const uint8_t *second_Cr = rows_Cr + (size_t)(rows - 1) * width;
+        size_t chroma_offset = (size_t)(y / 2) * values->chroma_width;
+
+        downsample_row_pair(rows_Cb, second_Cb, values->Cb + chroma_offset, width);
+        downsample_row_pair(rows_Cr, second_Cr, values->Cr + chroma_offset, width);
     }
+
+    free(rows_Cb);
+    free(rows_Cr);
+
+    return values;
 }
 
 void apply_matrix_dct(double block[BLOCK_SIZE][BLOCK_SIZE], double dct[BLOCK_SIZE][BLOCK_SIZE], 
@@ -82,11 +173,11 @@ void quantize(double dct[BLOCK_SIZE][BLOCK_SIZE], const uint8_t matrix[BLOCK_SIZ
 }
 
 // compress = 0, decompress != 0
-void zigzag(int block[8][8], int v[64], int type) {
+void zigzag(int block[8][8], int16_t v[64], int type) {
     int i = 0, j = 0;
 
     for (int k = 0; k < 64; k++) {
-        if(type == 0) v[k] = block[i][j];
+        if(type == 0) v[k] = (int16_t)block[i][j];
         else block[i][j] = v[k];
 
         if ((i + j) % 2 == 0) {  // Direction: UP
@@ -111,22 +202,55 @@ void zigzag(int block[8][8], int v[64], int type) {
     }
 }
 
-void delta_encoding_DC(Blocks_ZigZag *blocks) {
-    if (blocks->num_blocks == 0) return;
+static int16_t *alloc_coef_slab(int num_blocks) {
+    void *slab = NULL;
+    size_t size = (size_t)num_blocks * BLOCK_SIZE * BLOCK_SIZE * sizeof(int16_t);
 
-    for (int i = blocks->num_blocks - 1; i > 0; i--) {
-        blocks->Y_blocks[i][0] -= blocks->Y_blocks[i - 1][0];
-        blocks->Cb_blocks[i][0] -= blocks->Cb_blocks[i - 1][0];
-        blocks->Cr_blocks[i][0] -= blocks->Cr_blocks[i - 1][0];
-    }
+    if (posix_memalign(&slab, COEF_SLAB_ALIGNMENT, size > 0 ? size : COEF_SLAB_ALIGNMENT) != 0) return NULL;
+    memset(slab, 0, size);
+    return slab;
 }
 
-RLE_coef* RLE_encode_AC(int *coef, int *out_size) {
-    RLE_coef *encoded = malloc(sizeof(RLE_coef) * 64);
-    if (!encoded) {
-        *out_size = 0;
+Blocks_ZigZag *alloc_BlocosZigZag(int num_blocks, int num_chroma_blocks, int with_last) {
+    Blocks_ZigZag *blocks = calloc(1, sizeof(Blocks_ZigZag));
+    if (!blocks) return NULL;
+
+    blocks->num_blocks = num_blocks;
+    blocks->num_chroma_blocks = num_chroma_blocks;
+    blocks->Y_blocks = alloc_coef_slab(num_blocks);
+    blocks->Cb_blocks = alloc_coef_slab(num_chroma_blocks);
+    blocks->Cr_blocks = alloc_coef_slab(num_chroma_blocks);
+    int ok = blocks->Y_blocks && blocks->Cb_blocks && blocks->Cr_blocks;
+
+    if (with_last && ok) {
+        blocks->Y_last = malloc(num_blocks * sizeof(int));
+        blocks->Cb_last = malloc(num_chroma_blocks * sizeof(int));
+        blocks->Cr_last = malloc(num_chroma_blocks * sizeof(int));
+        ok = blocks->Y_last && blocks->Cb_last && blocks->Cr_last;
+    }
+
+    if (!ok) {
+        free_BlocosZigZag(blocks);
         return NULL;
     }
+
+    return blocks;
+}
+
+// DC is the first coefficient of each 64-element block of the slab
+static void delta_encode_slab(int16_t *slab, int num_blocks) {
+    for (int i = num_blocks - 1; i > 0; i--) {
+        block_coefs(slab, i)[0] -= block_coefs(slab, i - 1)[0];
+    }
+}
+
+void delta_encoding_DC(Blocks_ZigZag *blocks) {
+    delta_encode_slab(blocks->Y_blocks, blocks->num_blocks);
+    delta_encode_slab(blocks->Cb_blocks, blocks->num_chroma_blocks);
+    delta_encode_slab(blocks->Cr_blocks, blocks->num_chroma_blocks);
+}
+
+int RLE_encode_AC(const int16_t *coef, RLE_coef *encoded) {
     int skip = 0;
     int val = coef[0];
     int cat = coef_category(coef[0]);
@@ -150,8 +274,9 @@ RLE_coef* RLE_encode_AC(int *coef, int *out_size) {
             if (i != 63) skip = 0;
         }
     }
-    // If the end of the vector is all zeros, add EOB
-    if (skip > 0) {
+    // If the end of the vector is all zeros, add EOB. The decoder reads symbols until an EOB
+    // or 64 symbols, so a block ending on a non-zero coefficient also needs one when shorter.
+    if (skip > 0 || count < 64) {
         encoded[count] = (RLE_coef){0, 0, 0}; // EOB
         if (encoded[count-1].skip == 15 && encoded[count-1].value == 0) {
             count--;
@@ -164,8 +289,7 @@ RLE_coef* RLE_encode_AC(int *coef, int *out_size) {
         count++;
     }
 
-    *out_size = count;
-    return encoded;
+    return count;
 }
 
 int coef_category(int value) {
@@ -180,67 +304,131 @@ int coef_category(int value) {
     return category;
 }
 
-RLE_coef **process_AC_coef(int **blocks, int num_blocks, int *sizes) {
-    RLE_coef **rle_results = malloc(num_blocks * sizeof(RLE_coef *));
-    if (!rle_results) return NULL;
+int write_rle_block(Bit_Read_Write *bw, const RLE_coef *rle, int size, const Huffman_Encoder *codes) {
+    int dc_value = rle[0].value;
+    int dc_category = rle[0].category;
 
-    for (int i = 0; i < num_blocks; i++) {
-        rle_results[i] = RLE_encode_AC(blocks[i], &sizes[i]);
-        if (!rle_results[i]) {
-            for (int j = 0; j < i; j++) {
-                free(rle_results[j]);
-            }
-            free(rle_results);
-            return NULL;
-        }
+    if (dc_category < 0 || dc_category >= DC_CATEGORIES || codes->dc[dc_category].length == 0) {
+        report_error("DC Huffman Prefix not found");
+        return FAILURE;
     }
-    return rle_results;
-}
 
-int decode_dc(Bit_Read_Write *br, int *category) {
-    char buffer[9] = {0}; // max prefix lenght = 8 bits
-    for (int i = 0; i < 8; i++) {
-        int bit = read_bit(br);
-        if (bit < 0) return 0;
-        buffer[i] = '0' + bit;
-        buffer[i + 1] = '\0';
+    // DC: prefix + value in bits, merged into a single write
+    const Huffman_Code *dc_code = &codes->dc[dc_category];
+    write_code(bw, (dc_code->code << dc_category) | complement1_bits(dc_value, dc_category),
+               dc_code->length + dc_category);
 
-        for (int j = 0; j < 11; j++) {
-            if (dc_table[j].prefix && strcmp(buffer, dc_table[j].prefix) == 0) {
-                *category = dc_table[j].category;
-                return 1;
-            }
+    // AC
+    for (int j = 1; j < size; j++) {
+        RLE_coef coef = rle[j];
+        if (coef.skip == 0 && coef.category == 0) {
+            write_code(bw, codes->ac[0][0].code, codes->ac[0][0].length); // EOB
+            break;
         }
+
+        if (coef.skip < 0 || coef.skip > 15 || coef.category < 0 || coef.category >= AC_CATEGORIES ||
+            codes->ac[coef.skip][coef.category].length == 0) {
+            report_error("AC Huffman Prefix not found");
+            return FAILURE;
+        }
+
+        // Skip + category => prefix, followed by the value bits in the same write
+        const Huffman_Code *ac_code = &codes->ac[coef.skip][coef.category];
+        write_code(bw, (ac_code->code << coef.category) | complement1_bits(coef.value, coef.category),
+                   ac_code->length + coef.category);
     }
-    return 0;
+
+    return SUCCESS;
 }
 
-int decode_ac(Bit_Read_Write *br, int *skip, int *category) {
-    char buffer[27] = {0}; // max prefix lenght = 26 bits
-    for (int i = 0; i < 26; i++) {
-        int bit = read_bit(br);
-        if (bit < 0) return 0;
-        buffer[i] = '0' + bit;
-        buffer[i + 1] = '\0';
+int write_coef_block(Bit_Read_Write *bw, const int16_t *coef, int dc_diff, const Huffman_Encoder *codes,
+                     Pipeline_Stats *stats) {
+    int category = dc_diff != 0 ? value_category(dc_diff) : 0;
+    if (category >= DC_CATEGORIES || codes->dc[category].length == 0) {
+        report_error("DC Huffman Prefix not found");
+        return FAILURE;
+    }
 
-        for (int j = 0; j < 162; j++) {
-            if (ac_table[j].prefix && strcmp(buffer, ac_table[j].prefix) == 0) {
-                *skip = ac_table[j].zeros;
-                *category = ac_table[j].category;
-                return 1;
+    const Huffman_Code *code = &codes->dc[category];
+    write_code(bw, (code->code << category) | complement1_bits(dc_diff, category), code->length + category);
+
+    // Same symbols as RLE_encode_AC(): a ZRL after every 16 zeros, dropped before the EOB
+    const Huffman_Code *zrl_code = &codes->ac[15][0];
+    int run = 0, zrl = 0, count = 1, written_zrl = 0;
+    for (int k = 1; k < BLOCK_SIZE * BLOCK_SIZE; k++) {
+        int value = coef[k];
+        if (value == 0) {
+            if (++run == 16) {
+                zrl++;
+                count++;
+                if (k != 63) run = 0;
             }
+            continue;
+        }
+
+        category = value_category(value);
+        if (category >= AC_CATEGORIES || codes->ac[run][category].length == 0 ||
+            (zrl > 0 && zrl_code->length == 0)) {
+            report_error("AC Huffman Prefix not found");
+            return FAILURE;
         }
+
+        for (written_zrl += zrl; zrl > 0; zrl--) write_code(bw, zrl_code->code, zrl_code->length);
+        code = &codes->ac[run][category];
+        write_code(bw, (code->code << category) | complement1_bits(value, category), code->length + category);
+        count++;
+        if (k != 63) run = 0;
+    }
+
+    // Pending ZRLs are only left when the block ends on zeros, which takes an EOB
+    int eob = run > 0 || count < 64;
+    if (eob) write_code(bw, codes->ac[0][0].code, codes->ac[0][0].length);
+
+    if (stats) {
+        stats->blocks++;
+        stats->symbols += (uint64_t)(count - zrl + eob);
+        stats->zrl_symbols += (uint64_t)written_zrl;
+        stats->eob_blocks += (uint64_t)eob;
     }
-    return 0;
+    return SUCCESS;
+}
+
+int decode_dc(Bit_Read_Write *br, const Huffman_Decoder *dc_dec, int *category) {
+    int symbol = decode_symbol(br, dc_dec);
+    if (symbol < 0) return 0;
+
+    *category = symbol;
+    return 1;
+}
+
+int decode_ac(Bit_Read_Write *br, const Huffman_Decoder *ac_dec, int *skip, int *category) {
+    int symbol = decode_symbol(br, ac_dec);
+    if (symbol < 0) return 0;
+
+    *skip = symbol >> 4;
+    *category = symbol & 0x0F;
+    return 1;
 }
 
-RLE_coef *read_rle_block(Bit_Read_Write *br, int *size) {
+RLE_coef *read_rle_block(Bit_Read_Write *br, const Huffman_Decoder *dc_dec,
+                         const Huffman_Decoder *ac_dec, int *size) {
     RLE_coef *coefs = malloc(64 * sizeof(RLE_coef));
+    if (!coefs) return NULL;
+
+    if (read_rle_symbols(br, dc_dec, ac_dec, coefs, size) != SUCCESS) {
+        free(coefs);
+        return NULL;
+    }
+    return coefs;
+}
+
+int read_rle_symbols(Bit_Read_Write *br, const Huffman_Decoder *dc_dec,
+                     const Huffman_Decoder *ac_dec, RLE_coef *coefs, int *size) {
     int index = 0;
 
     // DC
     int category;
-    if (!decode_dc(br, &category)) return NULL;
+    if (!decode_dc(br, dc_dec, &category)) return FAILURE;
 
     int value = 0;
     if (category > 0) {
@@ -252,7 +440,7 @@ RLE_coef *read_rle_block(Bit_Read_Write *br, int *size) {
     // AC
     while (index < 64) {
         int skip, cat;
-        if (!decode_ac(br, &skip, &cat)) return NULL;
+        if (!decode_ac(br, ac_dec, &skip, &cat)) return FAILURE;
 
         if (skip == 0 && cat == 0) { // EOB
             coefs[index++] = (RLE_coef){0, 0, 0};
@@ -265,22 +453,33 @@ RLE_coef *read_rle_block(Bit_Read_Write *br, int *size) {
     }
 
     *size = index;
-    return coefs;
+    return SUCCESS;
 }
 
-void delta_decoding(Blocks_ZigZag *blocks) {
-    if (blocks->num_blocks == 0) return;
+// Prefix sum of the DC values; 'segment_blocks' > 0 restarts it every that many blocks
+static void delta_decode_slab(int16_t *slab, int num_blocks, int segment_blocks) {
+    for (int i = 1; i < num_blocks; i++) {
+        if (segment_blocks > 0 && i % segment_blocks == 0) continue;
+        block_coefs(slab, i)[0] += block_coefs(slab, i - 1)[0];
+    }
+}
 
-    for (int i = 1; i < blocks->num_blocks; i++) {
-        blocks->Y_blocks[i][0] += blocks->Y_blocks[i - 1][0];
-        blocks->Cb_blocks[i][0] += blocks->Cb_blocks[i - 1][0];
-        blocks->Cr_blocks[i][0] += blocks->Cr_blocks[i - 1][0];
+void delta_decoding(Blocks_ZigZag *blocks, const Stream_Layout *layout) {
+    // A segment covers whole block rows: two Y rows and one Cb/Cr row per stripe
+    int segment_blocks = 0, chroma_segment_blocks = 0;
+    if (layout->restart_interval > 0) {
+        segment_blocks = layout->restart_interval * 2 * layout->blocks_x;
+        chroma_segment_blocks = layout->restart_interval * layout->chroma_blocks_x;
     }
+
+    delta_decode_slab(blocks->Y_blocks, blocks->num_blocks, segment_blocks);
+    delta_decode_slab(blocks->Cb_blocks, blocks->num_chroma_blocks, chroma_segment_blocks);
+    delta_decode_slab(blocks->Cr_blocks, blocks->num_chroma_blocks, chroma_segment_blocks);
 }
 
-int *rle_to_block(RLE_coef *rle, int size) {
-    int *block = calloc(64, sizeof(int));
+void rle_to_block(RLE_coef *rle, int size, int16_t *block, int *last) {
     int index = 0;
+    int last_index = 0;
 
     for (int i = 0; i < size && index < 64; i++) {
 
@@ -291,10 +490,11 @@ int *rle_to_block(RLE_coef *rle, int size) {
         index += coef.skip;
         if (index >= 64) break;
 
-        block[index++] = coef.value;
+        if (coef.value != 0) last_index = index;
+        block[index++] = (int16_t)coef.value;
     }
 
-    return block;
+    if (last) *last = last_index;
 }
 
 void dequantize(int input[BLOCK_SIZE][BLOCK_SIZE], const uint8_t matrix[BLOCK_SIZE][BLOCK_SIZE],
@@ -316,43 +516,115 @@ void apply_matrix_idct(double dct[BLOCK_SIZE][BLOCK_SIZE], double block[BLOCK_SI
     multiply_matrix(temp, (double (*)[BLOCK_SIZE])C, block);   // block = temp * C
 }
 
-RGB_Pixel *YCbCr_to_rgb(YCbCr_Pixel *ycbcr, int total_pixels) {
-    RGB_Pixel *rgb = malloc(sizeof(RGB_Pixel) * total_pixels);
-    if (!rgb) return NULL;
+void upsample_row_h2v2(const uint8_t *near, const uint8_t *far, int chroma_width, uint8_t *out, int width) {
+    for (int i = 0; i < chroma_width; i++) {
+        int prev = (i > 0) ? i - 1 : i;
+        int next = (i + 1 < chroma_width) ? i + 1 : i;
 
-    for (int i = 0; i < total_pixels; i++) {
-        double Y  = ycbcr[i].Y;
-        double Cb = ycbcr[i].Cb;
-        double Cr = ycbcr[i].Cr;
+        // Vertical pass (x4), then horizontal pass (x4) with the 3:1 weights of the nearest samples
+        int center = 3 * near[i] + far[i];
+        int left = 3 * near[prev] + far[prev];
+        int right = 3 * near[next] + far[next];
 
-        double R = Y + 1.402 * Cr;
-        double G = Y - 0.344 * Cb - 0.714 * Cr;
-        double B = Y + 1.772 * Cb;
-        
-        rgb[i].r = (uint8_t)( (R > 255) ? 255 : ( (R < 0) ? 0 : round(R)) );
-        rgb[i].g = (uint8_t)( (G > 255) ? 255 : ( (G < 0) ? 0 : round(G)) );
-        rgb[i].b = (uint8_t)( (B > 255) ? 255 : ( (B < 0) ? 0 : round(B)) );
+        out[2 * i] = (uint8_t)((3 * center + left + 8) >> 4);
+        if (2 * i + 1 < width) out[2 * i + 1] = (uint8_t)((3 * center + right + 7) >> 4);
     }
+}
 
+void upsample_row_h2v2_range(const uint8_t *near, const uint8_t *far, int chroma_width, uint8_t *out,
+                             int first_x, int count) {
+    for (int k = 0; k < count; k++) {
+        int x = first_x + k;
+        int i = x / 2;
+
+        // Same weights as upsample_row_h2v2(): even samples lean left, odd samples right
+        int side = (x % 2 == 0) ? ((i > 0) ? i - 1 : i) : ((i + 1 < chroma_width) ? i + 1 : i);
+        int center = 3 * near[i] + far[i];
+        int neighbor = 3 * near[side] + far[side];
+
+        out[k] = (uint8_t)((3 * center + neighbor + ((x % 2 == 0) ? 8 : 7)) >> 4);
+    }
+}
+
+RGB_Pixel *YCbCr_to_rgb(YCbCr_Planes *ycbcr) {
+    int width = ycbcr->width;
+    int height = ycbcr->height;
+    RGB_Pixel *rgb = malloc(sizeof(RGB_Pixel) * (size_t)width * height);
+    if (!rgb) return NULL;
+
+    if (YCbCr_to_rgb_rows(ycbcr, (uint8_t *)rgb, (ptrdiff_t)width * (ptrdiff_t)sizeof(RGB_Pixel)) != SUCCESS) {
+        free(rgb);
+        return NULL;
+    }
     return rgb;
 }
 
-void free_BlocosZigZag(Blocks_ZigZag *blocks) {
-    for (int i = 0; i < blocks->num_blocks; i++) {
-        free(blocks->Y_blocks[i]);
-        free(blocks->Cb_blocks[i]);
-        free(blocks->Cr_blocks[i]);
+int YCbCr_to_rgb_rows(YCbCr_Planes *ycbcr, uint8_t *first_row, ptrdiff_t stride) {
+    int width = ycbcr->width;
+    int height = ycbcr->height;
+    Color_Kernel kernel = detect_color_kernel();
+
+    if (ycbcr->chroma_width == width && ycbcr->chroma_height == height) {
+        for (int y = 0; y < height; y++) {
+            size_t offset = (size_t)y * width;
+            ycbcr_planes_to_rgb(ycbcr->Y + offset, ycbcr->Cb + offset, ycbcr->Cr + offset,
+                                (RGB_Pixel *)(first_row + (ptrdiff_t)y * stride), width, kernel);
+        }
+        return SUCCESS;
+    }
+
+    uint8_t *row_Cb = malloc(width);
+    uint8_t *row_Cr = malloc(width);
+    if (!row_Cb || !row_Cr) {
+        free(row_Cb);
+        free(row_Cr);
+        return FAILURE;
     }
 
+    int chroma_width = ycbcr->chroma_width;
+    int last_row = ycbcr->chroma_height - 1;
+
+    for (int y = 0; y < height; y++) {
+        // Chroma samples sit between two luma rows: even rows lean on the row above, odd rows on the one below
+        int near = y / 2;
+        int far = (y % 2 == 0) ? near - 1 : near + 1;
+        if (far < 0) far = 0;
+        if (far > last_row) far = last_row;
+
+        size_t near_offset = (size_t)near * chroma_width;
+        size_t far_offset = (size_t)far * chroma_width;
+
+        upsample_row_h2v2(ycbcr->Cb + near_offset, ycbcr->Cb + far_offset, chroma_width, row_Cb, width);
+        upsample_row_h2v2(ycbcr->Cr + near_offset, ycbcr->Cr + far_offset, chroma_width, row_Cr, width);
+
+        ycbcr_planes_to_rgb(ycbcr->Y + (size_t)y * width, row_Cb, row_Cr,
+                            (RGB_Pixel *)(first_row + (ptrdiff_t)y * stride), width, kernel);
+    }
+
+    free(row_Cb);
+    free(row_Cr);
+
+    return SUCCESS;
+}
+
+void free_BlocosZigZag(Blocks_ZigZag *blocks) {
+    if (!blocks) return;
+
     free(blocks->Y_blocks);
     free(blocks->Cb_blocks);
     free(blocks->Cr_blocks);
+    free(blocks->Y_last);
+    free(blocks->Cb_last);
+    free(blocks->Cr_last);
     free(blocks);
 }
 
-void free_rle(RLE *rle, int num_blocks) {
+void free_rle(RLE *rle, int num_blocks, int num_chroma_blocks) {
     for (int i = 0; i < num_blocks; i++) {
         free(rle->Y_rle[i]);
+    }
+
+    for (int i = 0; i < num_chroma_blocks; i++) {
         free(rle->Cb_rle[i]);
         free(rle->Cr_rle[i]);
     }
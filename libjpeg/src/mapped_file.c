@@ -0,0 +1,149 @@
+// open(), fstat(), ftruncate(), mmap(), read() and write()
+#define _POSIX_C_SOURCE 200809L
+
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Bytes moved by each read() or write() when a file cannot be mapped
+#define IO_CHUNK_SIZE (4 * 1024 * 1024)
+
+// Reads the rest of a descriptor into a growing heap buffer
+static int read_whole(int fd, size_t size_hint, Mapped_File *file) {
+    // One spare byte, so that a file of the expected size is seen to end without growing the buffer
+    size_t capacity = size_hint > 0 ? size_hint + 1 : IO_CHUNK_SIZE;
+    size_t size = 0;
+    uint8_t *data = malloc(capacity);
+    if (!data) return FAILURE;
+
+    for (;;) {
+        if (size == capacity) {
+            uint8_t *grown = realloc(data, capacity * 2);
+            if (!grown) {
+                free(data);
+                return FAILURE;
+            }
+            data = grown;
+            capacity *= 2;
+        }
+
+        size_t want = capacity - size < IO_CHUNK_SIZE ? capacity - size : IO_CHUNK_SIZE;
+        ssize_t got = read(fd, data + size, want);
+        if (got < 0) {
+            free(data);
+            return FAILURE;
+        }
+        if (got == 0) break;
+        size += (size_t)got;
+    }
+
+    file->data = data;
+    file->size = size;
+    file->mapped = 0;
+    return SUCCESS;
+}
+
+int map_file(const char *path, Mapped_File *file) {
+    file->data = NULL;
+    file->size = 0;
+    file->mapped = 0;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return FAILURE;
+
+    struct stat st;
+    int status = fstat(fd, &st) == 0 ? SUCCESS : FAILURE;
+
+    if (status == SUCCESS && S_ISREG(st.st_mode) && st.st_size > 0 && (uint64_t)st.st_size <= SIZE_MAX) {
+        void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            // The file is read front to back, once
+            posix_madvise(data, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+            file->data = data;
+            file->size = (size_t)st.st_size;
+            file->mapped = 1;
+        }
+    }
+
+    if (status == SUCCESS && !file->mapped) {
+        size_t hint = (S_ISREG(st.st_mode) && st.st_size > 0) ? (size_t)st.st_size : 0;
+        status = read_whole(fd, hint, file);
+    }
+
+    close(fd);
+    return status;
+}
+
+void unmap_file(Mapped_File *file) {
+    if (!file->data) return;
+
+    if (file->mapped) munmap((void *)file->data, file->size);
+    else free((void *)file->data);
+
+    file->data = NULL;
+    file->size = 0;
+}
+
+int create_mapped_output(const char *path, size_t size, Mapped_Output *file) {
+    file->data = NULL;
+    file->size = size;
+    file->mapped = 0;
+    if (size == 0) return FAILURE;
+
+    file->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (file->fd < 0) return FAILURE;
+
+    // A shared writable mapping also needs read access; it is only asked for on regular files,
+    // since holding the read end of a pipe would keep writes from ever failing once its reader is gone
+    struct stat st;
+    int regular = fstat(file->fd, &st) == 0 && S_ISREG(st.st_mode);
+    if (regular) {
+        int fd = open(path, O_RDWR);
+        if (fd >= 0) {
+            close(file->fd);
+            file->fd = fd;
+        }
+    }
+
+    if (regular && ftruncate(file->fd, (off_t)size) == 0) {
+        void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, file->fd, 0);
+        if (data != MAP_FAILED) {
+            file->data = data;
+            file->mapped = 1;
+            return SUCCESS;
+        }
+    }
+
+    file->data = calloc(1, size);
+    if (!file->data) {
+        close(file->fd);
+        return FAILURE;
+    }
+    return SUCCESS;
+}
+
+int close_mapped_output(Mapped_Output *file) {
+    int status = SUCCESS;
+
+    if (file->mapped) {
+        if (munmap(file->data, file->size) != 0) status = FAILURE;
+    } else if (file->data) {
+        for (size_t done = 0; done < file->size;) {
+            size_t want = file->size - done < IO_CHUNK_SIZE ? file->size - done : IO_CHUNK_SIZE;
+            ssize_t put = write(file->fd, file->data + done, want);
+            if (put <= 0) {
+                status = FAILURE;
+                break;
+            }
+            done += (size_t)put;
+        }
+        free(file->data);
+    }
+
+    if (close(file->fd) != 0) status = FAILURE;
+    file->data = NULL;
+    return status;
+}
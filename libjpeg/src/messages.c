@@ -0,0 +1,29 @@
+#include "messages.h"
+
+#include <stdarg.h>
+
+// Longer messages are truncated
+#define MESSAGE_SIZE 256
+
+static Message_Handler message_handler = print_message;
+
+void print_message(const char *message) {
+    printf("%s\n", message);
+}
+
+void set_message_handler(Message_Handler handler) {
+    message_handler = handler;
+}
+
+void report_error(const char *format, ...) {
+    Message_Handler handler = message_handler;
+    if (!handler) return;
+
+    char message[MESSAGE_SIZE];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+
+    handler(message);
+}
@@ -0,0 +1,80 @@
+#include "quant.h"
+
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define QUANT_X86 1
+#include <immintrin.h>
+#endif
+
+static inline int16_t saturate_i16(int64_t v) {
+    return (int16_t)(v < INT16_MIN ? INT16_MIN : (v > INT16_MAX ? INT16_MAX : v));
+}
+
+static void quantize_zigzag_scalar(const int32_t *data, const int32_t *reciprocal, int16_t *coef) {
+    const int64_t half = (int64_t)1 << (FDCT_RECIPROCAL_BITS - 1);
+
+    for (int k = 0; k < BLOCK_SIZE * BLOCK_SIZE; k++) {
+        int64_t v = (int64_t)data[zigzag_order[k]] * reciprocal[k];
+        int64_t sign = v >> 63;                                             // 0 or -1
+        int64_t q = (((v ^ sign) - sign) + half) >> FDCT_RECIPROCAL_BITS;   // |v| rounded
+        coef[k] = saturate_i16((q ^ sign) - sign);
+    }
+}
+
+#ifdef QUANT_X86
+
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+// |data| * reciprocal on 8 lanes as two sets of 32x32 -> 64-bit products, rounded, then signed like data
+static TARGET_AVX2 void quantize_zigzag_avx2(const int32_t *data, const int32_t *reciprocal, int16_t *coef) {
+    const __m256i half = _mm256_set1_epi64x((int64_t)1 << (FDCT_RECIPROCAL_BITS - 1));
+
+    for (int k = 0; k < BLOCK_SIZE * BLOCK_SIZE; k += 8) {
+        __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(zigzag_order + k)));
+        __m256i value = _mm256_i32gather_epi32((const int *)data, index, 4);
+        __m256i magnitude = _mm256_abs_epi32(value);
+        __m256i recip = _mm256_loadu_si256((const __m256i *)(reciprocal + k));
+
+        __m256i even = _mm256_mul_epu32(magnitude, recip);
+        __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(magnitude, 32), _mm256_srli_epi64(recip, 32));
+        even = _mm256_srli_epi64(_mm256_add_epi64(even, half), FDCT_RECIPROCAL_BITS);
+        odd = _mm256_srli_epi64(_mm256_add_epi64(odd, half), FDCT_RECIPROCAL_BITS);
+
+        // The rounded magnitudes fit in 31 bits: even lanes keep their low half, odd lanes move up
+        __m256i q = _mm256_sign_epi32(_mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA), value);
+        __m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(q), _mm256_extracti128_si256(q, 1));
+        _mm_storeu_si128((__m128i *)(coef + k), packed);
+    }
+}
+
+#endif /* QUANT_X86 */
+
+Quant_Kernel detect_quant_kernel(void) {
+#ifdef QUANT_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return QUANT_KERNEL_AVX2;
+#endif
+    return QUANT_KERNEL_SCALAR;
+}
+
+void quantize_zigzag(const int32_t data[BLOCK_SIZE * BLOCK_SIZE], const int32_t reciprocal[BLOCK_SIZE * BLOCK_SIZE],
+                     int16_t coef[BLOCK_SIZE * BLOCK_SIZE], Quant_Kernel kernel) {
+    if (kernel == QUANT_KERNEL_AUTO) kernel = detect_quant_kernel();
+
+    switch (kernel) {
+#ifdef QUANT_X86
+        case QUANT_KERNEL_AVX2: quantize_zigzag_avx2(data, reciprocal, coef); break;
+#endif
+        default: quantize_zigzag_scalar(data, reciprocal, coef); break;
+    }
+}
+
+void dequantize_unzigzag(const int16_t coef[BLOCK_SIZE * BLOCK_SIZE], int last,
+                         const int32_t multiplier[BLOCK_SIZE * BLOCK_SIZE], int32_t data[BLOCK_SIZE * BLOCK_SIZE]) {
+    memset(data, 0, BLOCK_SIZE * BLOCK_SIZE * sizeof(int32_t));
+
+    for (int k = 0; k <= last; k++) {
+        data[zigzag_order[k]] = coef[k] * multiplier[k];
+    }
+}
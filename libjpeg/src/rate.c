@@ -0,0 +1,94 @@
+#include "rate.h"
+#include "img_functions.h"
+
+void init_symbol_costs(Symbol_Costs *costs, const Huffman_Encoder *codes) {
+    memset(costs, 0, sizeof(*costs));
+
+    for (int category = 0; category < DC_CATEGORIES; category++) {
+        if (codes->dc[category].length > 0) costs->dc[category] = (uint8_t)(codes->dc[category].length + category);
+    }
+    for (int zeros = 0; zeros < 16; zeros++) {
+        for (int category = 0; category < AC_CATEGORIES; category++) {
+            int length = codes->ac[zeros][category].length;
+            if (length > 0) costs->ac[zeros][category] = (uint8_t)(length + category);
+        }
+    }
+}
+
+void init_requant_table(Requant_Table *table, const uint8_t matrix[BLOCK_SIZE][BLOCK_SIZE]) {
+    for (int k = 0; k < BLOCK_SIZE * BLOCK_SIZE; k++) {
+        uint32_t divisor = matrix[zigzag_order[k] / BLOCK_SIZE][zigzag_order[k] % BLOCK_SIZE];
+        table->reciprocal[k] = (((uint64_t)1 << 32) + divisor - 1) / divisor;
+        table->half[k] = divisor / 2;
+    }
+}
+
+// round(value / divisor), exact for the 16-bit magnitudes of a block
+static inline int requantize(int value, const Requant_Table *table, int k) {
+    uint32_t magnitude = (uint32_t)(value < 0 ? -value : value) + table->half[k];
+    int quotient = (int)((magnitude * table->reciprocal[k]) >> 32);
+    return value < 0 ? -quotient : quotient;
+}
+
+void requantize_blocks(int16_t *slab, int num_blocks, const Requant_Table *table) {
+    for (int b = 0; b < num_blocks; b++) {
+        int16_t *coef = block_coefs(slab, b);
+        for (int k = 0; k < BLOCK_SIZE * BLOCK_SIZE; k++) {
+            coef[k] = (int16_t)requantize(coef[k], table, k);
+        }
+    }
+}
+
+void count_requantized_symbols(const int16_t *slab, int num_blocks, const Requant_Table *table,
+                               Symbol_Histogram *histogram, int *last_dc) {
+    for (int b = 0; b < num_blocks; b++) {
+        const int16_t *coef = block_coefs((int16_t *)slab, b);
+        int16_t block[BLOCK_SIZE * BLOCK_SIZE];
+        for (int k = 0; k < BLOCK_SIZE * BLOCK_SIZE; k++) {
+            block[k] = (int16_t)requantize(coef[k], table, k);
+        }
+
+        count_coef_symbols(histogram, block, (int16_t)(block[0] - *last_dc));
+        *last_dc = block[0];
+    }
+}
+
+uint64_t estimate_blocks_bits(const int16_t *slab, int num_blocks, const Requant_Table *table,
+                              const Symbol_Costs *costs, int *last_dc) {
+    uint64_t bits = 0;
+
+    for (int b = 0; b < num_blocks; b++) {
+        const int16_t *coef = block_coefs((int16_t *)slab, b);
+
+        int dc = requantize(coef[0], table, 0);
+        int diff = dc - *last_dc;
+        int category = diff != 0 ? value_category(diff) : 0;
+        *last_dc = dc;
+        if (category >= DC_CATEGORIES || costs->dc[category] == 0) return UINT64_MAX;
+        bits += costs->dc[category];
+
+        // Same symbols as RLE_encode_AC(): a ZRL after every 16 zeros, dropped before the EOB
+        int run = 0, zrl = 0, count = 1;
+        for (int k = 1; k < BLOCK_SIZE * BLOCK_SIZE; k++) {
+            int value = requantize(coef[k], table, k);
+            if (value == 0) {
+                if (++run == 16) {
+                    zrl++;
+                    count++;
+                    if (k != 63) run = 0;
+                }
+                continue;
+            }
+
+            category = value_category(value);
+            if (category >= AC_CATEGORIES || costs->ac[run][category] == 0) return UINT64_MAX;
+            bits += (uint64_t)zrl * costs->ac[15][0] + costs->ac[run][category];
+            zrl = 0;
+            count++;
+            if (k != 63) run = 0;
+        }
+        if (run > 0 || count < 64) bits += costs->ac[0][0];
+    }
+
+    return bits;
+}
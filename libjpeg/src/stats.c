@@ -0,0 +1,63 @@
+// clock_gettime()
+#define _POSIX_C_SOURCE 200809L
+
+#include "stats.h"
+
+#include <string.h>
+#include <time.h>
+
+static const char *stage_names[NUM_PIPELINE_STAGES] = {
+    "read", "color", "subsample", "transform", "rle", "huffman", "write"
+};
+
+void init_pipeline_stats(Pipeline_Stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+}
+
+void add_pipeline_stats(Pipeline_Stats *total, const Pipeline_Stats *part) {
+    for (int s = 0; s < NUM_PIPELINE_STAGES; s++) {
+        total->seconds[s] += part->seconds[s];
+    }
+    total->elapsed_seconds += part->elapsed_seconds;
+    total->pixels += part->pixels;
+    total->blocks += part->blocks;
+    total->eob_blocks += part->eob_blocks;
+    total->zrl_symbols += part->zrl_symbols;
+    total->symbols += part->symbols;
+}
+
+const char *pipeline_stage_name(Pipeline_Stage stage) {
+    return stage >= 0 && stage < NUM_PIPELINE_STAGES ? stage_names[stage] : "unknown";
+}
+
+double monotonic_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+void count_block_symbols(Pipeline_Stats *stats, const RLE_coef *rle, int size) {
+    stats->blocks++;
+    stats->symbols += (uint64_t)size;
+
+    // Entry 0 is the DC; an AC entry with no run and no category is the EOB
+    for (int i = 1; i < size; i++) {
+        if (rle[i].category != 0) continue;
+        if (rle[i].skip == 15) stats->zrl_symbols++;
+        else if (rle[i].skip == 0) stats->eob_blocks++;
+    }
+}
+
+void write_pipeline_stats_json(FILE *out, const Pipeline_Stats *stats) {
+    fprintf(out, "{\"elapsed_ms\": %.3f, \"mpix_per_s\": %.3f, \"stages_ms\": {", 1e3 * stats->elapsed_seconds,
+            stats->elapsed_seconds > 0 ? stats->pixels / stats->elapsed_seconds / 1e6 : 0.0);
+    for (int s = 0; s < NUM_PIPELINE_STAGES; s++) {
+        fprintf(out, "%s\"%s\": %.3f", s > 0 ? ", " : "", stage_names[s], 1e3 * stats->seconds[s]);
+    }
+
+    fprintf(out, "}, \"pixels\": %llu, \"blocks\": %llu, \"eob_blocks\": %llu, \"zrl_symbols\": %llu, "
+                 "\"symbols\": %llu, \"avg_symbols_per_block\": %.3f}",
+            (unsigned long long)stats->pixels, (unsigned long long)stats->blocks,
+            (unsigned long long)stats->eob_blocks, (unsigned long long)stats->zrl_symbols,
+            (unsigned long long)stats->symbols, stats->blocks > 0 ? (double)stats->symbols / stats->blocks : 0.0);
+}
@@ -0,0 +1,139 @@
+// pthreads and sysconf()
+#define _POSIX_C_SOURCE 200112L
+
+#include "thread_pool.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+struct Thread_Pool {
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;      /* Signaled when tasks are submitted or the pool stops */
+    pthread_cond_t work_done;       /* Signaled when the last task of a set completes */
+    Pool_Task task;
+    void *context;
+    int count;                      /* Tasks in the current set */
+    int next;                       /* Next index to hand out */
+    int done;                       /* Tasks completed */
+    int stop;
+    int num_threads;                /* Including the waiting caller */
+    int num_workers;
+    pthread_t *workers;
+};
+
+int available_cpus(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (int)cpus : 1;
+}
+
+int parse_thread_count(const char *text, int *threads) {
+    char *end;
+    long value = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || value < 0 || value > 1024) return FAILURE;
+
+    *threads = (int)value;
+    return SUCCESS;
+}
+
+// Claims and runs tasks until the current set is exhausted; called and returns with the lock held
+static void run_tasks(Thread_Pool *pool) {
+    while (pool->next < pool->count) {
+        int index = pool->next++;
+        Pool_Task task = pool->task;
+        void *context = pool->context;
+
+        pthread_mutex_unlock(&pool->lock);
+        task(context, index);
+        pthread_mutex_lock(&pool->lock);
+
+        if (++pool->done == pool->count) pthread_cond_broadcast(&pool->work_done);
+    }
+}
+
+static void *worker_main(void *arg) {
+    Thread_Pool *pool = arg;
+
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->stop) {
+        if (pool->next < pool->count) run_tasks(pool);
+        else pthread_cond_wait(&pool->work_ready, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+Thread_Pool *thread_pool_create(int num_threads) {
+    if (num_threads <= 0) num_threads = available_cpus();
+
+    Thread_Pool *pool = calloc(1, sizeof(Thread_Pool));
+    if (!pool) return NULL;
+
+    pool->num_threads = num_threads;
+    pool->workers = malloc((size_t)num_threads * sizeof(pthread_t));
+    if (!pool->workers) {
+        free(pool);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_ready, NULL);
+    pthread_cond_init(&pool->work_done, NULL);
+
+    for (int i = 0; i < num_threads - 1; i++) {
+        if (pthread_create(&pool->workers[i], NULL, worker_main, pool) != 0) {
+            thread_pool_destroy(pool);
+            return NULL;
+        }
+        pool->num_workers++;
+    }
+
+    return pool;
+}
+
+int thread_pool_size(const Thread_Pool *pool) {
+    return pool->num_threads;
+}
+
+void thread_pool_submit(Thread_Pool *pool, Pool_Task task, void *context, int count) {
+    thread_pool_wait(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->task = task;
+    pool->context = context;
+    pool->count = count;
+    pool->next = 0;
+    pool->done = 0;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void thread_pool_wait(Thread_Pool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    run_tasks(pool);
+    while (pool->done < pool->count) {
+        pthread_cond_wait(&pool->work_done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void thread_pool_destroy(Thread_Pool *pool) {
+    if (!pool) return;
+
+    thread_pool_wait(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->num_workers; i++) {
+        pthread_join(pool->workers[i], NULL);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work_ready);
+    pthread_cond_destroy(&pool->work_done);
+    free(pool->workers);
+    free(pool);
+}
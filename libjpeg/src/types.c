@@ -36,183 +36,218 @@ const double C[BLOCK_SIZE][BLOCK_SIZE] = {
     {0.098, -0.278,  0.416, -0.490,  0.490, -0.416,  0.278, -0.098}
 };
 
+// Zigzag scan order: entry k is the row-major index of the k-th coefficient
+const uint8_t zigzag_order[BLOCK_SIZE * BLOCK_SIZE] = {
+     0,  1,  8, 16,  9,  2,  3, 10,
+    17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34,
+    27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36,
+    29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46,
+    53, 60, 61, 54, 47, 55, 62, 63
+};
+
 // Provided DC Huffman Table
 const DC_Huffman_Code dc_table[11] = {
-    {0, "010", 3, 0},  
-    {1, "011", 4, 1},  
-    {2, "100", 5, 2},  
-    {3, "00", 5, 3},
-    {4, "101", 7, 4},
-    {5, "110", 8, 5},
-    {6, "1110", 10, 6},
-    {7, "11110", 12, 7},
-    {8, "111110", 14, 8},
-    {9, "1111110", 16, 9},
-    {10, "11111110", 18, 10}
+    {0, "010", 3, 0, 0x2, 3},  
+    {1, "011", 4, 1, 0x3, 3},  
+    {2, "100", 5, 2, 0x4, 3},  
+    {3, "00", 5, 3, 0x0, 2},
+    {4, "101", 7, 4, 0x5, 3},
+    {5, "110", 8, 5, 0x6, 3},
+    {6, "1110", 10, 6, 0xE, 4},
+    {7, "11110", 12, 7, 0x1E, 5},
+    {8, "111110", 14, 8, 0x3E, 6},
+    {9, "1111110", 16, 9, 0x7E, 7},
+    {10, "11111110", 18, 10, 0xFE, 8}
 };
 
-// Provided AC Huffman Table
+// Provided AC Huffman Table. The provided 2/10 and 14/10 codes (0x7FC7/15, a prefix of 2/9, and 0x1FFE4/17,
+// an extension of 14/8) could not be decoded; they take the two free 16-bit codes instead. Only quality
+// factors well above the default produce these categories, so default-quality files never use them.
 const AC_Huffman_Code ac_table[162] = {
-    {0, 0, "1010", 4},
-    {0, 1, "00", 3},
-    {0, 2, "01", 4},
-    {0, 3, "100", 6},
-    {0, 4, "1011", 8},
-    {0, 5, "11010", 10},
-    {0, 6, "111000", 12},
-    {0, 7, "1111000", 14},
-    {0, 8, "1111110110", 18},
-    {0, 9, "1111111110000010", 25},
-    {0, 10, "1111111110000011", 26},
-    {1, 1, "1100", 5},
-    {1, 2, "111001", 8},
-    {1, 3, "1111001", 10},
-    {1, 4, "111110110", 13},
-    {1, 5, "11111110110", 16},
-    {1, 6, "1111111110000100", 22},
-    {1, 7, "1111111110000101", 23},
-    {1, 8, "1111111110000110", 24},
-    {1, 9, "1111111110000111", 25},
-    {1, 10, "1111111110001000", 26},
-    {2, 1, "11011", 6},
-    {2, 2, "11111000", 10},
-    {2, 3, "1111110111", 13},
-    {2, 4, "1111111110001001", 20},
-    {2, 5, "1111111110001010", 21},
-    {2, 6, "1111111110001011", 22},
-    {2, 7, "1111111110001100", 23},
-    {2, 8, "1111111110001101", 24},
-    {2, 9, "1111111110001110", 25},
-    {2, 10, "111111111000111",26},
-    {3, 1, "111010", 7},
-    {3, 2, "111110111", 11},
-    {3, 3, "11111110111", 14},
-    {3, 4, "1111111110010000", 20},
-    {3, 5, "1111111110010001", 21},
-    {3, 6, "1111111110010010", 22},
-    {3, 7, "1111111110010011", 23},
-    {3, 8, "1111111110010100", 24},
-    {3, 9, "1111111110010101", 25},
-    {3, 10, "1111111110010110", 26},
-    {4, 1, "111011", 7},
-    {4, 2, "1111111000", 12},
-    {4, 3, "1111111110010111", 19},
-    {4, 4, "1111111110011000", 20},
-    {4, 5, "1111111110011001", 21},
-    {4, 6, "1111111110011010", 22},
-    {4, 7, "1111111110011011", 23},
-    {4, 8, "1111111110011100", 24},
-    {4, 9, "1111111110011101", 25},
-    {4, 10, "1111111110011110", 26},
-    {5, 1, "1111010", 8},
-    {5, 2, "1111111001", 12},
-    {5, 3, "1111111110011111", 19},
-    {5, 4, "1111111110100000", 20},
-    {5, 5, "1111111110100001", 21},
-    {5, 6, "1111111110100010", 22},
-    {5, 7, "1111111110100011", 23},
-    {5, 8, "1111111110100100", 24},
-    {5, 9, "1111111110100101", 25},
-    {5, 10, "1111111110100110", 26},
-    {6, 1, "1111011", 8},
-    {6, 2, "11111111000", 13},
-    {6, 3, "1111111110100111", 19},
-    {6, 4, "1111111110101000", 20},
-    {6, 5, "1111111110101001", 21},
-    {6, 6, "1111111110101010", 22},
-    {6, 7, "1111111110101011", 23},
-    {6, 8, "1111111110101100", 24},
-    {6, 9, "1111111110101101", 25},
-    {6, 10, "1111111110101110", 26},
-    {7, 1, "11111001", 9},
-    {7, 2, "11111111001", 13},
-    {7, 3, "1111111110101111", 19},
-    {7, 4, "1111111110110000", 20},
-    {7, 5, "1111111110110001", 21},
-    {7, 6, "1111111110110010", 22},
-    {7, 7, "1111111110110011", 23},
-    {7, 8, "1111111110110100", 24},
-    {7, 9, "1111111110110101", 25},
-    {7, 10, "1111111110110110", 26},
-    {8, 1, "11111010", 9},
-    {8, 2, "111111111000000", 17},
-    {8, 3, "1111111110110111", 19},
-    {8, 4, "1111111110111000", 20},
-    {8, 5, "1111111110111001", 21},
-    {8, 6, "1111111110111010", 22},
-    {8, 7, "1111111110111011", 23},
-    {8, 8, "1111111110111100", 24},
-    {8, 9, "1111111110111101", 25},
-    {8, 10, "1111111110111110", 26},
-    {9, 1, "111111000", 10},
-    {9, 2, "1111111110111111", 18},
-    {9, 3, "1111111111000000", 19},
-    {9, 4, "1111111111000001", 20},
-    {9, 5, "1111111111000010", 21},
-    {9, 6, "1111111111000011", 22},
-    {9, 7, "1111111111000100", 23},
-    {9, 8, "1111111111000101", 24},
-    {9, 9, "1111111111000110", 25},
-    {9, 10, "1111111111000111", 26},
-    {10, 1, "111111001", 10},
-    {10, 2, "1111111111001000", 18},
-    {10, 3, "1111111111001001", 19},
-    {10, 4, "1111111111001010", 20},
-    {10, 5, "1111111111001011", 21},
-    {10, 6, "1111111111001100", 22},
-    {10, 7, "1111111111001101", 23},
-    {10, 8, "1111111111001110", 24},
-    {10, 9, "1111111111001111", 25},
-    {10, 10, "1111111111010000", 26},
-    {11, 1, "111111010", 10},
-    {11, 2, "1111111111010001", 18},
-    {11, 3, "1111111111010010", 19},
-    {11, 4, "1111111111010011", 20},
-    {11, 5, "1111111111010100", 21},
-    {11, 6, "1111111111010101", 22},
-    {11, 7, "1111111111010110", 23},
-    {11, 8, "1111111111010111", 24},
-    {11, 9, "1111111111011000", 25},
-    {11, 10, "1111111111011001", 26},
-    {12, 1, "1111111010", 11},
-    {12, 2, "1111111111011010", 18},
-    {12, 3, "1111111111011011", 19},
-    {12, 4, "1111111111011100", 20},
-    {12, 5, "1111111111011101", 21},
-    {12, 6, "1111111111011110", 22},
-    {12, 7, "1111111111011111", 23},
-    {12, 8, "1111111111100000", 24},
-    {12, 9, "1111111111100001", 25},
-    {12, 10, "1111111111100010", 26},
-    {13, 1, "11111111010", 12},
-    {13, 2, "1111111111100011", 18},
-    {13, 3, "1111111111100100", 19},
-    {13, 4, "1111111111100101", 20},
-    {13, 5, "1111111111100110", 21},
-    {13, 6, "1111111111100111", 22},
-    {13, 7, "1111111111101000", 23},
-    {13, 8, "1111111111101001", 24},
-    {13, 9, "1111111111101010", 25},
-    {13, 10, "1111111111101011", 26},
-    {14, 1, "111111110110", 13},
-    {14, 2, "1111111111101100", 18},
-    {14, 3, "1111111111101101", 19},
-    {14, 4, "1111111111101110", 20},
-    {14, 5, "1111111111101111", 21},
-    {14, 6, "1111111111110000", 22},
-    {14, 7, "1111111111110001", 23},
-    {14, 8, "1111111111110010", 24},
-    {14, 9, "1111111111110011", 25},
-    {14, 10, "11111111111100100", 26},
-    {15, 0, "111111110111", 12}, // Extensão de Zeros
-    {15, 1, "1111111111110101", 17},
-    {15, 2, "1111111111110110", 18},
-    {15, 3, "1111111111110111", 19},
-    {15, 4, "1111111111111000", 20},
-    {15, 5, "1111111111111001", 21},
-    {15, 6, "1111111111111010", 22},
-    {15, 7, "1111111111111011", 23},
-    {15, 8, "1111111111111100", 24},
-    {15, 9, "1111111111111101", 25},
-    {15, 10, "1111111111111110", 26}    
+    {0, 0, "1010", 4, 0xA, 4},
+    {0, 1, "00", 3, 0x0, 2},
+    {0, 2, "01", 4, 0x1, 2},
+    {0, 3, "100", 6, 0x4, 3},
+    {0, 4, "1011", 8, 0xB, 4},
+    {0, 5, "11010", 10, 0x1A, 5},
+    {0, 6, "111000", 12, 0x38, 6},
+    {0, 7, "1111000", 14, 0x78, 7},
+    {0, 8, "1111110110", 18, 0x3F6, 10},
+    {0, 9, "1111111110000010", 25, 0xFF82, 16},
+    {0, 10, "1111111110000011", 26, 0xFF83, 16},
+    {1, 1, "1100", 5, 0xC, 4},
+    {1, 2, "111001", 8, 0x39, 6},
+    {1, 3, "1111001", 10, 0x79, 7},
+    {1, 4, "111110110", 13, 0x1F6, 9},
+    {1, 5, "11111110110", 16, 0x7F6, 11},
+    {1, 6, "1111111110000100", 22, 0xFF84, 16},
+    {1, 7, "1111111110000101", 23, 0xFF85, 16},
+    {1, 8, "1111111110000110", 24, 0xFF86, 16},
+    {1, 9, "1111111110000111", 25, 0xFF87, 16},
+    {1, 10, "1111111110001000", 26, 0xFF88, 16},
+    {2, 1, "11011", 6, 0x1B, 5},
+    {2, 2, "11111000", 10, 0xF8, 8},
+    {2, 3, "1111110111", 13, 0x3F7, 10},
+    {2, 4, "1111111110001001", 20, 0xFF89, 16},
+    {2, 5, "1111111110001010", 21, 0xFF8A, 16},
+    {2, 6, "1111111110001011", 22, 0xFF8B, 16},
+    {2, 7, "1111111110001100", 23, 0xFF8C, 16},
+    {2, 8, "1111111110001101", 24, 0xFF8D, 16},
+    {2, 9, "1111111110001110", 25, 0xFF8E, 16},
+    {2, 10, "1111111110001111", 26, 0xFF8F, 16},
+    {3, 1, "111010", 7, 0x3A, 6},
+    {3, 2, "111110111", 11, 0x1F7, 9},
+    {3, 3, "11111110111", 14, 0x7F7, 11},
+    {3, 4, "1111111110010000", 20, 0xFF90, 16},
+    {3, 5, "1111111110010001", 21, 0xFF91, 16},
+    {3, 6, "1111111110010010", 22, 0xFF92, 16},
+    {3, 7, "1111111110010011", 23, 0xFF93, 16},
+    {3, 8, "1111111110010100", 24, 0xFF94, 16},
+    {3, 9, "1111111110010101", 25, 0xFF95, 16},
+    {3, 10, "1111111110010110", 26, 0xFF96, 16},
+    {4, 1, "111011", 7, 0x3B, 6},
+    {4, 2, "1111111000", 12, 0x3F8, 10},
+    {4, 3, "1111111110010111", 19, 0xFF97, 16},
+    {4, 4, "1111111110011000", 20, 0xFF98, 16},
+    {4, 5, "1111111110011001", 21, 0xFF99, 16},
+    {4, 6, "1111111110011010", 22, 0xFF9A, 16},
+    {4, 7, "1111111110011011", 23, 0xFF9B, 16},
+    {4, 8, "1111111110011100", 24, 0xFF9C, 16},
+    {4, 9, "1111111110011101", 25, 0xFF9D, 16},
+    {4, 10, "1111111110011110", 26, 0xFF9E, 16},
+    {5, 1, "1111010", 8, 0x7A, 7},
+    {5, 2, "1111111001", 12, 0x3F9, 10},
+    {5, 3, "1111111110011111", 19, 0xFF9F, 16},
+    {5, 4, "1111111110100000", 20, 0xFFA0, 16},
+    {5, 5, "1111111110100001", 21, 0xFFA1, 16},
+    {5, 6, "1111111110100010", 22, 0xFFA2, 16},
+    {5, 7, "1111111110100011", 23, 0xFFA3, 16},
+    {5, 8, "1111111110100100", 24, 0xFFA4, 16},
+    {5, 9, "1111111110100101", 25, 0xFFA5, 16},
+    {5, 10, "1111111110100110", 26, 0xFFA6, 16},
+    {6, 1, "1111011", 8, 0x7B, 7},
+    {6, 2, "11111111000", 13, 0x7F8, 11},
+    {6, 3, "1111111110100111", 19, 0xFFA7, 16},
+    {6, 4, "1111111110101000", 20, 0xFFA8, 16},
+    {6, 5, "1111111110101001", 21, 0xFFA9, 16},
+    {6, 6, "1111111110101010", 22, 0xFFAA, 16},
+    {6, 7, "1111111110101011", 23, 0xFFAB, 16},
+    {6, 8, "1111111110101100", 24, 0xFFAC, 16},
+    {6, 9, "1111111110101101", 25, 0xFFAD, 16},
+    {6, 10, "1111111110101110", 26, 0xFFAE, 16},
+    {7, 1, "11111001", 9, 0xF9, 8},
+    {7, 2, "11111111001", 13, 0x7F9, 11},
+    {7, 3, "1111111110101111", 19, 0xFFAF, 16},
+    {7, 4, "1111111110110000", 20, 0xFFB0, 16},
+    {7, 5, "1111111110110001", 21, 0xFFB1, 16},
+    {7, 6, "1111111110110010", 22, 0xFFB2, 16},
+    {7, 7, "1111111110110011", 23, 0xFFB3, 16},
+    {7, 8, "1111111110110100", 24, 0xFFB4, 16},
+    {7, 9, "1111111110110101", 25, 0xFFB5, 16},
+    {7, 10, "1111111110110110", 26, 0xFFB6, 16},
+    {8, 1, "11111010", 9, 0xFA, 8},
+    {8, 2, "111111111000000", 17, 0x7FC0, 15},
+    {8, 3, "1111111110110111", 19, 0xFFB7, 16},
+    {8, 4, "1111111110111000", 20, 0xFFB8, 16},
+    {8, 5, "1111111110111001", 21, 0xFFB9, 16},
+    {8, 6, "1111111110111010", 22, 0xFFBA, 16},
+    {8, 7, "1111111110111011", 23, 0xFFBB, 16},
+    {8, 8, "1111111110111100", 24, 0xFFBC, 16},
+    {8, 9, "1111111110111101", 25, 0xFFBD, 16},
+    {8, 10, "1111111110111110", 26, 0xFFBE, 16},
+    {9, 1, "111111000", 10, 0x1F8, 9},
+    {9, 2, "1111111110111111", 18, 0xFFBF, 16},
+    {9, 3, "1111111111000000", 19, 0xFFC0, 16},
+    {9, 4, "1111111111000001", 20, 0xFFC1, 16},
+    {9, 5, "1111111111000010", 21, 0xFFC2, 16},
+    {9, 6, "1111111111000011", 22, 0xFFC3, 16},
+    {9, 7, "1111111111000100", 23, 0xFFC4, 16},
+    {9, 8, "1111111111000101", 24, 0xFFC5, 16},
+    {9, 9, "1111111111000110", 25, 0xFFC6, 16},
+    {9, 10, "1111111111000111", 26, 0xFFC7, 16},
+    {10, 1, "111111001", 10, 0x1F9, 9},
+    {10, 2, "1111111111001000", 18, 0xFFC8, 16},
+    {10, 3, "1111111111001001", 19, 0xFFC9, 16},
+    {10, 4, "1111111111001010", 20, 0xFFCA, 16},
+    {10, 5, "1111111111001011", 21, 0xFFCB, 16},
+    {10, 6, "1111111111001100", 22, 0xFFCC, 16},
+    {10, 7, "1111111111001101", 23, 0xFFCD, 16},
+    {10, 8, "1111111111001110", 24, 0xFFCE, 16},
+    {10, 9, "1111111111001111", 25, 0xFFCF, 16},
+    {10, 10, "1111111111010000", 26, 0xFFD0, 16},
+    {11, 1, "111111010", 10, 0x1FA, 9},
+    {11, 2, "1111111111010001", 18, 0xFFD1, 16},
+    {11, 3, "1111111111010010", 19, 0xFFD2, 16},
+    {11, 4, "1111111111010011", 20, 0xFFD3, 16},
+    {11, 5, "1111111111010100", 21, 0xFFD4, 16},
+    {11, 6, "1111111111010101", 22, 0xFFD5, 16},
+    {11, 7, "1111111111010110", 23, 0xFFD6, 16},
+    {11, 8, "1111111111010111", 24, 0xFFD7, 16},
+    {11, 9, "1111111111011000", 25, 0xFFD8, 16},
+    {11, 10, "1111111111011001", 26, 0xFFD9, 16},
+    {12, 1, "1111111010", 11, 0x3FA, 10},
+    {12, 2, "1111111111011010", 18, 0xFFDA, 16},
+    {12, 3, "1111111111011011", 19, 0xFFDB, 16},
+    {12, 4, "1111111111011100", 20, 0xFFDC, 16},
+    {12, 5, "1111111111011101", 21, 0xFFDD, 16},
+    {12, 6, "1111111111011110", 22, 0xFFDE, 16},
+    {12, 7, "1111111111011111", 23, 0xFFDF, 16},
+    {12, 8, "1111111111100000", 24, 0xFFE0, 16},
+    {12, 9, "1111111111100001", 25, 0xFFE1, 16},
+    {12, 10, "1111111111100010", 26, 0xFFE2, 16},
+    {13, 1, "11111111010", 12, 0x7FA, 11},
+    {13, 2, "1111111111100011", 18, 0xFFE3, 16},
+    {13, 3, "1111111111100100", 19, 0xFFE4, 16},
+    {13, 4, "1111111111100101", 20, 0xFFE5, 16},
+    {13, 5, "1111111111100110", 21, 0xFFE6, 16},
+    {13, 6, "1111111111100111", 22, 0xFFE7, 16},
+    {13, 7, "1111111111101000", 23, 0xFFE8, 16},
+    {13, 8, "1111111111101001", 24, 0xFFE9, 16},
+    {13, 9, "1111111111101010", 25, 0xFFEA, 16},
+    {13, 10, "1111111111101011", 26, 0xFFEB, 16},
+    {14, 1, "111111110110", 13, 0xFF6, 12},
+    {14, 2, "1111111111101100", 18, 0xFFEC, 16},
+    {14, 3, "1111111111101101", 19, 0xFFED, 16},
+    {14, 4, "1111111111101110", 20, 0xFFEE, 16},
+    {14, 5, "1111111111101111", 21, 0xFFEF, 16},
+    {14, 6, "1111111111110000", 22, 0xFFF0, 16},
+    {14, 7, "1111111111110001", 23, 0xFFF1, 16},
+    {14, 8, "1111111111110010", 24, 0xFFF2, 16},
+    {14, 9, "1111111111110011", 25, 0xFFF3, 16},
+    {14, 10, "1111111111110100", 26, 0xFFF4, 16},
+    {15, 0, "111111110111", 12, 0xFF7, 12}, // Extensão de Zeros
+    {15, 1, "1111111111110101", 17, 0xFFF5, 16},
+    {15, 2, "1111111111110110", 18, 0xFFF6, 16},
+    {15, 3, "1111111111110111", 19, 0xFFF7, 16},
+    {15, 4, "1111111111111000", 20, 0xFFF8, 16},
+    {15, 5, "1111111111111001", 21, 0xFFF9, 16},
+    {15, 6, "1111111111111010", 22, 0xFFFA, 16},
+    {15, 7, "1111111111111011", 23, 0xFFFB, 16},
+    {15, 8, "1111111111111100", 24, 0xFFFC, 16},
+    {15, 9, "1111111111111101", 25, 0xFFFD, 16},
+    {15, 10, "1111111111111110", 26, 0xFFFE, 16}    
+};
+
+// AC Huffman codes indexed directly by [zeros][category] (same codes as 'ac_table').
+// Combinations without a code have length 0.
+const Huffman_Code ac_encode_table[16][11] = {
+    {{0xA, 4}, {0x0, 2}, {0x1, 2}, {0x4, 3}, {0xB, 4}, {0x1A, 5}, {0x38, 6}, {0x78, 7}, {0x3F6, 10}, {0xFF82, 16}, {0xFF83, 16}},
+    {{0x0, 0}, {0xC, 4}, {0x39, 6}, {0x79, 7}, {0x1F6, 9}, {0x7F6, 11}, {0xFF84, 16}, {0xFF85, 16}, {0xFF86, 16}, {0xFF87, 16}, {0xFF88, 16}},
+    {{0x0, 0}, {0x1B, 5}, {0xF8, 8}, {0x3F7, 10}, {0xFF89, 16}, {0xFF8A, 16}, {0xFF8B, 16}, {0xFF8C, 16}, {0xFF8D, 16}, {0xFF8E, 16}, {0xFF8F, 16}},
+    {{0x0, 0}, {0x3A, 6}, {0x1F7, 9}, {0x7F7, 11}, {0xFF90, 16}, {0xFF91, 16}, {0xFF92, 16}, {0xFF93, 16}, {0xFF94, 16}, {0xFF95, 16}, {0xFF96, 16}},
+    {{0x0, 0}, {0x3B, 6}, {0x3F8, 10}, {0xFF97, 16}, {0xFF98, 16}, {0xFF99, 16}, {0xFF9A, 16}, {0xFF9B, 16}, {0xFF9C, 16}, {0xFF9D, 16}, {0xFF9E, 16}},
+    {{0x0, 0}, {0x7A, 7}, {0x3F9, 10}, {0xFF9F, 16}, {0xFFA0, 16}, {0xFFA1, 16}, {0xFFA2, 16}, {0xFFA3, 16}, {0xFFA4, 16}, {0xFFA5, 16}, {0xFFA6, 16}},
+    {{0x0, 0}, {0x7B, 7}, {0x7F8, 11}, {0xFFA7, 16}, {0xFFA8, 16}, {0xFFA9, 16}, {0xFFAA, 16}, {0xFFAB, 16}, {0xFFAC, 16}, {0xFFAD, 16}, {0xFFAE, 16}},
+    {{0x0, 0}, {0xF9, 8}, {0x7F9, 11}, {0xFFAF, 16}, {0xFFB0, 16}, {0xFFB1, 16}, {0xFFB2, 16}, {0xFFB3, 16}, {0xFFB4, 16}, {0xFFB5, 16}, {0xFFB6, 16}},
+    {{0x0, 0}, {0xFA, 8}, {0x7FC0, 15}, {0xFFB7, 16}, {0xFFB8, 16}, {0xFFB9, 16}, {0xFFBA, 16}, {0xFFBB, 16}, {0xFFBC, 16}, {0xFFBD, 16}, {0xFFBE, 16}},
+    {{0x0, 0}, {0x1F8, 9}, {0xFFBF, 16}, {0xFFC0, 16}, {0xFFC1, 16}, {0xFFC2, 16}, {0xFFC3, 16}, {0xFFC4, 16}, {0xFFC5, 16}, {0xFFC6, 16}, {0xFFC7, 16}},
+    {{0x0, 0}, {0x1F9, 9}, {0xFFC8, 16}, {0xFFC9, 16}, {0xFFCA, 16}, {0xFFCB, 16}, {0xFFCC, 16}, {0xFFCD, 16}, {0xFFCE, 16}, {0xFFCF, 16}, {0xFFD0, 16}},
+    {{0x0, 0}, {0x1FA, 9}, {0xFFD1, 16}, {0xFFD2, 16}, {0xFFD3, 16}, {0xFFD4, 16}, {0xFFD5, 16}, {0xFFD6, 16}, {0xFFD7, 16}, {0xFFD8, 16}, {0xFFD9, 16}},
+    {{0x0, 0}, {0x3FA, 10}, {0xFFDA, 16}, {0xFFDB, 16}, {0xFFDC, 16}, {0xFFDD, 16}, {0xFFDE, 16}, {0xFFDF, 16}, {0xFFE0, 16}, {0xFFE1, 16}, {0xFFE2, 16}},
+    {{0x0, 0}, {0x7FA, 11}, {0xFFE3, 16}, {0xFFE4, 16}, {0xFFE5, 16}, {0xFFE6, 16}, {0xFFE7, 16}, {0xFFE8, 16}, {0xFFE9, 16}, {0xFFEA, 16}, {0xFFEB, 16}},
+    {{0x0, 0}, {0xFF6, 12}, {0xFFEC, 16}, {0xFFED, 16}, {0xFFEE, 16}, {0xFFEF, 16}, {0xFFF0, 16}, {0xFFF1, 16}, {0xFFF2, 16}, {0xFFF3, 16}, {0xFFF4, 16}},
+    {{0xFF7, 12}, {0xFFF5, 16}, {0xFFF6, 16}, {0xFFF7, 16}, {0xFFF8, 16}, {0xFFF9, 16}, {0xFFFA, 16}, {0xFFFB, 16}, {0xFFFC, 16}, {0xFFFD, 16}, {0xFFFE, 16}}
 };